@@ -28,6 +28,7 @@
 #include "ext/rapidjson/stringbuffer.h"
 #include "ext/rapidjson/writer.h"
 #include "dd_types.h"
+#include "binarydata.h"
 #include <unordered_map>
 #include <vector>
 #include <sstream>
@@ -114,8 +115,15 @@ namespace dd
     APIData(const JVal &jval);
 
     APIData(const APIData &ad)
-      :_data(ad._data)
+      :_data(ad._data),_bdata(ad._bdata)
     {}
+
+    APIData(APIData &&ad) noexcept
+      :_data(std::move(ad._data)),_bdata(std::move(ad._bdata))
+    {}
+
+    APIData& operator=(const APIData &ad) = default;
+    APIData& operator=(APIData &&ad) = default;
     
     /**
      * \brief destructor
@@ -161,6 +169,20 @@ namespace dd
       else return ""; // beware
     }
     
+    /**
+     * \brief get value from data object, without copy
+     * @param key string unique key
+     * @return reference to variant value, to an empty string if key is missing
+     */
+    inline const ad_variant_type& get_view(const std::string &key) const
+    {
+      static const ad_variant_type empty_val = std::string();
+      std::unordered_map<std::string,ad_variant_type>::const_iterator hit;
+      if ((hit=_data.find(key))!=_data.end())
+	return (*hit).second;
+      else return empty_val;
+    }
+    
     /**
      * \brief get vector container as variant value
      * @param key string unique value
@@ -169,8 +191,8 @@ namespace dd
     inline std::vector<APIData> getv(const std::string &key) const
     {
       visitor_vad vv;
-      vout v = mapbox::util::apply_visitor(vv,get(key));
-      return v._vad;
+      vout v = mapbox::util::apply_visitor(vv,get_view(key));
+      return std::move(v._vad);
     }
 
     /**
@@ -180,11 +202,27 @@ namespace dd
      */
     inline APIData getobj(const std::string &key) const
     {
-      visitor_vad vv;
-      vout v = mapbox::util::apply_visitor(vv,get(key));
-      if (v._vad.empty())
-	return APIData();
-      return v._vad.at(0);
+      return getobj_ref(key);
+    }
+
+    /**
+     * \brief get data object value, without copy
+     * @param key string unique value
+     * @return reference to object, to an empty object if key is missing or not an object
+     */
+    inline const APIData& getobj_ref(const std::string &key) const
+    {
+      static const APIData empty_obj;
+      const ad_variant_type &v = get_view(key);
+      if (v.is<mapbox::util::recursive_wrapper<APIData>>())
+	return v.get<mapbox::util::recursive_wrapper<APIData>>().get();
+      else if (v.is<mapbox::util::recursive_wrapper<std::vector<APIData>>>())
+	{
+	  const std::vector<APIData> &vad = v.get<mapbox::util::recursive_wrapper<std::vector<APIData>>>().get();
+	  if (!vad.empty())
+	    return vad.at(0);
+	}
+      return empty_obj;
     }
 
     /**
@@ -254,6 +292,14 @@ namespace dd
      * @param jval destination JSON value
      */
     void toJVal(JDoc &jd, JVal &jv) const;
+
+    /**
+     * \brief writes APIData as a JSON object straight to a rapidjson writer,
+     *        without building an intermediate JSON document
+     * @param writer rapidjson writer over any output stream
+     */
+    template<typename TWriter>
+      void toWriter(TWriter &writer) const;
     
   public:
     /**
@@ -281,8 +327,27 @@ namespace dd
     {
       return _data.empty();
     }
+
+    /**
+     * \brief attaches binary data elements, that bypass the variant types
+     * @param bdata binary data elements, shared with copies of this object
+     */
+    inline void set_binary_data(const std::shared_ptr<const BinaryData> &bdata)
+    {
+      _bdata = bdata;
+    }
+
+    /**
+     * \brief binary data elements, if any
+     * @return binary data elements or nullptr
+     */
+    inline std::shared_ptr<const BinaryData> binary_data() const
+    {
+      return _bdata;
+    }
     
     std::unordered_map<std::string,ad_variant_type> _data; /**< data as hashtable of variant types. */
+    std::shared_ptr<const BinaryData> _bdata; /**< binary data elements, e.g. raw images or tensors. */
   };
 
   /**
@@ -418,6 +483,76 @@ namespace dd
     JDoc *_jd = nullptr;
     JVal *_jv = nullptr;
   };
+
+  /**
+   * \brief visitor class for direct JSON serialization to a rapidjson writer
+   */
+  template<typename TWriter>
+    class visitor_rwriter : public mapbox::util::static_visitor<>
+  {
+  public:
+    visitor_rwriter(TWriter &writer):_writer(writer) {}
+    ~visitor_rwriter() {}
+
+    void process(const std::string &str)
+    {
+      _writer.String(str.c_str(),static_cast<rapidjson::SizeType>(str.size()));
+    }
+    void process(const int &i)
+    {
+      _writer.Int(i);
+    }
+    void process(const double &d)
+    {
+      _writer.Double(d);
+    }
+    void process(const bool &b)
+    {
+      _writer.Bool(b);
+    }
+    void process(const APIData &ad)
+    {
+      ad.toWriter(_writer);
+    }
+    template<typename T>
+      void process(const std::vector<T> &v)
+      {
+	_writer.StartArray();
+	for (size_t i=0;i<v.size();i++)
+	  process(static_cast<const T&>(v[i]));
+	_writer.EndArray(static_cast<rapidjson::SizeType>(v.size()));
+      }
+    void process(const std::vector<bool> &vb)
+    {
+      _writer.StartArray();
+      for (size_t i=0;i<vb.size();i++)
+	_writer.Bool(vb[i]);
+      _writer.EndArray(static_cast<rapidjson::SizeType>(vb.size()));
+    }
+
+    template<typename T>
+      void operator() (T &t)
+      {
+	process(t);
+      }
+
+    TWriter &_writer;
+  };
+
+  template<typename TWriter>
+    void APIData::toWriter(TWriter &writer) const
+    {
+      visitor_rwriter<TWriter> vrw(writer);
+      writer.StartObject();
+      auto hit = _data.begin();
+      while(hit!=_data.end())
+	{
+	  writer.Key((*hit).first.c_str(),static_cast<rapidjson::SizeType>((*hit).first.size()));
+	  mapbox::util::apply_visitor(vrw,(*hit).second);
+	  ++hit;
+	}
+      writer.EndObject(static_cast<rapidjson::SizeType>(_data.size()));
+    }
   
 }
 
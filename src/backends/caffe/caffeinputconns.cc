@@ -25,9 +25,13 @@
 
 #include "caffeinputconns.h"
 #include "utils/utils.hpp"
+#include "utils/pipeline.hpp"
 #include <boost/multi_array.hpp>
 #include <algorithm>
+#include <chrono>
+#include <mutex>
 #include <random>
+#include <thread>
 #ifdef USE_HDF5
 #include <H5Cpp.h>
 #endif // USE_HDF5
@@ -38,6 +42,47 @@ using namespace caffe;
 
 namespace dd
 {
+
+  // new db, written in batched transactions
+  static std::unique_ptr<db::DB> new_db(const std::string &dbfullname, const std::string &backend)
+  {
+    std::unique_ptr<db::DB> db(db::GetDB(backend));
+    db->Open(dbfullname.c_str(),db::NEW);
+    return db;
+  }
+
+  // sequential db key, keeps the db in listing order
+  static std::string db_key(const int &line_id, const std::string &fname)
+  {
+    const int kMaxKeyLength = 256;
+    char key_cstr[kMaxKeyLength];
+    int length = snprintf(key_cstr, kMaxKeyLength, "%08d_%s", line_id, fname.c_str());
+    return std::string(key_cstr, std::min(length,kMaxKeyLength-1));
+  }
+
+  int ImgCaffeInputFileConn::db_threads() const
+  {
+    if (_db_threads > 0)
+      return _db_threads;
+    int n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+  }
+
+  void ImgCaffeInputFileConn::db_progress(const std::string &dbfullname,
+					  const long int &count,
+					  const long int &total,
+					  const std::chrono::steady_clock::time_point &tstart)
+  {
+    double elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-tstart).count() / 1000.0;
+    double rate = elapsed > 0.0 ? count / elapsed : 0.0;
+    _logger->info("{}: processed {} / {} files, {} images/s",dbfullname,count,total,rate);
+    if (_add_meas)
+      {
+	_add_meas("db_images",count);
+	_add_meas("db_images_total",total);
+	_add_meas("db_images_per_sec",rate);
+      }
+  }
   
   void CaffeInputInterface::write_class_weights(const std::string &model_repo,
 						const APIData &ad_mllib)
@@ -360,53 +405,48 @@ namespace dd
 						const bool &encoded,
 						const std::string &encode_type)
   {
-    // Create new DB
-    std::unique_ptr<db::DB> db(db::GetDB(backend));
-    db->Open(dbfullname.c_str(), db::NEW);
-    std::unique_ptr<db::Transaction> txn(db->NewTransaction());
-    
-    // Storing to db
-    int count = 0;
-    const int kMaxKeyLength = 256;
-    char key_cstr[kMaxKeyLength];
-    
-    for (int line_id = 0; line_id < (int)lfiles.size(); ++line_id) {
-      Datum datum;
-      bool status;
-      std::string enc = encode_type;
-      if (encoded && !enc.size()) {
-	enc = guess_encoding(lfiles[line_id].first);
-      }
-      else if (!encoded)
-	enc = "";
-
-      status = ReadImageToDatum(lfiles[line_id].first,
-				lfiles[line_id].second, _height, _width, !_bw,
-				enc, &datum, this->_unchanged_data);
-      if (status == false) continue;
-      
-      // sequential
-      int length = snprintf(key_cstr, kMaxKeyLength, "%08d_%s", line_id,
-			    lfiles[line_id].first.c_str());
-
-      // put in db
-      std::string out;
-      if(!datum.SerializeToString(&out))
-	_logger->error("Failed serialization of datum for db storage");
-      txn->Put(string(key_cstr, length), out);
-      
-      if (++count % 1000 == 0) {
-	// commit db
-	txn->Commit();
-	txn.reset(db->NewTransaction());
-	_logger->info("Processed {} files",count);
-      }
-    }
+    // images are read and encoded in parallel, then written in order to the new db
+    DbTxnWriter<db::DB> writer(new_db(dbfullname,backend));
+    std::chrono::steady_clock::time_point tstart = std::chrono::steady_clock::now();
+    long int count = 0;
+    int next_line = 0;
+    OrderedPipeline<int,std::pair<std::string,std::string>> pipeline(db_threads(),4*db_threads());
+    pipeline.run([&](int &line_id)
+		 {
+		   if (next_line >= (int)lfiles.size())
+		     return false;
+		   line_id = next_line++;
+		   return true;
+		 },
+		 [&](int &line_id, std::pair<std::string,std::string> &record)
+		 {
+		   Datum datum;
+		   std::string enc = encode_type;
+		   if (encoded && !enc.size())
+		     enc = guess_encoding(lfiles[line_id].first);
+		   else if (!encoded)
+		     enc = "";
+		   if (!ReadImageToDatum(lfiles[line_id].first,
+					 lfiles[line_id].second, _height, _width, !_bw,
+					 enc, &datum, this->_unchanged_data))
+		     return false;
+		   record.first = db_key(line_id,lfiles[line_id].first);
+		   if (!datum.SerializeToString(&record.second))
+		     {
+		       _logger->error("Failed serialization of datum for db storage");
+		       return false;
+		     }
+		   return true;
+		 },
+		 [&](std::pair<std::string,std::string> &record)
+		 {
+		   writer.put(record.first,record.second);
+		   if (++count % 1000 == 0)
+		     db_progress(dbfullname,count,lfiles.size(),tstart);
+		 });
     // write the last batch
-    if (count % 1000 != 0) {
-      txn->Commit();
-      _logger->info("Processed {} files",count);
-    }
+    writer.commit();
+    db_progress(dbfullname,count,lfiles.size(),tstart);
   }
 
   void ImgCaffeInputFileConn::write_image_to_db_multilabel(const std::string &dbfullname,
@@ -415,59 +455,48 @@ namespace dd
 							   const bool &encoded,
 							   const std::string &encode_type)
   {
-    // Create new DB
-    std::unique_ptr<db::DB> db(db::GetDB(backend));
-    db->Open(dbfullname.c_str(), db::NEW);
-    std::unique_ptr<db::Transaction> txn(db->NewTransaction());
-    
-    // Storing to db
-    //Datum datum;
-    int count = 0;
-    const int kMaxKeyLength = 256;
-    char key_cstr[kMaxKeyLength];
-    
-    for (int line_id = 0; line_id < (int)lfiles.size(); ++line_id) {
-      Datum datum;
-      bool status;
-      std::string enc = encode_type;
-      if (encoded && !enc.size()) {
-	enc = guess_encoding(lfiles[line_id].first);
-      }
-      status = ReadImageToDatum(lfiles[line_id].first,
-				lfiles[line_id].second[0], _height, _width, !_bw, // XXX: passing first label, fixing labels below
-				enc, &datum);
-      if (status == false)
-	_logger->error("failed reading image {}",lfiles[line_id].first);
-      
-      // store multi labels into float_data in the datum (encoded image should be into data as bytes)
-      std::vector<float> labels = lfiles[line_id].second;
-      for (auto l: labels)
-	{
-	  datum.add_float_data(l);
-	}
-      
-      // sequential
-      int length = snprintf(key_cstr, kMaxKeyLength, "%08d_%s", line_id,
-			    lfiles[line_id].first.c_str());
-      
-      // put in db
-      std::string out;
-      if(!datum.SerializeToString(&out))
-	_logger->error("Failed serialization of datum for db storage");
-      txn->Put(string(key_cstr, length), out);
-      
-      if (++count % 1000 == 0) {
-	// commit db
-	txn->Commit();
-	txn.reset(db->NewTransaction());
-	_logger->info("Processed {} files",count);
-      }
-    }
+    DbTxnWriter<db::DB> writer(new_db(dbfullname,backend));
+    std::chrono::steady_clock::time_point tstart = std::chrono::steady_clock::now();
+    long int count = 0;
+    int next_line = 0;
+    OrderedPipeline<int,std::pair<std::string,std::string>> pipeline(db_threads(),4*db_threads());
+    pipeline.run([&](int &line_id)
+		 {
+		   if (next_line >= (int)lfiles.size())
+		     return false;
+		   line_id = next_line++;
+		   return true;
+		 },
+		 [&](int &line_id, std::pair<std::string,std::string> &record)
+		 {
+		   Datum datum;
+		   std::string enc = encode_type;
+		   if (encoded && !enc.size())
+		     enc = guess_encoding(lfiles[line_id].first);
+		   bool status = ReadImageToDatum(lfiles[line_id].first,
+						  lfiles[line_id].second[0], _height, _width, !_bw, // XXX: passing first label, fixing labels below
+						  enc, &datum);
+		   if (status == false)
+		     _logger->error("failed reading image {}",lfiles[line_id].first);
+
+		   // store multi labels into float_data in the datum (encoded image should be into data as bytes)
+		   for (auto l: lfiles[line_id].second)
+		     datum.add_float_data(l);
+
+		   record.first = db_key(line_id,lfiles[line_id].first);
+		   if (!datum.SerializeToString(&record.second))
+		     _logger->error("Failed serialization of datum for db storage");
+		   return true;
+		 },
+		 [&](std::pair<std::string,std::string> &record)
+		 {
+		   writer.put(record.first,record.second);
+		   if (++count % 1000 == 0)
+		     db_progress(dbfullname,count,lfiles.size(),tstart);
+		 });
     // write the last batch
-    if (count % 1000 != 0) {
-      txn->Commit();
-      _logger->info("Processed {} files",count);
-    }
+    writer.commit();
+    db_progress(dbfullname,count,lfiles.size(),tstart);
   }
 
   // - fixed size in-memory arrays put down to disk at once
@@ -827,112 +856,117 @@ namespace dd
 						  const std::string &backend,
 						  const bool &train)
   {
-
-    // Create new DB
-    std::unique_ptr<db::DB> db(db::GetDB(backend));
-    db->Open(dbfullname.c_str(), db::NEW);
-    std::unique_ptr<db::Transaction> txn(db->NewTransaction());
+    // annotated images are read in parallel, then written in order to the new db
+    DbTxnWriter<db::DB> writer(new_db(dbfullname,backend));
 
     // Storing to db
     AnnotatedDatum_AnnotationType type = AnnotatedDatum_AnnotationType_BBOX; 
 
-    int count = 0;
+    long int count = 0;
     int data_size = 0;
     bool data_size_initialized = false;
     int min_dim = 0;
     int max_dim = 0;
     std::string label_type = "txt";
-    bool status = true;
     bool check_size = false; // check whether all datum have the same size
-    std::vector<float> meanv;
     
-    std::map<std::string, int> name_to_label;
+    const std::map<std::string, int> name_to_label;
     std::string enc = encode_type;
-    
-    for (size_t line_id = 0; line_id < lines.size(); ++line_id)
+    if (encoded && !enc.size() && !lines.empty())
       {
-	AnnotatedDatum anno_datum;
-	Datum* datum = anno_datum.mutable_datum();
-	if (encoded && !enc.size())
-	  {
-	    // Guess the encoding type from the file name
-	    string fn = lines[line_id].first;
-	    size_t p = fn.rfind('.');
-	    if ( p == fn.npos )
-	      _logger->warn("failed to guess the encoding of '{}",fn);
-	    enc = fn.substr(p);
-	    std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
-	    _logger->info("using encoding {}",enc);
-	  }
-	std::string filename = lines[line_id].first;
-	std::string labelname = lines[line_id].second;
-	int width = db_width; // do not resize images is default
-	int height = db_height;
-	status = ReadRichImageToAnnotatedDatum(filename, labelname, height,
-					       width, min_dim, max_dim, !_bw, enc, type, label_type,
-					       name_to_label, &anno_datum);
-	anno_datum.set_type(AnnotatedDatum_AnnotationType_BBOX);
-	if (status == false)
-	  {
-	    _logger->error("failed to read {} or {}",lines[line_id].first,lines[line_id].second);
-	    throw InputConnectorBadParamException("failed to read " + lines[line_id].first + " or " + lines[line_id].second + " at line " + std::to_string(line_id));
-	  }
-	if (check_size)
-	  {
-	    if (!data_size_initialized)
-	      {
-		data_size = datum->channels() * datum->height() * datum->width();
-		data_size_initialized = true;
-	      }
-	    else
-	      {
-		const std::string& data = datum->data();
-	        if (static_cast<int>(data.size()) != data_size)
-		  {
-		    _logger->error("incorrect data field size {}",data.size());
-		    throw InputConnectorBadParamException("incorrect data field size " + std::to_string(data.size()));
-		  }
-	      }
-	  }
-
-	// compute the mean
-	if (train)
-	  {
-	    if (_mean_values.empty())
-	      _mean_values = std::vector<float>(datum->channels(),0.0);
-	    std::vector<float> lmeanv(datum->channels(),0.0);
-	    std::vector<cv::Mat> channels;
-	    cv::Mat img = cv::imread(lines[line_id].first);
-	    cv::split(img, channels);
-	    for (int d=0;d<datum->channels();d++) {
-	      lmeanv[d] = cv::mean(channels[d])[0];
-	      _mean_values[d] += lmeanv[d];
-	    }
-	  }
-	
-	// sequential
-	string key_str = caffe::format_int(line_id, 8) + "_" + lines[line_id].first;
-	
-	// Put in db
-	string out;
-	CHECK(anno_datum.SerializeToString(&out));
-	if (!anno_datum.SerializeToString(&out))
-	  _logger->error("Failed serialization of annotated datum for db storage");
-	txn->Put(key_str, out);
-	
-	if (++count % 1000 == 0) {
-	  // Commit db
-	  txn->Commit();
-	  txn.reset(db->NewTransaction());
-	  LOG(INFO) << "Processed " << count << " files.";
-	}
+	// Guess the encoding type from the first file name
+	string fn = lines[0].first;
+	size_t p = fn.rfind('.');
+	if ( p == fn.npos )
+	  _logger->warn("failed to guess the encoding of '{}",fn);
+	enc = fn.substr(p);
+	std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
+	_logger->info("using encoding {}",enc);
       }
+
+    struct objrecord
+    {
+      std::string _key;
+      std::string _value;
+      int _data_size = 0;
+      int _dim = 0;
+      std::vector<float> _meanv; /**< image mean values per channel. */
+    };
+    std::chrono::steady_clock::time_point tstart = std::chrono::steady_clock::now();
+    size_t next_line = 0;
+    OrderedPipeline<size_t,objrecord> pipeline(db_threads(),4*db_threads());
+    pipeline.run([&](size_t &line_id)
+		 {
+		   if (next_line >= lines.size())
+		     return false;
+		   line_id = next_line++;
+		   return true;
+		 },
+		 [&](size_t &line_id, objrecord &record)
+		 {
+		   AnnotatedDatum anno_datum;
+		   Datum* datum = anno_datum.mutable_datum();
+		   std::string filename = lines[line_id].first;
+		   std::string labelname = lines[line_id].second;
+		   int width = db_width; // do not resize images is default
+		   int height = db_height;
+		   bool status = ReadRichImageToAnnotatedDatum(filename, labelname, height,
+							       width, min_dim, max_dim, !_bw, enc, type, label_type,
+							       name_to_label, &anno_datum);
+		   anno_datum.set_type(AnnotatedDatum_AnnotationType_BBOX);
+		   if (status == false)
+		     {
+		       _logger->error("failed to read {} or {}",lines[line_id].first,lines[line_id].second);
+		       throw InputConnectorBadParamException("failed to read " + lines[line_id].first + " or " + lines[line_id].second + " at line " + std::to_string(line_id));
+		     }
+		   record._data_size = datum->data().size();
+		   record._dim = datum->channels() * datum->height() * datum->width();
+
+		   // compute the image mean
+		   if (train)
+		     {
+		       cv::Mat img = cv::imread(lines[line_id].first);
+		       cv::Scalar m = cv::mean(img);
+		       for (int d=0;d<datum->channels();d++)
+			 record._meanv.push_back(m[d]);
+		     }
+
+		   // sequential
+		   record._key = caffe::format_int(line_id, 8) + "_" + lines[line_id].first;
+		   if (!anno_datum.SerializeToString(&record._value))
+		     _logger->error("Failed serialization of annotated datum for db storage");
+		   return true;
+		 },
+		 [&](objrecord &record)
+		 {
+		   if (check_size)
+		     {
+		       if (!data_size_initialized)
+			 {
+			   data_size = record._dim;
+			   data_size_initialized = true;
+			 }
+		       else if (record._data_size != data_size)
+			 {
+			   _logger->error("incorrect data field size {}",record._data_size);
+			   throw InputConnectorBadParamException("incorrect data field size " + std::to_string(record._data_size));
+			 }
+		     }
+		   if (train)
+		     {
+		       if (_mean_values.empty())
+			 _mean_values = std::vector<float>(record._meanv.size(),0.0);
+		       for (size_t d=0;d<record._meanv.size() && d<_mean_values.size();d++)
+			 _mean_values[d] += record._meanv[d];
+		     }
+		   writer.put(record._key,record._value);
+		   if (++count % 1000 == 0)
+		     db_progress(dbfullname,count,lines.size(),tstart);
+		 });
   
     // write the last batch
-    if (count % 1000 != 0) {
-      txn->Commit();
-      LOG(INFO) << "Processed " << count << " files.";
-    }
+    writer.commit();
+    db_progress(dbfullname,count,lines.size(),tstart);
 
     // average the mean
     if (train)
@@ -974,10 +1008,10 @@ namespace dd
 
     std::unique_ptr<db::DB> db(db::GetDB(backend));
     db->Open(dbfullname.c_str(), db::READ);
+    long int total = db->Count();
     std::unique_ptr<db::Cursor> cursor(db->NewCursor());
 
     BlobProto sum_blob;
-    int count = 0;
     // load first datum
     Datum datum;
     datum.ParseFromString(cursor->value());
@@ -990,41 +1024,71 @@ namespace dd
     sum_blob.set_channels(datum.channels());
     sum_blob.set_height(datum.height());
     sum_blob.set_width(datum.width());
-    int size_in_datum = std::max<int>(datum.data().size(),
-				      datum.float_data_size());
+    const int size_in_datum = std::max<int>(datum.data().size(),
+					    datum.float_data_size());
+
+    // records are read in sequence and decoded in parallel, each worker
+    // summing into one of the partial sums
+    int nthreads = db_threads();
+    std::vector<std::vector<double>> sums(nthreads,std::vector<double>(size_in_datum,0.0));
+    std::vector<int> free_sums;
+    for (int t=0;t<nthreads;t++)
+      free_sums.push_back(t);
+    std::mutex sums_mutex;
+    std::chrono::steady_clock::time_point tstart = std::chrono::steady_clock::now();
+    long int count = 0;
+    OrderedPipeline<std::string,int> pipeline(nthreads,4*nthreads);
+    pipeline.run([&](std::string &value)
+		 {
+		   if (!cursor->valid())
+		     return false;
+		   value = cursor->value();
+		   cursor->Next();
+		   return true;
+		 },
+		 [&](std::string &value, int &dsize)
+		 {
+		   Datum datum;
+		   datum.ParseFromString(value);
+		   DecodeDatumNative(&datum);
+		   const std::string& data = datum.data();
+		   dsize = std::max<int>(data.size(),datum.float_data_size());
+		   if (dsize != size_in_datum)
+		     throw InputConnectorBadParamException("images of different sizes in db " + dbfullname + ", cannot compute mean image");
+		   int t = 0;
+		   {
+		     std::lock_guard<std::mutex> lock(sums_mutex);
+		     t = free_sums.back();
+		     free_sums.pop_back();
+		   }
+		   double *sum = sums.at(t).data();
+		   if (data.size() != 0)
+		     {
+		       for (int i = 0; i < dsize; ++i)
+			 sum[i] += (uint8_t)data[i];
+		     }
+		   else
+		     {
+		       for (int i = 0; i < dsize; ++i)
+			 sum[i] += static_cast<float>(datum.float_data(i));
+		     }
+		   std::lock_guard<std::mutex> lock(sums_mutex);
+		   free_sums.push_back(t);
+		   return true;
+		 },
+		 [&](int &dsize)
+		 {
+		   (void)dsize;
+		   if (++count % 10000 == 0)
+		     db_progress(dbfullname,count,total,tstart);
+		 });
+    db_progress(dbfullname,count,total,tstart);
+
     for (int i = 0; i < size_in_datum; ++i) {
-      sum_blob.add_data(0.);
-    }
-    while (cursor->valid()) {
-      Datum datum;
-      datum.ParseFromString(cursor->value());
-      DecodeDatumNative(&datum);
-      
-      const std::string& data = datum.data();
-      size_in_datum = std::max<int>(datum.data().size(),
-				    datum.float_data_size());
-      if (data.size() != 0) {
-	for (int i = 0; i < size_in_datum; ++i) {
-	  sum_blob.set_data(i, sum_blob.data(i) + (uint8_t)data[i]);
-	}
-      } else {
-	for (int i = 0; i < size_in_datum; ++i) {
-	  sum_blob.set_data(i, sum_blob.data(i) +
-			    static_cast<float>(datum.float_data(i)));
-	}
-      }
-      ++count;
-      if (count % 10000 == 0) {
-	_logger->info("Processed {} files",count);
-      }
-      cursor->Next();
-    }
-    
-    if (count % 10000 != 0) {
-      _logger->info("Processed {} files",count);
-    }
-    for (int i = 0; i < sum_blob.data_size(); ++i) {
-      sum_blob.set_data(i, sum_blob.data(i) / count);
+      double sum = 0.0;
+      for (int t = 0; t < nthreads; ++t)
+	sum += sums[t][i];
+      sum_blob.add_data(sum / count);
     }
     // Write to disk
     _logger->info("Write to {}",meanfile);
@@ -1173,6 +1237,7 @@ namespace dd
     _test_db_cursor = std::unique_ptr<caffe::db::Cursor>();
     _test_db = std::unique_ptr<caffe::db::DB>();
     _dt_seg = 0;
+    _fused_pos = 0;
   }
 
 
@@ -1408,6 +1473,8 @@ namespace dd
   void CSVCaffeInputFileConn::reset_dv_test()
   {
     _dt_vit = _dv_test.begin();
+    if (_stream)
+      reset_stream_test();
     _test_db_cursor = std::unique_ptr<caffe::db::Cursor>();
     _test_db = std::unique_ptr<caffe::db::DB>();
   }
@@ -2324,6 +2391,8 @@ namespace dd
   void SVMCaffeInputFileConn::reset_dv_test()
   {
     _dt_vit = _dv_test_sparse.begin();
+    if (_stream)
+      reset_stream_test();
     _test_db_cursor = std::unique_ptr<caffe::db::Cursor>();
     _test_db = std::unique_ptr<caffe::db::DB>();
   }
@@ -23,6 +23,7 @@
 #define CAFFEINPUTCONNS_H
 
 #include "imginputfileconn.h"
+#include "imgpreproc.h"
 #include "csvinputfileconn.h"
 #include "csvtsinputfileconn.h"
 #include "txtinputfileconn.h"
@@ -30,6 +31,7 @@
 #include "caffe/caffe.hpp"
 #include "caffe/util/db.hpp"
 #include "utils/fileops.hpp"
+#include <chrono>
 
 namespace dd
 {
@@ -67,6 +69,55 @@ namespace dd
 
     void reset_dv_test() {}
 
+    /**
+     * \brief whether training data is streamed from file, one batch at a time
+     */
+    bool streaming() const
+    {
+      return false;
+    }
+
+    /**
+     * \brief next batch of streamed training data
+     * @param num the size of the batch
+     * @return a vector of Caffe Datum
+     * @see CSVCaffeInputFileConn
+     */
+    std::vector<caffe::Datum> get_dv_stream(const int &num)
+      {
+	(void)num;
+	return std::vector<caffe::Datum>();
+      }
+
+    std::vector<caffe::SparseDatum> get_dv_stream_sparse(const int &num)
+      {
+	(void)num;
+	return std::vector<caffe::SparseDatum>();
+      }
+
+    /**
+     * \brief batch iterator over images already converted into the network input
+     *        layout, to be handed over to the input layer without copy
+     * @param num the max number of images in the batch
+     * @param data set to the first float of the batch
+     * @param labels set to the labels of the batch
+     * @return the number of images in the batch, 0 when exhausted or when not in use
+     * @see ImgPreproc
+     */
+    int get_fused_test(const int &num, float *&data, float *&labels)
+    {
+      if (_fused_pos >= _fused_n)
+	return 0;
+      int n = _fused_n - _fused_pos;
+      if (num > 0 && num < n)
+	n = num;
+      size_t dsize = static_cast<size_t>(_fused_channels) * _fused_height * _fused_width;
+      data = _fused_data.data() + _fused_pos * dsize;
+      labels = _fused_labels.data() + _fused_pos;
+      _fused_pos += n;
+      return n;
+    }
+
     // write class weights to binary proto
     void write_class_weights(const std::string &model_repo,
 			     const APIData &ad_mllib);
@@ -97,6 +148,15 @@ namespace dd
     int _timesteps = -1;  //default length for csv timeseries
     int _datadim = -1; //default size of vector data for timeseries
     int _ntargets = -1; // number of outputs for timeseries
+
+    float _fused_scale = 0.0; /**< input layer scale, > 0 when images can be converted straight into the input layer. */
+    int _fused_channels = 0; /**< input layer channels. */
+    int _fused_height = 0; /**< input layer height. */
+    int _fused_width = 0; /**< input layer width. */
+    std::vector<float> _fused_data; /**< images in input layer layout, when applicable. */
+    std::vector<float> _fused_labels; /**< labels of fused images. */
+    int _fused_n = 0; /**< number of fused images. */
+    int _fused_pos = 0; /**< fused images batch iterator. */
   };
 
   /**
@@ -108,9 +168,10 @@ namespace dd
     ImgCaffeInputFileConn()
       :ImgInputFileConn() {
       reset_dv_test();
+      _float_tensors = true;
     }
     ImgCaffeInputFileConn(const ImgCaffeInputFileConn &i)
-      :ImgInputFileConn(i),CaffeInputInterface(i) {/* _db = true;*/ }
+      :ImgInputFileConn(i),CaffeInputInterface(i),_db_threads(i._db_threads) {/* _db = true;*/ }
     ~ImgCaffeInputFileConn() {}
 
     // size of each element in Caffe jargon
@@ -146,6 +207,8 @@ namespace dd
 	return _db_testbatchsize;
       else if (!_dv_test.empty())
 	return _dv_test.size();
+      else if (_fused_n > 0)
+	return _fused_n;
       else return ImgInputFileConn::test_batch_size();
     }
 
@@ -164,6 +227,8 @@ namespace dd
 	_bbox = ad.get("bbox").get<bool>();
       if (ad.has("ctc"))
 	_ctc = ad.get("ctc").get<bool>();
+      if (ad.has("db_threads"))
+	_db_threads = ad.get("db_threads").get<int>();
     }
 
     void transform(const APIData &ad)
@@ -196,14 +261,12 @@ namespace dd
 	    {
 	      throw;
 	    }
-	  float *mean = nullptr;
 	  std::string meanfullname = _model_repo + "/" + _meanfname;
 	  if (_data_mean.count() == 0 && _has_mean_file)
 	    {
 	      caffe::BlobProto blob_proto;
 	      caffe::ReadProtoFromBinaryFile(meanfullname.c_str(),&blob_proto);
 	      _data_mean.FromProto(blob_proto);
-	      mean = _data_mean.mutable_cpu_data();
 	    }
 	  if (!_db_fname.empty())
 	    {
@@ -212,44 +275,57 @@ namespace dd
 	      return; // done
 	    }
 	  else _db = false;
-	  for (int i=0;i<(int)this->_images.size();i++)
-	    {      
-	      caffe::Datum datum;
-	      caffe::CVMatToDatum(this->_images.at(i),&datum);
-	      if (!_test_labels.empty())
-		datum.set_label(_test_labels.at(i));
-	      if (_data_mean.count() != 0)
-		{
-		  int height = datum.height();
-		  int width = datum.width();
-		  for (int c=0;c<datum.channels();++c)
-		    for (int h=0;h<height;++h)
-		      for (int w=0;w<width;++w)
-			{
-			  int data_index = (c*height+h)*width+w;
-			  float datum_element = static_cast<float>(static_cast<uint8_t>(datum.data()[data_index]));
-			  datum.add_float_data(datum_element - mean[data_index]);
-			}
-		  datum.clear_data();
-		}
-	      else if (_has_mean_scalar)
+
+	  ImgPreproc::Params pp;
+	  const float *dmean = _data_mean.count() != 0 ? _data_mean.cpu_data() : nullptr;
+	  if (dmean)
+	    pp._mean_img = dmean;
+	  else if (_has_mean_scalar)
+	    pp._mean = &_mean.at(0);
+	  if (fused_images(dmean))
+	    {
+	      // images go straight into the input layer layout, one pass per image
+	      int n = this->_images.size();
+	      size_t dsize = static_cast<size_t>(_fused_channels) * _fused_height * _fused_width;
+	      _fused_data.resize(n * dsize);
+	      _fused_labels.assign(n,0.0);
+	      pp._scale = _fused_scale;
+#pragma omp parallel for
+	      for (int i=0;i<n;i++)
+		ImgPreproc::convert(this->_images.at(i),_fused_data.data()+i*dsize,pp);
+	      for (int i=0;i<n;i++)
 		{
-		  int height = datum.height();
-		  int width = datum.width();
-		  for (int c=0;c<datum.channels();++c)
-		    for (int h=0;h<height;++h)
-		      for (int w=0;w<width;++w)
-			{
-			  int data_index = (c*height+h)*width+w;
-			  float datum_element = static_cast<float>(static_cast<uint8_t>(datum.data()[data_index]));
-			  datum.add_float_data(datum_element - _mean[c]);
-			}
-		  datum.clear_data();
+		  if (!_test_labels.empty())
+		    _fused_labels.at(i) = _test_labels.at(i);
+		  _ids.push_back(this->_uris.at(i));
+		  _imgs_size.insert(std::pair<std::string,std::pair<int,int>>(this->_uris.at(i),this->_images_size.at(i)));
 		}
-	      _dv_test.push_back(datum);
-	      _ids.push_back(this->_uris.at(i));
-	      _imgs_size.insert(std::pair<std::string,std::pair<int,int>>(this->_uris.at(i),this->_images_size.at(i)));
+	      _fused_n = n;
+	      _fused_pos = 0;
 	    }
+	  else
+	    for (int i=0;i<(int)this->_images.size();i++)
+	      {
+		caffe::Datum datum;
+		const cv::Mat &img = this->_images.at(i);
+		if (img.depth() == CV_32F || dmean || _has_mean_scalar)
+		  {
+		    // mean-subtracted float data, filled in a single pass
+		    int channels = img.channels();
+		    datum.set_channels(channels);
+		    datum.set_height(img.rows);
+		    datum.set_width(img.cols);
+		    google::protobuf::RepeatedField<float> *fdata = datum.mutable_float_data();
+		    fdata->Resize(channels*img.rows*img.cols,0.0);
+		    ImgPreproc::convert(img,fdata->mutable_data(),pp);
+		  }
+		else caffe::CVMatToDatum(img,&datum);
+		if (!_test_labels.empty())
+		  datum.set_label(_test_labels.at(i));
+		_dv_test.push_back(datum);
+		_ids.push_back(this->_uris.at(i));
+		_imgs_size.insert(std::pair<std::string,std::pair<int,int>>(this->_uris.at(i),this->_images_size.at(i)));
+	      }
 	  this->_images.clear();
 	  this->_images_size.clear();
 	}
@@ -282,6 +358,8 @@ namespace dd
 		    db_height = ad_input.get("db_height").get<int>();
 		  if (ad_input.has("db_width"))
 		    db_width = ad_input.get("db_width").get<int>();
+		  if (ad_input.has("db_threads"))
+		    _db_threads = ad_input.get("db_threads").get<int>();
 		  if (ad.has("autoencoder"))
 		    _autoencoder = ad.get("autoencoder").get<bool>();
 		}
@@ -455,6 +533,24 @@ namespace dd
     
   private:
 
+    /**
+     * \brief whether all images can be converted straight into the input layer,
+     *        i.e. the input layer was described and matches every image and the mean image
+     * @param dmean mean image, if any
+     */
+    bool fused_images(const float *dmean) const
+    {
+      if (_fused_scale <= 0.0 || this->_images.empty())
+	return false;
+      if (dmean && _data_mean.count() != _fused_channels * _fused_height * _fused_width)
+	return false;
+      for (const cv::Mat &img: this->_images)
+	if (img.channels() != _fused_channels || img.rows != _fused_height || img.cols != _fused_width
+	    || (img.depth() != CV_8U && img.depth() != CV_32F))
+	  return false;
+      return true;
+    }
+
     void create_test_db_for_imagedatalayer(const std::string &test_lst,
                                            const std::string &testdbname,
                                            const std::string &backend="lmdb", // lmdb, leveldb
@@ -516,6 +612,23 @@ namespace dd
 			    const std::string &backend="lmdb");
 
     std::string guess_encoding(const std::string &file);
+
+    /**
+     * \brief number of parallel workers when building dbs
+     */
+    int db_threads() const;
+
+    /**
+     * \brief logs db building progress and reports it as training job measures
+     * @param dbfullname db being built
+     * @param count number of processed images
+     * @param total number of images
+     * @param tstart db building start time
+     */
+    void db_progress(const std::string &dbfullname,
+		     const long int &count,
+		     const long int &total,
+		     const std::chrono::steady_clock::time_point &tstart);
     
   public:
     int _db_batchsize = -1;
@@ -531,6 +644,7 @@ namespace dd
     std::vector<std::pair<std::string,std::string>> _segmentation_data_lines;
     int _dt_seg = 0;
     bool _align = false;
+    int _db_threads = 0; /**< number of workers when building dbs, 0 for all cores. */
   };
 
   /**
@@ -596,6 +710,8 @@ namespace dd
     {
       if (_db_batchsize > 0)
 	return _db_batchsize;
+      else if (_stream)
+	return _stream_train_size;
       else return _dv.size();
     }
 
@@ -603,9 +719,16 @@ namespace dd
     {
       if (_db_testbatchsize > 0)
 	return _db_testbatchsize;
+      else if (_stream)
+	return _stream_test_size;
       else return _dv_test.size();
     }
 
+    bool streaming() const
+    {
+      return _stream;
+    }
+
     virtual void add_train_csvline(const std::string &id,
 				   std::vector<double> &vals);
 
@@ -625,6 +748,7 @@ namespace dd
 	  fillup_parameters(ad_input);
 	  get_data(ad);
 	  _db = true;
+	  _stream = false;
 	  csv_to_db(_model_repo + "/" + _dbname,_model_repo + "/" + _test_dbname,
 		    ad_input);
 	  write_class_weights(_model_repo,ad_mllib);
@@ -653,18 +777,7 @@ namespace dd
 	      auto hit = _csvdata.begin();
 	      while(hit!=_csvdata.end())
 		{
-		  if (_label.size() == 1)
-		    _dv.push_back(to_datum((*hit)._v));
-		  else // multi labels or autoencoder
-		    {
-		      caffe::Datum dat = to_datum((*hit)._v,true);
-		      for (size_t i=0;i<_label_pos.size();i++) // concat labels and slice them out in the network itself
-			{
-			  dat.add_float_data(static_cast<float>((*hit)._v.at(_label_pos[i])));
-			}
-		      dat.set_channels(dat.channels()+_label.size());
-		      _dv.push_back(dat);
-		    }
+		  _dv.push_back(to_datum_labels((*hit)._v));
 		  _ids.push_back((*hit)._str);
 		  ++hit;
 		}
@@ -684,18 +797,7 @@ namespace dd
 	  while(hit!=_csvdata_test.end())
 	    {
 	      // no ids taken on the test set
-	      if (_label.size() == 1)
-		_dv_test.push_back(to_datum((*hit)._v));
-	      else
-		{
-		  caffe::Datum dat = to_datum((*hit)._v,true);
-		  for (size_t i=0;i<_label_pos.size();i++)
-		    {
-		      dat.add_float_data(static_cast<float>((*hit)._v.at(_label_pos[i])));
-		    }
-		  dat.set_channels(dat.channels()+_label.size());
-		  _dv_test.push_back(dat);
-		}
+	      _dv_test.push_back(to_datum_labels((*hit)._v));
 	      if (!_train)
 		_ids.push_back((*hit)._str);
 	      ++hit;
@@ -709,7 +811,16 @@ namespace dd
 					  const bool &has_mean_file)
       {
 	(void)has_mean_file;
-	if (!_db)
+	if (_stream)
+	  {
+	    std::vector<CSVline> lines;
+	    stream_test(lines,num);
+	    std::vector<caffe::Datum> dv;
+	    for (const CSVline &l: lines)
+	      dv.push_back(to_datum_labels(l._v));
+	    return dv;
+	  }
+	else if (!_db)
 	  {
 	    int i = 0;
 	    std::vector<caffe::Datum> dv;
@@ -729,6 +840,38 @@ namespace dd
 
     void reset_dv_test();
 
+    /**
+     * \brief next batch of streamed training data
+     * @param num the size of the batch
+     * @return a vector of Caffe Datum
+     */
+    std::vector<caffe::Datum> get_dv_stream(const int &num)
+      {
+	std::vector<CSVline> lines;
+	stream_train(lines,num);
+	std::vector<caffe::Datum> dv;
+	for (const CSVline &l: lines)
+	  dv.push_back(to_datum_labels(l._v));
+	return dv;
+      }
+
+    /**
+     * \brief turns a vector of values into a Caffe Datum structure, multiple
+     *        labels are concatenated to the data and sliced out in the network itself
+     * @param vector of values
+     * @return datum
+     */
+    caffe::Datum to_datum_labels(const std::vector<double> &vf)
+    {
+      if (_label.size() == 1)
+	return to_datum(vf);
+      caffe::Datum dat = to_datum(vf,true); // multi labels or autoencoder
+      for (size_t i=0;i<_label_pos.size();i++)
+	dat.add_float_data(static_cast<float>(vf.at(_label_pos[i])));
+      dat.set_channels(dat.channels()+_label.size());
+      return dat;
+    }
+
     /**
      * \brief turns a vector of values into a Caffe Datum structure
      * @param vector of values
@@ -1184,19 +1327,17 @@ namespace dd
 	datum.set_label(tbe->_target);
 	if (!_characters)
 	  {
-	    std::unordered_map<std::string,Word>::const_iterator wit;
 	    if (!_embed)
 	      {
-		for (int i=0;i<datum_channels;i++) // XXX: expected to be slow
-		  datum.add_float_data(0.0);
+		datum.mutable_float_data()->Resize(datum_channels,0.0);
 		tbe->reset();
 		while(tbe->has_elt())
 		  {
-		    std::string key;
+		    int key;
 		    double val;
 		    tbe->get_next_elt(key,val);
-		    if ((wit = _vocab.find(key))!=_vocab.end())
-		      datum.set_float_data(_vocab[key]._pos,static_cast<float>(val));
+		    if (key < datum_channels)
+		      datum.set_float_data(key,static_cast<float>(val));
 		  }
 	      }
 	    else
@@ -1205,11 +1346,10 @@ namespace dd
 		int i = 0;
 		while(tbe->has_elt())
 		  {
-		    std::string key;
+		    int key;
 		    double val;
 		    tbe->get_next_elt(key,val);
-		    if ((wit = _vocab.find(key))!=_vocab.end())
-		      datum.add_float_data(static_cast<float>(_vocab[key]._pos));
+		    datum.add_float_data(static_cast<float>(key));
 		    ++i;
 		    if (i == _sequence) // tmp limit on sequence length
 		      break;
@@ -1225,10 +1365,10 @@ namespace dd
 	    std::unordered_map<uint32_t,int>::const_iterator whit;
 	    while(tbe->has_elt())
 	      {
-		std::string key;
+		int key;
 		double val = -1.0;
 		tbe->get_next_elt(key,val);
-		uint32_t c = std::strtoul(key.c_str(),0,10);
+		uint32_t c = key;
 		if ((whit=_alphabet.find(c))!=_alphabet.end())
 		  vals.push_back((*whit).second);
 		else vals.push_back(-1);
@@ -1268,21 +1408,16 @@ namespace dd
       {
 	caffe::SparseDatum datum;
 	datum.set_label(tbe->_target);
-	std::unordered_map<std::string,Word>::const_iterator wit;
 	tbe->reset();
 	int nwords = 0;
 	while(tbe->has_elt())
 	  {
-	    std::string key;
+	    int word_pos;
 	    double val;
-	    tbe->get_next_elt(key,val);
-	    if ((wit = _vocab.find(key))!=_vocab.end())
-	      {
-		int word_pos = _vocab[key]._pos;
-		datum.add_data(static_cast<float>(val));
-		datum.add_indices(word_pos);
-		++nwords;
-	      }
+	    tbe->get_next_elt(word_pos,val);
+	    datum.add_data(static_cast<float>(val));
+	    datum.add_indices(word_pos);
+	    ++nwords;
 	  }
 	datum.set_nnz(nwords);
 	datum.set_size(_vocab.size());
@@ -1344,6 +1479,8 @@ namespace dd
     {
       if (_db_batchsize > 0)
 	return _db_batchsize;
+      else if (_stream)
+	return _stream_train_size;
       else return _dv_sparse.size();
     }
 
@@ -1351,9 +1488,16 @@ namespace dd
     {
       if (_db_testbatchsize > 0)
 	return _db_testbatchsize;
+      else if (_stream)
+	return _stream_test_size;
       else return _dv_test_sparse.size();
     }
 
+    bool streaming() const
+    {
+      return _stream;
+    }
+
     virtual void add_train_svmline(const int &label,
 				   const std::unordered_map<int,double> &vals,
 				   const int &count);
@@ -1374,6 +1518,7 @@ namespace dd
 	  fillup_parameters(ad_input);
 	  get_data(ad);
 	  _db = true;
+	  _stream = false;
 	  svm_to_db(_model_repo + "/" + _dbname,_model_repo + "/" + _test_dbname,ad_input);
 	  write_class_weights(_model_repo,ad_mllib);
 	  
@@ -1452,9 +1597,33 @@ namespace dd
       }
 
     std::vector<caffe::SparseDatum> get_dv_test_sparse_db(const int &num);
+
+    /**
+     * \brief next batch of streamed training data
+     * @param num the size of the batch
+     * @return a vector of Caffe SparseDatum
+     */
+    std::vector<caffe::SparseDatum> get_dv_stream_sparse(const int &num)
+      {
+	std::vector<SVMline> lines;
+	stream_train(lines,num);
+	std::vector<caffe::SparseDatum> dv;
+	for (const SVMline &l: lines)
+	  dv.push_back(to_sparse_datum(l));
+	return dv;
+      }
     std::vector<caffe::SparseDatum> get_dv_test_sparse(const int &num)
       {
-	if (!_db)
+	if (_stream)
+	  {
+	    std::vector<SVMline> lines;
+	    stream_test(lines,num);
+	    std::vector<caffe::SparseDatum> dv;
+	    for (const SVMline &l: lines)
+	      dv.push_back(to_sparse_datum(l));
+	    return dv;
+	  }
+	else if (!_db)
 	  {
 	    int i = 0;
 	    std::vector<caffe::SparseDatum> dv;
@@ -31,6 +31,7 @@
 #include "utils/apitools.h"
 #include "caffe/sgd_solvers.hpp"
 #include <chrono>
+#include <future>
 #include <iostream>
 
 using caffe::Caffe;
@@ -67,11 +68,15 @@ namespace dd
     _loss = cl._loss;
     _best_metrics = cl._best_metrics;
     _best_metric_value = cl._best_metric_value;
+    _nreplicas = cl._nreplicas;
+    _replicas = std::move(cl._replicas);
+    _free_nets = std::move(cl._free_nets);
   }
 
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
   CaffeLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::~CaffeLib()
   {
+    clear_replicas();
     delete _net;
     _net = nullptr;
   }
@@ -849,6 +854,7 @@ namespace dd
     // create net and fill it up
     if (!this->_mlmodel._def.empty() && !this->_mlmodel._weights.empty())
       {
+	clear_replicas();
 	delete _net;
 	_net = nullptr;	
 	try
@@ -892,6 +898,8 @@ namespace dd
 	  {
 	    this->_logger->error("failed determining mltype");
 	  }
+	if (test && _nreplicas > 1)
+	  create_replicas();
 	return 0;
       }
     // net definition is missing
@@ -900,6 +908,87 @@ namespace dd
     return 1;
   }
 
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+  void CaffeLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::create_replicas()
+  {
+    std::unique_lock<std::mutex> lock(_replicas_mutex);
+    _free_nets.clear();
+    _free_nets.push_back(_net);
+    for (int r=1;r<_nreplicas;r++)
+      {
+	caffe::Net<float> *rnet = nullptr;
+	try
+	  {
+	    rnet = new Net<float>(this->_mlmodel._def,caffe::TEST);
+	    rnet->ShareTrainedLayersWith(_net);
+	  }
+	catch (std::exception &e)
+	  {
+	    this->_logger->error("Error creating net replica {}",r);
+	    delete rnet;
+	    throw;
+	  }
+	_replicas.push_back(rnet);
+	_free_nets.push_back(rnet);
+      }
+    this->_logger->info("created {} net replicas sharing weights",_nreplicas-1);
+  }
+
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+  void CaffeLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::clear_replicas()
+  {
+    std::unique_lock<std::mutex> lock(_replicas_mutex);
+    _replicas_cv.wait(lock,[this]{ return _nets_in_use == 0; });
+    for (caffe::Net<float> *rnet: _replicas)
+      delete rnet;
+    _replicas.clear();
+    _free_nets.clear();
+    _shape_nets.clear();
+  }
+
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+  caffe::Net<float>* CaffeLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::acquire_net()
+  {
+    if (_replicas.empty())
+      return _net;
+    std::unique_lock<std::mutex> lock(_replicas_mutex);
+    _replicas_cv.wait(lock,[this]{ return !_free_nets.empty(); });
+    caffe::Net<float> *net = _free_nets.back();
+    _free_nets.pop_back();
+    ++_nets_in_use;
+    return net;
+  }
+
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+  void CaffeLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::release_net(caffe::Net<float> *net)
+  {
+    std::unique_lock<std::mutex> lock(_replicas_mutex);
+    if (_nets_in_use == 0)
+      return; // no replicas
+    _free_nets.push_back(net);
+    --_nets_in_use;
+    _replicas_cv.notify_all();
+  }
+
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+  void CaffeLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::drop_net(caffe::Net<float> *net)
+  {
+    if (net != _net && std::find(_replicas.begin(),_replicas.end(),net) == _replicas.end())
+      {
+	// net cached per input shape, destroyed once the call releases it
+	_shape_nets.clear();
+	return;
+      }
+    if (!_replicas.empty())
+      {
+	// other replicas may be running, nets are re-created by the next call
+	_drop_nets.store(true);
+	return;
+      }
+    delete net;
+    _net = nullptr;
+  }
+
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
   void CaffeLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::init_mllib(const APIData &ad)
   {
@@ -947,6 +1036,16 @@ namespace dd
       _ntargets = this->_inputc._ntargets;
     if (ad.has("autoencoder") && ad.get("autoencoder").get<bool>())
       _autoencoder = true;
+    if (ad.has("replicas"))
+      {
+	_nreplicas = ad.get("replicas").get<int>();
+	if (_nreplicas < 1)
+	  throw MLLibBadParamException("replicas must be at least 1");
+	if (_gpu && _nreplicas > 1)
+	  this->_logger->warn("net replicas are meant for CPU inference, using {} replicas on GPU",_nreplicas);
+      }
+    if (ad.has("net_cache_size"))
+      _shape_nets.set_capacity(ad.get("net_cache_size").get<int>());
     if (!_autoencoder && _nclasses == 0)
       throw MLLibBadParamException("number of classes is unknown (nclasses == 0)");
     bool multi =
@@ -1023,6 +1122,7 @@ namespace dd
       cad.add("autoencoder",_autoencoder);
     if (typeid(this->_inputc) == typeid(CSVTSCaffeInputFileConn))
         inputc._timesteps = timesteps;
+    inputc._add_meas = [this](const std::string &meas, const double &l) { this->add_meas(meas,l); };
     try
       {
 	inputc.transform(cad);
@@ -1222,6 +1322,17 @@ namespace dd
 	inputc._dv_sparse.clear();
 	inputc._ids.clear();
       }
+    else if (inputc.streaming())
+      {
+	// streamed data fill up the net one batch at a time, see training loop
+	if (!inputc._sparse && boost::dynamic_pointer_cast<caffe::MemoryDataLayer<float>>(solver->net()->layers()[0]) == 0)
+	  throw MLLibBadParamException("solver's net's first layer is required to be of MemoryData type");
+	else if (inputc._sparse && boost::dynamic_pointer_cast<caffe::MemorySparseDataLayer<float>>(solver->net()->layers()[0]) == 0)
+	  throw MLLibBadParamException("solver's net's first layer is required to be of MemorySparseData type");
+	if (_gpuid.size() > 1)
+	  throw MLLibBadParamException("streamed training data requires a single GPU");
+	this->_logger->info("streaming training data");
+      }
     if (this->_mlmodel.read_from_repository(this->_mlmodel._repo,this->_logger))
       throw MLLibBadParamException("error reading or listing Caffe models in repository " + this->_mlmodel._repo);
     this->_mlmodel.read_corresp_file();
@@ -1298,6 +1409,56 @@ namespace dd
     if (!ad_mllib.has("resume") || !ad_mllib.get("resume").get<bool>())
       this->clear_all_meas_per_iter();
     float smoothed_loss = 0.0;
+
+    // reports test measures to the training job
+    auto report_test = [this,&batch_size](APIData &meas_obj)
+      {
+	std::vector<std::string> meas_str = meas_obj.list_keys();
+	this->_logger->info("batch size={}",batch_size);
+	
+	for (auto m: meas_str)
+	  {
+	    if (m != "cmdiag" && m != "cmfull" && m != "clacc" && m != "labels" && m!= "cliou") // do not report confusion matrix in server logs
+	      {
+		double mval = meas_obj.get(m).get<double>();
+		this->_logger->info("{}={}",m,mval);
+		this->add_meas(m,mval);
+		this->add_meas_per_iter(m,mval);
+	      }
+	    else if (m == "cmdiag" || m == "clacc" || m == "cliou")
+	      {
+		std::vector<double> mdiag = meas_obj.get(m).get<std::vector<double>>();
+		std::vector<std::string> cnames;
+		std::string mdiag_str;
+		for (size_t i=0;i<mdiag.size();i++)
+		  {
+		    mdiag_str += this->_mlmodel.get_hcorresp(i) + ":" + std::to_string(mdiag.at(i)) + " ";
+		    this->add_meas_per_iter(m+'_'+this->_mlmodel.get_hcorresp(i),mdiag.at(i));
+		    cnames.push_back(this->_mlmodel.get_hcorresp(i));
+		  }
+		this->_logger->info("{}=[{}]",m,mdiag_str);
+		this->add_meas(m,mdiag,cnames);
+	      }
+	  }
+      };
+
+    // asynchronous test: at most one test runs on a copy of the weights,
+    // test intervals reached in the meantime are coalesced into the next one
+    bool test_async = ad_solver.has("test_async") && ad_solver.get("test_async").get<bool>();
+    bool test_pending = false;
+    int test_future_iter = -1;
+    std::shared_ptr<caffe::NetParameter> test_weights;
+    std::future<APIData> test_future;
+    auto land_test = [&]()
+      {
+	APIData meas_out = test_future.get();
+	APIData meas_obj = meas_out.getobj("measure");
+	this->_logger->info("test results for iteration {}",test_future_iter);
+	save_if_best(meas_obj, solver, false, test_future_iter, test_weights.get());
+	report_test(meas_obj);
+	test_weights.reset();
+      };
+
     while(solver->iter_ < solver->param_.max_iter()
 	  && this->_tjob_running.load())
       {
@@ -1312,45 +1473,60 @@ namespace dd
 	  solver->Snapshot();
          already_snapshoted = true;
 	}
+	// collect asynchronous test results once ready
+	if (test_future.valid()
+	    && test_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	  land_test();
+
 	if (solver->param_.test_interval() && solver->iter_ % solver->param_.test_interval() == 0
 	    && (solver->iter_ > 0 || solver->param_.test_initialization())) 
 	  {
-	    APIData meas_out;
-	    solver->test_nets().at(0).get()->ShareTrainedLayersWith(solver->net().get());
-	    test(solver->test_nets().at(0).get(),ad,inputc,test_batch_size,has_mean_file,test_iter,meas_out);
-           APIData meas_obj = meas_out.getobj("measure");
-
-	    // save best iteration snapshot
-	    save_if_best(meas_obj, solver, already_snapshoted);
-
-	    std::vector<std::string> meas_str = meas_obj.list_keys();
-	    this->_logger->info("batch size={}",batch_size);
-	    
-	    for (auto m: meas_str)
+	    if (!test_async)
 	      {
-		if (m != "cmdiag" && m != "cmfull" && m != "clacc" && m != "labels" && m!= "cliou") // do not report confusion matrix in server logs
-		  {
-		    double mval = meas_obj.get(m).get<double>();
-		    this->_logger->info("{}={}",m,mval);
-		    this->add_meas(m,mval);
-		    this->add_meas_per_iter(m,mval);
-		  }
-		else if (m == "cmdiag" || m == "clacc" || m == "cliou")
-		  {
-		    std::vector<double> mdiag = meas_obj.get(m).get<std::vector<double>>();
-		    std::vector<std::string> cnames;
-		    std::string mdiag_str;
-		    for (size_t i=0;i<mdiag.size();i++)
-		      {
-			mdiag_str += this->_mlmodel.get_hcorresp(i) + ":" + std::to_string(mdiag.at(i)) + " ";
-			this->add_meas_per_iter(m+'_'+this->_mlmodel.get_hcorresp(i),mdiag.at(i));
-			cnames.push_back(this->_mlmodel.get_hcorresp(i));
-		      }
-		    this->_logger->info("{}=[{}]",m,mdiag_str);
-		    this->add_meas(m,mdiag,cnames);
-		  }
+		APIData meas_out;
+		solver->test_nets().at(0).get()->ShareTrainedLayersWith(solver->net().get());
+		test(solver->test_nets().at(0).get(),ad,inputc,test_batch_size,has_mean_file,test_iter,meas_out);
+		APIData meas_obj = meas_out.getobj("measure");
+
+		// save best iteration snapshot
+		save_if_best(meas_obj, solver, already_snapshoted);
+		report_test(meas_obj);
+	      }
+	    else
+	      {
+		if (test_pending || test_future.valid())
+		  this->_logger->info("test at iteration {} still running, coalescing test at iteration {}",test_future_iter,solver->iter_);
+		test_pending = true;
 	      }
 	  }
+	if (test_pending && !test_future.valid())
+	  {
+	    // the test net gets a copy of the weights, training proceeds while testing
+	    test_pending = false;
+	    test_future_iter = solver->iter_;
+	    test_weights.reset(new caffe::NetParameter());
+	    solver->net()->ToProto(test_weights.get(),false);
+	    std::shared_ptr<caffe::NetParameter> weights = test_weights;
+	    caffe::Net<float> *test_net = solver->test_nets().at(0).get();
+	    Caffe::Brew mode = Caffe::mode();
+	    int device = _gpuid.at(0);
+	    test_future = std::async(std::launch::async,
+				     [this,&ad,&inputc,test_net,weights,mode,device,test_batch_size,has_mean_file,test_iter]()
+				     {
+				       // Caffe mode and device are per thread
+				       Caffe::set_mode(mode);
+#if !defined(CPU_ONLY) && !defined(USE_CAFFE_CPU_ONLY)
+				       if (mode == Caffe::GPU)
+					 Caffe::SetDevice(device);
+#else
+				       (void)device;
+#endif
+				       test_net->CopyTrainedLayersFrom(*weights);
+				       APIData meas_out;
+				       test(test_net,ad,inputc,test_batch_size,has_mean_file,test_iter,meas_out);
+				       return meas_out;
+				     });
+	  }
 	
 	float loss = 0.0;
 	float avg_fb_time = 0.0;
@@ -1363,6 +1539,21 @@ namespace dd
 	    }
 	    for (int i = 0; i < solver->param_.iter_size(); ++i)
 	      {
+		if (inputc.streaming())
+		  {
+		    if (!inputc._sparse)
+		      {
+			boost::shared_ptr<caffe::MemoryDataLayer<float>> mdl
+			  = boost::dynamic_pointer_cast<caffe::MemoryDataLayer<float>>(solver->net()->layers()[0]);
+			mdl->AddDatumVector(inputc.get_dv_stream(mdl->batch_size()));
+		      }
+		    else
+		      {
+			boost::shared_ptr<caffe::MemorySparseDataLayer<float>> mdl
+			  = boost::dynamic_pointer_cast<caffe::MemorySparseDataLayer<float>>(solver->net()->layers()[0]);
+			mdl->AddDatumVector(inputc.get_dv_stream_sparse(mdl->batch_size()));
+		      }
+		  }
 		std::chrono::time_point<std::chrono::system_clock> tstart = std::chrono::system_clock::now();
 		loss += solver->net_->ForwardBackward();
 		std::chrono::time_point<std::chrono::system_clock> tstop = std::chrono::system_clock::now();
@@ -1427,11 +1618,20 @@ namespace dd
 	  }
       }
 
+    // wait for the last asynchronous test
+    if (test_future.valid())
+      {
+	test_future.wait();
+	if (this->_tjob_running.load())
+	  land_test();
+      }
+
     // always save final snapshot.
     if (solver->param_.snapshot_after_train())
       solver->Snapshot();
 
     // destroy the net
+    clear_replicas();
     delete _net;
     _net = nullptr;
 
@@ -1977,8 +2177,16 @@ namespace dd
   int CaffeLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::predict(const APIData &ad,
 										   APIData &out)
   {
-    std::lock_guard<std::mutex> lock(_net_mutex); // no concurrent calls since the net is not re-instantiated
+    std::unique_lock<std::mutex> lock(_net_mutex); // no concurrent calls on a net since it is not re-instantiated, replicas if any are acquired under the lock
 
+    // a replica failed during a previous call, all nets are re-created
+    if (_drop_nets.load())
+      {
+	clear_replicas();
+	delete _net;
+	_net = nullptr;
+	_drop_nets.store(false);
+      }
 
     // check for net
     if (!_net || _net->phase() == caffe::TRAIN)
@@ -1992,10 +2200,44 @@ namespace dd
 	  throw MLLibBadParamException("no deploy file in " + this->_mlmodel._repo + " for initializing the net");
       }
 
+    if (typeid(this->_inputc) == typeid(CSVTSCaffeInputFileConn)
+        && ad.getobj_ref("parameters").getobj_ref("input").has("timesteps"))
+      {
+        int timesteps = ad.getobj_ref("parameters").getobj_ref("input").get("timesteps").get<int>();
+
+        // nets for other timesteps share the main net weights, and are not replicated
+        std::shared_ptr<caffe::Net<float>> tnet = timesteps_net(timesteps);
+        if (tnet)
+          return predict_net(tnet.get(),ad,out);
+      }
+
+    // with replicas, the forward pass runs outside the lock on a free replica
+    caffe::Net<float> *net = acquire_net();
+    if (!_replicas.empty())
+      lock.unlock();
+    int status = 0;
+    try
+      {
+	status = predict_net(net,ad,out);
+      }
+    catch (...)
+      {
+	release_net(net);
+	throw;
+      }
+    release_net(net);
+    return status;
+  }
+
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+  int CaffeLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::predict_net(caffe::Net<float> *net,
+										       const APIData &ad,
+										       APIData &out)
+  {
     TInputConnectorStrategy inputc(this->_inputc);
     TOutputConnectorStrategy tout;
-    APIData ad_mllib = ad.getobj("parameters").getobj("mllib");
-    APIData ad_output = ad.getobj("parameters").getobj("output");
+    const APIData &ad_mllib = ad.getobj_ref("parameters").getobj_ref("mllib");
+    const APIData &ad_output = ad.getobj_ref("parameters").getobj_ref("output");
     bool bbox = false;
     bool rois = false;
     bool multibox_rois = false;
@@ -2017,24 +2259,6 @@ namespace dd
       }
 
 
-    if (typeid(inputc) == typeid(CSVTSCaffeInputFileConn)
-        && ad.getobj("parameters").getobj("input").has("timesteps"))
-      {
-        int timesteps = ad.getobj("parameters").getobj("input").get("timesteps").get<int>();
-
-        bool changed = update_timesteps(timesteps);
-        if (changed)
-          {
-            int cm = create_model(true);
-            if (cm != 0)
-              this->_logger->error("Error creating model for prediction");
-            if (cm == 1)
-              throw MLLibInternalException("no model in " + this->_mlmodel._repo + " for initializing the net");
-            else if (cm == 2)
-              throw MLLibBadParamException("no deploy file in " + this->_mlmodel._repo + " for initializing the net");
-          }
-      }
-
 
     if (ad_output.has("bbox") && ad_output.get("bbox").get<bool>())
       bbox = true;
@@ -2077,16 +2301,15 @@ namespace dd
     Caffe::set_mode(Caffe::CPU);
 #endif
 
-    APIData cad = ad;
     bool has_mean_file = this->_mlmodel._has_mean_file;
     if (_autoencoder)
       has_mean_file = false;
-    cad.add("has_mean_file",has_mean_file);
+    inputc._has_mean_file = has_mean_file; // set directly instead of copying the call data
     if (ad_output.has("measure"))
       {
 	try
 	  {
-	    inputc.transform(cad);
+	    inputc.transform(ad);
 	  }
 	catch (std::exception &e)
 	  {
@@ -2102,7 +2325,7 @@ namespace dd
 	  }
 
 	bool has_mean_file = this->_mlmodel._has_mean_file;
-	test(_net,ad,inputc,batch_size,has_mean_file,1,out);
+	test(net,ad,inputc,batch_size,has_mean_file,1,out);
 	APIData out_meas = out.getobj("measure");
 	out_meas.erase("train_loss");
 	out_meas.erase("iteration");
@@ -2113,10 +2336,27 @@ namespace dd
     std::string extract_layer;
     if (ad_mllib.has("extract_layer"))
       extract_layer = ad_mllib.get("extract_layer").get<std::string>();
-      
+
+    // when the input layer applies no transformation beyond scaling,
+    // images are converted by the connector straight into the batch
+    boost::shared_ptr<caffe::MemoryDataLayer<float>> mdl
+      = boost::dynamic_pointer_cast<caffe::MemoryDataLayer<float>>(net->layers()[0]);
+    if (mdl)
+      {
+	const caffe::TransformationParameter &tp = mdl->layer_param().transform_param();
+	if (!tp.has_mean_file() && tp.mean_value_size() == 0
+	    && tp.crop_size() == 0 && !tp.mirror())
+	  {
+	    inputc._fused_scale = tp.scale();
+	    inputc._fused_channels = mdl->channels();
+	    inputc._fused_height = mdl->height();
+	    inputc._fused_width = mdl->width();
+	  }
+      }
+
     try
       {
-        inputc.transform(cad);
+        inputc.transform(ad);
       }
     catch (std::exception &e)
       {
@@ -2140,7 +2380,16 @@ namespace dd
       {
 	try
 	  {
-           if (!inputc._sparse)
+	    float *fdata = nullptr;
+	    float *flabels = nullptr;
+	    int fn = 0;
+	    if (!inputc._sparse && (fn = inputc.get_fused_test(batch_size,fdata,flabels)) > 0)
+	      {
+		batch_size = fn;
+		mdl->set_batch_size(batch_size);
+		mdl->Reset(fdata,flabels,batch_size);
+	      }
+	    else if (!inputc._sparse)
 	      {
 		std::vector<Datum> dv = inputc.get_dv_test(batch_size,has_mean_file);
 		if (dv.empty())
@@ -2164,15 +2413,14 @@ namespace dd
                   break;
                 }
 		batch_size = dv.size();
-		if (boost::dynamic_pointer_cast<caffe::MemoryDataLayer<float>>(_net->layers()[0]) == 0)
+		if (boost::dynamic_pointer_cast<caffe::MemoryDataLayer<float>>(net->layers()[0]) == 0)
 		    {
 		      this->_logger->info("deploy net's first layer is required to be of MemoryData type (predict)");
-		      delete _net;
-		      _net = nullptr;
+		      drop_net(net);
 		      throw MLLibBadParamException("deploy net's first layer is required to be of MemoryData type");
 		    }
-		boost::dynamic_pointer_cast<caffe::MemoryDataLayer<float>>(_net->layers()[0])->set_batch_size(batch_size);
-		boost::dynamic_pointer_cast<caffe::MemoryDataLayer<float>>(_net->layers()[0])->AddDatumVector(dv);
+		boost::dynamic_pointer_cast<caffe::MemoryDataLayer<float>>(net->layers()[0])->set_batch_size(batch_size);
+		boost::dynamic_pointer_cast<caffe::MemoryDataLayer<float>>(net->layers()[0])->AddDatumVector(dv);
 	      }
 	    else
 	      {
@@ -2180,22 +2428,20 @@ namespace dd
 		if (dv.empty())
 		  break;
 		batch_size = dv.size();
-		if (boost::dynamic_pointer_cast<caffe::MemorySparseDataLayer<float>>(_net->layers()[0]) == 0)
+		if (boost::dynamic_pointer_cast<caffe::MemorySparseDataLayer<float>>(net->layers()[0]) == 0)
 		  {
 		    this->_logger->error("deploy net's first layer is required to be of MemoryData type (predict)");
-		    delete _net;
-		    _net = nullptr;
+		    drop_net(net);
 		    throw MLLibBadParamException("deploy net's first layer is required to be of MemorySparseData type");
 		  }
-		boost::dynamic_pointer_cast<caffe::MemorySparseDataLayer<float>>(_net->layers()[0])->set_batch_size(batch_size);
-		boost::dynamic_pointer_cast<caffe::MemorySparseDataLayer<float>>(_net->layers()[0])->AddDatumVector(dv);
+		boost::dynamic_pointer_cast<caffe::MemorySparseDataLayer<float>>(net->layers()[0])->set_batch_size(batch_size);
+		boost::dynamic_pointer_cast<caffe::MemorySparseDataLayer<float>>(net->layers()[0])->AddDatumVector(dv);
 	      }
 	  }
 	catch(std::exception &e)
 	  {
 	    this->_logger->error("exception while filling up network for prediction");
-	    delete _net;
-	    _net = nullptr;
+	    drop_net(net);
 	    throw;
 	  }
 	
@@ -2206,36 +2452,34 @@ namespace dd
 	    
 	    if (rois)
 	      {
-		std::map<std::string,int> n_layer_names_index = _net->layer_names_index();
+		std::map<std::string,int> n_layer_names_index = net->layer_names_index();
 		std::map<std::string,int>::const_iterator lit;
 		if ((lit=n_layer_names_index.find(roi_layer))==n_layer_names_index.end())
 		  throw MLLibBadParamException("unknown rois layer " + roi_layer);
 		int li = (*lit).second;
 		try
 		  {
-		    loss = _net->ForwardFromTo(0,li);
+		    loss = net->ForwardFromTo(0,li);
 		  }
 		catch(std::exception &e)
 		  {
 		    this->_logger->error("Error while proceeding with supervised prediction forward pass, not enough memory? {}",e.what());
-		    delete _net;
-		    _net = nullptr;
+		    drop_net(net);
 		    throw;
 		  }
-		const std::vector<std::vector<Blob<float>*>>& rresults = _net->top_vecs();
+		const std::vector<std::vector<Blob<float>*>>& rresults = net->top_vecs();
 		results = rresults.at(li);
 	      }
 	    else
 	      {
 		try
 		  {
-		    results = _net->Forward(&loss);
+		    results = net->Forward(&loss);
 		  }
 		catch(std::exception &e)
 		  {
 		    this->_logger->error("Error while proceeding with supervised prediction forward pass, not enough memory? {}",e.what());
-		    delete _net;
-		    _net = nullptr;
+		    drop_net(net);
 		    throw;
 		  }
 	      }
@@ -2549,11 +2793,11 @@ namespace dd
 	    }
            else if (typeid(inputc) == typeid(CSVTSCaffeInputFileConn)) // timeseries
              {
-               int slot = findOutputSlotNumberByBlobName(_net,"rnn_pred");
+               int slot = findOutputSlotNumberByBlobName(net,"rnn_pred");
                //results[slot] is TxNxDataDim , N is batchsize ...
                int nout = _ntargets;
 
-               const boost::shared_ptr<Blob<float>> contseq = _net->blob_by_name("cont_seq");
+               const boost::shared_ptr<Blob<float>> contseq = net->blob_by_name("cont_seq");
                //cont_seq is TxN
 
                CSVTSCaffeInputFileConn* ic =
@@ -2644,24 +2888,23 @@ namespace dd
 	  }
 	else // unsupervised
 	  {
-	    std::map<std::string,int> n_layer_names_index = _net->layer_names_index();
+	    std::map<std::string,int> n_layer_names_index = net->layer_names_index();
 	    std::map<std::string,int>::const_iterator lit;
 	    if ((lit=n_layer_names_index.find(extract_layer))==n_layer_names_index.end())
 	      throw MLLibBadParamException("unknown extract layer " + extract_layer);
 	    int li = (*lit).second;
 	    try
 	      {
-		loss = _net->ForwardFromTo(0,li);
+		loss = net->ForwardFromTo(0,li);
 	      }
 	    catch(std::exception &e)
 	      {
 		this->_logger->error("Error while proceeding with unsupervised prediction forward pass, not enough memory? {}",e.what());
-		delete _net;
-		_net = nullptr;
+		drop_net(net);
 		throw;
 	      }
 
-	    const std::vector<std::vector<Blob<float>*>>& rresults = _net->top_vecs();
+	    const std::vector<std::vector<Blob<float>*>>& rresults = net->top_vecs();
 	    std::vector<Blob<float>*> results = rresults.at(li);
 
 	    int slot = 0;
@@ -2842,7 +3085,7 @@ namespace dd
 	  {
 	    caffe::MemoryDataParameter *mdp = lp->mutable_memory_data_param();
 	    if (mdp->has_batch_size() && batch_size > 0 &&
-               ( (batch_size != inputc.batch_size()) || (typeid(inputc) == typeid(CSVTSCaffeInputFileConn)) ))
+               ( (batch_size != inputc.batch_size()) || (typeid(inputc) == typeid(CSVTSCaffeInputFileConn)) || inputc.streaming() ))
 	      {
 		if (i == 0) // training
 		  mdp->set_batch_size(batch_size);
@@ -2897,19 +3140,21 @@ namespace dd
 
 
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
-  bool CaffeLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::update_timesteps(int timesteps)
+  std::shared_ptr<caffe::Net<float>> CaffeLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::timesteps_net(const int &timesteps)
   {
-    std::string deploy_file = this->_mlmodel._repo + "/deploy.prototxt";
-    caffe::NetParameter deploy_net_param;
-    caffe::ReadProtoFromTextFile(deploy_file,&deploy_net_param);
-
-    caffe::LayerParameter *lparam = deploy_net_param.mutable_layer(0);
-    int orig_timesteps = lparam->memory_data_param().channels();
-    if (orig_timesteps == timesteps)
-      return false;
-    lparam->mutable_memory_data_param()->set_channels(timesteps);
-    caffe::WriteProtoToTextFile(deploy_net_param,deploy_file);
-    return true;
+    if (_net->layers().at(0)->layer_param().memory_data_param().channels() == timesteps)
+      return nullptr;
+    return _shape_nets.get(timesteps,[this,timesteps]
+      {
+	this->_logger->info("instantiating net for {} timesteps",timesteps);
+	caffe::NetParameter deploy_net_param;
+	caffe::ReadProtoFromTextFile(this->_mlmodel._def,&deploy_net_param);
+	deploy_net_param.mutable_layer(0)->mutable_memory_data_param()->set_channels(timesteps);
+	deploy_net_param.mutable_state()->set_phase(caffe::TEST);
+	std::shared_ptr<caffe::Net<float>> tnet(new Net<float>(deploy_net_param));
+	tnet->ShareTrainedLayersWith(_net);
+	return tnet;
+      });
   }
 
 
@@ -3306,7 +3551,9 @@ namespace dd
 
 	// code below is required when Caffe (weirdly) requires the batch size 
 	// to be a multiple of the training dataset size.
-	if (!inputc._ctc && !inputc._segmentation && !(!inputc._db && typeid(inputc) == typeid(ImgCaffeInputFileConn)))
+	// Streamed data are fed one batch at a time, and need no such adjustment.
+	if (!inputc._ctc && !inputc._segmentation && !(!inputc._db && typeid(inputc) == typeid(ImgCaffeInputFileConn))
+	    && !inputc.streaming())
 	  {
 	    if (batch_size < inputc.batch_size())
 	      {
@@ -3353,6 +3600,8 @@ namespace dd
 	if (batch_size == 0)
 	  throw MLLibBadParamException("auto batch size set to zero: MemoryData input requires batch size to be a multiple of training set");
       }
+    else if (inputc.streaming())
+      throw MLLibBadParamException("streamed training data requires a batch_size");
   }
 
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
@@ -3815,7 +4064,8 @@ namespace dd
   }
 
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
-  void CaffeLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::save_if_best(APIData &meas_out, boost::shared_ptr<caffe::Solver<float>>solver, bool already_snapshoted)
+  void CaffeLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::save_if_best(APIData &meas_out, boost::shared_ptr<caffe::Solver<float>>solver, bool already_snapshoted,
+											 const int &iter, const caffe::NetParameter *weights)
   {
     double cur_meas = std::numeric_limits<double>::infinity();
     std::string meas;
@@ -3838,14 +4088,27 @@ namespace dd
         is_better(cur_meas, _best_metric_value, meas))
       {
         _best_metric_value = cur_meas;
-        if (!already_snapshoted)
-          solver->Snapshot();
+        int best_iter = iter >= 0 ? iter : solver->iter_;
+        if (weights && solver->param().snapshot_format() == caffe::SolverParameter_SnapshotFormat_BINARYPROTO)
+          {
+            // tested weights are older than the solver's, saved as the snapshot of their iteration
+            std::string model_file = solver->param().snapshot_prefix() + "_iter_" + std::to_string(best_iter) + ".caffemodel";
+            if (!fileops::file_exists(model_file))
+              caffe::WriteProtoToBinaryFile(*weights,model_file.c_str());
+          }
+        else
+          {
+            // other formats snapshot the solver's current weights, recorded as the best iteration
+            best_iter = solver->iter_;
+            if (!already_snapshoted)
+              solver->Snapshot();
+          }
         try
           {
             std::ofstream bestfile;
             std::string bestfilename = this->_mlmodel._repo + this->_mlmodel._best_model_filename;
             bestfile.open(bestfilename,std::ios::out);
-            bestfile << "iteration:" <<  solver->iter_ << std::endl;
+            bestfile << "iteration:" <<  best_iter << std::endl;
             bestfile <<  meas << ":" << cur_meas << std::endl;
             bestfile.close();
           }
@@ -27,6 +27,8 @@
 #include "caffe/caffe.hpp"
 #include "caffe/layers/memory_data_layer.hpp"
 #include "caffe/layers/memory_sparse_data_layer.hpp"
+#include "netcache.h"
+#include <condition_variable>
 
 using caffe::Blob;
 
@@ -139,6 +141,23 @@ namespace dd
      * @return 0 if OK, 1 otherwise
      */
     int predict(const APIData &ad, APIData &out);
+
+    /**
+     * \brief predicts from a given net, i.e. the main net or one of its replicas
+     * @param net the net to run the forward pass with
+     * @param ad root data object
+     * @param out output data object (e.g. predictions, ...)
+     * @return 0 if OK, 1 otherwise
+     */
+    int predict_net(caffe::Net<float> *net, const APIData &ad, APIData &out);
+
+    /**
+     * \brief net cache statistics, reported by service info
+     */
+    void lib_stats(APIData &ad) const
+    {
+      ad.add("net_cache",_shape_nets.stats());
+    }
     
     //TODO: status ?
 
@@ -210,10 +229,12 @@ namespace dd
 
       void update_deploy_protofile_softmax(const APIData &ad);
       /**
-       * \brief updates the channel / timeteps number for timeseries
-       * @param mllib apidata object
+       * \brief gets the deploy net for a number of timesteps, from the cache of nets
+       *        sharing weights with the main net
+       * @param timesteps number of timesteps
+       * @return net for the timesteps, nullptr if the main net has that number of timesteps
        */
-      bool update_timesteps(int timesteps);
+      std::shared_ptr<caffe::Net<float>> timesteps_net(const int &timesteps);
       
     private:
       void update_protofile_classes(caffe::NetParameter &net_param);
@@ -247,6 +268,33 @@ namespace dd
 
       void set_gpuid(const APIData &ad);
 
+      /**
+       * \brief instantiates the deploy net replicas, sharing weights with the main net
+       */
+      void create_replicas();
+
+      /**
+       * \brief destroys net replicas, waits for running predict calls to release them,
+       *        and drops nets cached per input shape
+       */
+      void clear_replicas();
+
+      /**
+       * \brief gets a free net for prediction, blocks until one is available
+       * @return main net if there are no replicas, a free replica otherwise
+       */
+      caffe::Net<float>* acquire_net();
+
+      /**
+       * \brief gives a net back to the pool of free replicas
+       */
+      void release_net(caffe::Net<float> *net);
+
+      /**
+       * \brief destroys a net after a failed call, or schedules re-creation of all replicas
+       */
+      void drop_net(caffe::Net<float> *net);
+
       void model_complexity(long int &flops,
 			    long int &params);
 
@@ -261,9 +309,12 @@ namespace dd
 
       /**
        * \brief generates a file containing best iteration so far
+       * @param iter tested iteration, defaults to the solver's
+       * @param weights tested weights when older than the solver's, saved in place of a solver snapshot
        */
       void save_if_best(APIData &meas_out, boost::shared_ptr<caffe::Solver<float>>solver,
-                        bool already_snapshoted);
+                        bool already_snapshoted, const int &iter=-1,
+                        const caffe::NetParameter *weights=nullptr);
 
       int findOutputSlotNumberByBlobName(const caffe::Net<float> *net,
                                      const std::string blob_name);
@@ -300,6 +351,15 @@ namespace dd
       std::vector<std::string> _best_metrics; /**< metric to use for saving best model */
       double _best_metric_value; /**< best metric value  */
 
+      int _nreplicas = 1; /**< number of deploy nets sharing weights, for concurrent CPU predict calls. */
+      std::vector<caffe::Net<float>*> _replicas; /**< deploy net replicas, in addition to _net. */
+      std::vector<caffe::Net<float>*> _free_nets; /**< nets available for prediction, when using replicas. */
+      int _nets_in_use = 0; /**< number of nets acquired by running predict calls. */
+      std::mutex _replicas_mutex; /**< mutex around free nets. */
+      std::condition_variable _replicas_cv;
+      std::atomic<bool> _drop_nets = {false}; /**< whether nets need re-creation after a failed call. */
+      NetCache<int,caffe::Net<float>> _shape_nets; /**< deploy nets per number of timesteps, sharing weights with the main net. */
+
       caffe::P2PSync<float> *_sync = nullptr;
       std::vector<boost::shared_ptr<caffe::P2PSync<float>>> _syncs;
     };
@@ -135,7 +135,7 @@ namespace dd {
 
   void ImgCaffe2InputFileConn::transform_predict(const APIData &ad) {
 
-    if (ad.has("data")) { // If we know what kind of data we'll have to work with
+    if (ad.has("data") || ad.binary_data()) { // If we know what kind of data we'll have to work with
 
       get_data(ad);
       _is_load_manual = !fileops::is_db(_uris[0]);
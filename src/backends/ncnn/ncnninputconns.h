@@ -23,6 +23,7 @@
 #define NCNNINPUTCONNS_H
 
 #include "imginputfileconn.h"
+#include "imgpreproc.h"
 #include "csvtsinputfileconn.h"
 
 // NCNN
@@ -48,6 +49,10 @@ namespace dd
       std::vector<int> _timeseries_lengths;
       bool _continuation = false;
       int _ntargets;
+
+      std::vector<ncnn::Mat> _ins; /**< one input per element, e.g. per image. */
+      std::vector<ncnn::Mat> _outs; /**< extracted output per input. */
+      std::vector<std::string> _ids; /**< input ids (e.g. image ids) */
     };
 
     class ImgNCNNInputFileConn : public ImgInputFileConn, public NCNNInputInterface
@@ -86,21 +91,35 @@ namespace dd
             {
                 throw;
             }
-            cv::Mat bgr = this->_images.at(0);
-            _height = bgr.rows;
-            _width = bgr.cols;
-
-            _in = ncnn::Mat::from_pixels(bgr.data, ncnn::Mat::PIXEL_BGR, bgr.cols, bgr.rows);
-            _in.substract_mean_normalize(&_mean[0], 0);
-	    _ids.push_back(this->_uris.at(0));
+            // every image of the request, single pass from pixels to mean-subtracted planes
+            int nimgs = this->_images.size();
+            _ins.resize(nimgs);
+            bool bad_depth = false;
+#pragma omp parallel for reduction(||:bad_depth)
+            for (int i=0;i<nimgs;i++)
+            {
+                const cv::Mat &bgr = this->_images.at(i);
+                ncnn::Mat &in = _ins.at(i);
+                in.create(bgr.cols, bgr.rows, bgr.channels());
+                ImgPreproc::Params pp;
+                pp._cstep = in.cstep;
+                if (!_mean.empty())
+                    pp._mean = &_mean[0];
+                if (!ImgPreproc::convert(bgr, static_cast<float*>(in.data), pp))
+                    bad_depth = true;
+            }
+            if (bad_depth)
+                throw InputConnectorBadParamException("unsupported image depth");
+            // a net is set for a single input height
+            for (const ncnn::Mat &in: _ins)
+                if (in.h != _ins.front().h)
+                    throw InputConnectorBadParamException("images of a request must have the same height, got " + std::to_string(in.h) + " and " + std::to_string(_ins.front().h));
+            _height = _ins.back().h;
+            _width = _ins.back().w;
+            _ids = this->_uris;
         }
 
       double unscale_res(double res, int nout) {return 0 * res * nout;}
-
-    public:
-      ncnn::Mat _in;
-      ncnn::Mat _out;
-      std::vector<std::string> _ids; /**< input ids (e.g. image ids) */
     };
 
     class CSVTSNCNNInputFileConn : public CSVTSInputFileConn, public NCNNInputInterface
@@ -158,11 +177,13 @@ namespace dd
                 _height += l;
               }
             // Mat(w,h)
-            _in.create(_width,_height);
+            _ins.resize(1);
+            ncnn::Mat &in = _ins.at(0);
+            in.create(_width,_height);
 
             int mati = 0;
 
-            //only inputs are put into _in
+            //only inputs are put into in
             _ntargets = this->_label_pos.size();
             std::vector<int> input_pos;
             for (int i =0; i<_width-1; ++i)
@@ -173,20 +194,20 @@ namespace dd
             for (unsigned int si = 0; si<this->_csvtsdata.size(); ++si)
               {
                 if (_continuation)
-                  _in[mati++] = 1;
+                  in[mati++] = 1;
                 else
-                  _in[mati++] = 0;
+                  in[mati++] = 0;
                 for (int di = 0; di < _ntargets; ++di)
-                  _in[mati++] = 0;
+                  in[mati++] = 0;
                 for (unsigned int di : input_pos)
-                  _in[mati++] = this->_csvtsdata[si][0]._v[di];
+                  in[mati++] = this->_csvtsdata[si][0]._v[di];
                 for (unsigned int ti=1; ti < this->_csvtsdata[si].size(); ++ti)
                   {
-                    _in[mati++] = 1;
+                    in[mati++] = 1;
                     for (int di = 0; di < _ntargets; ++di)
-                      _in[mati++] = 0;
+                      in[mati++] = 0;
                     for (unsigned int di : input_pos)
-                      _in[mati++] = this->_csvtsdata[si][ti]._v[di];
+                      in[mati++] = this->_csvtsdata[si][ti]._v[di];
                   }
               }
             _ids.push_back(this->_uris.at(0));
@@ -202,11 +223,8 @@ namespace dd
 
 
     public:
-      ncnn::Mat _in;
-      ncnn::Mat _out;
       int _height;
       int _width;
-      std::vector<std::string> _ids; /**< input ids (e.g. image ids) */
     };
 
 }
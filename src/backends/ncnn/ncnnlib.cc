@@ -21,6 +21,9 @@
 
 #include "outputconnectorstrategy.h"
 #include <thread>
+#include <atomic>
+#include <fstream>
+#include <iterator>
 #include <algorithm>
 #include "utils/utils.hpp"
 
@@ -32,19 +35,11 @@
 
 namespace dd
 {
-  template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
-    ncnn::UnlockedPoolAllocator NCNNLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::_blob_pool_allocator
-      = ncnn::UnlockedPoolAllocator();
-    template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
-    ncnn::PoolAllocator NCNNLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::_workspace_pool_allocator
-      = ncnn::PoolAllocator();
-  
     template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
     NCNNLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::NCNNLib(const NCNNModel &cmodel)
         :MLLib<TInputConnectorStrategy,TOutputConnectorStrategy,NCNNModel>(cmodel)
     {
         this->_libname = "ncnn";
-        _net = new ncnn::Net();
     }
 
     template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
@@ -52,25 +47,32 @@ namespace dd
         :MLLib<TInputConnectorStrategy,TOutputConnectorStrategy,NCNNModel>(std::move(tl))
     {
         this->_libname = "ncnn";
-	_net = tl._net;
-	tl._net = nullptr;
 	_nclasses = tl._nclasses;
        _threads = tl._threads;
        _timeserie = tl._timeserie;
+       _param_mem = std::move(tl._param_mem);
+       _model_mem = std::move(tl._model_mem);
     }
 
     template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
     NCNNLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::~NCNNLib()
     {
-      delete _net;
-      _net = nullptr;
     }
 
     template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
     void NCNNLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::init_mllib(const APIData &ad)
     {
-        _net->load_param(this->_mlmodel._params.c_str());
-        _net->load_model(this->_mlmodel._weights.c_str());
+        // params and weights are read once, nets per input height are instantiated from memory
+        std::ifstream paramf(this->_mlmodel._params,std::ios::binary);
+        std::ifstream modelf(this->_mlmodel._weights,std::ios::binary);
+        if (!paramf.is_open() || !modelf.is_open())
+          throw MLLibBadParamException("failed opening NCNN model files " + this->_mlmodel._params + " and " + this->_mlmodel._weights);
+        _param_mem.assign(std::istreambuf_iterator<char>(paramf),std::istreambuf_iterator<char>());
+        _model_mem.assign(std::istreambuf_iterator<char>(modelf),std::istreambuf_iterator<char>());
+        _nets.clear();
+
+        if (ad.has("net_cache_size"))
+          _nets.set_capacity(ad.get("net_cache_size").get<int>());
 
         if (ad.has("nclasses"))
 	        _nclasses = ad.get("nclasses").get<int>();
@@ -85,13 +87,10 @@ namespace dd
             _timeserie = true;
           }
 
-        _blob_pool_allocator.set_size_compare_ratio(0.0f);
-        _workspace_pool_allocator.set_size_compare_ratio(0.5f);
+        // allocators are set per extractor, see NCNNContext
         ncnn::Option opt;
         opt.lightmode = true;
         opt.num_threads = _threads;
-        opt.blob_allocator = &_blob_pool_allocator;
-        opt.workspace_allocator = &_workspace_pool_allocator;
         ncnn::set_default_option(opt);
         model_type(this->_mlmodel._params,this->_mltype);
     }
@@ -111,6 +110,37 @@ namespace dd
       return 0;
     }
 
+    template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+    std::shared_ptr<ncnn::Net> NCNNLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::create_net(const int &height)
+    {
+        this->_logger->info("instantiating NCNN net for input height {}",height);
+        std::shared_ptr<ncnn::Net> net(new ncnn::Net());
+        if (net->load_param_mem(_param_mem.c_str()) != 0)
+          throw MLLibBadParamException("failed reading NCNN params " + this->_mlmodel._params);
+        if (net->load_model(_model_mem.data()) <= 0)
+          throw MLLibBadParamException("failed reading NCNN weights " + this->_mlmodel._weights);
+        net->set_input_h(height);
+        return net;
+    }
+
+    template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+    std::unique_ptr<NCNNContext> NCNNLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::acquire_context()
+    {
+        std::lock_guard<std::mutex> lock(_contexts_mutex);
+        if (_contexts.empty())
+            return std::unique_ptr<NCNNContext>(new NCNNContext());
+        std::unique_ptr<NCNNContext> ctx = std::move(_contexts.back());
+        _contexts.pop_back();
+        return ctx;
+    }
+
+    template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+    void NCNNLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::release_context(std::unique_ptr<NCNNContext> &ctx)
+    {
+        std::lock_guard<std::mutex> lock(_contexts_mutex);
+        _contexts.push_back(std::move(ctx));
+    }
+
     template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
     int NCNNLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::predict(const APIData &ad,
 										APIData &out)
@@ -123,23 +153,9 @@ namespace dd
             throw;
         }
 
-        // if height (timestep) changes we need to clear net before recreating an extractor with new
-        // height,
-        // and to reload params and models after clear()
-        if (_old_height != -1 && _old_height != inputc.height())
-          {
-            // in case of new prediction with different timesteps value, clear old net
-            _net->clear();
-            _net->load_param(this->_mlmodel._params.c_str());
-            _net->load_model(this->_mlmodel._weights.c_str());
-            _old_height = inputc.height();
-          }
-        _net->set_input_h(inputc.height());
-
-        ncnn::Extractor ex = _net->create_extractor();
-
-        ex.set_num_threads(_threads);
-        ex.input("data", inputc._in);
+        // a net is set for an input height (e.g. timesteps), nets are cached per height
+        int height = inputc.height();
+        std::shared_ptr<ncnn::Net> net = _nets.get(height,[this,height]{ return create_net(height); });
 
         APIData ad_output = ad.getobj("parameters").getobj("output");
 
@@ -162,7 +178,6 @@ namespace dd
 	  }
 
         // Extract detection or classification
-        int ret = 0;
 	std::string out_blob = "prob";
         if (bbox == true)
 	  out_blob = "detection_out";
@@ -170,18 +185,45 @@ namespace dd
 	  out_blob = "probs";
        else if (_timeserie)
          out_blob = "rnn_pred";
-	ret = ex.extract(out_blob.c_str(),inputc._out);
-        if (ret == -1) {
+
+        // one extractor per input, run in parallel, cores shared among extractors
+        int nins = inputc._ins.size();
+        inputc._outs.resize(nins);
+        int nworkers = std::max(1,std::min(nins,_threads));
+        int ex_threads = std::max(1,_threads / nworkers);
+        std::atomic<int> next(0);
+        std::atomic<bool> failed(false);
+        auto extract = [&]()
+          {
+            std::unique_ptr<NCNNContext> ctx = acquire_context();
+            int i;
+            while (!failed.load() && (i = next++) < nins)
+              {
+                ncnn::Extractor ex = net->create_extractor();
+                ex.set_num_threads(ex_threads);
+                ex.set_blob_allocator(&ctx->_blob_pool_allocator);
+                ex.set_workspace_allocator(&ctx->_workspace_pool_allocator);
+                ex.input("data", inputc._ins.at(i));
+                ncnn::Mat outm;
+                if (ex.extract(out_blob.c_str(),outm) == -1)
+                  {
+                    failed = true;
+                    break;
+                  }
+                inputc._outs.at(i) = outm.clone(); // off the pooled allocators, reused by other calls
+              }
+            release_context(ctx);
+          };
+        std::vector<std::thread> workers;
+        for (int w=1;w<nworkers;w++)
+          workers.push_back(std::thread(extract));
+        extract();
+        for (std::thread &w: workers)
+          w.join();
+        if (failed.load()) {
             throw MLLibInternalException("NCNN internal error");
         }
 
-        std::vector<APIData> vrad;
-        std::vector<double> probs;
-        std::vector<std::string> cats;
-        std::vector<APIData> bboxes;
-        std::vector<APIData> series;
-        APIData rad;
-	
         // Get confidence_threshold
         float confidence_threshold = 0.0;
         if (ad_output.has("confidence_threshold")) {
@@ -194,115 +236,127 @@ namespace dd
             best = ad_output.get("best").get<int>();
         }
 
-        if (bbox == true)
-	  {
-            for (int i = 0; i < inputc._out.h; i++) {
-                const float* values = inputc._out.row(i);
-                if (values[1] < confidence_threshold)
-                    continue;
-
-                cats.push_back(this->_mlmodel.get_hcorresp(values[0]));
-                probs.push_back(values[1]);
-
-                APIData ad_bbox;
-                ad_bbox.add("xmin",values[2] * inputc.width());
-                ad_bbox.add("ymax",values[3] * inputc.height());
-                ad_bbox.add("xmax",values[4] * inputc.width());
-                ad_bbox.add("ymin",values[5] * inputc.height());
-                bboxes.push_back(ad_bbox);
+        std::vector<APIData> vrad;
+        for (int n=0;n<nins;n++)
+          {
+            const ncnn::Mat &outm = inputc._outs.at(n);
+            int width = inputc._ins.at(n).w;
+            int height = inputc._ins.at(n).h;
+            std::vector<double> probs;
+            std::vector<std::string> cats;
+            std::vector<APIData> bboxes;
+            std::vector<APIData> series;
+            APIData rad;
+
+            if (bbox == true)
+              {
+                for (int i = 0; i < outm.h; i++) {
+                    const float* values = outm.row(i);
+                    if (values[1] < confidence_threshold)
+                        continue;
+
+                    cats.push_back(this->_mlmodel.get_hcorresp(values[0]));
+                    probs.push_back(values[1]);
+
+                    APIData ad_bbox;
+                    ad_bbox.add("xmin",values[2] * width);
+                    ad_bbox.add("ymax",values[3] * height);
+                    ad_bbox.add("xmax",values[4] * width);
+                    ad_bbox.add("ymin",values[5] * height);
+                    bboxes.push_back(ad_bbox);
+                }
             }
-        }
-	else if (ctc == true)
-	  {
-	    int alphabet = inputc._out.w;
-	    int time_step = inputc._out.h;
-	    std::vector<int> pred_label_seq_with_blank(time_step);
-	    for (int t=0;t<time_step;++t)
-	      {
-		const float *values = inputc._out.row(t);
-		pred_label_seq_with_blank[t] = std::distance(values,std::max_element(values,values+alphabet));
-	      }
-
-	    std::vector<int> pred_label_seq;
-	    int prev = blank_label;
-	    for (int t=0;t<time_step;++t)
-	      {
-		int cur = pred_label_seq_with_blank[t];
-		if (cur != prev && cur != blank_label)
-		  pred_label_seq.push_back(cur);
-		prev = cur;
-	      }
-	    std::string outstr;
-	    std::ostringstream oss;
-	    for (auto l: pred_label_seq)
-	      outstr += char(std::atoi(this->_mlmodel.get_hcorresp(l).c_str()));
-	    cats.push_back(outstr);
-	    probs.push_back(1.0);
-	  }
-	else if (_timeserie)
-         {
-           std::vector<int> tsl = inputc._timeseries_lengths;
-           for (unsigned int tsi = 0; tsi< tsl.size(); ++tsi)
+            else if (ctc == true)
+              {
+                int alphabet = outm.w;
+                int time_step = outm.h;
+                std::vector<int> pred_label_seq_with_blank(time_step);
+                for (int t=0;t<time_step;++t)
+                  {
+                    const float *values = outm.row(t);
+                    pred_label_seq_with_blank[t] = std::distance(values,std::max_element(values,values+alphabet));
+                  }
+
+                std::vector<int> pred_label_seq;
+                int prev = blank_label;
+                for (int t=0;t<time_step;++t)
+                  {
+                    int cur = pred_label_seq_with_blank[t];
+                    if (cur != prev && cur != blank_label)
+                      pred_label_seq.push_back(cur);
+                    prev = cur;
+                  }
+                std::string outstr;
+                std::ostringstream oss;
+                for (auto l: pred_label_seq)
+                  outstr += char(std::atoi(this->_mlmodel.get_hcorresp(l).c_str()));
+                cats.push_back(outstr);
+                probs.push_back(1.0);
+              }
+            else if (_timeserie)
              {
-               for (int ti = 0; ti<tsl[tsi]; ++ti)
+               std::vector<int> tsl = inputc._timeseries_lengths;
+               for (unsigned int tsi = 0; tsi< tsl.size(); ++tsi)
                  {
-                   std::vector<double> predictions;
-                   for (int k =0; k< inputc._ntargets; ++k)
+                   for (int ti = 0; ti<tsl[tsi]; ++ti)
                      {
-                       double res = inputc._out.row(ti)[k];
-                       predictions.push_back(inputc.unscale_res(res,k));
+                       std::vector<double> predictions;
+                       for (int k =0; k< inputc._ntargets; ++k)
+                         {
+                           double res = outm.row(ti)[k];
+                           predictions.push_back(inputc.unscale_res(res,k));
+                         }
+                       APIData ts;
+                       ts.add("out", predictions);
+                       series.push_back(ts);
                      }
-                   APIData ts;
-                   ts.add("out", predictions);
-                   series.push_back(ts);
                  }
              }
-         }
-       else
-         {
-            std::vector<float> cls_scores;
-
-            cls_scores.resize(inputc._out.w);
-            for (int j = 0; j < inputc._out.w; j++) {
-                cls_scores[j] = inputc._out[j];
-            }
-            int size = cls_scores.size();
-            std::vector< std::pair<float, int> > vec;
-            vec.resize(size);
-            for (int i = 0; i < size; i++) {
-                vec[i] = std::make_pair(cls_scores[i], i);
-            }
+           else
+             {
+                std::vector<float> cls_scores;
+
+                cls_scores.resize(outm.w);
+                for (int j = 0; j < outm.w; j++) {
+                    cls_scores[j] = outm[j];
+                }
+                int size = cls_scores.size();
+                std::vector< std::pair<float, int> > vec;
+                vec.resize(size);
+                for (int i = 0; i < size; i++) {
+                    vec[i] = std::make_pair(cls_scores[i], i);
+                }
         
-            std::partial_sort(vec.begin(), vec.begin() + best, vec.end(),
-                              std::greater< std::pair<float, int> >());
+                std::partial_sort(vec.begin(), vec.begin() + best, vec.end(),
+                                  std::greater< std::pair<float, int> >());
         
-            for (int i = 0; i < best; i++)
-            {
-                if (vec[i].first < confidence_threshold)
-                    continue;
-                cats.push_back(this->_mlmodel.get_hcorresp(vec[i].second));
-                probs.push_back(vec[i].first);
+                for (int i = 0; i < best; i++)
+                {
+                    if (vec[i].first < confidence_threshold)
+                        continue;
+                    cats.push_back(this->_mlmodel.get_hcorresp(vec[i].second));
+                    probs.push_back(vec[i].first);
+                }
             }
-        }
 
-        rad.add("uri",inputc._ids.at(0));
-        rad.add("loss", 0.0);
-        rad.add("cats", cats);
-        if (bbox == true)
-            rad.add("bboxes", bboxes);
-        if (_timeserie)
-          {
-            rad.add("series", series);
-            rad.add("probs",std::vector<double>(series.size(),1.0));
+            rad.add("uri",inputc._ids.at(n));
+            rad.add("loss", 0.0);
+            rad.add("cats", cats);
+            if (bbox == true)
+                rad.add("bboxes", bboxes);
+            if (_timeserie)
+              {
+                rad.add("series", series);
+                rad.add("probs",std::vector<double>(series.size(),1.0));
+              }
+            else
+              rad.add("probs", probs);
+            vrad.push_back(rad);
           }
-        else
-          rad.add("probs", probs);
 
         if (_timeserie)
           out.add("timeseries",true);
 
-
-        vrad.push_back(rad);
         tout.add_results(vrad);
         out.add("nclasses", this->_nclasses);
         if (bbox == true)
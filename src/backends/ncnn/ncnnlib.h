@@ -27,9 +27,31 @@
 #include "ncnnmodel.h"
 
 #include "apidata.h"
+#include "netcache.h"
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace dd
 {
+    /**
+     * \brief allocators of a running extractor, pool allocators are not to be shared
+     *        across concurrent extractors
+     */
+    class NCNNContext
+    {
+    public:
+        NCNNContext()
+        {
+            _blob_pool_allocator.set_size_compare_ratio(0.0f);
+            _workspace_pool_allocator.set_size_compare_ratio(0.5f);
+        }
+        ~NCNNContext() {}
+
+        ncnn::UnlockedPoolAllocator _blob_pool_allocator;
+        ncnn::PoolAllocator _workspace_pool_allocator;
+    };
+
     template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel=NCNNModel>
     class NCNNLib : public MLLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>
     {
@@ -49,17 +71,42 @@ namespace dd
 
         void model_type(const std::string &param_file,
 			std::string &mltype);
+
+        /**
+         * \brief net cache statistics, reported by service info
+         */
+        void lib_stats(APIData &ad) const
+        {
+            ad.add("net_cache",_nets.stats());
+        }
     
     public:
-        ncnn::Net *_net = nullptr;
         int _nclasses = 0;
         bool _timeserie =  false;
     private:
-        static ncnn::UnlockedPoolAllocator _blob_pool_allocator;
-        static ncnn::PoolAllocator _workspace_pool_allocator;
+        /**
+         * \brief instantiates a net for an input height, from the in-memory params and weights
+         */
+        std::shared_ptr<ncnn::Net> create_net(const int &height);
+
+        std::string _param_mem; /**< net params, read once. */
+        std::vector<unsigned char> _model_mem; /**< net weights, read once and shared by all nets. */
+        NetCache<int,ncnn::Net> _nets; /**< nets per input height. */
+
+        /**
+         * \brief gets idle extractor allocators, or new ones
+         */
+        std::unique_ptr<NCNNContext> acquire_context();
+
+        /**
+         * \brief returns extractor allocators to the pool
+         */
+        void release_context(std::unique_ptr<NCNNContext> &ctx);
+
+        std::vector<std::unique_ptr<NCNNContext>> _contexts; /**< idle extractor allocators, reused across calls. */
+        std::mutex _contexts_mutex; /**< mutex around extractor allocators. */
     protected:
         int _threads = 1;
-    int _old_height = -1;
     };
 }
 
@@ -21,17 +21,14 @@
 #define TFINPUTCONNS_H
 
 #include "imginputfileconn.h"
+#include "imgpreproc.h"
 #include "tensorflow/core/public/session.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_util.h"
 #include <opencv2/opencv.hpp>
 
-#include "tensorflow/cc/ops/const_op.h"
-#include "tensorflow/cc/ops/image_ops.h"
-#include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/core/framework/graph.pb.h"
-#include "tensorflow/core/framework/tensor.h"
-#include "tensorflow/core/graph/graph_def_builder.h"
 
 
 #include "inputconnectorstrategy.h"
@@ -49,8 +46,8 @@ namespace dd
 
   public:
     // parameters common to all TF input connectors
-    std::vector<tensorflow::Tensor> _dv; // main tensor for prediction.
-    std::vector<tensorflow::Tensor> _dv_test;
+    tensorflow::Tensor _dv; // main tensor for prediction, [N,H,W,C] batch of all inputs.
+    tensorflow::Tensor _dv_test;
     std::vector<std::string> _ids; // input ids (eg. Image Ids).
   };
 
@@ -61,6 +58,7 @@ namespace dd
       :ImgInputFileConn() 
       {
 	reset_dv();
+	_float_tensors = true;
       }
     ImgTFInputFileConn(const ImgTFInputFileConn &i)
       :ImgInputFileConn(i),TFInputInterface(i),_mean(i._mean),_std(i._std) {}
@@ -84,15 +82,15 @@ namespace dd
 
     int batch_size() const
     {
-      if (!_dv.empty())
-      return _dv.size();
+      if (_dv.dims() > 0)
+	return _dv.dim_size(0);
       else return ImgInputFileConn::batch_size();
     }
     
     int test_batch_size() const
     {
-      if (!_dv_test.empty())
-	return _dv_test.size();
+      if (_dv_test.dims() > 0)
+	return _dv_test.dim_size(0);
       else return ImgInputFileConn::test_batch_size();
     }
 
@@ -126,64 +124,65 @@ namespace dd
 	    _std = ad_input.get("std").get<double>();
 	}
       
-      for (size_t i=0;i<_images.size();i++)
+      // single pass from pixels to the RGB normalized batch tensor, allocated once
+      int nimgs = _images.size();
+      _dv = tensorflow::Tensor(tensorflow::DT_FLOAT,tensorflow::TensorShape({nimgs,_height,_width,channels()}));
+      float *dv_data = _dv.flat<float>().data();
+      size_t img_size = static_cast<size_t>(_height) * _width * channels();
+      std::vector<float> mean(channels(),static_cast<float>(_mean));
+      bool bad_size = false, bad_depth = false;
+#pragma omp parallel for reduction(||:bad_size,bad_depth)
+      for (int i=0;i<nimgs;i++)
 	{
-	  tensorflow::Tensor input_tensor(tensorflow::DT_FLOAT, tensorflow::TensorShape({1,_height,_width,channels()}));
-	  auto input_tensor_mapped = input_tensor.tensor<float, 4>();
-
-	  cv::Mat CImage = std::move(this->_images.at(i));
-	  cv::Mat Image;
-	  CImage.convertTo(Image, CV_32FC1);
-	  cv::Mat Image2;
-	  cv::cvtColor(Image,Image2,CV_BGR2RGB); // because OpenCV defaults to BGR
-	  Image = (Image2 - _mean) / _std;
-	  const float * source_data = (float*) Image.data;
-
-	  // copying the data into the corresponding tensor
-	  for (int y = 0; y < height(); ++y) {
-	    const float* source_row = source_data + (y * width()  * channels());
-	    for (int x = 0; x < width(); ++x) {
-	      const float* source_pixel = source_row + (x * channels());
-	      for (int c = 0; c < channels(); ++c) {
-		const float* source_value = source_pixel + c;
-		input_tensor_mapped(0, y, x, c) = *source_value;
-	      }
+	  const cv::Mat &img = this->_images.at(i);
+	  if (img.rows != _height || img.cols != _width || img.channels() != channels())
+	    {
+	      bad_size = true;
+	      continue;
 	    }
-	  }
-	  
-	  _dv.push_back(input_tensor);
-	  _ids.push_back(_uris.at(i));
+	  ImgPreproc::Params pp;
+	  pp._chw = false;
+	  pp._swap_rb = img.channels() == 3; // because OpenCV defaults to BGR
+	  pp._mean = mean.data();
+	  pp._scale = 1.0 / _std;
+	  if (!ImgPreproc::convert(img,dv_data + i * img_size,pp))
+	    bad_depth = true;
 	}
+      if (bad_size)
+	throw InputConnectorBadParamException("image size does not match input tensor");
+      if (bad_depth)
+	throw InputConnectorBadParamException("unsupported image depth");
+      _ids.insert(_ids.end(),_uris.begin(),_uris.begin()+nimgs);
       _images.clear();
     }
     
-    std::vector<tensorflow::Tensor> get_dv(const int &num)
+    /**
+     * \brief gets the next batch of inputs, as a view into the batch tensor when aligned
+     * @param num max number of inputs
+     * @return [n,H,W,C] tensor with n <= num, n = 0 when inputs are exhausted
+     */
+    tensorflow::Tensor get_dv(const int &num)
       {
-	if (!_train)
-	  {
-	    int i = 0;
-	    std::vector<tensorflow::Tensor> dv;
-	    while(_dt_vit!=_dv.end()
-		  && i < num)
-	      {
-		dv.push_back((*_dt_vit));
-		++i;
-		++_dt_vit;
-	      }
-	    return dv;
-	  }
-	return std::vector<tensorflow::Tensor>(); // unused
+	int nimgs = _dv.dims() > 0 ? _dv.dim_size(0) : 0;
+	if (_train || _dv_pos >= nimgs)
+	  return tensorflow::Tensor(tensorflow::DT_FLOAT,tensorflow::TensorShape({0}));
+	int end = std::min(nimgs,_dv_pos + num);
+	tensorflow::Tensor dv = (_dv_pos == 0 && end == nimgs) ? _dv : _dv.Slice(_dv_pos,end);
+	_dv_pos = end;
+	if (!dv.IsAligned())
+	  return tensorflow::tensor::DeepCopy(dv);
+	return dv;
       }
 
   void reset_dv()
   {
-    _dt_vit = _dv.begin();
+    _dv_pos = 0;
   }
 
   public:
     int _mean = 128;
     int _std = 128;
-    std::vector<tensorflow::Tensor>::const_iterator _dt_vit;
+    int _dv_pos = 0; /**< next input in the batch tensor. */
   };
 
 }
@@ -27,7 +27,6 @@
 #include "tensorflow/core/public/session.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/framework/tensor.h"
-#include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/core/graph/default_device.h" 
 
 namespace dd
@@ -51,6 +50,9 @@ namespace dd
     _inputLayer = cl._inputLayer;
     _outputLayer = cl._outputLayer;
     _inputFlag = cl._inputFlag;
+    _concurrent_runs = cl._concurrent_runs;
+    _inter_op_threads = cl._inter_op_threads;
+    _intra_op_threads = cl._intra_op_threads;
     this->_mltype = "classification";
   }
 
@@ -89,6 +91,14 @@ namespace dd
       {
 	_inputFlag = ad.getobj("input_flag");
       }
+    if (ad.has("concurrent_runs"))
+      _concurrent_runs = ad.get("concurrent_runs").get<int>();
+    if (_concurrent_runs < 1)
+      throw MLLibBadParamException("concurrent_runs must be strictly positive");
+    if (ad.has("inter_op_threads"))
+      _inter_op_threads = ad.get("inter_op_threads").get<int>();
+    if (ad.has("intra_op_threads"))
+      _intra_op_threads = ad.get("intra_op_threads").get<int>();
     if (ad.has("ntargets")) // XXX: unsupported
       _ntargets = ad.get("ntargets").get<int>();
     if (_nclasses == 0)
@@ -105,32 +115,135 @@ namespace dd
   }
 
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
-  void TFLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::tf_concat(const std::vector<tensorflow::Tensor> &dv,
-										   std::vector<tensorflow::Tensor> &vtfinputs)
+  void TFLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::create_session()
   {
-    /*
-      as incredible as it seems, code below is the bloated tf way of concatenating
-      tensors to produce the intput to the neural net graph.
-    */
-    int rbatch_size = dv.size();
-    auto root = tensorflow::Scope::NewRootScope();
-    std::string concat_name = "concatenated";
-    std::vector<tensorflow::Input> ops_inputs;
-    for (int i=0;i<rbatch_size;i++)
-      ops_inputs.push_back(std::move(tensorflow::Input(dv[i])));
-    tensorflow::gtl::ArraySlice<tensorflow::Input> ipl(&ops_inputs[0],ops_inputs.size());
-    tensorflow::InputList toil(ipl);
-    auto concatout = tensorflow::ops::Concat(root.WithOpName(concat_name),toil,0);
-    std::unique_ptr<tensorflow::Session> concat_session(tensorflow::NewSession(tensorflow::SessionOptions()));
-    tensorflow::GraphDef graph;
-    root.ToGraphDef(&graph);
-    concat_session->Create(graph);
-    tensorflow::Status concat_run_status = concat_session->Run({}, {concat_name}, {}, &vtfinputs);
-    if (!concat_run_status.ok())
+    if (_session)
+      return;
+    tensorflow::GraphDef graph_def;
+    std::string graphFile = this->_mlmodel._graphName;
+    if (graphFile.empty())
+      throw MLLibBadParamException("No pre-trained model found in model repository");
+    this->_logger->info("using graphFile dir={}",graphFile);
+    // Loading the graph to the given variable
+    tensorflow::Status graphLoadedStatus = ReadBinaryProto(tensorflow::Env::Default(),graphFile,&graph_def);
+    
+    if (!graphLoadedStatus.ok())
+      {
+	this->_logger->error("failed loading tensorflow graph with status={}",graphLoadedStatus.ToString());
+	throw MLLibBadParamException("failed loading tensorflow graph with status=" + graphLoadedStatus.ToString());
+      }
+    
+    if (_inputLayer.empty())
       {
-	std::cout << concat_run_status.ToString() << std::endl;
-	throw MLLibInternalException(concat_run_status.ToString());
+	_inputLayer = graph_def.node(0).name();
+	this->_logger->info("using input layer={}",_inputLayer);
+      }
+    if (_outputLayer.empty())
+      {
+	_outputLayer = graph_def.node(graph_def.node_size()-1).name();
+	this->_logger->info("using output layer={}",_outputLayer);
+      }
+    //tensorflow::graph::SetDefaultDevice(device, &graph_def);
+    
+    // creating a session with the graph
+    tensorflow::SessionOptions options;
+    tensorflow::ConfigProto &config = options.config;
+    config.mutable_gpu_options()->set_allow_growth(true); // default is we prevent tf from holding all memory across all GPUs
+    if (_inter_op_threads > 0)
+      config.set_inter_op_parallelism_threads(_inter_op_threads);
+    if (_intra_op_threads > 0)
+      config.set_intra_op_parallelism_threads(_intra_op_threads);
+    _session = std::unique_ptr<tensorflow::Session>(tensorflow::NewSession(options));
+    tensorflow::Status session_create_status = _session->Create(graph_def);
+    
+    if (!session_create_status.ok())
+      {
+	std::cout << session_create_status.ToString()<<std::endl;
+	_session = nullptr;
+	throw MLLibInternalException(session_create_status.ToString());
+      }
+  }
+  
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+  void TFLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::acquire_run()
+  {
+    std::unique_lock<std::mutex> lock(_runs_mutex);
+    _runs_cv.wait(lock,[this]{ return _nruns < _concurrent_runs; });
+    ++_nruns;
+  }
+
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+  void TFLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::release_run()
+  {
+    std::lock_guard<std::mutex> lock(_runs_mutex);
+    --_nruns;
+    _runs_cv.notify_one();
+  }
+
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+  void TFLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::run_session(const std::vector<std::pair<std::string,tensorflow::Tensor>> &inputs,
+										     const std::string &output_layer,
+										     std::vector<tensorflow::Tensor> &outputs,
+										     tensorflow::RunMetadata *run_metadata)
+  {
+    tensorflow::RunOptions run_options;
+    if (run_metadata)
+      run_options.set_trace_level(tensorflow::RunOptions::FULL_TRACE);
+    acquire_run();
+    tensorflow::Status run_status;
+    try
+      {
+	// TF sessions support concurrent calls, the number of runs is bounded
+	// so that cumulated calls do not overflow the resources.
+	run_status = _session->Run(run_options,inputs,{output_layer},{},&outputs,run_metadata);
+      }
+    catch (...)
+      {
+	release_run();
+	throw;
+      }
+    release_run();
+    if (!run_status.ok())
+      {
+	std::cout << run_status.ToString() << std::endl;
+	throw MLLibInternalException(run_status.ToString()); //TODO: separate bad param and internal errors
+      }
+  }
+
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+  APIData TFLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::run_metadata_stats(const tensorflow::RunMetadata &run_metadata)
+  {
+    const tensorflow::StepStats &step_stats = run_metadata.step_stats();
+    int64_t step_start = -1;
+    int64_t step_end = 0;
+    for (const tensorflow::DeviceStepStats &ds: step_stats.dev_stats())
+      for (const tensorflow::NodeExecStats &ns: ds.node_stats())
+	{
+	  if (step_start < 0 || ns.all_start_micros() < step_start)
+	    step_start = ns.all_start_micros();
+	  step_end = std::max(step_end,static_cast<int64_t>(ns.all_start_micros() + ns.all_end_rel_micros()));
+	}
+    std::vector<APIData> devices;
+    for (const tensorflow::DeviceStepStats &ds: step_stats.dev_stats())
+      {
+	std::vector<APIData> nodes;
+	for (const tensorflow::NodeExecStats &ns: ds.node_stats())
+	  {
+	    APIData node;
+	    node.add("name",ns.node_name());
+	    node.add("start_micros",static_cast<double>(ns.all_start_micros() - step_start));
+	    node.add("duration_micros",static_cast<double>(ns.all_end_rel_micros()));
+	    nodes.push_back(node);
+	  }
+	APIData device;
+	device.add("device",ds.device());
+	device.add("nodes",nodes);
+	devices.push_back(device);
       }
+    APIData stats;
+    stats.add("step_micros",static_cast<double>(step_start < 0 ? 0 : step_end - step_start));
+    stats.add("devices",devices);
+    return stats;
   }
   
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
@@ -174,44 +287,14 @@ namespace dd
 	batch_size = ad_mllib.get("test_batch_size").get<int>();
       }
 
-    tensorflow::GraphDef graph_def;
-    std::string graphFile = this->_mlmodel._graphName;
-    if (graphFile.empty())
-      throw MLLibBadParamException("No pre-trained model found in model repository");
-    this->_logger->info("test: using graphFile dir={}",graphFile);
-    // Loading the graph to the given variable
-    tensorflow::Status graphLoadedStatus = ReadBinaryProto(tensorflow::Env::Default(),graphFile,&graph_def);
-    
-    if (!graphLoadedStatus.ok())
-      {
-	this->_logger->error("failed loading tensorflow graph with status={}",graphLoadedStatus.ToString());
-	throw MLLibBadParamException("failed loading tensorflow graph with status=" + graphLoadedStatus.ToString());
-      }
-    std::string inputLayer = _inputLayer;
-    std::string outputLayer = _outputLayer;
-    if (inputLayer.empty())
-      {
-	inputLayer = graph_def.node(0).name();
-	this->_logger->info("testing: using input layer={}",inputLayer);
-      }
-    if (outputLayer.empty())
-      {
-	outputLayer = graph_def.node(graph_def.node_size()-1).name();
-	this->_logger->info("testing: using output layer={}",outputLayer);
-      }
-    
-    // creating a session with the graph
-    tensorflow::SessionOptions options;
-    tensorflow::ConfigProto &config = options.config;
-    config.mutable_gpu_options()->set_allow_growth(true); // default is we prevent tf from holding all memory across all GPUs
-    auto session = std::unique_ptr<tensorflow::Session>(tensorflow::NewSession(options));
-    tensorflow::Status session_create_status = session->Create(graph_def);
-    
-    if (!session_create_status.ok())
-      {
-	std::cout << session_create_status.ToString()<<std::endl;
-	throw MLLibInternalException(session_create_status.ToString());
-      }
+    // runs on the persistent session shared with predict
+    std::string input_layer, output_layer;
+    {
+      std::lock_guard<std::mutex> lock(_net_mutex);
+      create_session();
+      input_layer = _inputLayer;
+      output_layer = _outputLayer;
+    }
     
     // vector for storing  the outputAPI of the file 
     APIData ad_res;
@@ -219,41 +302,32 @@ namespace dd
     int tresults = 0;
     
     inputc.reset_dv();
-    int idoffset = 0;
+    const std::vector<int> &dv_labels = inputc._test_labels;
     while(true)
       {
-	std::vector<int> dv_labels = inputc._test_labels;
-	std::vector<tensorflow::Tensor> dv = inputc.get_dv(batch_size);
-	if (dv.empty())
+	tensorflow::Tensor dv = inputc.get_dv(batch_size);
+	int dv_size = dv.dim_size(0);
+	if (dv_size == 0)
 	  break;
-	std::vector<tensorflow::Tensor> vtfinputs;
-	if (dv.size() > 1)
-	  tf_concat(dv,vtfinputs);
-	else vtfinputs = dv;
 	
 	// running the loded graph and saving the generated output 
 	std::vector<tensorflow::Tensor> finalOutput; // To save the final Output generated by the tensorflow
-	tensorflow::Status run_status  = session->Run({{inputLayer,*(vtfinputs.begin())}},{outputLayer},{},&finalOutput);
-	if (!run_status.ok())
-	  {
-	    std::cout << run_status.ToString() << std::endl;
-	    throw MLLibInternalException(run_status.ToString()); //XXX: does not separate bad param from internal errors
-	  }
+	run_session({{input_layer,dv}},output_layer,finalOutput);
 	tensorflow::Tensor output = std::move(finalOutput.at(0));
 	
 	auto scores = output.flat<float>();
-	std::vector<double> predictions;
-	for (size_t i=0;i<dv.size();i++)
+	for (int i=0;i<dv_size;i++)
 	  {
 	    APIData bad;
+	    std::vector<double> predictions;
 	    for (int c=0;c<_nclasses;c++)
 	      predictions.push_back(scores(i*_nclasses+c));
-	    double target = dv_labels.at(i);
+	    double target = dv_labels.at(tresults+i);
 	    bad.add("target",target);
 	    bad.add("pred",predictions);
 	    ad_res.add(std::to_string(tresults+i),bad);
 	  }
-	tresults += dv.size();
+	tresults += dv_size;
       } // end prediction loop over batches
     
     std::vector<std::string> clnames;
@@ -269,12 +343,8 @@ namespace dd
   int TFLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::predict(const APIData &ad,
 										APIData &out)
   {
-    // TF sessions support concurrent calls, however server design enforces
-    // preference for using batches to max out resources instead of 
-    // cumulated calls that may overflow the resources.
-    // This policy may be subjected to futur changes.
-    std::lock_guard<std::mutex> lock(_net_mutex);
-
+    // input transformation and output finalization run concurrently,
+    // session runs are bounded by concurrent_runs, see run_session
     APIData ad_output = ad.getobj("parameters").getobj("output");
     if (ad_output.has("measure"))
       {
@@ -306,72 +376,28 @@ namespace dd
 
     std::string extract_layer;
     if (ad_mllib.has("extract_layer") && !ad_mllib.get("extract_layer").get<std::string>().empty())
-      {
-       	_outputLayer = ad_mllib.get("extract_layer").get<std::string>();
-	extract_layer = _outputLayer;
-      }
-      
-    if (!_session)
-      {
-	tensorflow::GraphDef graph_def;
-	std::string graphFile = this->_mlmodel._graphName;
-	if (graphFile.empty())
-	  throw MLLibBadParamException("No pre-trained model found in model repository");
-	this->_logger->info("predict: using graphFile dir={}",graphFile);
-	// Loading the graph to the given variable
-	tensorflow::Status graphLoadedStatus = ReadBinaryProto(tensorflow::Env::Default(),graphFile,&graph_def);
-	
-	if (!graphLoadedStatus.ok())
-	  {
-	    this->_logger->error("failed loading tensorflow graph with status={}",graphLoadedStatus.ToString());
-	    throw MLLibBadParamException("failed loading tensorflow graph with status=" + graphLoadedStatus.ToString());
-	  }
+      extract_layer = ad_mllib.get("extract_layer").get<std::string>();
+    bool run_metadata = ad_mllib.has("run_metadata") && ad_mllib.get("run_metadata").get<bool>();
 
-	/*for (int l=0;l<graph_def.node_size();l++)
-	  {
-	    std::cerr << graph_def.node(l).name() << std::endl;
-	    }*/
-	
-	if (_inputLayer.empty())
-	  {
-	    _inputLayer = graph_def.node(0).name();
-	    this->_logger->info("using input layer={}",_inputLayer);
-	  }
-	if (_outputLayer.empty())
-	  {
-	    _outputLayer = graph_def.node(graph_def.node_size()-1).name();
-	    this->_logger->info("using output layer={}",_outputLayer);
-	  }
-	//tensorflow::graph::SetDefaultDevice(device, &graph_def);
-	
-	// creating a session with the graph
-	tensorflow::SessionOptions options;
-	tensorflow::ConfigProto &config = options.config;
-	config.mutable_gpu_options()->set_allow_growth(true); // default is we prevent tf from holding all memory across all GPUs
-	_session = std::unique_ptr<tensorflow::Session>(tensorflow::NewSession(options));
-	tensorflow::Status session_create_status = _session->Create(graph_def);
-	
-	if (!session_create_status.ok())
-	  {
-	    std::cout << session_create_status.ToString()<<std::endl;
-	    _session = nullptr;
-	    throw MLLibInternalException(session_create_status.ToString());
-	  }
-      }
+    std::string input_layer, output_layer;
+    {
+      std::lock_guard<std::mutex> lock(_net_mutex);
+      create_session();
+      input_layer = _inputLayer;
+      output_layer = extract_layer.empty() ? _outputLayer : extract_layer;
+    }
     
     // vector for storing  the outputAPI of the file 
     std::vector<APIData> vrad;
+    std::vector<APIData> vrun_metadata;
     inputc.reset_dv();
     int idoffset = 0;
     while(true)
       {
-	std::vector<tensorflow::Tensor> dv = inputc.get_dv(batch_size);
-	if (dv.empty())
+	tensorflow::Tensor dv = inputc.get_dv(batch_size);
+	int dv_size = dv.dim_size(0);
+	if (dv_size == 0)
 	  break;
-	std::vector<tensorflow::Tensor> vtfinputs;
-	if (dv.size() > 1)
-	  tf_concat(dv,vtfinputs);
-	else vtfinputs = dv;
 	
 	// other input variables
 	std::pair<std::string,tensorflow::Tensor> othertfinputs;
@@ -390,22 +416,20 @@ namespace dd
 	
 	// running the loded graph and saving the generated output 
 	std::vector<tensorflow::Tensor> finalOutput; // To save the final output generated by the tensorflow
-	tensorflow::Status run_status;
+	std::vector<std::pair<std::string,tensorflow::Tensor>> tfinputs = {{input_layer,dv}};
 	if (has_input_vars)
-	  run_status = _session->Run({{_inputLayer,*(vtfinputs.begin())},othertfinputs},{_outputLayer},{},&finalOutput);
-	else run_status = _session->Run({{_inputLayer,*(vtfinputs.begin())}},{_outputLayer},{},&finalOutput);
-	if (!run_status.ok())
-	  {
-	    std::cout <<run_status.ToString()<<std::endl;
-	    throw MLLibInternalException(run_status.ToString()); //TODO: separate bad param and internal errors
-	  }
+	  tfinputs.push_back(othertfinputs);
+	tensorflow::RunMetadata rmeta;
+	run_session(tfinputs,output_layer,finalOutput,run_metadata ? &rmeta : nullptr);
+	if (run_metadata)
+	  vrun_metadata.push_back(run_metadata_stats(rmeta));
 	tensorflow::Tensor output = std::move(finalOutput.at(0));
 
 	APIData rad;
 	if (extract_layer.empty()) // supervised setting
 	  {
 	    auto scores = output.flat<float>();
-	    for (size_t i=0;i<dv.size();i++)
+	    for (int i=0;i<dv_size;i++)
 	      {
 		rad.add("uri",inputc._ids.at(idoffset+i));
 		std::vector<double> probs;
@@ -424,14 +448,14 @@ namespace dd
 		rad.add("loss",0.0);
 		vrad.push_back(rad);
 	      }
-	    idoffset += dv.size();
+	    idoffset += dv_size;
 	  }
 	else // unsupervised
 	  {
 	    auto layer_vals = output.flat<float>();
-	    int embedding_size = layer_vals.size() / static_cast<float>(dv.size());
+	    int embedding_size = layer_vals.size() / static_cast<float>(dv_size);
 	    int offset = 0;
-	    for (size_t i=0;i<dv.size();i++)
+	    for (int i=0;i<dv_size;i++)
 	      {
 		std::vector<double> vals;
 		vals.reserve(embedding_size);//layer_vals.size());
@@ -442,12 +466,14 @@ namespace dd
 		vrad.push_back(rad);
 		offset += embedding_size;
 	      }
-	    idoffset += dv.size();
+	    idoffset += dv_size;
 	  }
       } // end prediction loop over batches
     tout.add_results(vrad);
     out.add("nclasses",_nclasses);
     tout.finalize(ad.getobj("parameters").getobj("output"),out,static_cast<MLModel*>(&this->_mlmodel));
+    if (run_metadata)
+      out.add("run_metadata",vrun_metadata); // one per batch
     out.add("status",0);
     return 0;
   }
@@ -26,6 +26,8 @@
 #include "tfmodel.h"
 
 # include <string>
+#include <condition_variable>
+#include <mutex>
 #include "tensorflow/core/public/session.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -52,8 +54,40 @@ namespace dd
     int predict(const APIData &ad, APIData &out);
 
     /*- local functions -*/
-    void tf_concat(const std::vector<tensorflow::Tensor> &dv,
-		   std::vector<tensorflow::Tensor> &vtfinputs);
+    /**
+     * \brief loads the graph and creates the persistent session used by
+     *        both predict and test, if not already there. Requires _net_mutex.
+     */
+    void create_session();
+
+    /**
+     * \brief waits for one of the concurrent session run slots
+     */
+    void acquire_run();
+
+    /**
+     * \brief frees a session run slot
+     */
+    void release_run();
+
+    /**
+     * \brief runs the session on a batch, within a run slot
+     * @param inputs input tensors
+     * @param output_layer layer to fetch
+     * @param outputs fetched tensors
+     * @param run_metadata per step statistics, collected if not null
+     */
+    void run_session(const std::vector<std::pair<std::string,tensorflow::Tensor>> &inputs,
+		     const std::string &output_layer,
+		     std::vector<tensorflow::Tensor> &outputs,
+		     tensorflow::RunMetadata *run_metadata=nullptr);
+
+    /**
+     * \brief turns run step statistics into per device node timings
+     * @param run_metadata run metadata from a traced run
+     * @return data object with timings
+     */
+    static APIData run_metadata_stats(const tensorflow::RunMetadata &run_metadata);
     
 
     public:
@@ -64,8 +98,14 @@ namespace dd
     std::string _inputLayer; // input Layer of the model
     std::string _outputLayer; // output layer of the model
     APIData _inputFlag; // boolean input to the model
+    int _concurrent_runs = 1; /**< max number of concurrent session runs, defaults to one at a time, the server preferring batches to cumulated calls. */
+    int _inter_op_threads = 0; /**< session inter-op thread pool size, 0 lets TF decide. */
+    int _intra_op_threads = 0; /**< session intra-op thread pool size, 0 lets TF decide. */
     std::unique_ptr<tensorflow::Session> _session = nullptr;
-    std::mutex _net_mutex; /**< mutex around net, e.g. no concurrent predict calls as net is not re-instantiated. Use batches instead. */
+    std::mutex _net_mutex; /**< mutex around session creation and layer defaults. */
+    int _nruns = 0; /**< number of ongoing session runs. */
+    std::mutex _runs_mutex; /**< mutex around ongoing session runs. */
+    std::condition_variable _runs_cv; /**< signals a free session run slot. */
     };
   
 }
@@ -0,0 +1,513 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2019 Jolibrain
+ * Author: Emmanuel Benazera <beniz@droidnik.fr>
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bhtsne.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+namespace dd
+{
+
+  /*- QuadTree -*/
+  int QuadTree::add_node(const double &cx, const double &cy, const double &hw, const double &hh)
+  {
+    Node n;
+    n._cx = cx;
+    n._cy = cy;
+    n._hw = hw;
+    n._hh = hh;
+    _nodes.push_back(n);
+    return _nodes.size() - 1;
+  }
+
+  void QuadTree::build(const double *Y, const int &N)
+  {
+    _nodes.clear();
+    if (N == 0)
+      return;
+    double min_x = Y[0], max_x = Y[0], min_y = Y[1], max_y = Y[1];
+    for (int i=1;i<N;i++)
+      {
+	min_x = std::min(min_x,Y[2*i]);
+	max_x = std::max(max_x,Y[2*i]);
+	min_y = std::min(min_y,Y[2*i+1]);
+	max_y = std::max(max_y,Y[2*i+1]);
+      }
+    add_node((min_x+max_x)/2.0,(min_y+max_y)/2.0,(max_x-min_x)/2.0+1e-5,(max_y-min_y)/2.0+1e-5);
+    for (int i=0;i<N;i++)
+      insert(Y,i);
+  }
+
+  void QuadTree::insert(const double *Y, const int &i)
+  {
+    const double x = Y[2*i], y = Y[2*i+1];
+    int n = 0;
+    for (int depth=0;;depth++)
+      {
+	if (_nodes[n]._children < 0)
+	  {
+	    if (_nodes[n]._size == 0)
+	      {
+		_nodes[n]._point = i;
+		_nodes[n]._size = 1;
+		_nodes[n]._com_x = x;
+		_nodes[n]._com_y = y;
+		return;
+	      }
+	    // duplicates (or points too close to be told apart) only add to the cell's mass
+	    int p = _nodes[n]._point;
+	    if ((Y[2*p] == x && Y[2*p+1] == y) || depth >= 64)
+	      {
+		Node &nd = _nodes[n];
+		nd._com_x = (nd._com_x * nd._size + x) / (nd._size + 1);
+		nd._com_y = (nd._com_y * nd._size + y) / (nd._size + 1);
+		++nd._size;
+		return;
+	      }
+
+	    // subdivides, the held point moves down to its quadrant
+	    double hw = _nodes[n]._hw / 2.0, hh = _nodes[n]._hh / 2.0;
+	    double cx = _nodes[n]._cx, cy = _nodes[n]._cy;
+	    int c = add_node(cx-hw,cy-hh,hw,hh);
+	    add_node(cx+hw,cy-hh,hw,hh);
+	    add_node(cx-hw,cy+hh,hw,hh);
+	    add_node(cx+hw,cy+hh,hw,hh);
+	    Node &pn = _nodes[c + (Y[2*p] >= cx ? 1 : 0) + (Y[2*p+1] >= cy ? 2 : 0)];
+	    pn._point = p;
+	    pn._size = _nodes[n]._size;
+	    pn._com_x = _nodes[n]._com_x;
+	    pn._com_y = _nodes[n]._com_y;
+	    _nodes[n]._children = c;
+	    _nodes[n]._point = -1;
+	  }
+	Node &nd = _nodes[n];
+	nd._com_x = (nd._com_x * nd._size + x) / (nd._size + 1);
+	nd._com_y = (nd._com_y * nd._size + y) / (nd._size + 1);
+	++nd._size;
+	n = nd._children + (x >= nd._cx ? 1 : 0) + (y >= nd._cy ? 2 : 0);
+      }
+  }
+
+  void QuadTree::non_edge_forces(const double *Y, const int &i, const double &theta,
+				 double neg_f[2], double &sum_Q) const
+  {
+    if (!_nodes.empty())
+      non_edge_forces(0,Y,i,theta*theta,neg_f,sum_Q);
+  }
+
+  void QuadTree::non_edge_forces(const int &node, const double *Y, const int &i, const double &theta2,
+				 double neg_f[2], double &sum_Q) const
+  {
+    const Node &nd = _nodes[node];
+    if (nd._size == 0 || (nd._children < 0 && nd._point == i))
+      return;
+    double dx = Y[2*i] - nd._com_x;
+    double dy = Y[2*i+1] - nd._com_y;
+    double D = dx*dx + dy*dy;
+    double max_width = std::max(nd._hw,nd._hh);
+    if (nd._children < 0 || max_width * max_width < theta2 * D)
+      {
+	// the cell is summarized by its center of mass
+	double Q = 1.0 / (1.0 + D);
+	double mult = nd._size * Q;
+	sum_Q += mult;
+	mult *= Q;
+	neg_f[0] += mult * dx;
+	neg_f[1] += mult * dy;
+      }
+    else
+      {
+	for (int c=0;c<4;c++)
+	  non_edge_forces(nd._children+c,Y,i,theta2,neg_f,sum_Q);
+      }
+  }
+
+  /*- VPTree -*/
+  /**
+   * \brief vantage-point tree for exact nearest neighbours in euclidean space
+   */
+  class VPTree
+  {
+  public:
+    VPTree(const double *X, const int &N, const int &D, std::mt19937 &g)
+      :_X(X),_D(D),_items(N)
+    {
+      std::iota(_items.begin(),_items.end(),0);
+      _nodes.reserve(N);
+      build(0,N,g);
+    }
+    ~VPTree() {}
+
+    double dist(const int &a, const int &b) const
+    {
+      const double *xa = _X + static_cast<size_t>(a) * _D;
+      const double *xb = _X + static_cast<size_t>(b) * _D;
+      double d = 0.0;
+      for (int k=0;k<_D;k++)
+	d += (xa[k] - xb[k]) * (xa[k] - xb[k]);
+      return std::sqrt(d);
+    }
+
+    /**
+     * \brief k nearest neighbours of a point, itself included, by increasing distance
+     */
+    void search(const int &target, const int &k, std::vector<std::pair<double,int>> &heap) const
+    {
+      heap.clear();
+      double tau = DBL_MAX;
+      if (!_nodes.empty())
+	search(0,target,k,heap,tau);
+      std::sort_heap(heap.begin(),heap.end());
+    }
+
+  private:
+    class Node
+    {
+    public:
+      int _point = -1;
+      double _threshold = 0.0;
+      int _left = -1;
+      int _right = -1;
+    };
+
+    int build(const int &lower, const int &upper, std::mt19937 &g)
+    {
+      if (upper == lower)
+	return -1;
+      int n = _nodes.size();
+      _nodes.push_back(Node());
+      if (upper - lower > 1)
+	{
+	  // random vantage point, other points split at the median distance
+	  std::swap(_items[lower],_items[lower + g() % (upper - lower)]);
+	  int vp = _items[lower];
+	  int median = (upper + lower) / 2;
+	  std::nth_element(_items.begin()+lower+1,_items.begin()+median,_items.begin()+upper,
+			   [this,vp](const int &a, const int &b) { return dist(vp,a) < dist(vp,b); });
+	  _nodes[n]._threshold = dist(vp,_items[median]);
+	  int left = build(lower+1,median,g);
+	  int right = build(median,upper,g);
+	  _nodes[n]._left = left;
+	  _nodes[n]._right = right;
+	}
+      _nodes[n]._point = _items[lower];
+      return n;
+    }
+
+    void search(const int &node, const int &target, const int &k,
+		std::vector<std::pair<double,int>> &heap, double &tau) const
+    {
+      if (node < 0)
+	return;
+      const Node &nd = _nodes[node];
+      double d = dist(nd._point,target);
+      if (d < tau)
+	{
+	  if (static_cast<int>(heap.size()) == k)
+	    {
+	      std::pop_heap(heap.begin(),heap.end());
+	      heap.pop_back();
+	    }
+	  heap.push_back(std::pair<double,int>(d,nd._point));
+	  std::push_heap(heap.begin(),heap.end());
+	  if (static_cast<int>(heap.size()) == k)
+	    tau = heap.front().first;
+	}
+      if (d < nd._threshold)
+	{
+	  if (d - tau <= nd._threshold)
+	    search(nd._left,target,k,heap,tau);
+	  if (d + tau >= nd._threshold)
+	    search(nd._right,target,k,heap,tau);
+	}
+      else
+	{
+	  if (d + tau >= nd._threshold)
+	    search(nd._right,target,k,heap,tau);
+	  if (d - tau <= nd._threshold)
+	    search(nd._left,target,k,heap,tau);
+	}
+    }
+
+    const double *_X;
+    int _D;
+    std::vector<int> _items;
+    std::vector<Node> _nodes;
+  };
+
+  /*- BHTSNE -*/
+  void BHTSNE::knn(const double *X, const int &K, std::vector<int> &ids,
+		   std::vector<double> &dists, const std::atomic<bool> &running) const
+  {
+    std::mt19937 g(_seed >= 0 ? _seed : std::random_device()());
+    VPTree tree(X,_N,_D,g);
+    ids.resize(static_cast<size_t>(_N) * K);
+    dists.resize(static_cast<size_t>(_N) * K);
+#pragma omp parallel for num_threads(_num_threads) schedule(dynamic,64)
+    for (int n=0;n<_N;n++)
+      {
+	if (!running.load())
+	  continue;
+	std::vector<std::pair<double,int>> heap;
+	tree.search(n,K+1,heap);
+	int k = 0;
+	for (const std::pair<double,int> &h: heap)
+	  {
+	    if (h.second == n || k == K)
+	      continue;
+	    ids[static_cast<size_t>(n)*K+k] = h.second;
+	    dists[static_cast<size_t>(n)*K+k] = h.first;
+	    ++k;
+	  }
+      }
+  }
+
+  void BHTSNE::symmetrize(const int &K, const std::vector<int> &ids, const std::vector<double> &vals)
+  {
+    // P + P^T, as per-row lists of (column,value) with duplicates
+    std::vector<int> offsets(_N+1,0);
+    for (size_t e=0;e<ids.size();e++)
+      {
+	++offsets[e/K+1];
+	++offsets[ids[e]+1];
+      }
+    std::partial_sum(offsets.begin(),offsets.end(),offsets.begin());
+    std::vector<std::pair<int,double>> elts(offsets.back());
+    std::vector<int> fill(offsets.begin(),offsets.end()-1);
+    for (size_t e=0;e<ids.size();e++)
+      {
+	int n = e/K;
+	elts[fill[n]++] = std::pair<int,double>(ids[e],vals[e]);
+	elts[fill[ids[e]]++] = std::pair<int,double>(n,vals[e]);
+      }
+
+    // merge duplicates within rows
+    std::vector<int> sizes(_N+1,0);
+#pragma omp parallel for num_threads(_num_threads) schedule(dynamic,256)
+    for (int n=0;n<_N;n++)
+      {
+	auto begin = elts.begin()+offsets[n], end = elts.begin()+offsets[n+1];
+	std::sort(begin,end,[](const std::pair<int,double> &a, const std::pair<int,double> &b) { return a.first < b.first; });
+	auto out = begin;
+	for (auto it=begin;it!=end;++it)
+	  {
+	    if (out != begin && (out-1)->first == it->first)
+	      (out-1)->second += it->second;
+	    else *out++ = *it;
+	  }
+	sizes[n+1] = out - begin;
+      }
+    _row_P.resize(_N+1);
+    std::partial_sum(sizes.begin(),sizes.end(),_row_P.begin());
+    _col_P.resize(_row_P.back());
+    _val_P.resize(_row_P.back());
+    double sum_P = 0.0;
+#pragma omp parallel for num_threads(_num_threads) reduction(+:sum_P)
+    for (int n=0;n<_N;n++)
+      for (int i=0;i<_row_P[n+1]-_row_P[n];i++)
+	{
+	  _col_P[_row_P[n]+i] = elts[offsets[n]+i].first;
+	  _val_P[_row_P[n]+i] = elts[offsets[n]+i].second;
+	  sum_P += elts[offsets[n]+i].second;
+	}
+    for (double &v: _val_P)
+      v /= sum_P;
+  }
+
+  bool BHTSNE::step1(double *X, double *Y, const std::atomic<bool> &running)
+  {
+    // zero-mean data, scaled to [-1,1]
+    std::vector<double> mean(_D,0.0);
+    for (int n=0;n<_N;n++)
+      for (int d=0;d<_D;d++)
+	mean[d] += X[static_cast<size_t>(n)*_D+d];
+    for (double &m: mean)
+      m /= _N;
+    double max_X = 0.0;
+    for (int n=0;n<_N;n++)
+      for (int d=0;d<_D;d++)
+	{
+	  double &x = X[static_cast<size_t>(n)*_D+d];
+	  x -= mean[d];
+	  max_X = std::max(max_X,std::fabs(x));
+	}
+    if (max_X > 0.0)
+      for (size_t i=0;i<static_cast<size_t>(_N)*_D;i++)
+	X[i] /= max_X;
+
+    // gaussian similarities over nearest neighbours, with bandwidths matching the perplexity
+    int K = std::min(_N-1,static_cast<int>(3 * _perplexity));
+    std::vector<int> ids;
+    std::vector<double> vals;
+    knn(X,K,ids,vals,running);
+    if (!running.load())
+      return false;
+#pragma omp parallel for num_threads(_num_threads) schedule(dynamic,64)
+    for (int n=0;n<_N;n++)
+      {
+	double *P = &vals[static_cast<size_t>(n)*K];
+	std::vector<double> D2(P,P+K);
+	for (double &d: D2)
+	  d *= d;
+	double beta = 1.0, min_beta = -DBL_MAX, max_beta = DBL_MAX, sum_P = DBL_MIN;
+	for (int iter=0;iter<200;iter++)
+	  {
+	    sum_P = DBL_MIN;
+	    double H = 0.0;
+	    for (int k=0;k<K;k++)
+	      {
+		P[k] = std::exp(-beta * D2[k]);
+		sum_P += P[k];
+		H += beta * D2[k] * P[k];
+	      }
+	    H = H / sum_P + std::log(sum_P);
+	    double Hdiff = H - std::log(_perplexity);
+	    if (std::fabs(Hdiff) < 1e-5)
+	      break;
+	    if (Hdiff > 0)
+	      {
+		min_beta = beta;
+		beta = max_beta == DBL_MAX ? beta * 2.0 : (beta + max_beta) / 2.0;
+	      }
+	    else
+	      {
+		max_beta = beta;
+		beta = min_beta == -DBL_MAX ? beta / 2.0 : (beta + min_beta) / 2.0;
+	      }
+	  }
+	for (int k=0;k<K;k++)
+	  P[k] /= sum_P;
+      }
+    symmetrize(K,ids,vals);
+
+    // early exaggeration
+    _cur_exaggeration = _exaggeration;
+    for (double &v: _val_P)
+      v *= _cur_exaggeration;
+
+    // small random initial embedding
+    std::mt19937 g(_seed >= 0 ? _seed : std::random_device()());
+    std::normal_distribution<double> gauss(0.0,1e-4);
+    for (int i=0;i<2*_N;i++)
+      Y[i] = gauss(g);
+    _uY.assign(2*_N,0.0);
+    _gains.assign(2*_N,1.0);
+    _dY.assign(2*_N,0.0);
+    _neg_f.assign(2*_N,0.0);
+    return running.load();
+  }
+
+  void BHTSNE::gradient(const double *Y, double *loss)
+  {
+    _tree.build(Y,_N);
+    double sum_Q = 0.0;
+#pragma omp parallel for num_threads(_num_threads) schedule(dynamic,256) reduction(+:sum_Q)
+    for (int n=0;n<_N;n++)
+      {
+	// attractive forces over the point's similarities
+	double pos_x = 0.0, pos_y = 0.0;
+	for (int i=_row_P[n];i<_row_P[n+1];i++)
+	  {
+	    int m = _col_P[i];
+	    double dx = Y[2*n] - Y[2*m];
+	    double dy = Y[2*n+1] - Y[2*m+1];
+	    double q = _val_P[i] / (1.0 + dx*dx + dy*dy);
+	    pos_x += q * dx;
+	    pos_y += q * dy;
+	  }
+	_dY[2*n] = pos_x;
+	_dY[2*n+1] = pos_y;
+
+	// repulsive forces from the tree
+	double neg_f[2] = {0.0,0.0};
+	double q = 0.0;
+	_tree.non_edge_forces(Y,n,_theta,neg_f,q);
+	_neg_f[2*n] = neg_f[0];
+	_neg_f[2*n+1] = neg_f[1];
+	sum_Q += q;
+      }
+#pragma omp parallel for num_threads(_num_threads)
+    for (int i=0;i<2*_N;i++)
+      _dY[i] -= _neg_f[i] / sum_Q;
+
+    if (loss)
+      {
+	// KL divergence over non-zero similarities, with the normalization of the current embedding
+	double C = 0.0;
+#pragma omp parallel for num_threads(_num_threads) schedule(dynamic,256) reduction(+:C)
+	for (int n=0;n<_N;n++)
+	  for (int i=_row_P[n];i<_row_P[n+1];i++)
+	    {
+	      int m = _col_P[i];
+	      double dx = Y[2*n] - Y[2*m];
+	      double dy = Y[2*n+1] - Y[2*m+1];
+	      double Q = (1.0 / (1.0 + dx*dx + dy*dy)) / sum_Q;
+	      double P = _val_P[i] / _cur_exaggeration;
+	      C += P * std::log((P + FLT_MIN) / (Q + FLT_MIN));
+	    }
+	*loss = C;
+      }
+  }
+
+  void BHTSNE::step2_one_iter(double *Y, const int &iter, double &loss, const int &test_iter)
+  {
+    if (iter >= _stop_lying_iter && _cur_exaggeration != 1.0)
+      {
+	for (double &v: _val_P)
+	  v /= _cur_exaggeration;
+	_cur_exaggeration = 1.0;
+      }
+    double momentum = iter < _mom_switch_iter ? _momentum : _final_momentum;
+
+    gradient(Y,test_iter > 0 && iter % test_iter == 0 ? &loss : nullptr);
+
+    // gradient update with adaptive gains
+#pragma omp parallel for num_threads(_num_threads)
+    for (int i=0;i<2*_N;i++)
+      {
+	if ((_dY[i] > 0.0) - (_dY[i] < 0.0) != (_uY[i] > 0.0) - (_uY[i] < 0.0))
+	  _gains[i] += 0.2;
+	else _gains[i] *= 0.8;
+	_gains[i] = std::max(_gains[i],0.01);
+	_uY[i] = momentum * _uY[i] - _eta * _gains[i] * _dY[i];
+	Y[i] += _uY[i];
+      }
+
+    // zero-mean embedding
+    double mean_x = 0.0, mean_y = 0.0;
+    for (int n=0;n<_N;n++)
+      {
+	mean_x += Y[2*n];
+	mean_y += Y[2*n+1];
+      }
+    mean_x /= _N;
+    mean_y /= _N;
+    for (int n=0;n<_N;n++)
+      {
+	Y[2*n] -= mean_x;
+	Y[2*n+1] -= mean_y;
+      }
+  }
+
+}
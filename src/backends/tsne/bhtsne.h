@@ -0,0 +1,143 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2019 Jolibrain
+ * Author: Emmanuel Benazera <beniz@droidnik.fr>
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BHTSNE_H
+#define BHTSNE_H
+
+#include <atomic>
+#include <vector>
+
+namespace dd
+{
+  /**
+   * \brief quadtree over a 2D embedding, for Barnes-Hut approximation of repulsive forces
+   */
+  class QuadTree
+  {
+  public:
+    QuadTree() {}
+    ~QuadTree() {}
+
+    /**
+     * \brief builds the tree
+     * @param Y N x 2 embedding
+     * @param N number of points
+     */
+    void build(const double *Y, const int &N);
+
+    /**
+     * \brief accumulates the repulsive forces on a point
+     * @param Y embedding
+     * @param i point index
+     * @param theta Barnes-Hut angle
+     * @param neg_f unnormalized repulsive force
+     * @param sum_Q accumulated normalization term
+     */
+    void non_edge_forces(const double *Y, const int &i, const double &theta,
+			 double neg_f[2], double &sum_Q) const;
+
+  private:
+    int add_node(const double &cx, const double &cy, const double &hw, const double &hh);
+    void insert(const double *Y, const int &i);
+    void non_edge_forces(const int &node, const double *Y, const int &i, const double &theta2,
+			 double neg_f[2], double &sum_Q) const;
+
+    class Node
+    {
+    public:
+      double _cx = 0.0; /**< cell center. */
+      double _cy = 0.0;
+      double _hw = 0.0; /**< cell half-width. */
+      double _hh = 0.0; /**< cell half-height. */
+      double _com_x = 0.0; /**< center of mass. */
+      double _com_y = 0.0;
+      int _size = 0; /**< number of points in the cell, duplicates included. */
+      int _point = -1; /**< point held by a leaf, if any. */
+      int _children = -1; /**< index of the first of four children, -1 for a leaf. */
+    };
+
+    std::vector<Node> _nodes; /**< cells, root first. */
+  };
+
+  /**
+   * \brief Barnes-Hut t-SNE to two dimensions. Input similarities are computed over
+   *        nearest neighbours, gradient steps are parallelized over points, with attractive
+   *        forces from the sparse similarity rows and repulsive forces from a quadtree.
+   */
+  class BHTSNE
+  {
+  public:
+    BHTSNE(const int &N, const int &D, const double &perplexity, const double &theta,
+	   const int &num_threads, const int &seed=-1)
+      :_N(N),_D(D),_perplexity(perplexity),_theta(theta),_num_threads(num_threads),_seed(seed) {}
+    ~BHTSNE() {}
+
+    /**
+     * \brief computes input similarities and initializes the embedding
+     * @param X N x D row-major input data, normalized in place
+     * @param Y N x 2 embedding
+     * @param running polled for cancellation
+     * @return false if cancelled
+     */
+    bool step1(double *X, double *Y, const std::atomic<bool> &running);
+
+    /**
+     * \brief runs one gradient descent iteration
+     * @param Y N x 2 embedding
+     * @param iter iteration number
+     * @param loss KL divergence, updated every test_iter iterations
+     * @param test_iter loss evaluation period
+     */
+    void step2_one_iter(double *Y, const int &iter, double &loss, const int &test_iter);
+
+    int _stop_lying_iter = 250; /**< end of early exaggeration. */
+    int _mom_switch_iter = 250; /**< switch from initial to final momentum. */
+    double _exaggeration = 12.0;
+    double _momentum = 0.5;
+    double _final_momentum = 0.8;
+    double _eta = 200.0; /**< learning rate. */
+
+  private:
+    void knn(const double *X, const int &K, std::vector<int> &ids,
+	     std::vector<double> &dists, const std::atomic<bool> &running) const;
+    void symmetrize(const int &K, const std::vector<int> &ids, const std::vector<double> &vals);
+    void gradient(const double *Y, double *loss);
+
+    int _N;
+    int _D;
+    double _perplexity;
+    double _theta;
+    int _num_threads;
+    int _seed;
+    double _cur_exaggeration = 1.0; /**< current scaling of similarities. */
+    std::vector<int> _row_P; /**< symmetrized similarities, CSR row offsets. */
+    std::vector<int> _col_P;
+    std::vector<double> _val_P;
+    std::vector<double> _uY; /**< gradient momentum. */
+    std::vector<double> _gains;
+    std::vector<double> _dY; /**< gradient. */
+    std::vector<double> _neg_f; /**< unnormalized repulsive forces. */
+    QuadTree _tree;
+  };
+
+}
+
+#endif
@@ -64,15 +64,14 @@ namespace dd
     while(hit!=_txt.end())
       {
 	TxtBowEntry *tbe = static_cast<TxtBowEntry*>((*hit));
-	std::unordered_map<std::string,Word>::const_iterator wit;
 	tbe->reset();
 	while(tbe->has_elt())
 	  {
-	    std::string key;
+	    int key;
 	    double val;
 	    tbe->get_next_elt(key,val);
-	    if ((wit = _vocab.find(key))!=_vocab.end())
-	      _X(i,_vocab[key]._pos) = val;
+	    if (key < _D)
+	      _X(i,key) = val;
 	  }
 	++i;
 	++hit;
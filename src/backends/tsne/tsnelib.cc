@@ -24,6 +24,7 @@
 #include "outputconnectorstrategy.h"
 #include <thread>
 #include "utils/utils.hpp"
+#include "ext/base64/base64.h"
 
 namespace dd
 {
@@ -91,41 +92,65 @@ namespace dd
       _iterations = ad_mllib.get("iterations").get<int>();
     if (ad_mllib.has("perplexity"))
       _perplexity = ad_mllib.get("perplexity").get<int>();
+    if (ad_mllib.has("snapshot_interval"))
+      _snapshot_interval = ad_mllib.get("snapshot_interval").get<int>();
+    if (inputc._N - 1 < 3 * _perplexity)
+      throw MLLibBadParamException("perplexity " + std::to_string(_perplexity) + " is too large for " + std::to_string(inputc._N) + " points");
+    {
+      std::lock_guard<std::mutex> slock(_snapshot_mutex);
+      _snapshot.clear();
+      _snapshot_iter = -1;
+    }
     
     // t-sne
     int N = -1;
     int D = -1;
     double *Y = nullptr;
+    this->_tjob_running = true;
     try
       {
 	N = inputc._N;
 	D = inputc._D;
-	std::cerr << "N=" << N << " / D=" << D << std::endl;
+	this->_logger->info("N={} / D={}",N,D);
 	int num_threads = hardware_concurrency();
 	this->_logger->info("Detected {} cores", num_threads);
 	Y = new double[N*_no_dims]; // results
 	for (int i=0;i<N*_no_dims;i++)
 	  Y[i] = 0.0;
 
-	TSNE tsne = TSNE(N,D,_perplexity,_theta);
-	tsne.step1(inputc._X.data(),Y,num_threads);
+	BHTSNE tsne(N,D,_perplexity,_theta,num_threads);
+	tsne.step1(inputc._X.data(),Y,this->_tjob_running);
 	int test_iter = 50;
-	//time_t start = time(0);
 	double loss = 0.0;
-	for (int iter = 0; iter < _iterations; iter++) {
+	for (int iter = 0; iter < _iterations && this->_tjob_running.load(); iter++) {
 	  tsne.step2_one_iter(Y,iter,loss,test_iter);
 	  this->add_meas("train_loss",loss);
 	  this->add_meas_per_iter("train_loss",loss);
 	  this->add_meas("iteration", iter);
+	  if (_snapshot_interval > 0 && ((iter+1) % _snapshot_interval == 0 || iter+1 == _iterations))
+	    {
+	      std::vector<float> snapshot(Y,Y+N*_no_dims);
+	      std::lock_guard<std::mutex> slock(_snapshot_mutex);
+	      _snapshot.swap(snapshot);
+	      _snapshot_iter = iter+1;
+	    }
 	}
-	
       }
     catch(std::exception &e)
       {
+	delete[] Y;
 	this->_logger->error(e.what());
 	throw; //TODO: MLLib exception
       }
 
+    // bail on forced stop
+    if (!this->_tjob_running.load())
+      {
+	this->_logger->info("t-SNE stopped");
+	delete[] Y;
+	return 0;
+      }
+
     // capture of results
     TOutputConnectorStrategy tout;
     std::vector<APIData> vrad;
@@ -149,6 +174,27 @@ namespace dd
     return 0;
   }
 
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+  void TSNELib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::collect_intermediate_results(const APIData &ad_out,
+														APIData &out) const
+  {
+    if (!ad_out.has("embedding") || !ad_out.get("embedding").get<bool>())
+      return;
+    std::lock_guard<std::mutex> slock(_snapshot_mutex);
+    if (_snapshot.empty())
+      return;
+    // packed little-endian float32 values, row-major, base64 encoded
+    std::string packed(reinterpret_cast<const char*>(_snapshot.data()),_snapshot.size()*sizeof(float));
+    std::string b64;
+    Base64::Encode(packed,&b64);
+    APIData emb;
+    emb.add("iteration",_snapshot_iter);
+    emb.add("points",static_cast<int>(_snapshot.size())/_no_dims);
+    emb.add("dims",_no_dims);
+    emb.add("data",b64);
+    out.add("embedding",emb);
+  }
+
   template class TSNELib<CSVTSNEInputFileConn,UnsupervisedOutput,TSNEModel>;
   template class TSNELib<TxtTSNEInputFileConn,UnsupervisedOutput,TSNEModel>;
 }
@@ -24,12 +24,12 @@
 
 #include "mllibstrategy.h"
 #include "tsnemodel.h"
-#include "tsne.h"
+#include "bhtsne.h"
 
 namespace dd
 {
   /**
-   * Multicore TSNE wrapper
+   * Barnes-Hut TSNE wrapper
    */
     template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel=TSNEModel>
     class TSNELib : public MLLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>
@@ -46,6 +46,13 @@ namespace dd
 
     int train(const APIData &ad, APIData &out);
 
+    /**
+     * \brief collects the latest embedding captured while training, if requested
+     * @param ad_out data object for "parameters/output" of the status call
+     * @param out status data object
+     */
+    void collect_intermediate_results(const APIData &ad_out, APIData &out) const;
+
     // N/A
     int predict(const APIData &ad, APIData &out)
     {
@@ -59,7 +66,12 @@ namespace dd
     int _perplexity = 30;
     const int _no_dims = 2; /**< target dimensionality, backend lib only supports 2D */
     double _theta = 0.5; /**< angle */
+    int _snapshot_interval = 0; /**< iterations between captures of the embedding, 0 for none. */
     std::mutex _tsne_mutex;
+
+    mutable std::mutex _snapshot_mutex; /**< mutex around the captured embedding. */
+    std::vector<float> _snapshot; /**< latest captured embedding, as N x 2 floats. */
+    int _snapshot_iter = -1; /**< iteration of the captured embedding. */
     };
 
 }
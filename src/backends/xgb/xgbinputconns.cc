@@ -24,6 +24,7 @@
 #include <dmlc/registry.h>
 #include "data/simple_csr_source.h"
 #include "common/math.h"
+#include <cstdlib>
 
 namespace dd
 {
@@ -129,8 +130,143 @@ namespace dd
     return out;
   }
   
+  long int CSVXGBInputFileConn::write_stream_libsvm(const std::string &fname,
+						   const std::string &libsvm_fname,
+						   const int &part)
+  {
+    StreamReader<CSVline> reader;
+    reader._test_split = _csv_test_fname.empty() ? _test_split : -1.0;
+    reader._prefetch = _stream_prefetch;
+    reader.start(fname,1,stream_parse_func(),part,false);
+    std::ofstream out(libsvm_fname,std::ios::binary);
+    if (!out.is_open())
+      throw InputConnectorInternalException("failed opening file " + libsvm_fname);
+    bool nan_missing = xgboost::common::CheckNAN(_missing);
+    std::vector<CSVline> lines;
+    std::string row;
+    char buf[64];
+    long int n = 0;
+    while(reader.next(lines,1024) > 0)
+      {
+	for (const CSVline &l: lines)
+	  {
+	    double label = 0.0;
+	    row.clear();
+	    for (int i=0;i<(int)l._v.size();i++)
+	      {
+		double v = l._v.at(i);
+		if (xgboost::common::CheckNAN(v) && !nan_missing)
+		  throw InputConnectorBadParamException("NaN value in input data matrix, and missing != NaN");
+		if (!_label_pos.empty() && i == _label_pos[0])
+		  label = v + _label_offset[0];
+		else if (i == _id_pos || std::find(_label_pos.begin(),_label_pos.end(),i)!=_label_pos.end())
+		  continue;
+		else if (!xgboost::common::CheckNAN(v) && (nan_missing || v != _missing))
+		  {
+		    snprintf(buf,sizeof(buf)," %d:%.9g",i,v);
+		    row += buf;
+		  }
+	      }
+	    snprintf(buf,sizeof(buf),"%.9g",label);
+	    out << buf << row << '\n';
+	    ++n;
+	  }
+	lines.clear();
+      }
+    return n;
+  }
+
+  void CSVXGBInputFileConn::transform_dense(const APIData &ad_input)
+  {
+    fillup_parameters(ad_input);
+    if (_scale)
+      throw InputConnectorBadParamException("dense rows are not scaled, scale features beforehand and set scale to false");
+    _dense_data.clear();
+    _dense_rows = _dense_cols = 0;
+    _ids.clear();
+    auto add_row = [this](const int &ncols)
+      {
+	if (_dense_rows == 0)
+	  _dense_cols = ncols;
+	else if (ncols != _dense_cols)
+	  throw InputConnectorBadParamException("dense rows have " + std::to_string(ncols) + " and " + std::to_string(_dense_cols) + " values");
+	++_dense_rows;
+      };
+    if (_bdata)
+      {
+	for (const BinaryEl &bel: *_bdata)
+	  {
+	    if (!bel.is_tensor())
+	      throw InputConnectorBadParamException("dense data requires float tensors, got encoded content for " + bel._id);
+	    int rows = bel._shape.at(0);
+	    int cols = bel._shape.at(1) * bel._shape.at(2);
+	    size_t pos = _dense_data.size();
+	    _dense_data.resize(pos + static_cast<size_t>(rows) * cols);
+	    std::memcpy(_dense_data.data() + pos,bel.data(),static_cast<size_t>(rows) * cols * sizeof(float));
+	    for (int r=0;r<rows;r++)
+	      {
+		add_row(cols);
+		_ids.push_back(rows == 1 ? bel._id : bel._id + "_" + std::to_string(r));
+	      }
+	  }
+      }
+    else
+      {
+	const char delim = _delim.empty() ? ',' : _delim[0];
+	for (size_t u=0;u<_uris.size();u++)
+	  {
+	    const char *p = _uris.at(u).c_str();
+	    int ncols = 0;
+	    while (true)
+	      {
+		char *end = nullptr;
+		float v = std::strtof(p,&end);
+		while (*end == ' ')
+		  ++end;
+		if (end == p || (*end != delim && *end != '\0'))
+		  {
+		    while (*p == ' ')
+		      ++p;
+		    if (*p != delim && *p != '\0')
+		      throw InputConnectorBadParamException("non numerical value in dense row " + std::to_string(u));
+		    v = _missing; // empty value
+		    end = const_cast<char*>(p);
+		  }
+		_dense_data.push_back(v);
+		++ncols;
+		if (*end == '\0')
+		  break;
+		p = end + 1;
+	      }
+	    add_row(ncols);
+	    _ids.push_back(std::to_string(u));
+	  }
+      }
+    if (_dense_rows == 0)
+      throw InputConnectorBadParamException("no data could be found");
+    // same as the CSV matrix
+    if (!xgboost::common::CheckNAN(_missing))
+      for (const float &v: _dense_data)
+	if (xgboost::common::CheckNAN(v))
+	  throw InputConnectorBadParamException("NaN value in input data matrix, and missing != NaN");
+  }
+
   void CSVXGBInputFileConn::transform(const APIData &ad)
   {
+    // dense rows, predicted from directly
+    if (!_train)
+      {
+	get_data(ad);
+	APIData ad_input = ad.getobj("parameters").getobj("input");
+	if (_bdata || (ad_input.has("dense") && ad_input.get("dense").get<bool>()))
+	  {
+	    transform_dense(ad_input);
+	    return;
+	  }
+      }
+    else if (ad.binary_data())
+      throw InputConnectorBadParamException("binary data is not supported for training");
+
     try
       {
 	CSVInputFileConn::transform(ad);
@@ -152,7 +288,25 @@ namespace dd
 	  }
       }
       
-    if (!_direct_csv)
+    if (_stream)
+      {
+	// streamed data are written in libSVM format then loaded as external memory
+	// matrices, paged from disk by XGBoost
+	bool test_file = !_csv_test_fname.empty();
+	std::string train_fname = _model_repo + "/train.libsvm";
+	long int n = write_stream_libsvm(_csv_fname,train_fname,test_file ? -1 : 0);
+	_logger->info("streamed {} training lines to {}",n,train_fname);
+	_m = std::shared_ptr<xgboost::DMatrix>(xgboost::DMatrix::Load(train_fname + "#" + _model_repo + "/train.cache",false,true));
+	if (test_file || _test_split > 0.0)
+	  {
+	    std::string test_fname = _model_repo + "/test.libsvm";
+	    n = write_stream_libsvm(test_file ? _csv_test_fname : _csv_fname,test_fname,test_file ? -1 : 1);
+	    _logger->info("streamed {} testing lines to {}",n,test_fname);
+	    if (n > 0)
+	      _mtest = std::shared_ptr<xgboost::DMatrix>(xgboost::DMatrix::Load(test_fname + "#" + _model_repo + "/test.cache",false,true));
+	  }
+      }
+    else if (!_direct_csv)
       {
 	_m = std::shared_ptr<xgboost::DMatrix>(create_from_mat(_csvdata));
 	_csvdata.clear();
@@ -172,6 +326,39 @@ namespace dd
       }
   }
 
+  void SVMXGBInputFileConn::split_stream(const std::string &fname,
+					 const std::string &train_fname,
+					 const std::string &test_fname)
+  {
+    std::ifstream in(fname,std::ios::binary);
+    if (!in.is_open())
+      throw InputConnectorBadParamException("cannot open file " + fname);
+    std::ofstream train_out(train_fname,std::ios::binary);
+    std::ofstream test_out(test_fname,std::ios::binary);
+    if (!train_out.is_open() || !test_out.is_open())
+      throw InputConnectorInternalException("failed opening file " + train_fname + " or " + test_fname);
+    std::string line;
+    long int lnum = 0, ntrain = 0, ntest = 0;
+    while(std::getline(in,line))
+      {
+	long int l = lnum++;
+	line.erase(std::remove(line.begin(),line.end(),'\r'),line.end());
+	if (line.empty())
+	  continue;
+	if (StreamReader<std::string>::is_test(l,_test_split))
+	  {
+	    test_out << line << '\n';
+	    ++ntest;
+	  }
+	else
+	  {
+	    train_out << line << '\n';
+	    ++ntrain;
+	  }
+      }
+    _logger->info("split {} into {} training lines and {} testing lines",fname,ntrain,ntest);
+  }
+
   void SVMXGBInputFileConn::transform(const APIData &ad)
   {
     //- get data
@@ -180,11 +367,29 @@ namespace dd
     //- load lsvm file(s)
     bool silent = false;
     int dsplit = 2;
-    if (_uris.size() == 1)
+    APIData ad_input = ad.getobj("parameters").getobj("input");
+    fillup_parameters(ad_input);
+    if (_stream)
       {
-	//- shuffle & split matrix as required (read parameters -> fillup_parameters or init ?)
-	APIData ad_input = ad.getobj("parameters").getobj("input");
-	fillup_parameters(ad_input);
+	// external memory matrices, paged from disk by XGBoost, with a deterministic
+	// split by line instead of a shuffle, since row order does not matter to boosting
+	_logger->info("streaming {}",_uris.at(0));
+	std::string train_uri = _uris.at(0);
+	std::string test_uri = _uris.size() > 1 ? _uris.at(1) : "";
+	if (test_uri.empty() && _test_split > 0.0)
+	  {
+	    train_uri = _model_repo + "/train.libsvm";
+	    test_uri = _model_repo + "/test.libsvm";
+	    split_stream(_uris.at(0),train_uri,test_uri);
+	  }
+	_m = std::shared_ptr<xgboost::DMatrix>(xgboost::DMatrix::Load(train_uri + "#" + _model_repo + "/train.cache",silent,dsplit));
+	if (!test_uri.empty())
+	  _mtest = std::shared_ptr<xgboost::DMatrix>(xgboost::DMatrix::Load(test_uri + "#" + _model_repo + "/test.cache",silent,dsplit));
+	_logger->info("successfully acquired data");
+      }
+    else if (_uris.size() == 1)
+      {
+	//- shuffle & split matrix as required
 	_logger->info("loading {}",_uris.at(0));
 	_m = std::shared_ptr<xgboost::DMatrix>(xgboost::DMatrix::Load(_uris.at(0),silent,dsplit));
 	size_t rsize = _m->Info().num_row_;
@@ -252,14 +457,8 @@ namespace dd
     if (ad.has("model_repo"))
       {
 	std::ofstream fmap(ad.get("model_repo").get<std::string>()+"/model.fmap",std::ios::binary);
-	int nc = 0;
-	auto vit = this->_vocab.begin();
-	while(vit!=this->_vocab.end())
-	  {
-	    fmap << nc << "\t" << (*vit).first << "\tq\n";
-	    ++vit;
-	    ++nc;
-	  }
+	for (size_t i=0;i<this->_vocab.size();i++)
+	  fmap << this->_vocab.word(i)._pos << "\t" << this->_vocab.key(i) << "\tq\n";
       }
     
     _m = std::shared_ptr<xgboost::DMatrix>(create_from_mat(_txt));
@@ -288,12 +487,12 @@ namespace dd
 	tbe->reset();
 	while(tbe->has_elt())
 	  {
-	    std::string key;
+	    int key;
 	    double v;
 	    tbe->get_next_elt(key,v);
 	    if (xgboost::common::CheckNAN(v) && !nan_missing)
 	      throw InputConnectorBadParamException("NaN value in input data matrix, and missing != NaN");
-	    mat.page_.data.HostVector().push_back(xgboost::Entry(_vocab[key]._pos,v));
+	    mat.page_.data.HostVector().push_back(xgboost::Entry(key,v));
 	    ++nelem;
 	  }
 	mat.page_.offset.HostVector().push_back(mat.page_.offset.HostVector().back()+nelem);
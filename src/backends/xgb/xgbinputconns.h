@@ -65,15 +65,21 @@ namespace dd
     // parameters
     float _missing;// = std::NAN; /**< represents missing values. */
     std::vector<std::string> _ids; /**< input ids. */
+
+    // dense rows, predicted from directly without building a matrix
+    std::vector<float> _dense_data; /**< dense feature rows, row-major. */
+    int _dense_rows = 0; /**< number of dense rows, 0 when predicting from _m. */
+    int _dense_cols = 0; /**< number of features per dense row. */
   };
   
   class CSVXGBInputFileConn : public CSVInputFileConn, public XGBInputInterface
   {
   public:
     CSVXGBInputFileConn()
-      :CSVInputFileConn() {}
+      :CSVInputFileConn() { _accepts_binary = true; }
     CSVXGBInputFileConn(const CSVXGBInputFileConn &i)
-      :CSVInputFileConn(i),XGBInputInterface(i),_direct_csv(i._direct_csv) {}
+      :CSVInputFileConn(i),XGBInputInterface(i),_direct_csv(i._direct_csv)
+      { _accepts_binary = true; }
     ~CSVXGBInputFileConn() {}
     
     void init(const APIData &ad)
@@ -87,6 +93,25 @@ namespace dd
 
     xgboost::DMatrix* create_from_mat(const std::vector<CSVline> &csvl);
 
+    /**
+     * \brief reads dense feature rows for prediction, from float tensors (one row per tensor
+     *        line, one feature per column) or from delimited rows of values without header nor id,
+     *        with feature i from column i, as for header-less CSV data
+     * @param ad_input input parameters
+     */
+    void transform_dense(const APIData &ad_input);
+
+    /**
+     * \brief writes streamed lines in libSVM format, to be loaded as an external memory DMatrix
+     * @param fname CSV file name
+     * @param libsvm_fname output file name
+     * @param part 0 for training lines, 1 for testing lines, -1 for all lines
+     * @return number of lines written
+     */
+    long int write_stream_libsvm(const std::string &fname,
+				 const std::string &libsvm_fname,
+				 const int &part);
+
   public:
     bool _direct_csv = false; /**< whether to use the xgboost built-in CSV reader. */
   };
@@ -108,6 +133,8 @@ namespace dd
 	_seed = ad_input.get("seed").get<int>();
       if (ad_input.has("test_split"))
 	_test_split = ad_input.get("test_split").get<double>();
+      if (ad_input.has("stream"))
+	_stream = ad_input.get("stream").get<bool>();
     }
     
     void init(const APIData &ad)
@@ -116,11 +143,22 @@ namespace dd
     }
     
     void transform(const APIData &ad);
+
+    /**
+     * \brief splits a libSVM file into training and testing files, line by line
+     * @param fname libSVM file name
+     * @param train_fname training lines output file name
+     * @param test_fname testing lines output file name
+     */
+    void split_stream(const std::string &fname,
+		      const std::string &train_fname,
+		      const std::string &test_fname);
     
   public:
     bool _shuffle = false;
     int _seed = -1;
     double _test_split = -1;
+    bool _stream = false; /**< whether to use external memory matrices instead of loading data in memory. */
   };
 
   class TxtXGBInputFileConn : public TxtInputFileConn, public XGBInputInterface
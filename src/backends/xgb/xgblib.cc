@@ -22,8 +22,11 @@
 #include "xgblib.h"
 #include "csvinputfileconn.h"
 #include "outputconnectorstrategy.h"
+#include "common/math.h"
+#include <dmlc/omp.h>
 #include <iomanip>
 #include <iostream>
+#include <thread>
 
 namespace dd
 {
@@ -52,8 +55,6 @@ namespace dd
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
   XGBLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::~XGBLib()
   {
-    if (_learner)
-      delete _learner;
   }
 
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
@@ -72,6 +73,10 @@ namespace dd
       }
     if (ad.has("ntargets"))
       _ntargets = ad.get("ntargets").get<int>();
+    if (ad.has("max_predict_contexts"))
+      _max_learners = ad.get("max_predict_contexts").get<int>();
+    if (ad.has("nthread"))
+      _nthread = ad.get("nthread").get<int>();
     if (_nclasses == 0)
       throw MLLibBadParamException("number of classes is unknown (nclasses == 0)");
     if (_regression && _ntargets == 0)
@@ -94,7 +99,7 @@ namespace dd
     // any check on model here
     this->_mlmodel.read_from_repository(this->_logger);
     
-    // mutex if train and predict calls need to be isolated
+    // mutex if train calls need to be isolated
     std::lock_guard<std::mutex> lock(_learner_mutex);
     
     TInputConnectorStrategy inputc(this->_inputc);
@@ -372,6 +377,7 @@ namespace dd
 	std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create(os.str().c_str(), "w"));
 	learner->Save(fo.get());
       }
+      clear_learners(); // predict from the new model
 
       // bail on forced stop, i.e. not testing the model further.
       if (!this->_tjob_running.load())
@@ -392,14 +398,79 @@ namespace dd
       return 0;
   }
 
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+  std::unique_ptr<xgboost::Learner> XGBLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::acquire_learner()
+  {
+    std::unique_lock<std::mutex> lock(_learners_mutex);
+    int max_learners = _max_learners > 0 ? _max_learners : std::max(1u,std::thread::hardware_concurrency());
+    _learners_cv.wait(lock,[this,max_learners]{ return !_learners.empty() || _nlearners < max_learners; });
+    if (!_learners.empty())
+      {
+	std::unique_ptr<xgboost::Learner> learner = std::move(_learners.back());
+	_learners.pop_back();
+	return learner;
+      }
+    ++_nlearners;
+    std::string model_in = this->_mlmodel._weights;
+    if (_nlearners == 1)
+      {
+	// we can't read the objective function string name from the xgboost in-memory model,
+	// so let's read it from file
+	_objective = this->_mlmodel.lookup_objective(model_in,this->_logger);
+	if (_objective == "")
+	  {
+	    --_nlearners;
+	    _learners_cv.notify_one();
+	    throw MLLibInternalException("failed to read the objective from XGBoost model file " + model_in);
+	  }
+      }
+    std::vector<std::pair<std::string,std::string>> cfg = _params.cfg;
+    lock.unlock();
+
+    // loading and configuration happen once per context
+    try
+      {
+	this->_logger->info("loading XGBoost model file={}",model_in);
+	std::unique_ptr<xgboost::Learner> learner(xgboost::Learner::Create({}));
+	std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(model_in.c_str(),"r"));
+	learner->Load(fi.get());
+	learner->Configure(cfg);
+	return learner;
+      }
+    catch (...)
+      {
+	lock.lock();
+	--_nlearners;
+	_learners_cv.notify_one();
+	throw;
+      }
+  }
+
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+  void XGBLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::release_learner(std::unique_ptr<xgboost::Learner> &learner)
+  {
+    if (!learner)
+      return;
+    std::lock_guard<std::mutex> lock(_learners_mutex);
+    _learners.push_back(std::move(learner));
+    _learners_cv.notify_one();
+  }
+
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+  void XGBLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::clear_learners()
+  {
+    // contexts in use are not expected, predict calls are locked out while training
+    std::lock_guard<std::mutex> lock(_learners_mutex);
+    _nlearners -= _learners.size();
+    _learners.clear();
+    _learners_cv.notify_all();
+  }
+
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
   int XGBLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::predict(const APIData &ad,
 										   APIData &out)
   {
-    // mutex since using in-memory learner
-    std::lock_guard<std::mutex> lock(_learner_mutex);
-    
-    // data
+    // data, prepared concurrently with other calls
     TInputConnectorStrategy inputc(this->_inputc);
     APIData cad = ad;
     try
@@ -410,31 +481,32 @@ namespace dd
       {
 	throw;
       }
-    
-    // load existing model as needed
-    if (!_learner)
-      {
-	_learner = xgboost::Learner::Create({});
-	std::string model_in = this->_mlmodel._weights;
-	this->_logger->info("loading XGBoost model file={}",model_in);
-	std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(model_in.c_str(),"r"));
-	_learner->Load(fi.get());
-	// we can't read the objective function string name from the xgboost in-memory model,
-	// so let's read it from file
-	_objective = this->_mlmodel.lookup_objective(model_in,this->_logger);
-	if (_objective == "")
-	  throw MLLibInternalException("failed to read the objective from XGBoost model file " + model_in);
-      }
 
+    // threads per call, set for the calling thread, from which xgboost runs its parallel loops
+    int nthread = _nthread;
+    APIData ad_mllib = ad.getobj("parameters").getobj("mllib");
+    if (ad_mllib.has("nthread"))
+      nthread = ad_mllib.get("nthread").get<int>();
+    omp_set_num_threads(nthread > 0 ? nthread : omp_get_num_procs());
+    
     // test
     APIData ad_out = ad.getobj("parameters").getobj("output");
+    if (ad_out.has("measure") && inputc._dense_rows > 0)
+      throw MLLibBadParamException("measure requires labeled data, not supported with dense rows");
+    std::unique_ptr<xgboost::Learner> learner = acquire_learner();
     if (ad_out.has("measure"))
       {
-	std::vector<std::shared_ptr<xgboost::DMatrix>> eval_datasets = { inputc._m };
 	APIData meas_out;
-	std::unique_ptr<xgboost::Learner> learner(_learner);
-	test(ad,learner,eval_datasets.at(0).get(),meas_out);
-	learner.release();
+	try
+	  {
+	    test(ad,learner,inputc._m.get(),meas_out);
+	  }
+	catch (...)
+	  {
+	    release_learner(learner);
+	    throw;
+	  }
+	release_learner(learner);
 	meas_out.erase("iteration");
 	out.add("measure",meas_out.getobj("measure"));
 	return 0;
@@ -442,17 +514,49 @@ namespace dd
     
     // predict
     xgboost::HostDeviceVector<float> preds;
-    _learner->Configure(_params.cfg);
-    _learner->Predict(inputc._m.get(),_params.pred_margin,&preds,_params.ntree_limit);
+    try
+      {
+	if (inputc._dense_rows > 0)
+	  predict_dense(learner,inputc,preds.HostVector());
+	else learner->Predict(inputc._m.get(),_params.pred_margin,&preds,_params.ntree_limit);
+      }
+    catch (...)
+      {
+	release_learner(learner);
+	throw;
+      }
+    release_learner(learner);
 
     // results
     //float loss = 0.0; // XXX: how to acquire loss ?
-    int batch_size = preds.Size();
+    const std::vector<float> &vpreds = preds.HostVector();
+    int batch_size = vpreds.size();
     int nclasses = _nclasses;
     if (_objective == "multi:softprob")
       batch_size /= nclasses;
     else if (_objective == "binary:logistic")
       nclasses--;
+
+    // compact results, values per row in class order, without class names
+    if (ad_out.has("compact") && ad_out.get("compact").get<bool>())
+      {
+	std::vector<APIData> vrad(batch_size);
+	int nout = batch_size > 0 ? vpreds.size() / batch_size : 0;
+	for (int j=0;j<batch_size;j++)
+	  {
+	    std::vector<double> vals;
+	    vals.reserve(nout+1);
+	    if (_objective == "binary:logistic")
+	      vals.push_back(1.0-vpreds[j]);
+	    vals.insert(vals.end(),vpreds.begin()+j*nout,vpreds.begin()+(j+1)*nout);
+	    vrad[j].add("uri",inputc._ids.at(j));
+	    vrad[j].add("vals",vals);
+	  }
+	out.add("predictions",vrad);
+	out.add("status",0);
+	return 0;
+      }
+
     TOutputConnectorStrategy tout;
     std::vector<APIData> vrad;
     for (int j=0;j<batch_size;j++)
@@ -464,7 +568,7 @@ namespace dd
 	std::vector<std::string> cats;
 	for (int i=0;i<nclasses;i++)
 	  {
-	    probs.push_back(preds.HostVector().at(j*nclasses+i));
+	    probs.push_back(vpreds.at(j*nclasses+i));
 	    cats.push_back(this->_mlmodel.get_hcorresp(i));
 	  }
 	if (_objective == "binary:logistic")
@@ -489,6 +593,41 @@ namespace dd
     return 0;
   }
   
+  template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
+  void XGBLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::predict_dense(const std::unique_ptr<xgboost::Learner> &learner,
+											  const TInputConnectorStrategy &inputc,
+											  std::vector<float> &preds)
+  {
+    bool nan_missing = xgboost::common::CheckNAN(inputc._missing);
+    std::vector<xgboost::Entry> row;
+    row.reserve(inputc._dense_cols);
+    xgboost::HostDeviceVector<float> rpreds;
+    const float *data = inputc._dense_data.data();
+    size_t nout = 0;
+    for (int r=0;r<inputc._dense_rows;r++)
+      {
+	// same entries as from a header-less CSV row, feature i from column i
+	row.clear();
+	for (int i=0;i<inputc._dense_cols;i++)
+	  {
+	    float v = data[static_cast<size_t>(r)*inputc._dense_cols+i];
+	    if (xgboost::common::CheckNAN(v))
+	      continue;
+	    if (nan_missing || v != inputc._missing)
+	      row.push_back(xgboost::Entry(i,v));
+	  }
+	learner->Predict(xgboost::SparsePage::Inst(row.data(),row.size()),
+			 _params.pred_margin,&rpreds,_params.ntree_limit);
+	const std::vector<float> &rp = rpreds.HostVector();
+	if (r == 0)
+	  {
+	    nout = rp.size();
+	    preds.resize(nout*inputc._dense_rows);
+	  }
+	std::copy(rp.begin(),rp.end(),preds.begin()+r*nout);
+      }
+  }
+
   template <class TInputConnectorStrategy, class TOutputConnectorStrategy, class TMLModel>
   void XGBLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>::test(const APIData &ad,
 									       std::unique_ptr<xgboost::Learner> &learner,
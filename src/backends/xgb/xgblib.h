@@ -26,6 +26,7 @@
 #include "xgbmodel.h"
 #include <dmlc/build_config.h>
 #include <xgboost/learner.h>
+#include <condition_variable>
 
 namespace xgboost
 {
@@ -95,6 +96,33 @@ namespace dd
     int predict(const APIData &ad, APIData &out);
 
     /*- local functions -*/
+
+    /**
+     * \brief gets an idle prediction context, loading and configuring a new one from the
+     *        model file as needed, or waits for one when the max number of contexts is reached
+     */
+    std::unique_ptr<xgboost::Learner> acquire_learner();
+
+    /**
+     * \brief returns a prediction context to the pool
+     */
+    void release_learner(std::unique_ptr<xgboost::Learner> &learner);
+
+    /**
+     * \brief drops all prediction contexts, e.g. after the model has changed
+     */
+    void clear_learners();
+
+    /**
+     * \brief predicts dense rows one by one, straight from the connector float buffer
+     * @param learner prediction context
+     * @param inputc input connector holding dense rows
+     * @param preds output predictions, row-major, sized once from the first row
+     */
+    void predict_dense(const std::unique_ptr<xgboost::Learner> &learner,
+		       const TInputConnectorStrategy &inputc,
+		       std::vector<float> &preds);
+
     void test(const APIData &ad,
 	      std::unique_ptr<xgboost::Learner> &learner,
 	      xgboost::DMatrix *dtest,
@@ -117,8 +145,15 @@ namespace dd
 
     bool _gpu = false; /**< whether to use GPU. */
     xgboost::CLIParam _params;
-    xgboost::Learner *_learner = nullptr; /**< learner for prediction. */
-    std::mutex _learner_mutex; /**< mutex around the learner, e.g.. no concurrent predict calls as learner is not re-instantiated. Use batches instead. */
+    std::mutex _learner_mutex; /**< mutex around training. */
+
+    // prediction contexts, since a learner does not support concurrent predict calls
+    std::vector<std::unique_ptr<xgboost::Learner>> _learners; /**< idle prediction contexts. */
+    int _nlearners = 0; /**< number of prediction contexts, idle or in use. */
+    int _max_learners = 0; /**< max number of prediction contexts, 0 for the number of cores. */
+    int _nthread = 0; /**< default number of threads per predict call, 0 for all cores. */
+    std::mutex _learners_mutex; /**< mutex around prediction contexts. */
+    std::condition_variable _learners_cv;
     };
 
 }
@@ -0,0 +1,260 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2019 Jolibrain
+ * Author: Emmanuel Benazera <beniz@droidnik.fr>
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BINARYDATA_H
+#define BINARYDATA_H
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dd
+{
+  /**
+   * \brief binary input element, i.e. a raw encoded image or a float tensor,
+   *        held as a view over the request body, so that the payload is never copied
+   *        nor base64 encoded before reaching the input connector.
+   *
+   *        Tensors are laid out as three uint32 (height, width, channels)
+   *        followed by height*width*channels float32 values in HWC order, all little-endian.
+   */
+  class BinaryEl
+  {
+  public:
+    BinaryEl() {}
+    BinaryEl(const std::string &id,
+	     const std::shared_ptr<const std::string> &buf,
+	     const size_t &offset, const size_t &size)
+      :_id(id),_buf(buf),_offset(offset),_size(size) {}
+    ~BinaryEl() {}
+
+    /**
+     * \brief pointer to the element's content
+     */
+    const char* data() const
+    {
+      return _buf->data() + _offset;
+    }
+
+    /**
+     * \brief whether the element is a float tensor
+     */
+    bool is_tensor() const
+    {
+      return !_shape.empty();
+    }
+
+    std::string _id; /**< element id, returned as uri along with predictions. */
+    std::shared_ptr<const std::string> _buf; /**< request body holding the element. */
+    size_t _offset = 0; /**< element start in the body, after tensor header if any. */
+    size_t _size = 0; /**< element size in bytes. */
+    std::vector<int> _shape; /**< tensor shape as height, width, channels, empty for encoded content. */
+  };
+
+  typedef std::vector<BinaryEl> BinaryData;
+
+  /**
+   * \brief parsing of binary request bodies
+   */
+  class binarydata
+  {
+  public:
+    static const char* octet_stream() { return "application/octet-stream"; } /**< single raw encoded element. */
+    static const char* tensor() { return "application/x-dd-tensor"; } /**< one or more concatenated float tensors. */
+    static const char* multipart() { return "multipart/form-data"; } /**< multipart form, one element per part. */
+    static const uint32_t max_channels = 512; /**< max tensor channels, as OpenCV's CV_CN_MAX. */
+
+    /**
+     * \brief whether the content type is a supported binary payload
+     * @param content_type HTTP Content-Type header value
+     */
+    static bool is_binary(const std::string &content_type)
+    {
+      return content_type.find(octet_stream()) != std::string::npos
+	|| content_type.find(tensor()) != std::string::npos
+	|| content_type.find(multipart()) != std::string::npos;
+    }
+
+    /**
+     * \brief splits a binary body into data elements
+     * @param content_type HTTP Content-Type header value
+     * @param body request body
+     * @param bd output data elements
+     * @param jstr JSON call parameters from the multipart 'json' part, if any
+     * @return 0 if OK, 1 on malformed body
+     */
+    static int parse(const std::string &content_type,
+		     const std::shared_ptr<const std::string> &body,
+		     BinaryData &bd,
+		     std::string &jstr)
+    {
+      if (content_type.find(multipart()) != std::string::npos)
+	{
+	  std::string boundary = header_param(content_type,"boundary");
+	  if (boundary.empty())
+	    return 1;
+	  return parse_multipart(body,boundary,bd,jstr);
+	}
+      else if (content_type.find(tensor()) != std::string::npos)
+	return parse_tensors(body,0,body->size(),bd);
+      bd.push_back(BinaryEl("0",body,0,body->size()));
+      return 0;
+    }
+
+    /**
+     * \brief reads concatenated tensors from a body range
+     */
+    static int parse_tensors(const std::shared_ptr<const std::string> &body,
+			     size_t pos, const size_t &end,
+			     BinaryData &bd,
+			     const std::string &id="")
+    {
+      static const size_t header_size = 3 * sizeof(uint32_t);
+      int t = 0;
+      while (pos < end)
+	{
+	  if (end - pos < header_size)
+	    return 1;
+	  uint32_t shape[3];
+	  std::memcpy(shape,body->data()+pos,header_size);
+	  pos += header_size;
+	  // dims are client supplied, checked before any product that could wrap around
+	  if (shape[0] == 0 || shape[1] == 0 || shape[2] == 0
+	      || shape[0] > static_cast<uint32_t>(INT_MAX) || shape[1] > static_cast<uint32_t>(INT_MAX)
+	      || shape[2] > max_channels)
+	    return 1;
+	  size_t avail = (end - pos) / sizeof(float);
+	  if (shape[0] > avail || shape[1] > avail / shape[0]
+	      || shape[2] > avail / (static_cast<size_t>(shape[0]) * shape[1]))
+	    return 1;
+	  size_t tsize = static_cast<size_t>(shape[0]) * shape[1] * shape[2] * sizeof(float);
+	  std::string tid = id.empty() ? std::to_string(bd.size())
+	    : (t == 0 ? id : id + "_" + std::to_string(t));
+	  BinaryEl bel(tid,body,pos,tsize);
+	  bel._shape = {static_cast<int>(shape[0]),static_cast<int>(shape[1]),static_cast<int>(shape[2])};
+	  bd.push_back(bel);
+	  pos += tsize;
+	  ++t;
+	}
+      return 0;
+    }
+
+    /**
+     * \brief reads multipart/form-data parts, a part named 'json' holds the call parameters,
+     *        every other part is a data element, identified by its filename or name
+     */
+    static int parse_multipart(const std::shared_ptr<const std::string> &body,
+			       const std::string &boundary,
+			       BinaryData &bd,
+			       std::string &jstr)
+    {
+      const std::string &b = *body;
+      std::string delim = "--" + boundary;
+      size_t pos = b.find(delim);
+      if (pos == std::string::npos)
+	return 1;
+      while (true)
+	{
+	  pos += delim.size();
+	  if (b.compare(pos,2,"--") == 0)
+	    break; // closing delimiter
+	  pos = b.find("\r\n",pos);
+	  if (pos == std::string::npos)
+	    return 1;
+	  pos += 2;
+	  size_t hend = b.find("\r\n\r\n",pos);
+	  if (hend == std::string::npos)
+	    return 1;
+	  std::string headers = b.substr(pos,hend-pos);
+	  size_t cstart = hend + 4;
+	  size_t next = b.find("\r\n" + delim,cstart);
+	  if (next == std::string::npos)
+	    return 1;
+	  std::string name = header_param(headers,"name");
+	  std::string filename = header_param(headers,"filename");
+	  std::string ctype = header_value(headers,"content-type");
+	  if (name == "json" || ctype.find("application/json") != std::string::npos)
+	    jstr = b.substr(cstart,next-cstart);
+	  else
+	    {
+	      std::string id = !filename.empty() ? filename : (!name.empty() ? name : std::to_string(bd.size()));
+	      if (ctype.find(tensor()) != std::string::npos)
+		{
+		  if (parse_tensors(body,cstart,next,bd,id))
+		    return 1;
+		}
+	      else bd.push_back(BinaryEl(id,body,cstart,next-cstart));
+	    }
+	  pos = next + 2;
+	}
+      return 0;
+    }
+
+  private:
+    /**
+     * \brief value of a 'key=value' or 'key="value"' parameter in a header line
+     */
+    static std::string header_param(const std::string &header, const std::string &key)
+    {
+      size_t p = 0;
+      while ((p = header.find(key + "=",p)) != std::string::npos)
+	{
+	  if (p == 0 || header[p-1] == ' ' || header[p-1] == ';')
+	    break;
+	  p += key.size();
+	}
+      if (p == std::string::npos)
+	return "";
+      p += key.size() + 1;
+      if (p < header.size() && header[p] == '"')
+	{
+	  size_t e = header.find('"',p+1);
+	  return header.substr(p+1,e == std::string::npos ? std::string::npos : e-p-1);
+	}
+      size_t e = header.find_first_of(";\r\n",p);
+      return header.substr(p,e == std::string::npos ? std::string::npos : e-p);
+    }
+
+    /**
+     * \brief value of a header in a block of part headers, case insensitive on header name
+     */
+    static std::string header_value(const std::string &headers, const std::string &lname)
+    {
+      std::string lheaders = headers;
+      for (char &c: lheaders)
+	c = std::tolower(c);
+      size_t p = lheaders.find(lname + ":");
+      if (p == std::string::npos)
+	return "";
+      p += lname.size() + 1;
+      size_t e = headers.find("\r\n",p);
+      std::string v = headers.substr(p,e == std::string::npos ? std::string::npos : e-p);
+      size_t s = v.find_first_not_of(' ');
+      return s == std::string::npos ? "" : v.substr(s);
+    }
+  };
+
+}
+
+#endif
@@ -20,6 +20,11 @@
  */
 
 #include "csvinputfileconn.h"
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
 
 namespace dd
 {
@@ -288,93 +293,407 @@ namespace dd
     std::getline(csv_file,hline); // skip header line
   }
   
-  void CSVInputFileConn::read_csv(const std::string &fname, const bool forbid_shuffle)
+  // parses a decimal number, with exact results when mantissa and exponent allow it,
+  // falls back to strtod otherwise, with the same semantics as std::stod
+  static bool parse_double(const char *s, const char *e, double &v)
   {
-      std::ifstream csv_file(fname,std::ios::binary);
-      _logger->info("fname={} / open={}",fname,csv_file.is_open());
-      if (!csv_file.is_open())
-	throw InputConnectorBadParamException("cannot open file " + fname);
-      std::string hline;
-      std::getline(csv_file,hline);
-      read_header(hline);
-      
-      //debug
-      /*std::cerr << "found " << _detect_cols << " columns\n";
-      std::cerr << "label size=" << _label.size() << " / label_pos size=" << _label_pos.size() << std::endl;
-      std::cout << "CSV columns:\n";
-      std::copy(_columns.begin(),_columns.end(),
-		std::ostream_iterator<std::string>(std::cout," "));
-		std::cout << std::endl;*/
-      //debug
-
-      // categorical variables
-      if (_train && !_categoricals.empty())
-	{
-	  int l = 0;
-	  while(std::getline(csv_file,hline))
-	    {
-	      hline.erase(std::remove(hline.begin(),hline.end(),'\r'),hline.end());
-	      std::vector<double> vals;
-	      std::string cid;
-	      std::string col;
-	      auto hit = _columns.begin();
-	      std::unordered_set<int>::const_iterator igit;
-	      std::stringstream sh(hline);
-	      int cu = 0;
-	      while(std::getline(sh,col,_delim[0]))
-		{
-		  if (cu >= _detect_cols)
-		    {
-		      _logger->error("line {} has more columns than headers",l);
-		      _logger->error(hline);
-		      throw InputConnectorBadParamException("line has more columns than headers");
-		    }
-		  if ((igit=_ignored_columns_pos.find(cu))!=_ignored_columns_pos.end())
+    static const double pow10[] = {1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,
+				   1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+    const char *p = s;
+    bool neg = false;
+    if (p < e && (*p == '-' || *p == '+'))
+      neg = (*p++ == '-');
+    uint64_t mant = 0;
+    int ndigits = 0, exp10 = 0;
+    bool digits = false;
+    while (p < e && *p >= '0' && *p <= '9')
+      {
+	if (mant || *p != '0')
+	  ++ndigits;
+	mant = mant * 10 + (*p++ - '0');
+	digits = true;
+	if (ndigits > 15)
+	  break;
+      }
+    if (p < e && *p == '.' && ndigits <= 15)
+      {
+	++p;
+	while (p < e && *p >= '0' && *p <= '9')
+	  {
+	    if (mant || *p != '0')
+	      ++ndigits;
+	    mant = mant * 10 + (*p++ - '0');
+	    --exp10;
+	    digits = true;
+	    if (ndigits > 15)
+	      break;
+	  }
+      }
+    if (digits && ndigits <= 15 && p < e && (*p == 'e' || *p == 'E'))
+      {
+	const char *q = p + 1;
+	bool eneg = false;
+	if (q < e && (*q == '-' || *q == '+'))
+	  eneg = (*q++ == '-');
+	int ev = 0;
+	bool edigits = false;
+	while (q < e && *q >= '0' && *q <= '9' && ev < 10000)
+	  {
+	    ev = ev * 10 + (*q++ - '0');
+	    edigits = true;
+	  }
+	if (edigits)
+	  {
+	    exp10 += eneg ? -ev : ev;
+	    p = q;
+	  }
+      }
+    if (digits && ndigits <= 15 && p == e && exp10 >= -22 && exp10 <= 22)
+      {
+	// mantissa and power of ten are exact doubles, so is the correctly rounded result
+	v = exp10 >= 0 ? static_cast<double>(mant) * pow10[exp10] : static_cast<double>(mant) / pow10[-exp10];
+	if (neg)
+	  v = -v;
+	return true;
+      }
+
+    std::string str(s,e);
+    char *endp = nullptr;
+    errno = 0;
+    v = strtod(str.c_str(),&endp);
+    if (endp == str.c_str())
+      return false;
+    if (errno == ERANGE)
+      throw std::out_of_range("stod");
+    return true;
+  }
+
+  void CSVInputFileConn::read_csv_chunk(const char *begin, const char *end,
+					const std::vector<std::string> &columns,
+					const std::vector<int> &cat_cols,
+					const std::vector<CCategorical*> &cats,
+					const bool &learn_cats,
+					CSVChunk &chunk)
+  {
+    const char delim = _delim[0];
+    chunk._cats.resize(cats.size());
+    chunk._cats_ids.resize(cats.size());
+    std::string cline;
+    const char *lstart = begin;
+    while (lstart < end)
+      {
+	const char *lend = static_cast<const char*>(memchr(lstart,'\n',end-lstart));
+	const char *next = lend ? lend + 1 : end;
+	if (!lend)
+	  lend = end;
+	if (memchr(lstart,'\r',lend-lstart))
+	  {
+	    // remove ^M if any
+	    cline.assign(lstart,lend);
+	    cline.erase(std::remove(cline.begin(),cline.end(),'\r'),cline.end());
+	    lstart = cline.data();
+	    lend = lstart + cline.size();
+	  }
+
+	std::vector<double> vals;
+	vals.reserve(columns.size());
+	std::vector<std::pair<int,int>> catpos;
+	std::string column_id;
+	int c = -1;
+	size_t ci = 0;
+	const char *cstart = lstart;
+	while (cstart < lend)
+	  {
+	    const char *cend = static_cast<const char*>(memchr(cstart,delim,lend-cstart));
+	    if (!cend)
+	      cend = lend;
+	    ++c;
+	    if (!columns.empty())
+	      {
+		if (_ignored_columns_pos.find(c)!=_ignored_columns_pos.end())
+		  {
+		    cstart = cend + 1;
+		    continue;
+		  }
+		if (ci >= columns.size())
+		  {
+		    _logger->error("line {} has more columns than headers",std::string(lstart,lend));
+		    throw InputConnectorBadParamException("line has more columns than headers");
+		  }
+		if (_id_pos == c)
+		  column_id.assign(cstart,cend);
+	      }
+	    int k = columns.empty() ? -1 : cat_cols[ci];
+	    int cnum = -1;
+	    if (k >= 0 && learn_cats)
+	      {
+		// empty values are learnt as well, though they yield no value
+		std::string cval(cstart,cend);
+		auto hit = chunk._cats_ids[k].find(cval);
+		if (hit == chunk._cats_ids[k].end())
+		  {
+		    cnum = chunk._cats[k].size();
+		    chunk._cats_ids[k].insert(std::pair<std::string,int>(cval,cnum));
+		    chunk._cats[k].push_back(cval);
+		  }
+		else cnum = (*hit).second;
+	      }
+	    if (cend > cstart)
+	      {
+		if (k >= 0)
+		  {
+		    // categorical value, to be expanded into a one-hot vector
+		    std::string cval(cstart,cend);
+		    if (!learn_cats && (cnum = cats[k]->get_cat_num(cval)) < 0)
+		      throw InputConnectorBadParamException("unknown category " + cval + " for variable " + columns[ci]);
+		    catpos.push_back(std::pair<int,int>(vals.size(),k));
+		    vals.push_back(cnum);
+		  }
+		else
+		  {
+		    double val = 0.0;
+		    if (parse_double(cstart,cend,val))
+		      vals.push_back(val);
+		    else if (column_id.size() == static_cast<size_t>(cend-cstart)
+			     && column_id.compare(0,column_id.size(),cstart,cend-cstart) == 0) // if id is string, replace with number / TODO: better scheme
+		      vals.push_back(c);
+		    else
+		      {
+			std::string col_name = columns.empty() ? "" : columns[ci];
+			_logger->error("skipping column {} / not a number",col_name);
+			_logger->error(std::string(lstart,lend));
+			throw InputConnectorBadParamException("column " + col_name + " is not a number, use categoricals or ignore parameters instead");
+		      }
+		  }
+	      }
+	    ++ci;
+	    cstart = cend + 1;
+	  }
+	chunk._lines.emplace_back(column_id,std::move(vals));
+	if (!cats.empty())
+	  chunk._catpos.push_back(std::move(catpos));
+	lstart = next;
+      }
+  }
+
+  void CSVInputFileConn::chunk_columns(std::vector<std::string> &columns,
+				       std::vector<int> &cat_cols,
+				       std::vector<CCategorical*> &cats)
+  {
+    columns.assign(_columns.begin(),_columns.end());
+    cat_cols.assign(columns.size(),-1);
+    cats.clear();
+    for (size_t i=0;i<columns.size();i++)
+      {
+	auto chit = _categoricals.find(columns[i]);
+	if (chit != _categoricals.end())
+	  {
+	    cat_cols[i] = cats.size();
+	    cats.push_back(&(*chit).second);
+	  }
+      }
+  }
+
+  void CSVInputFileConn::read_csv_chunks(const char *begin, const char *end,
+					 const bool &learn_cats,
+					 std::vector<CSVChunk> &chunks)
+  {
+    std::vector<std::string> columns;
+    std::vector<int> cat_cols;
+    std::vector<CCategorical*> cats;
+    chunk_columns(columns,cat_cols,cats);
+
+    // split at line boundaries
+    size_t size = end - begin;
+    int nthreads = std::max(1u,std::thread::hardware_concurrency());
+    int nchunks = std::max(1,static_cast<int>(std::min<size_t>(size / (1 << 20),4*nthreads)));
+    std::vector<const char*> bounds(nchunks+1,end);
+    bounds[0] = begin;
+    for (int k=1;k<nchunks;k++)
+      {
+	const char *p = std::max(bounds[k-1],begin + (size * k) / nchunks);
+	const char *nl = p < end ? static_cast<const char*>(memchr(p,'\n',end-p)) : nullptr;
+	bounds[k] = nl ? nl + 1 : end;
+      }
+
+    chunks.clear();
+    chunks.resize(nchunks);
+    std::vector<std::exception_ptr> eptrs(nchunks);
+#pragma omp parallel for schedule(dynamic)
+    for (int k=0;k<nchunks;k++)
+      {
+	try
+	  {
+	    read_csv_chunk(bounds[k],bounds[k+1],columns,cat_cols,cats,learn_cats,chunks[k]);
+	  }
+	catch (...)
+	  {
+	    eptrs[k] = std::current_exception();
+	  }
+      }
+    for (auto &eptr: eptrs)
+      if (eptr)
+	std::rethrow_exception(eptr);
+    if (cats.empty())
+      return;
+
+    // merge dictionaries in chunk order, i.e. in order of first appearance in the file
+    if (learn_cats)
+      for (CSVChunk &chunk: chunks)
+	for (size_t k=0;k<cats.size();k++)
+	  for (const std::string &v: chunk._cats[k])
+	    cats[k]->add_cat(v);
+    std::vector<int> csizes;
+    for (CCategorical *cc: cats)
+      csizes.push_back(cc->_vals.size());
+
+    // expand categorical values into one-hot vectors
+#pragma omp parallel for schedule(dynamic)
+    for (int c=0;c<nchunks;c++)
+      expand_categoricals(cats,csizes,learn_cats,chunks[c]);
+  }
+
+  void CSVInputFileConn::expand_categoricals(const std::vector<CCategorical*> &cats,
+					     const std::vector<int> &csizes,
+					     const bool &learn_cats,
+					     CSVChunk &chunk)
+  {
+    std::vector<std::vector<int>> cnums(cats.size());
+    if (learn_cats)
+      for (size_t k=0;k<cats.size();k++)
+	for (const std::string &v: chunk._cats[k])
+	  cnums[k].push_back(cats[k]->get_cat_num(v));
+    for (size_t l=0;l<chunk._lines.size();l++)
+      {
+	const std::vector<std::pair<int,int>> &catpos = chunk._catpos[l];
+	if (catpos.empty())
+	  continue;
+	std::vector<double> &vals = chunk._lines[l]._v;
+	std::vector<double> nvals;
+	size_t from = 0;
+	for (const std::pair<int,int> &cp: catpos)
+	  {
+	    nvals.insert(nvals.end(),vals.begin()+from,vals.begin()+cp.first);
+	    int cnum = static_cast<int>(vals[cp.first]);
+	    if (learn_cats)
+	      cnum = cnums[cp.second][cnum];
+	    std::vector<double> ohv = one_hot_vector(cnum,csizes[cp.second]);
+	    nvals.insert(nvals.end(),ohv.begin(),ohv.end());
+	    from = cp.first + 1;
+	  }
+	nvals.insert(nvals.end(),vals.begin()+from,vals.end());
+	vals.swap(nvals);
+      }
+    chunk._catpos.clear();
+    chunk._cats.clear();
+    chunk._cats_ids.clear();
+  }
+
+  void CSVInputFileConn::find_min_max(const std::vector<CSVChunk> &chunks)
+  {
+    std::vector<std::vector<double>> cmin(chunks.size()), cmax(chunks.size());
+    std::vector<std::exception_ptr> eptrs(chunks.size());
+#pragma omp parallel for schedule(dynamic)
+    for (int c=0;c<static_cast<int>(chunks.size());c++)
+      {
+	try
+	  {
+	    for (const CSVline &line: chunks[c]._lines)
+	      {
+		const std::vector<double> &vals = line._v;
+		if (vals.empty())
+		  continue;
+		if (cmin[c].empty())
+		  cmin[c] = cmax[c] = vals;
+		else
+		  for (size_t j=0;j<vals.size();j++)
 		    {
-		      ++cu;
-		      continue;
+		      cmin[c].at(j) = std::min(vals[j],cmin[c].at(j));
+		      cmax[c].at(j) = std::max(vals[j],cmax[c].at(j));
 		    }
-		  update_category((*hit),col);
-		  ++hit;
-		  ++cu;
-		}
-	      ++l;
-	    }
-	  csv_file.clear();
-	  csv_file.seekg(0,std::ios::beg);
-	  std::getline(csv_file,hline); // skip header line
-	}
+	      }
+	  }
+	catch (...)
+	  {
+	    eptrs[c] = std::current_exception();
+	  }
+      }
+    for (auto &eptr: eptrs)
+      if (eptr)
+	std::rethrow_exception(eptr);
+    bool first = _min_vals.empty() || _max_vals.empty();
+    for (size_t c=0;c<chunks.size();c++)
+      {
+	if (cmin[c].empty())
+	  continue;
+	if (first)
+	  {
+	    _min_vals = cmin[c];
+	    _max_vals = cmax[c];
+	    first = false;
+	    continue;
+	  }
+	for (size_t j=0;j<cmin[c].size();j++)
+	  {
+	    _min_vals.at(j) = std::min(cmin[c][j],_min_vals.at(j));
+	    _max_vals.at(j) = std::max(cmax[c][j],_max_vals.at(j));
+	  }
+      }
+  }
 
-      // scaling to [0,1]
-      int nlines = 0;
-      if (_scale && (_min_vals.empty() || _max_vals.empty()))
-	{
-         find_min_max(csv_file);
-	}
-      
-      // read data
-      while(std::getline(csv_file,hline))
+  void CSVInputFileConn::add_csv_chunks(std::vector<CSVChunk> &chunks,
+					const bool &train,
+					int &nlines)
+  {
+    if (_scale)
+      {
+#pragma omp parallel for schedule(dynamic)
+	for (int c=0;c<static_cast<int>(chunks.size());c++)
+	  for (CSVline &line: chunks[c]._lines)
+	    scale_vals(line._v);
+      }
+    for (CSVChunk &chunk: chunks)
+      {
+	for (CSVline &line: chunk._lines)
+	  {
+	    ++nlines;
+	    std::string id = !_id.empty() ? line._str : std::to_string(nlines);
+	    if (train)
+	      add_train_csvline(id,line._v);
+	    else add_test_csvline(id,line._v);
+	  }
+	std::vector<CSVline>().swap(chunk._lines);
+      }
+  }
+
+  void CSVInputFileConn::read_csv(const std::string &fname, const bool forbid_shuffle)
+  {
+      if (_stream)
 	{
-	  hline.erase(std::remove(hline.begin(),hline.end(),'\r'),hline.end());
-	  std::vector<double> vals;
-	  std::string cid;
-	  read_csv_line(hline,_delim,vals,cid,nlines);
-	  if (_scale)
-	    {
-	      scale_vals(vals);
-	    }
-	  if (!_id.empty())
-	    {
-	      add_train_csvline(cid,vals);
-	    }
-	  else add_train_csvline(std::to_string(nlines),vals); 
-	  
-	  //debug
-	  /*std::cout << "csv data line #" << nlines << "= " << vals.size() << std::endl;
-	    std::copy(vals.begin(),vals.end(),std::ostream_iterator<double>(std::cout," "));
-	    std::cout << std::endl;*/
-	  //debug
+	  read_csv_stream(fname);
+	  return;
 	}
+
+      // the file is mapped into memory and parsed in parallel chunks, in a single pass
+      mmap_file csv_file;
+      bool open = csv_file.open(fname);
+      _logger->info("fname={} / open={}",fname,open);
+      if (!open)
+	throw InputConnectorBadParamException("cannot open file " + fname);
+      const char *begin = csv_file.data();
+      const char *end = begin + csv_file.size();
+      const char *eol = begin ? static_cast<const char*>(memchr(begin,'\n',end-begin)) : nullptr;
+      std::string hline(begin,eol ? eol : end);
+      read_header(hline);
+      begin = eol ? eol + 1 : end;
+
+      // categorical variables are learnt, and bounds for scaling to [0,1] are collected, from the training data
+      std::vector<CSVChunk> chunks;
+      read_csv_chunks(begin,end,_train && !_categoricals.empty(),chunks);
+      if (_scale && (_min_vals.empty() || _max_vals.empty()))
+	find_min_max(chunks);
+      int nlines = 0;
+      add_csv_chunks(chunks,true,nlines);
       _logger->info("read {} lines from {}",nlines,fname);
       csv_file.close();
       
@@ -382,34 +701,16 @@ namespace dd
       if (!_csv_test_fname.empty())
 	{
 	  nlines = 0;
-	  std::ifstream csv_test_file(_csv_test_fname,std::ios::binary);
-	  if (!csv_test_file.is_open())
+	  mmap_file csv_test_file;
+	  if (!csv_test_file.open(_csv_test_fname))
 	    throw InputConnectorBadParamException("cannot open test file " + fname);
-	  std::getline(csv_test_file,hline); // skip header line
-	  while(std::getline(csv_test_file,hline))
-	    {
-	      hline.erase(std::remove(hline.begin(),hline.end(),'\r'),hline.end());
-	      std::vector<double> vals;
-	      std::string cid;
-	      read_csv_line(hline,_delim,vals,cid,nlines);
-	      if (_scale)
-		{
-		  scale_vals(vals);
-		}
-	      if (!_id.empty())
-		add_test_csvline(cid,vals);
-	      //_csvdata_test.emplace_back(cid,vals);
-	      else add_test_csvline(std::to_string(nlines),vals);
-	      //_csvdata_test.emplace_back(std::to_string(nlines),vals);
-	      
-	      //debug
-	      /*std::cout << "csv test data line=";
-		std::copy(vals.begin(),vals.end(),std::ostream_iterator<double>(std::cout," "));
-		std::cout << std::endl;*/
-	      //debug
-	    }
+	  begin = csv_test_file.data();
+	  end = begin + csv_test_file.size();
+	  eol = begin ? static_cast<const char*>(memchr(begin,'\n',end-begin)) : nullptr;
+	  begin = eol ? eol + 1 : end; // skip header line
+	  read_csv_chunks(begin,end,false,chunks);
+	  add_csv_chunks(chunks,false,nlines);
 	  _logger->info("read {} lines from {}", nlines, _csv_test_fname);
-	  csv_test_file.close();
 	}
 
       // shuffle before possible test data selection.
@@ -425,4 +726,194 @@ namespace dd
 	update_columns();
   }
   
+  // reads a file from its current position by blocks of whole lines, for parsing in bounded memory
+  static void read_csv_blocks(std::ifstream &in,
+			      const std::function<void(const char*,const char*)> &func)
+  {
+    static const size_t block_size = 1 << 26;
+    std::string buf;
+    size_t from = 0;
+    while (in)
+      {
+	buf.resize(from + block_size);
+	in.read(&buf[from],block_size);
+	buf.resize(from + in.gcount());
+	const char *nl = buf.empty() ? nullptr : static_cast<const char*>(memrchr(buf.data(),'\n',buf.size()));
+	if (!nl)
+	  {
+	    from = buf.size();
+	    continue;
+	  }
+	size_t len = nl - buf.data() + 1;
+	func(buf.data(),buf.data()+len);
+	buf.erase(0,len);
+	from = buf.size();
+      }
+    if (!buf.empty())
+      func(buf.data(),buf.data()+buf.size());
+  }
+
+  void CSVInputFileConn::read_csv_stream(const std::string &fname)
+  {
+    std::ifstream csv_file(fname,std::ios::binary);
+    _logger->info("streaming fname={} / open={}",fname,csv_file.is_open());
+    if (!csv_file.is_open())
+      throw InputConnectorBadParamException("cannot open file " + fname);
+    std::string hline;
+    std::getline(csv_file,hline);
+    read_header(hline);
+    std::streampos data_pos = csv_file.tellg();
+
+    // lines count in each part, empty lines are numbered but not counted
+    bool learn_cats = !_categoricals.empty();
+    bool min_max = _scale && (_min_vals.empty() || _max_vals.empty());
+    bool split = _csv_test_fname.empty() && _test_split > 0.0;
+    _stream_train_size = _stream_test_size = 0;
+    long int lnum = 0;
+    std::vector<CSVChunk> chunks;
+    auto count_lines = [&]()
+      {
+	for (const CSVChunk &chunk: chunks)
+	  for (const CSVline &line: chunk._lines)
+	    {
+	      long int l = lnum++;
+	      if (line._v.empty())
+		continue;
+	      if (split && StreamReader<CSVline>::is_test(l,_test_split))
+		++_stream_test_size;
+	      else ++_stream_train_size;
+	    }
+      };
+
+    // categorical variables are learnt first, so that scaling bounds are collected
+    // over one-hot vectors of their final size
+    if (learn_cats)
+      {
+	read_csv_blocks(csv_file,[&](const char *begin, const char *end)
+			{
+			  read_csv_chunks(begin,end,true,chunks);
+			  if (!min_max)
+			    count_lines();
+			});
+	csv_file.clear();
+	csv_file.seekg(data_pos);
+      }
+    if (!learn_cats || min_max)
+      read_csv_blocks(csv_file,[&](const char *begin, const char *end)
+		      {
+			read_csv_chunks(begin,end,false,chunks);
+			count_lines();
+			if (min_max)
+			  find_min_max(chunks);
+		      });
+    csv_file.close();
+    if (!_csv_test_fname.empty())
+      {
+	std::ifstream csv_test_file(_csv_test_fname,std::ios::binary);
+	if (!csv_test_file.is_open())
+	  throw InputConnectorBadParamException("cannot open test file " + _csv_test_fname);
+	std::getline(csv_test_file,hline); // skip header line
+	while(std::getline(csv_test_file,hline))
+	  {
+	    hline.erase(std::remove(hline.begin(),hline.end(),'\r'),hline.end());
+	    if (!hline.empty())
+	      ++_stream_test_size;
+	  }
+      }
+    _logger->info("streaming {} training lines and {} testing lines",_stream_train_size,_stream_test_size);
+    if (_stream_train_size == 0)
+      throw InputConnectorBadParamException("no data could be found");
+
+    // streamed lines are parsed against the original columns
+    _stream_parser = std::make_shared<CSVInputFileConn>(*this);
+    _stream_train_reader.reset();
+    _stream_test_reader.reset();
+    if (!_ignored_columns.empty() || !_categoricals.empty())
+      update_columns();
+  }
+
+  StreamReader<CSVline>::parse_func CSVInputFileConn::stream_parse_func() const
+  {
+    std::shared_ptr<CSVInputFileConn> parser = _stream_parser;
+    std::vector<std::string> columns;
+    std::vector<int> cat_cols;
+    std::vector<CCategorical*> cats;
+    parser->chunk_columns(columns,cat_cols,cats);
+    std::vector<int> csizes;
+    for (CCategorical *cc: cats)
+      csizes.push_back(cc->_vals.size());
+    return [parser,columns,cat_cols,cats,csizes](std::string &line, const long int &lnum, std::vector<CSVline> &lines)
+      {
+	CSVChunk chunk;
+	parser->read_csv_chunk(line.data(),line.data()+line.size(),columns,cat_cols,cats,false,chunk);
+	if (chunk._lines.empty() || chunk._lines.front()._v.empty())
+	  return;
+	if (!cats.empty())
+	  parser->expand_categoricals(cats,csizes,false,chunk);
+	CSVline &cline = chunk._lines.front();
+	if (parser->_scale)
+	  parser->scale_vals(cline._v);
+	lines.emplace_back(!parser->_id.empty() ? cline._str : std::to_string(lnum+1),std::move(cline._v));
+      };
+  }
+
+  int CSVInputFileConn::stream_train(std::vector<CSVline> &lines, const int &n)
+  {
+    if (!_stream_parser)
+      throw InputConnectorInternalException("CSV streaming requires reading the training file first");
+    if (!_stream_train_reader)
+      {
+	_stream_train_reader = std::make_shared<StreamReader<CSVline>>();
+	_stream_train_reader->_test_split = _csv_test_fname.empty() ? _test_split : -1.0;
+	_stream_train_reader->_shuffle_window = _shuffle ? _shuffle_window : 0;
+	_stream_train_reader->_seed = _stream_seed;
+	_stream_train_reader->_prefetch = _stream_prefetch;
+	_stream_train_reader->start(_csv_fname,1,stream_parse_func(),0,true);
+      }
+    try
+      {
+	return _stream_train_reader->next(lines,n);
+      }
+    catch (InputConnectorBadParamException &e)
+      {
+	throw;
+      }
+    catch (std::exception &e)
+      {
+	throw InputConnectorBadParamException(std::string("error streaming CSV training data: ") + e.what());
+      }
+  }
+
+  void CSVInputFileConn::reset_stream_test()
+  {
+    if (!_stream_parser)
+      return;
+    bool test_file = !_csv_test_fname.empty();
+    if (!_stream_test_reader)
+      _stream_test_reader = std::make_shared<StreamReader<CSVline>>();
+    _stream_test_reader->_test_split = test_file ? -1.0 : _test_split;
+    _stream_test_reader->_prefetch = _stream_prefetch;
+    _stream_test_reader->start(test_file ? _csv_test_fname : _csv_fname,1,stream_parse_func(),test_file ? -1 : 1,false);
+  }
+
+  int CSVInputFileConn::stream_test(std::vector<CSVline> &lines, const int &n)
+  {
+    if (!_stream_test_reader)
+      reset_stream_test();
+    if (!_stream_test_reader || _stream_test_size == 0)
+      return 0;
+    try
+      {
+	return _stream_test_reader->next(lines,n);
+      }
+    catch (InputConnectorBadParamException &e)
+      {
+	throw;
+      }
+    catch (std::exception &e)
+      {
+	throw InputConnectorBadParamException(std::string("error streaming CSV testing data: ") + e.what());
+      }
+  }
+
 }
@@ -24,6 +24,7 @@
 
 #include "inputconnectorstrategy.h"
 #include "utils/fileops.hpp"
+#include "utils/streamreader.hpp"
 #include <fstream>
 #include <unordered_set>
 #include <algorithm>
@@ -93,6 +94,23 @@ namespace dd
     std::unordered_map<std::string,int> _vals; /**< categorical value mapping. */
   };
   
+  /**
+   * \brief CSV lines parsed from a chunk of a file. When categorical variables are
+   *        learnt from the data, their values are held as chunk ids until dictionaries
+   *        from all chunks are merged.
+   */
+  class CSVChunk
+  {
+  public:
+    CSVChunk() {}
+    ~CSVChunk() {}
+
+    std::vector<CSVline> _lines;
+    std::vector<std::vector<std::pair<int,int>>> _catpos; /**< per line, position and variable of categorical values. */
+    std::vector<std::vector<std::string>> _cats; /**< per categorical variable, values in order of first appearance. */
+    std::vector<std::unordered_map<std::string,int>> _cats_ids; /**< per categorical variable, value to chunk id. */
+  };
+
   class CSVInputFileConn : public InputConnectorStrategy
   {
   public:
@@ -114,6 +132,7 @@ namespace dd
           if (ad_input.has("seed") && ad_input.get("seed").get<int>() >= 0)
             {
               _g = std::mt19937(ad_input.get("seed").get<int>());
+              _stream_seed = ad_input.get("seed").get<int>();
             }
           else
             {
@@ -136,6 +155,14 @@ namespace dd
 
       if (ad_input.has("test_split"))
 	_test_split = ad_input.get("test_split").get<double>();
+
+      // streaming from file
+      if (ad_input.has("stream"))
+	_stream = ad_input.get("stream").get<bool>();
+      if (ad_input.has("shuffle_window"))
+	_shuffle_window = ad_input.get("shuffle_window").get<int>();
+      if (ad_input.has("stream_prefetch"))
+	_stream_prefetch = ad_input.get("stream_prefetch").get<int>();
       
       // read categorical mapping, if any
       read_categoricals(ad_input);
@@ -372,6 +399,7 @@ namespace dd
 	    }
 	  else // training from posted data (in-memory)
 	    {
+	      _stream = false;
 	      for (size_t i=uri_offset;i<_uris.size();i++)
 		{
 		  DataEl<DDCsv> ddcsv;
@@ -411,7 +439,7 @@ namespace dd
 	      ddcsv.read_element(_uris.at(i),this->_logger);
 	    }
 	}
-      if (_csvdata.empty() && _db_fname.empty())
+      if (_csvdata.empty() && _db_fname.empty() && !_stream)
 	throw InputConnectorBadParamException("no data could be found");
     }
 
@@ -425,6 +453,96 @@ namespace dd
     
     void read_csv(const std::string &fname, const bool forbid_shuffle = false);
 
+    /**
+     * \brief prepares streaming of training data from file: learns categorical
+     *        variables and scaling bounds, and counts lines in the training and testing
+     *        parts, without holding the data in memory
+     * @param fname training file name
+     */
+    void read_csv_stream(const std::string &fname);
+
+    /**
+     * \brief parser of streamed lines, with the header state prior to columns update
+     */
+    StreamReader<CSVline>::parse_func stream_parse_func() const;
+
+    /**
+     * \brief gets the next streamed training lines, the training data are looped over
+     * @param lines parsed lines are appended to this vector
+     * @param n number of lines
+     * @return number of lines appended
+     */
+    int stream_train(std::vector<CSVline> &lines, const int &n);
+
+    /**
+     * \brief restarts streaming of the testing data
+     */
+    void reset_stream_test();
+
+    /**
+     * \brief gets the next streamed testing lines
+     * @param lines parsed lines are appended to this vector
+     * @param n max number of lines
+     * @return number of lines appended, 0 when the testing data is exhausted
+     */
+    int stream_test(std::vector<CSVline> &lines, const int &n);
+
+    /**
+     * \brief parses CSV lines in parallel from a memory range, split into chunks at
+     *        line boundaries. Categorical variables are expanded into one-hot vectors.
+     * @param begin first character
+     * @param end past the last character
+     * @param learn_cats whether to learn categorical values, otherwise unknown values are an error
+     * @param chunks parsed lines, in order
+     */
+    void read_csv_chunks(const char *begin, const char *end,
+			 const bool &learn_cats,
+			 std::vector<CSVChunk> &chunks);
+
+    /**
+     * \brief parses the lines of a single chunk, see read_csv_line for the format
+     */
+    void read_csv_chunk(const char *begin, const char *end,
+			const std::vector<std::string> &columns,
+			const std::vector<int> &cat_cols,
+			const std::vector<CCategorical*> &cats,
+			const bool &learn_cats,
+			CSVChunk &chunk);
+
+    /**
+     * \brief columns of the header, and categorical variables by column, for parsing chunks
+     */
+    void chunk_columns(std::vector<std::string> &columns,
+		       std::vector<int> &cat_cols,
+		       std::vector<CCategorical*> &cats);
+
+    /**
+     * \brief expands the categorical values of parsed lines into one-hot vectors
+     * @param cats categorical variables
+     * @param csizes number of values of each variable
+     * @param learn_cats whether values are held as chunk ids, see CSVChunk
+     * @param chunk parsed lines
+     */
+    void expand_categoricals(const std::vector<CCategorical*> &cats,
+			     const std::vector<int> &csizes,
+			     const bool &learn_cats,
+			     CSVChunk &chunk);
+
+    /**
+     * \brief min and max values over parsed chunks, merged with the current bounds if any
+     */
+    void find_min_max(const std::vector<CSVChunk> &chunks);
+
+    /**
+     * \brief scales and adds parsed lines to the training or testing set
+     * @param chunks parsed lines, released as they are added
+     * @param train whether lines go to the training set
+     * @param nlines line counter, used as id when there's no id column
+     */
+    void add_csv_chunks(std::vector<CSVChunk> &chunks,
+			const bool &train,
+			int &nlines);
+
     int batch_size() const
     {
       return _csvdata.size();
@@ -566,6 +684,15 @@ namespace dd
     std::unordered_map<std::string,CCategorical> _categoricals; /**< auto-converted categorical variables */
     double _test_split = -1;
     int _detect_cols = -1;
+    bool _stream = false; /**< whether training data is streamed from file instead of held in memory. */
+    int _shuffle_window = 100000; /**< number of lines shuffled together when streaming. */
+    int _stream_prefetch = 16; /**< number of blocks of lines read ahead when streaming. */
+    int _stream_seed = -1;
+    long int _stream_train_size = 0; /**< number of streamed training lines. */
+    long int _stream_test_size = 0; /**< number of streamed testing lines. */
+    std::shared_ptr<CSVInputFileConn> _stream_parser; /**< parsing state for streamed lines. */
+    std::shared_ptr<StreamReader<CSVline>> _stream_train_reader;
+    std::shared_ptr<StreamReader<CSVline>> _stream_test_reader;
     
     // data
     std::vector<CSVline> _csvdata;
@@ -33,6 +33,7 @@ namespace dd
         _cifc->_columns.clear();
         std::string testfname = _cifc->_csv_test_fname;
         _cifc->_csv_test_fname = "";
+        _cifc->_stream = false; // timeseries are held in memory
         _cifc->read_csv(fname,true);
         _cifc->_csv_test_fname = testfname;
         _cifc->push_csv_to_csvts(is_test_data);
@@ -0,0 +1,752 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2019 Jolibrain
+ * Author: Emmanuel Benazera <beniz@droidnik.fr>
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HNSWINDEX_H
+#define HNSWINDEX_H
+
+#include <boost/thread/shared_mutex.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dd
+{
+  /**
+   * \brief in-memory vector storage of the HNSW index
+   */
+  enum class HnswStorage
+  {
+    float32 = 0, /**< 4 bytes per dimension. */
+    int8 = 1, /**< 1 byte per dimension plus a per-vector scale. */
+    pq = 2 /**< product quantization, 1 byte per subspace, float32 until the codebook is trained. */
+  };
+
+  /**
+   * \brief Hierarchical Navigable Small World graph over angular distance
+   *        (Malkov & Yashunin), that supports insertions at any time and
+   *        concurrent searches. Vectors are stored normalized, and distances
+   *        are reported as sqrt(2-2cos), i.e. the same as Annoy's angular distance.
+   *
+   *        Insertions are serialized internally and look for neighbors under a
+   *        shared lock, the graph is only locked exclusively while the new node
+   *        is linked in.
+   */
+  class HnswIndex
+  {
+  public:
+    /**
+     * \brief graph constructor
+     * @param dim vector length
+     * @param M max number of links per node on upper layers, 2*M on the bottom layer
+     * @param ef_construction size of the candidate list at insertion
+     * @param storage in-memory vector storage
+     * @param pq_m number of product quantization subspaces, 0 for dim/4 when possible
+     * @param pq_train_size number of vectors the quantization codebook is trained on
+     */
+    HnswIndex(const int &dim, const int &M=16, const int &ef_construction=200,
+	      const HnswStorage &storage=HnswStorage::float32,
+	      const int &pq_m=0, const int &pq_train_size=10000)
+      :_dim(dim),_M(std::max(2,M)),_ef_construction(ef_construction),
+       _ml(1.0/std::log(static_cast<double>(_M))),_storage(storage),
+       _pq_train_size(std::max(1,pq_train_size))
+    {
+      _pq_m = pq_m > 0 && dim % pq_m == 0 ? pq_m : (dim % 4 == 0 ? dim / 4 : dim);
+    }
+    ~HnswIndex() {}
+
+    /**
+     * \brief inserts a vector into the graph
+     * @param vec vector of size dim
+     * @return the vector's id, i.e. its insertion rank
+     */
+    int add(const double *vec)
+    {
+      std::lock_guard<std::mutex> alock(_add_mutex);
+      std::vector<float> v(_dim);
+      normalize(vec,v.data());
+      int level = random_level();
+      int id = static_cast<int>(_levels.size());
+
+      // neighbors lookup, the graph cannot change since insertions are serialized
+      std::vector<std::vector<int>> nlinks(level+1);
+      {
+	boost::shared_lock<boost::shared_mutex> lock(_mutex);
+	if (_entry >= 0)
+	  {
+	    query q(v.data(),*this);
+	    int ep = _entry;
+	    float epd = distance(q,ep);
+	    for (int l=_max_level;l>level;l--)
+	      greedy(q,l,ep,epd);
+	    std::vector<std::pair<float,int>> eps = {std::pair<float,int>(epd,ep)};
+	    for (int l=std::min(level,_max_level);l>=0;l--)
+	      {
+		std::vector<std::pair<float,int>> cands = search_layer(q,eps,_ef_construction,l);
+		nlinks.at(l) = select_neighbors(cands,_M);
+		eps = std::move(cands);
+	      }
+	  }
+      }
+
+      // linking
+      {
+	boost::unique_lock<boost::shared_mutex> lock(_mutex);
+	encode(v.data());
+	_levels.push_back(level);
+	_links.push_back(nlinks);
+	std::vector<float> nbuf(_dim), cbuf(_dim);
+	for (int l=0;l<=level;l++)
+	  {
+	    size_t max_links = l == 0 ? 2*_M : _M;
+	    for (int n: nlinks.at(l))
+	      {
+		std::vector<int> &nl = _links.at(n).at(l);
+		nl.push_back(id);
+		if (nl.size() > max_links)
+		  {
+		    const float *nv = vec_ptr(n,nbuf.data());
+		    std::vector<std::pair<float,int>> cands;
+		    cands.reserve(nl.size());
+		    for (int c: nl)
+		      cands.push_back(std::pair<float,int>(1.0f-dot(nv,vec_ptr(c,cbuf.data())),c));
+		    std::sort(cands.begin(),cands.end());
+		    nl = select_neighbors(cands,max_links);
+		  }
+	      }
+	  }
+	if (_entry < 0 || level > _max_level)
+	  {
+	    _entry = id;
+	    _max_level = level;
+	  }
+      }
+
+      if (_storage == HnswStorage::pq && !_pq_trained
+	  && static_cast<int>(_levels.size()) >= _pq_train_size)
+	train_pq();
+      return id;
+    }
+
+    /**
+     * \brief nearest neighbors search, safe to call concurrently with insertions
+     * @param vec query vector of size dim
+     * @param nn number of neighbors
+     * @param ids neighbors ids, closest first
+     * @param distances neighbors distances, approximated for compressed storages
+     * @param ef size of the candidate list, higher is more accurate and slower
+     */
+    void search(const double *vec, const int &nn,
+		std::vector<int> &ids, std::vector<double> &distances,
+		const int &ef=64) const
+    {
+      std::vector<float> v(_dim);
+      normalize(vec,v.data());
+      boost::shared_lock<boost::shared_mutex> lock(_mutex);
+      if (_entry < 0 || nn <= 0)
+	return;
+      query q(v.data(),*this);
+      int ep = _entry;
+      float epd = distance(q,ep);
+      for (int l=_max_level;l>0;l--)
+	greedy(q,l,ep,epd);
+      std::vector<std::pair<float,int>> eps = {std::pair<float,int>(epd,ep)};
+      std::vector<std::pair<float,int>> res = search_layer(q,eps,std::max(ef,nn),0);
+      for (size_t i=0;i<res.size()&&static_cast<int>(i)<nn;i++)
+	{
+	  ids.push_back(res.at(i).second);
+	  distances.push_back(std::sqrt(std::max(0.0f,2.0f*res.at(i).first)));
+	}
+    }
+
+    /**
+     * \brief number of indexed vectors
+     */
+    int size() const
+    {
+      boost::shared_lock<boost::shared_mutex> lock(_mutex);
+      return static_cast<int>(_levels.size());
+    }
+
+    /**
+     * \brief vector storage, as configured or as read from file
+     */
+    HnswStorage storage() const
+    {
+      boost::shared_lock<boost::shared_mutex> lock(_mutex);
+      return _storage;
+    }
+
+    /**
+     * \brief approximate memory held by stored vectors, in bytes
+     */
+    size_t vectors_bytes() const
+    {
+      boost::shared_lock<boost::shared_mutex> lock(_mutex);
+      return _data.size()*sizeof(float) + _codes.size() + _scales.size()*sizeof(float)
+	+ _centroids.size()*sizeof(float);
+    }
+
+    /**
+     * \brief writes the graph to file, searches can proceed meanwhile
+     * @param path file path, written to a temporary file first then renamed
+     * @return true if OK
+     */
+    bool save(const std::string &path) const
+    {
+      std::lock_guard<std::mutex> alock(_add_mutex);
+      boost::shared_lock<boost::shared_mutex> lock(_mutex);
+      std::string tmp_path = path + ".tmp";
+      std::ofstream out(tmp_path,std::ios::binary|std::ios::trunc);
+      if (!out.is_open())
+	return false;
+      int32_t header[10] = {_magic,_dim,_M,_ef_construction,_max_level,_entry,
+			    static_cast<int32_t>(_storage),_pq_m,_pq_k,_pq_trained};
+      out.write(reinterpret_cast<const char*>(header),sizeof(header));
+      uint64_t n = _levels.size();
+      out.write(reinterpret_cast<const char*>(&n),sizeof(n));
+      write_vec(out,_data);
+      write_vec(out,_codes);
+      write_vec(out,_scales);
+      write_vec(out,_centroids);
+      for (size_t i=0;i<_levels.size();i++)
+	{
+	  int32_t level = _levels.at(i);
+	  out.write(reinterpret_cast<const char*>(&level),sizeof(level));
+	  for (int l=0;l<=level;l++)
+	    write_vec(out,_links.at(i).at(l));
+	}
+      out.close();
+      if (!out)
+	return false;
+      return std::rename(tmp_path.c_str(),path.c_str()) == 0;
+    }
+
+    /**
+     * \brief reads the graph from file, replacing current content, including storage settings
+     * @param path file path
+     * @return true if OK, false if the file cannot be read, its dimension does not match
+     *         or its content is inconsistent
+     */
+    bool load(const std::string &path)
+    {
+      std::ifstream in(path,std::ios::binary|std::ios::ate);
+      if (!in.is_open())
+	return false;
+      uint64_t left = static_cast<uint64_t>(in.tellg()); // sizes read from file are checked against the bytes left
+      in.seekg(0,std::ios::beg);
+      int32_t header[10];
+      uint64_t n = 0;
+      if (!read_pod(in,header,sizeof(header),left)
+	  || header[0] != _magic || header[1] != _dim
+	  || !read_pod(in,&n,sizeof(n),left))
+	return false;
+
+      // header fields
+      int M = header[2], max_level = header[4], entry = header[5];
+      int storage = header[6], pq_m = header[7], pq_k = header[8], pq_trained = header[9];
+      bool pq = storage == static_cast<int>(HnswStorage::pq);
+      if (M < 2 || header[3] < 1
+	  || storage < static_cast<int>(HnswStorage::float32) || storage > static_cast<int>(HnswStorage::pq)
+	  || (pq && (pq_m <= 0 || _dim % pq_m != 0 || pq_k < 0 || pq_k > 256))
+	  || (pq && pq_trained && pq_k == 0)
+	  || n > static_cast<uint64_t>(std::numeric_limits<int>::max())
+	  || n > left / (sizeof(int32_t)+sizeof(uint64_t)) // a level and a layer per node at least
+	  || (n == 0 && (entry != -1 || max_level != -1))
+	  || (n > 0 && (entry < 0 || static_cast<uint64_t>(entry) >= n || max_level < 0)))
+	return false;
+
+      // stored vectors
+      std::vector<float> data, scales, centroids;
+      std::vector<uint8_t> codes;
+      if (!read_vec(in,data,left) || !read_vec(in,codes,left)
+	  || !read_vec(in,scales,left) || !read_vec(in,centroids,left))
+	return false;
+      bool pq_coded = pq && pq_trained;
+      size_t dim = _dim;
+      if (storage == static_cast<int>(HnswStorage::int8))
+	{
+	  if (!data.empty() || codes.size() != n*dim || scales.size() != n || !centroids.empty())
+	    return false;
+	}
+      else if (pq_coded)
+	{
+	  if (!data.empty() || codes.size() != n*pq_m || !scales.empty()
+	      || centroids.size() != static_cast<size_t>(pq_m)*pq_k*(_dim/pq_m))
+	    return false;
+	  for (const uint8_t &c: codes)
+	    if (c >= pq_k)
+	      return false;
+	}
+      else if (data.size() != n*dim || !codes.empty() || !scales.empty() || !centroids.empty())
+	return false;
+
+      // graph, nodes are linked on their layers only
+      std::vector<int> levels;
+      std::vector<std::vector<std::vector<int>>> links(n);
+      levels.reserve(n);
+      for (uint64_t i=0;i<n;i++)
+	{
+	  int32_t level = 0;
+	  if (!read_pod(in,&level,sizeof(level),left) || level < 0 || level > max_level)
+	    return false;
+	  levels.push_back(level);
+	  links.at(i).resize(level+1);
+	  for (int l=0;l<=level;l++)
+	    if (!read_vec(in,links.at(i).at(l),left))
+	      return false;
+	}
+      if (n > 0 && levels.at(entry) != max_level)
+	return false;
+      for (uint64_t i=0;i<n;i++)
+	for (size_t l=0;l<links.at(i).size();l++)
+	  for (const int &c: links.at(i).at(l))
+	    if (c < 0 || static_cast<uint64_t>(c) >= n || levels.at(c) < static_cast<int>(l))
+	      return false;
+
+      std::lock_guard<std::mutex> alock(_add_mutex);
+      boost::unique_lock<boost::shared_mutex> lock(_mutex);
+      _M = M;
+      _ef_construction = header[3];
+      _ml = 1.0/std::log(static_cast<double>(_M));
+      _max_level = header[4];
+      _entry = header[5];
+      _storage = static_cast<HnswStorage>(header[6]);
+      _pq_m = header[7];
+      _pq_k = header[8];
+      _pq_trained = header[9];
+      _data = std::move(data);
+      _codes = std::move(codes);
+      _scales = std::move(scales);
+      _centroids = std::move(centroids);
+      _levels = std::move(levels);
+      _links = std::move(links);
+      return true;
+    }
+
+  private:
+    /**
+     * \brief normalized query, with its distance table to the quantization
+     *        centroids when the storage is product quantized
+     */
+    class query
+    {
+    public:
+      query(const float *v, const HnswIndex &hi)
+	:_v(v)
+      {
+	if (hi.pq_coded())
+	  {
+	    int dsub = hi._dim / hi._pq_m;
+	    _table.resize(static_cast<size_t>(hi._pq_m)*hi._pq_k);
+	    for (int j=0;j<hi._pq_m;j++)
+	      for (int c=0;c<hi._pq_k;c++)
+		_table[j*hi._pq_k+c] = dot(v+j*dsub,hi.centroid(j,c),dsub);
+	  }
+      }
+
+      const float *_v;
+      std::vector<float> _table;
+    };
+
+    bool pq_coded() const
+    {
+      return _storage == HnswStorage::pq && _pq_trained;
+    }
+
+    const float* centroid(const int &j, const int &c) const
+    {
+      int dsub = _dim / _pq_m;
+      return _centroids.data() + (static_cast<size_t>(j)*_pq_k + c)*dsub;
+    }
+
+    void normalize(const double *vec, float *out) const
+    {
+      double norm = 0.0;
+      for (int i=0;i<_dim;i++)
+	norm += vec[i]*vec[i];
+      norm = norm > 0.0 ? 1.0/std::sqrt(norm) : 1.0;
+      for (int i=0;i<_dim;i++)
+	out[i] = static_cast<float>(vec[i]*norm);
+    }
+
+    static float dot(const float *a, const float *b, const int &n)
+    {
+      float d = 0.0f;
+      for (int i=0;i<n;i++)
+	d += a[i]*b[i];
+      return d;
+    }
+
+    float dot(const float *a, const float *b) const
+    {
+      return dot(a,b,_dim);
+    }
+
+    /**
+     * \brief appends a normalized vector to the storage
+     */
+    void encode(const float *v)
+    {
+      if (_storage == HnswStorage::int8)
+	{
+	  float amax = 0.0f;
+	  for (int i=0;i<_dim;i++)
+	    amax = std::max(amax,std::fabs(v[i]));
+	  float scale = amax > 0.0f ? amax / 127.0f : 1.0f;
+	  for (int i=0;i<_dim;i++)
+	    _codes.push_back(static_cast<uint8_t>(static_cast<int8_t>(std::round(v[i]/scale))));
+	  _scales.push_back(scale);
+	}
+      else if (pq_coded())
+	pq_encode(v,_codes);
+      else _data.insert(_data.end(),v,v+_dim);
+    }
+
+    void pq_encode(const float *v, std::vector<uint8_t> &codes) const
+    {
+      int dsub = _dim / _pq_m;
+      for (int j=0;j<_pq_m;j++)
+	{
+	  int best = 0;
+	  float bestd = std::numeric_limits<float>::max();
+	  for (int c=0;c<_pq_k;c++)
+	    {
+	      const float *cv = centroid(j,c);
+	      float d = 0.0f;
+	      for (int i=0;i<dsub;i++)
+		{
+		  float e = v[j*dsub+i] - cv[i];
+		  d += e*e;
+		}
+	      if (d < bestd)
+		{
+		  bestd = d;
+		  best = c;
+		}
+	    }
+	  codes.push_back(static_cast<uint8_t>(best));
+	}
+    }
+
+    /**
+     * \brief pointer to a stored vector, decoded into buf if the storage is compressed
+     */
+    const float* vec_ptr(const int &id, float *buf) const
+    {
+      if (_storage == HnswStorage::int8)
+	{
+	  const int8_t *code = reinterpret_cast<const int8_t*>(_codes.data()) + static_cast<size_t>(id)*_dim;
+	  float scale = _scales[id];
+	  for (int i=0;i<_dim;i++)
+	    buf[i] = code[i]*scale;
+	  return buf;
+	}
+      else if (pq_coded())
+	{
+	  int dsub = _dim / _pq_m;
+	  const uint8_t *code = _codes.data() + static_cast<size_t>(id)*_pq_m;
+	  for (int j=0;j<_pq_m;j++)
+	    std::copy(centroid(j,code[j]),centroid(j,code[j])+dsub,buf+j*dsub);
+	  return buf;
+	}
+      return _data.data() + static_cast<size_t>(id)*_dim;
+    }
+
+    float distance(const query &q, const int &id) const
+    {
+      if (_storage == HnswStorage::int8)
+	{
+	  const int8_t *code = reinterpret_cast<const int8_t*>(_codes.data()) + static_cast<size_t>(id)*_dim;
+	  float d = 0.0f;
+	  for (int i=0;i<_dim;i++)
+	    d += q._v[i]*code[i];
+	  return 1.0f - d*_scales[id];
+	}
+      else if (pq_coded())
+	{
+	  const uint8_t *code = _codes.data() + static_cast<size_t>(id)*_pq_m;
+	  float d = 0.0f;
+	  for (int j=0;j<_pq_m;j++)
+	    d += q._table[j*_pq_k+code[j]];
+	  return 1.0f - d;
+	}
+      return 1.0f - dot(q._v,_data.data()+static_cast<size_t>(id)*_dim);
+    }
+
+    /**
+     * \brief trains the quantization codebook with k-means over the vectors
+     *        indexed so far, then encodes them. Searches proceed during training.
+     */
+    void train_pq()
+    {
+      int dsub = _dim / _pq_m;
+      std::vector<float> centroids;
+      std::vector<uint8_t> codes;
+      int n = 0;
+      int k = 0;
+      {
+	boost::shared_lock<boost::shared_mutex> lock(_mutex);
+	n = static_cast<int>(_levels.size());
+	k = std::min(256,n);
+	centroids.resize(static_cast<size_t>(_pq_m)*k*dsub);
+	std::vector<int> perm(n);
+	for (int i=0;i<n;i++)
+	  perm[i] = i;
+	std::shuffle(perm.begin(),perm.end(),_rng);
+#pragma omp parallel for
+	for (int j=0;j<_pq_m;j++)
+	  {
+	    float *cj = centroids.data() + static_cast<size_t>(j)*k*dsub;
+	    for (int c=0;c<k;c++)
+	      std::copy(_data.begin()+static_cast<size_t>(perm[c])*_dim+j*dsub,
+			_data.begin()+static_cast<size_t>(perm[c])*_dim+(j+1)*dsub,
+			cj+c*dsub);
+	    std::vector<int> assign(n,0);
+	    std::vector<float> sums(static_cast<size_t>(k)*dsub);
+	    std::vector<int> counts(k);
+	    for (int iter=0;iter<_pq_iterations;iter++)
+	      {
+		std::fill(sums.begin(),sums.end(),0.0f);
+		std::fill(counts.begin(),counts.end(),0);
+		for (int i=0;i<n;i++)
+		  {
+		    const float *v = _data.data() + static_cast<size_t>(i)*_dim + j*dsub;
+		    int best = 0;
+		    float bestd = std::numeric_limits<float>::max();
+		    for (int c=0;c<k;c++)
+		      {
+			float d = 0.0f;
+			for (int t=0;t<dsub;t++)
+			  {
+			    float e = v[t] - cj[c*dsub+t];
+			    d += e*e;
+			  }
+			if (d < bestd)
+			  {
+			    bestd = d;
+			    best = c;
+			  }
+		      }
+		    assign[i] = best;
+		    ++counts[best];
+		    for (int t=0;t<dsub;t++)
+		      sums[best*dsub+t] += v[t];
+		  }
+		for (int c=0;c<k;c++)
+		  if (counts[c] > 0) // empty clusters keep their centroid
+		    for (int t=0;t<dsub;t++)
+		      cj[c*dsub+t] = sums[c*dsub+t] / counts[c];
+	      }
+	  }
+      }
+      boost::unique_lock<boost::shared_mutex> lock(_mutex);
+      _centroids = std::move(centroids);
+      _pq_k = k;
+      _pq_trained = 1;
+      codes.reserve(static_cast<size_t>(n)*_pq_m);
+      for (int i=0;i<n;i++)
+	pq_encode(_data.data()+static_cast<size_t>(i)*_dim,codes);
+      _codes = std::move(codes);
+      std::vector<float>().swap(_data);
+    }
+
+    int random_level()
+    {
+      std::uniform_real_distribution<double> u(0.0,1.0);
+      return static_cast<int>(-std::log(std::max(u(_rng),1e-12)) * _ml);
+    }
+
+    /**
+     * \brief greedy walk toward the query on a given layer
+     */
+    void greedy(const query &q, const int &level, int &ep, float &epd) const
+    {
+      bool changed = true;
+      while (changed)
+	{
+	  changed = false;
+	  for (int n: _links.at(ep).at(level))
+	    {
+	      float d = distance(q,n);
+	      if (d < epd)
+		{
+		  epd = d;
+		  ep = n;
+		  changed = true;
+		}
+	    }
+	}
+    }
+
+    /**
+     * \brief best-first search on a given layer
+     * @return up to ef closest nodes as (distance,id), closest first
+     */
+    std::vector<std::pair<float,int>> search_layer(const query &q,
+						    const std::vector<std::pair<float,int>> &eps,
+						    const int &ef, const int &level) const
+    {
+      // visited marks are reused across searches of the same thread
+      static thread_local std::vector<uint32_t> visited;
+      static thread_local uint32_t epoch = 0;
+      if (visited.size() < _levels.size())
+	visited.resize(_levels.size(),0);
+      if (++epoch == 0)
+	{
+	  std::fill(visited.begin(),visited.end(),0);
+	  epoch = 1;
+	}
+
+      typedef std::pair<float,int> dn;
+      std::priority_queue<dn,std::vector<dn>,std::greater<dn>> cands; // closest on top
+      std::priority_queue<dn> res; // farthest on top
+      for (const dn &e: eps)
+	{
+	  visited[e.second] = epoch;
+	  cands.push(e);
+	  res.push(e);
+	}
+      while (static_cast<int>(res.size()) > ef)
+	res.pop();
+      while (!cands.empty())
+	{
+	  dn c = cands.top();
+	  if (c.first > res.top().first && static_cast<int>(res.size()) >= ef)
+	    break;
+	  cands.pop();
+	  for (int n: _links.at(c.second).at(level))
+	    {
+	      if (visited[n] == epoch)
+		continue;
+	      visited[n] = epoch;
+	      float d = distance(q,n);
+	      if (static_cast<int>(res.size()) < ef || d < res.top().first)
+		{
+		  cands.push(dn(d,n));
+		  res.push(dn(d,n));
+		  if (static_cast<int>(res.size()) > ef)
+		    res.pop();
+		}
+	    }
+	}
+      std::vector<dn> out(res.size());
+      for (int i=static_cast<int>(out.size())-1;i>=0;i--)
+	{
+	  out[i] = res.top();
+	  res.pop();
+	}
+      return out;
+    }
+
+    /**
+     * \brief keeps candidates that are closer to the query than to any already
+     *        selected neighbor, so that links spread in all directions
+     * @param cands candidates as (distance,id), closest first
+     * @param m max number of neighbors
+     */
+    std::vector<int> select_neighbors(const std::vector<std::pair<float,int>> &cands,
+				      const size_t &m) const
+    {
+      std::vector<int> sel;
+      sel.reserve(m);
+      std::vector<float> cbuf(_dim), sbuf(_dim);
+      for (const std::pair<float,int> &c: cands)
+	{
+	  if (sel.size() >= m)
+	    break;
+	  const float *cv = vec_ptr(c.second,cbuf.data());
+	  bool keep = true;
+	  for (int s: sel)
+	    if (1.0f - dot(cv,vec_ptr(s,sbuf.data())) < c.first)
+	      {
+		keep = false;
+		break;
+	      }
+	  if (keep)
+	    sel.push_back(c.second);
+	}
+      return sel;
+    }
+
+    template <typename T>
+      static void write_vec(std::ofstream &out, const std::vector<T> &v)
+      {
+	uint64_t s = v.size();
+	out.write(reinterpret_cast<const char*>(&s),sizeof(s));
+	out.write(reinterpret_cast<const char*>(v.data()),s*sizeof(T));
+      }
+
+    template <typename T>
+      static bool read_vec(std::ifstream &in, std::vector<T> &v, uint64_t &left)
+      {
+	uint64_t s = 0;
+	if (!read_pod(in,&s,sizeof(s),left) || s > left / sizeof(T))
+	  return false;
+	v.resize(s);
+	return read_pod(in,v.data(),s*sizeof(T),left);
+      }
+
+    static bool read_pod(std::ifstream &in, void *p, const uint64_t &size, uint64_t &left)
+    {
+      if (size > left || !in.read(reinterpret_cast<char*>(p),size))
+	return false;
+      left -= size;
+      return true;
+    }
+
+    static const int32_t _magic = 0x57534e48; /**< file marker, 'HNSW'. */
+    const int _dim;
+    int _M = 16;
+    int _ef_construction = 200;
+    double _ml; /**< level generation factor. */
+    std::mt19937 _rng{100};
+    int _entry = -1; /**< entry point id. */
+    int _max_level = -1;
+    std::vector<int> _levels; /**< top layer of each node. */
+    std::vector<std::vector<std::vector<int>>> _links; /**< per node and per layer neighbors. */
+
+    HnswStorage _storage = HnswStorage::float32;
+    std::vector<float> _data; /**< normalized float32 vectors, contiguous. */
+    std::vector<uint8_t> _codes; /**< int8 or product quantization codes, contiguous. */
+    std::vector<float> _scales; /**< per-vector int8 scale. */
+    int _pq_m = 1; /**< number of quantization subspaces. */
+    int _pq_k = 0; /**< number of centroids per subspace. */
+    int _pq_train_size = 10000; /**< codebook is trained once this many vectors are indexed. */
+    int _pq_trained = 0;
+    const int _pq_iterations = 20; /**< k-means iterations. */
+    std::vector<float> _centroids; /**< per subspace centroids. */
+
+    mutable boost::shared_mutex _mutex; /**< shared by searches, exclusive while linking. */
+    mutable std::mutex _add_mutex; /**< serializes insertions and saving. */
+  };
+
+}
+
+#endif
@@ -31,7 +31,6 @@
 #include "ext/rapidjson/writer.h"
 #include <spdlog/spdlog.h>
 #include <gflags/gflags.h>
-#include "utils/httpclient.hpp"
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/copy.hpp>
@@ -42,6 +41,12 @@ DEFINE_string(host,"localhost","host for running the server");
 DEFINE_string(port,"8080","server port");
 DEFINE_int32(nthreads,10,"number of HTTP server threads");
 DEFINE_string(allow_origin,"","Access-Control-Allow-Origin for the server");
+DEFINE_int32(network_threads,2,"number of network output connector delivery threads");
+DEFINE_int32(network_queue_size,1000,"max number of network output connector results pending delivery");
+DEFINE_int32(network_batch_size,1,"max number of network output connector results per post, sent as a JSON array when > 1");
+DEFINE_int32(network_retries,3,"number of retries of a failed network output connector post");
+DEFINE_int32(network_retry_delay,100,"delay in ms before the first retry of a network output connector post, doubled on every retry");
+DEFINE_int32(network_timeout,30000,"max duration in ms of a network output connector post");
 
 using namespace boost::iostreams;
 
@@ -138,6 +143,54 @@ namespace dd
       }
     else return "";
   }
+
+  /**
+   * \brief rapidjson output stream appending to a string, i.e. the response content
+   */
+  class StringOStream
+  {
+  public:
+    typedef char Ch;
+    StringOStream(std::string &str):_str(str) {}
+    void Put(char c) { _str.push_back(c); }
+    void Flush() {}
+    std::string &_str;
+  };
+
+  /**
+   * \brief rapidjson output stream compressing on the fly into a string,
+   *        characters are buffered and fed to gzip by chunks
+   */
+  class GzipStringOStream
+  {
+  public:
+    typedef char Ch;
+    GzipStringOStream(std::string &str)
+    {
+      _gzout.push(gzip_compressor());
+      _gzout.push(boost::iostreams::back_inserter(str));
+      _buf.reserve(_chunk_size);
+    }
+    void Put(char c)
+    {
+      _buf.push_back(c);
+      if (_buf.size() == _chunk_size)
+	Flush();
+    }
+    void Flush()
+    {
+      _gzout.write(_buf.data(),_buf.size());
+      _buf.clear();
+    }
+    void close()
+    {
+      Flush();
+      boost::iostreams::close(_gzout);
+    }
+    static const size_t _chunk_size = 65536;
+    std::string _buf;
+    filtering_ostream _gzout;
+  };
 }
 
 class APIHandler
@@ -217,17 +270,12 @@ public:
 	    if (janswer["network"].HasMember("content_type"))
 	      content_type = janswer["network"]["content_type"].GetString();
 	    
-	    //- make call
-	    std::string outstr;
-	    try
-	      {
-		dd::httpclient::post_call(url,stranswer,http_method,outcode,outstr,content_type);
-		stranswer = outstr;
-	      }
-	    catch (std::runtime_error &e)
+	    //- queue call, delivery happens in the background so that a slow
+	    //  destination does not hold the server threads
+	    bool batchable = !janswer.HasMember("template") && content_type.find("json") != std::string::npos;
+	    if (!_hja->_delivery.push(url,stranswer,http_method,content_type,batchable))
 	      {
-		_logger->error(e.what());
-		_logger->info(stranswer);
+		_logger->error("network output connector delivery queue is full, dropping result for {}",url);
 		stranswer = _hja->jrender(_hja->dd_output_connector_network_error_1009());
 	      }
 	  }
@@ -270,6 +318,107 @@ public:
     response.status = static_cast<http_server::response::status_type>(code);
   }
 
+  void fillup_binary_response(http_server::response &response,
+			      const JDoc &janswer,
+			      const std::string &bout,
+			      std::string &access_log,
+			      int &code,
+			      std::chrono::time_point<std::chrono::system_clock> tstart)
+  {
+    std::chrono::time_point<std::chrono::system_clock> tstop = std::chrono::system_clock::now();
+    if (janswer.HasMember("head") && janswer["head"].HasMember("service"))
+      access_log += " " + std::string(janswer["head"]["service"].GetString());
+    code = janswer["status"]["code"].GetInt();
+    access_log += " " + std::to_string(code);
+    int proctime = std::chrono::duration_cast<std::chrono::milliseconds>(tstop-tstart).count();
+    access_log += " " + std::to_string(proctime);
+    response = http_server::response::stock_reply(http_server::response::status_type(code),bout);
+    response.headers[1].value = "application/octet-stream";
+    if (!FLAGS_allow_origin.empty())
+      {
+	int pos = response.headers.size()+1;
+	response.headers.resize(pos);
+	response.headers[pos-1].name = "Access-Control-Allow-Origin";
+	response.headers[pos-1].value = FLAGS_allow_origin;
+      }
+    response.status = static_cast<http_server::response::status_type>(code);
+  }
+
+  /**
+   * \brief predict response serialized straight from the output data object
+   *        into the response content, possibly gzipped on the fly
+   */
+  template<typename TStream>
+    void write_predict(TStream &os, const JDoc &janswer, const dd::APIData &body)
+  {
+    rapidjson::Writer<TStream> writer(os);
+    writer.StartObject();
+    writer.Key("status");
+    janswer["status"].Accept(writer);
+    writer.Key("head");
+    janswer["head"].Accept(writer);
+    writer.Key("body");
+    body.toWriter(writer);
+    writer.EndObject();
+  }
+
+  void fillup_stream_response(http_server::response &response,
+			      const JDoc &janswer,
+			      const dd::APIData &body,
+			      std::string &access_log,
+			      int &code,
+			      std::chrono::time_point<std::chrono::system_clock> tstart,
+			      const std::string &encoding="")
+  {
+    code = janswer["status"]["code"].GetInt();
+    bool has_gzip = (encoding.find("gzip") != std::string::npos);
+    std::string content;
+    try
+      {
+	if (has_gzip)
+	  {
+	    dd::GzipStringOStream gzos(content);
+	    write_predict(gzos,janswer,body);
+	    gzos.close();
+	  }
+	else
+	  {
+	    dd::StringOStream sos(content);
+	    write_predict(sos,janswer,body);
+	  }
+      }
+    catch(const std::exception &e)
+      {
+	_logger->error(e.what());
+	fillup_response(response,_hja->dd_bad_request_400(),access_log,code,tstart);
+	return;
+      }
+    std::chrono::time_point<std::chrono::system_clock> tstop = std::chrono::system_clock::now();
+    if (janswer["head"].HasMember("service"))
+      access_log += " " + std::string(janswer["head"]["service"].GetString());
+    access_log += " " + std::to_string(code);
+    int proctime = std::chrono::duration_cast<std::chrono::milliseconds>(tstop-tstart).count();
+    access_log += " " + std::to_string(proctime);
+    response = http_server::response::stock_reply(http_server::response::status_type(code),"");
+    response.content.swap(content);
+    response.headers[0].value = std::to_string(response.content.size());
+    response.headers[1].value = "application/json";
+    if (has_gzip)
+      {
+	response.headers.resize(3);
+	response.headers[2].name = "Content-Encoding";
+	response.headers[2].value = "gzip";
+      }
+    if (!FLAGS_allow_origin.empty())
+      {
+	int pos = response.headers.size()+1;
+	response.headers.resize(pos);
+	response.headers[pos-1].name = "Access-Control-Allow-Origin";
+	response.headers[pos-1].value = FLAGS_allow_origin;
+      }
+    response.status = static_cast<http_server::response::status_type>(code);
+  }
+
   void operator()(http_server::request const &request,
 		  http_server::response &response)
   {
@@ -316,11 +465,17 @@ public:
 
     std::string content_encoding;
     std::string accept_encoding;
+    std::string content_type;
+    std::string accept;
     for (const auto& header : request.headers) {
       if (header.name == "Accept-Encoding")
 	  accept_encoding = header.value;
       else if (header.name == "Content-Encoding")
 	content_encoding = header.value;
+      else if (header.name == "Content-Type")
+	content_type = header.value;
+      else if (header.name == "Accept")
+	accept = header.value;
     }
     bool encoding_error = false;
     if (!content_encoding.empty())
@@ -362,7 +517,14 @@ public:
 	if (rscs.at(0) == _rsc_info)
 	  {
 	    std::string jstr = dd::uri_query_to_json(req_query);
-	    fillup_response(response,_hja->info(jstr),access_log,code,tstart,accept_encoding);
+	    JDoc jinfo = _hja->info(jstr);
+	    if (jinfo.HasMember("head"))
+	      {
+		JVal jdelivery(rapidjson::kObjectType);
+		_hja->_delivery.stats().toJVal(jinfo,jdelivery);
+		jinfo["head"].AddMember("network_delivery",jdelivery,jinfo.GetAllocator());
+	      }
+	    fillup_response(response,jinfo,access_log,code,tstart,accept_encoding);
 	  }
 	else if (rscs.at(0) == _rsc_services)
 	  {
@@ -396,7 +558,42 @@ public:
 		_logger->error(access_log);
 		return;
 	      }
-	    fillup_response(response,_hja->service_predict(body),access_log,code,tstart,accept_encoding);
+	    bool binary_out = (accept.find(dd::binarydata::octet_stream()) != std::string::npos);
+	    if (!dd::binarydata::is_binary(content_type) && !binary_out)
+	      {
+		dd::APIData sbody;
+		JDoc janswer = _hja->service_predict(body,nullptr,nullptr,&sbody);
+		if (janswer.HasMember("body") || !janswer.HasMember("head")) // measures, templates, network and errors
+		  fillup_response(response,janswer,access_log,code,tstart,accept_encoding);
+		else fillup_stream_response(response,janswer,sbody,access_log,code,tstart,accept_encoding);
+	      }
+	    else
+	      {
+		// binary payload, data elements are read in place from the request body
+		std::shared_ptr<dd::BinaryData> bdata;
+		std::string jstr;
+		if (!dd::binarydata::is_binary(content_type))
+		  jstr = body;
+		else
+		  {
+		    std::shared_ptr<const std::string> bbody = std::make_shared<const std::string>(std::move(body));
+		    bdata = std::make_shared<dd::BinaryData>();
+		    if (dd::binarydata::parse(content_type,bbody,*bdata,jstr))
+		      {
+			_logger->error("malformed binary payload");
+			fillup_response(response,_hja->dd_bad_request_400(),access_log,code,tstart);
+			_logger->error(access_log);
+			return;
+		      }
+		    if (jstr.empty()) // parameters from the query string, e.g. ?service=imageserv&parameters.output.best=3
+		      jstr = dd::uri_query_to_json(req_query);
+		  }
+		std::string bout;
+		JDoc janswer = _hja->service_predict(jstr,bdata,binary_out ? &bout : nullptr);
+		if (!bout.empty())
+		  fillup_binary_response(response,janswer,bout,access_log,code,tstart);
+		else fillup_response(response,janswer,access_log,code,tstart,accept_encoding);
+	      }
 	  }
 	else if (rscs.at(0) == _rsc_train)
 	  {
@@ -475,6 +672,9 @@ namespace dd
 
     if (!FLAGS_allow_origin.empty())
       _logger->info("Allowing origin from {}",FLAGS_allow_origin);
+    _delivery.start(_logger,FLAGS_network_threads,FLAGS_network_queue_size,
+		    FLAGS_network_batch_size,FLAGS_network_retries,
+		    FLAGS_network_retry_delay,FLAGS_network_timeout);
     
     std::vector<std::thread> ts;
     for (int i=0;i<nthreads;i++)
@@ -520,6 +720,7 @@ namespace dd
 	    _logger->error(e.what());
 	  }
       }
+    _delivery.stop();
   }
 
   void HttpJsonAPI::terminate(int param)
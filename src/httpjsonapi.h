@@ -23,6 +23,7 @@
 #define HTTPJSONAPI_H
 
 #include "jsonapi.h"
+#include "networkdelivery.h"
 #include <boost/network/protocol/http/server.hpp>
 #include <boost/network/uri.hpp>
 #include <boost/network/uri/uri_io.hpp>
@@ -56,6 +57,7 @@ namespace dd
     
     http_server *_dd_server = nullptr; /**< main reusable pointer to server object */
     std::future<int> _ft; /**< holds the results from the main server thread */
+    NetworkDelivery _delivery; /**< background delivery of network output connector results */
   };
 }
 
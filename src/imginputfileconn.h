@@ -28,6 +28,7 @@
 #include <opencv2/highgui/highgui.hpp>
 #include "ext/base64/base64.h"
 #include "utils/apitools.h"
+#include <fstream>
 #include <random>
 
 namespace dd
@@ -71,23 +72,142 @@ namespace dd
       else return false;
     }
 
-    void scale(const cv::Mat &src, cv::Mat &dst) const {
-      float coef = std::min(static_cast<float>(_scale_max) / std::max(src.rows, src.cols),
-			    static_cast<float>(_scale_min) / std::min(src.rows, src.cols));
-      cv::resize(src, dst, cv::Size(), coef, coef, CV_INTER_CUBIC);
+    float scale_coef(const int &rows, const int &cols) const {
+      return std::min(static_cast<float>(_scale_max) / std::max(rows, cols),
+		      static_cast<float>(_scale_min) / std::min(rows, cols));
+    }
+
+    void scale(const cv::Mat &src, cv::Mat &dst, const int &interp=CV_INTER_CUBIC) const {
+      float coef = scale_coef(src.rows, src.cols);
+      cv::resize(src, dst, cv::Size(), coef, coef, interp);
+    }
+
+    // JPEG dimensions from the frame header, without decoding
+    static bool jpeg_size(const char *data, const size_t &size, int &rows, int &cols)
+    {
+      const unsigned char *d = reinterpret_cast<const unsigned char*>(data);
+      if (size < 4 || d[0] != 0xFF || d[1] != 0xD8)
+	return false;
+      size_t p = 2;
+      while (p + 4 <= size)
+	{
+	  if (d[p] != 0xFF)
+	    return false;
+	  unsigned char m = d[p+1];
+	  if (m == 0xFF) // fill byte
+	    {
+	      ++p;
+	      continue;
+	    }
+	  if (m == 0x01 || (m >= 0xD0 && m <= 0xD8)) // markers without payload
+	    {
+	      p += 2;
+	      continue;
+	    }
+	  if (m >= 0xC0 && m <= 0xCF && m != 0xC4 && m != 0xC8 && m != 0xCC) // start of frame
+	    {
+	      if (p + 9 > size)
+		return false;
+	      rows = (d[p+5] << 8) | d[p+6];
+	      cols = (d[p+7] << 8) | d[p+8];
+	      return rows > 0 && cols > 0;
+	    }
+	  if (m == 0xDA || m == 0xD9) // scan or end of image before any frame
+	    return false;
+	  int len = (d[p+2] << 8) | d[p+3];
+	  if (len < 2) // segment length includes its own two bytes
+	    return false;
+	  p += 2 + len;
+	}
+      return false;
+    }
+
+    // largest JPEG DCT scaling denominator (8, 4, 2) that keeps the decoded image
+    // at least as large as the resizing target, 1 if none
+    int reduction_factor(const int &rows, const int &cols) const
+    {
+      double trows = 0.0, tcols = 0.0;
+      if (_scaled)
+	{
+	  float coef = scale_coef(rows, cols);
+	  trows = rows * coef;
+	  tcols = cols * coef;
+	}
+      else if (_width == 0 && _height == 0)
+	return 1;
+      else if (_width == 0 || _height == 0)
+	{
+	  double s = static_cast<double>(std::max(_width, _height)) / std::max(rows, cols);
+	  trows = rows * s;
+	  tcols = cols * s;
+	}
+      else // EXIF orientation may swap dimensions
+	trows = tcols = std::max(_width, _height);
+      for (int f: {8, 4, 2})
+	{
+	  if (_scaled || (_width == 0 || _height == 0))
+	    {
+	      if (rows / f >= trows && cols / f >= tcols)
+		return f;
+	    }
+	  else if (std::min(rows, cols) / f >= trows)
+	    return f;
+	}
+      return 1;
     }
 
     // decode image
     void decode(const std::string &str)
       {
-	std::vector<unsigned char> vdat(str.begin(),str.end());
-	cv::Mat img = cv::Mat(cv::imdecode(cv::Mat(vdat,true),
-                                     _unchanged_data ? CV_LOAD_IMAGE_UNCHANGED :
-                                     (_bw ? CV_LOAD_IMAGE_GRAYSCALE : CV_LOAD_IMAGE_COLOR)));
-	_imgs_size.push_back(std::pair<int,int>(img.rows,img.cols));
+	decode(str.data(),str.size());
+      }
+
+    // decode image from memory, without copying the encoded buffer
+    void decode(const char *data, const size_t &size)
+      {
+	cv::Mat vdat(1,static_cast<int>(size),CV_8UC1,const_cast<char*>(data));
+	int flags = _unchanged_data ? CV_LOAD_IMAGE_UNCHANGED :
+	  (_bw ? CV_LOAD_IMAGE_GRAYSCALE : CV_LOAD_IMAGE_COLOR);
+#if CV_MAJOR_VERSION >= 3
+	int orows = 0, ocols = 0;
+	int f = 1;
+	if (_reduced_decode && !_unchanged_data && jpeg_size(data,size,orows,ocols))
+	  f = reduction_factor(orows,ocols);
+	if (f > 1)
+	  {
+	    // DCT domain downscaling by libjpeg, then a cheap resize to the exact target
+	    if (f == 8)
+	      flags = _bw ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8;
+	    else if (f == 4)
+	      flags = _bw ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4;
+	    else flags = _bw ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2;
+	    cv::Mat img = cv::imdecode(vdat,flags);
+	    if ((img.rows > img.cols) != (orows > ocols) && orows != ocols)
+	      std::swap(orows,ocols); // EXIF orientation applied
+	    resize_push(img,orows,ocols,CV_INTER_AREA);
+	    return;
+	  }
+#endif
+	cv::Mat img = cv::imdecode(vdat,flags);
+	resize_push(img);
+      }
+
+    // resize, crop and store image
+    void resize_push(const cv::Mat &img)
+      {
+	resize_push(img,img.rows,img.cols,CV_INTER_CUBIC);
+      }
+
+    // resize, crop and store image, reporting the original image size
+    void resize_push(const cv::Mat &img, const int &orows, const int &ocols,
+		     const int &interp)
+      {
+	_imgs_size.push_back(std::pair<int,int>(orows,ocols));
     cv::Mat rimg;
-	if (_scaled)
-	  scale(img, rimg);
+	if (img.empty())
+	  rimg = img;
+	else if (_scaled)
+	  scale(img, rimg, interp);
 	else if (_width == 0 || _height == 0) {
 		if (_width == 0 && _height == 0) {
 			// XXX - Do nothing and keep native resolution. May cause issues if batched images are different resolutions
@@ -97,21 +217,21 @@ namespace dd
 			// XXX - This may cause issues if batch images are different resolutions
 			size_t currMaxDim = std::max(img.rows, img.cols);
 			double scale = static_cast<double>(std::max(_width, _height)) / static_cast<double>(currMaxDim);
-			cv::resize(img,rimg,cv::Size(),scale,scale,CV_INTER_CUBIC);
+			cv::resize(img,rimg,cv::Size(),scale,scale,interp);
 		}
 	} else {
 		// Resize normally to the specified width and height
-		cv::resize(img,rimg,cv::Size(_width,_height),0,0,CV_INTER_CUBIC);
+		cv::resize(img,rimg,cv::Size(_width,_height),0,0,interp);
 	}
 
-	if (_crop_width != 0 && _crop_height != 0) {
+	if (!rimg.empty() && _crop_width != 0 && _crop_height != 0) {
 		int widthBorder = (_width - _crop_width)/2;
 		int heightBorder = (_height - _crop_height)/2;
 		rimg = rimg(cv::Rect(widthBorder, heightBorder, _crop_width, _crop_height));
 	}
 	_imgs.push_back(rimg);
       }
-    
+
     // deserialize image, independent of format
     void deserialize(std::stringstream &input)
       {
@@ -129,6 +249,31 @@ namespace dd
     // data acquisition
     int read_file(const std::string &fname)
     {
+      if (_reduced_decode && !_unchanged_data)
+	{
+	  // encoded content is needed to pick the JPEG reduction factor
+	  std::ifstream ifs(fname,std::ios::binary);
+	  std::string content((std::istreambuf_iterator<char>(ifs)),std::istreambuf_iterator<char>());
+	  if (content.empty())
+	    {
+	      _logger->error("empty image {}",fname);
+	      return -1;
+	    }
+	  try
+	    {
+	      decode(content);
+	    }
+	  catch(...)
+	    {
+	      throw InputConnectorBadParamException("failed resizing image " + fname);
+	    }
+	  if (_imgs.back().empty())
+	    {
+	      _logger->error("empty image {}",fname);
+	      return -1;
+	    }
+	  return 0;
+	}
       cv::Mat img = cv::imread(fname, _unchanged_data ? CV_LOAD_IMAGE_UNCHANGED :
                                (_bw ? CV_LOAD_IMAGE_GRAYSCALE : CV_LOAD_IMAGE_COLOR));
       if (img.empty())
@@ -189,9 +334,7 @@ namespace dd
 	{
 	  std::string ccontent;
 	  Base64::Decode(content,&ccontent);
-	  std::stringstream sstr;
-	  sstr << ccontent;
-	  deserialize(sstr);
+	  decode(ccontent);
 	}
       else
 	{
@@ -202,6 +345,25 @@ namespace dd
       return 0;
     }
 
+    // binary element, i.e. raw encoded image or float tensor (HWC)
+    int read_bin(const BinaryEl &bel)
+    {
+      if (bel.is_tensor())
+	{
+	  int h = bel._shape.at(0), w = bel._shape.at(1), c = bel._shape.at(2);
+	  if (c > CV_CN_MAX)
+	    throw InputConnectorBadParamException("too many channels in tensor " + bel._id);
+	  cv::Mat tmat(h,w,CV_32FC(c),const_cast<char*>(bel.data()));
+	  resize_push(tmat);
+	  if (_imgs.back().datastart == tmat.datastart)
+	    _imgs.back() = _imgs.back().clone(); // request body does not outlive the call
+	}
+      else decode(bel.data(),bel._size);
+      if (_imgs.at(0).empty())
+	return -1;
+      return 0;
+    }
+
     int read_dir(const std::string &dir)
     {
       // list directories in dir
@@ -312,6 +474,7 @@ namespace dd
     bool _scaled = false;
     int _scale_min = 600;
     int _scale_max = 1000;
+    bool _reduced_decode = false; /**< whether to decode JPEG at reduced resolution when larger than needed. */
     std::string _db_fname;
     std::shared_ptr<spdlog::logger> _logger;
   };
@@ -320,14 +483,16 @@ namespace dd
   {
   public:
   ImgInputFileConn()
-    :InputConnectorStrategy(){}
+    :InputConnectorStrategy(){ _accepts_binary = true; }
     ImgInputFileConn(const ImgInputFileConn &i)
       :InputConnectorStrategy(i),
       _width(i._width),_height(i._height),
       _crop_width(i._crop_width),_crop_height(i._crop_height),
       _bw(i._bw),_unchanged_data(i._unchanged_data),
       _mean(i._mean),_has_mean_scalar(i._has_mean_scalar),
-      _scaled(i._scaled), _scale_min(i._scale_min), _scale_max(i._scale_max) {}
+      _scaled(i._scaled), _scale_min(i._scale_min), _scale_max(i._scale_max),
+      _float_tensors(i._float_tensors), _reduced_decode(i._reduced_decode)
+      { _accepts_binary = true; }
     ~ImgInputFileConn() {}
 
     void init(const APIData &ad)
@@ -379,6 +544,10 @@ namespace dd
 	_scale_min = ad.get("scale_min").get<int>();
       if (ad.has("scale_max"))
 	_scale_max = ad.get("scale_max").get<int>();
+
+      // JPEG decoding at reduced resolution
+      if (ad.has("reduced_decode"))
+	_reduced_decode = ad.get("reduced_decode").get<bool>();
     }
     
     int feature_size() const
@@ -411,10 +580,10 @@ namespace dd
       
       if (ad.has("parameters")) // hotplug of parameters, overriding the defaults
 	{
-	  APIData ad_param = ad.getobj("parameters");
+	  const APIData &ad_param = ad.getobj_ref("parameters");
 	  if (ad_param.has("input"))
 	    {
-	      fillup_parameters(ad_param.getobj("input"));
+	      fillup_parameters(ad_param.getobj_ref("input"));
 	    }
 	}
       int catch_read = 0;
@@ -436,9 +605,21 @@ namespace dd
 	  dimg._ctype._scaled = _scaled;
 	  dimg._ctype._scale_min = _scale_min;
 	  dimg._ctype._scale_max = _scale_max;
+	  dimg._ctype._reduced_decode = _reduced_decode;
 	  try
 	    {
-	      if (dimg.read_element(u,this->_logger))
+	      if (_bdata)
+		{
+		  if (_bdata->at(i).is_tensor() && !_float_tensors)
+		    throw InputConnectorBadParamException("tensor data is not supported by this backend");
+		  dimg._ctype._logger = this->_logger;
+		  if (dimg._ctype.read_bin(_bdata->at(i)))
+		    {
+		      _logger->error("no data for image {}",u);
+		      no_img = true;
+		    }
+		}
+	      else if (dimg.read_element(u,this->_logger))
 		{
 		  _logger->error("no data for image {}",u);
 		  no_img = true;
@@ -473,7 +654,7 @@ namespace dd
 	      _test_labels.insert(_test_labels.end(),
 	      std::make_move_iterator(dimg._ctype._labels.begin()),
 	      std::make_move_iterator(dimg._ctype._labels.end()));
-	    if (!dimg._ctype._b64 && dimg._ctype._imgs.size() == 1)
+	    if (_bdata || (!dimg._ctype._b64 && dimg._ctype._imgs.size() == 1))
 	      uris.push_back(u);
 	    else if (!dimg._ctype._img_files.empty())
 	      uris.insert(uris.end(),
@@ -550,6 +731,8 @@ namespace dd
     bool _scaled = false;
     int _scale_min = 600;
     int _scale_max = 1000;
+    bool _float_tensors = false; /**< whether the backend accepts float tensors as binary data. */
+    bool _reduced_decode = false; /**< whether to decode JPEG at reduced resolution when larger than needed. */
   };
 }
 
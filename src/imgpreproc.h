@@ -0,0 +1,171 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2019 Jolibrain
+ * Author: Emmanuel Benazera <beniz@droidnik.fr>
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMGPREPROC_H
+#define IMGPREPROC_H
+
+#include <opencv2/core/core.hpp>
+#include <cstddef>
+#include <cstdint>
+
+namespace dd
+{
+  /**
+   * \brief fused conversion of a resized image into network input: channel reordering,
+   *        mean subtraction, scaling and layout change are done in a single pass over
+   *        the pixels, writing floats straight into the destination buffer.
+   *        Inner loops are vectorized with OpenMP simd.
+   */
+  class ImgPreproc
+  {
+  public:
+    /**
+     * \brief conversion parameters
+     */
+    class Params
+    {
+    public:
+      bool _chw = true; /**< planar output (Caffe, NCNN), otherwise interleaved (TF). */
+      bool _swap_rb = false; /**< reverse the first three channels, e.g. BGR to RGB. */
+      const float *_mean = nullptr; /**< per channel mean in source channel order, if any. */
+      const float *_mean_img = nullptr; /**< per element mean in output CHW layout, overrides _mean. */
+      float _scale = 1.0; /**< applied after mean subtraction. */
+      size_t _cstep = 0; /**< distance between output planes in floats, 0 for rows*cols. */
+    };
+
+    /**
+     * \brief converts an 8 bits or float image
+     * @param img interleaved image, CV_8U or CV_32F with any number of channels
+     * @param out destination, at least channels*rows*cols floats (or channels*cstep)
+     * @param p conversion parameters
+     * @return false if the image depth is not supported
+     */
+    static bool convert(const cv::Mat &img, float *out, const Params &p)
+    {
+      if (img.depth() == CV_8U)
+	convert(img.ptr<uint8_t>(0),img.step[0],img.rows,img.cols,img.channels(),out,p);
+      else if (img.depth() == CV_32F)
+	convert(img.ptr<float>(0),img.step[0],img.rows,img.cols,img.channels(),out,p);
+      else return false;
+      return true;
+    }
+
+    /**
+     * \brief converts raw interleaved pixels
+     * @param src first pixel
+     * @param step bytes per source row
+     * @param rows image height
+     * @param cols image width
+     * @param channels channels per pixel
+     * @param out destination
+     * @param p conversion parameters
+     */
+    template <typename T>
+      static void convert(const T *src, const size_t &step,
+			  const int &rows, const int &cols, const int &channels,
+			  float *out, const Params &p)
+      {
+	size_t cstep = p._cstep > 0 ? p._cstep : static_cast<size_t>(rows)*cols;
+	float m[CV_CN_MAX];
+	int sc[CV_CN_MAX];
+	for (int c=0;c<channels;c++)
+	  {
+	    sc[c] = (p._swap_rb && channels >= 3 && c < 3) ? 2-c : c; // source channel
+	    m[c] = p._mean ? p._mean[sc[c]] : 0.0f;
+	  }
+	const float scale = p._scale;
+
+	for (int h=0;h<rows;h++)
+	  {
+	    const T *row = reinterpret_cast<const T*>(reinterpret_cast<const char*>(src) + h*step);
+	    if (!p._chw)
+	      {
+		float *o = out + static_cast<size_t>(h)*cols*channels;
+		if (channels == 3)
+		  {
+		    const int s0 = sc[0], s1 = sc[1], s2 = sc[2];
+		    const float m0 = m[0], m1 = m[1], m2 = m[2];
+#pragma omp simd
+		    for (int w=0;w<cols;w++)
+		      {
+			o[3*w] = (row[3*w+s0] - m0) * scale;
+			o[3*w+1] = (row[3*w+s1] - m1) * scale;
+			o[3*w+2] = (row[3*w+s2] - m2) * scale;
+		      }
+		  }
+		else
+		  for (int c=0;c<channels;c++)
+		    {
+		      const int s = sc[c];
+		      const float mc = m[c];
+#pragma omp simd
+		      for (int w=0;w<cols;w++)
+			o[w*channels+c] = (row[w*channels+s] - mc) * scale;
+		    }
+		continue;
+	      }
+
+	    size_t off = static_cast<size_t>(h)*cols;
+	    if (p._mean_img)
+	      {
+		for (int c=0;c<channels;c++)
+		  {
+		    float *o = out + c*cstep + off;
+		    const float *mi = p._mean_img + static_cast<size_t>(c)*rows*cols + off;
+		    const int s = sc[c];
+#pragma omp simd
+		    for (int w=0;w<cols;w++)
+		      o[w] = (row[w*channels+s] - mi[w]) * scale;
+		  }
+	      }
+	    else if (channels == 3)
+	      {
+		// single pass over interleaved pixels, writing three planes
+		float *o0 = out + off, *o1 = out + cstep + off, *o2 = out + 2*cstep + off;
+		const int s0 = sc[0], s1 = sc[1], s2 = sc[2];
+		const float m0 = m[0], m1 = m[1], m2 = m[2];
+#pragma omp simd
+		for (int w=0;w<cols;w++)
+		  {
+		    o0[w] = (row[3*w+s0] - m0) * scale;
+		    o1[w] = (row[3*w+s1] - m1) * scale;
+		    o2[w] = (row[3*w+s2] - m2) * scale;
+		  }
+	      }
+	    else
+	      {
+		for (int c=0;c<channels;c++)
+		  {
+		    float *o = out + c*cstep + off;
+		    const int s = sc[c];
+		    const float mc = m[c];
+#pragma omp simd
+		    for (int w=0;w<cols;w++)
+		      o[w] = (row[w*channels+s] - mc) * scale;
+		  }
+	      }
+	  }
+      }
+  };
+
+}
+
+#endif
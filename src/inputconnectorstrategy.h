@@ -27,6 +27,7 @@
 #include "utils/httpclient.hpp"
 #include <spdlog/spdlog.h>
 #include <exception>
+#include <functional>
 
 namespace dd
 {
@@ -152,6 +153,18 @@ namespace dd
      */
     void get_data(const APIData &ad)
     {
+      _bdata = ad.binary_data();
+      if (_bdata)
+	{
+	  if (!_accepts_binary)
+	    throw InputConnectorBadParamException("binary data is not supported by this input connector");
+	  _uris.clear();
+	  for (const BinaryEl &bel: *_bdata)
+	    _uris.push_back(bel._id);
+	  if (_uris.empty())
+	    throw InputConnectorBadParamException("missing data");
+	  return;
+	}
       try
 	{
 	  _uris = ad.get("data").get<std::vector<std::string>>();
@@ -181,8 +194,11 @@ namespace dd
     bool _shuffle = false; /**< whether to shuffle the dataset, usually before splitting. */
 
     std::vector<std::string> _uris;
+    std::shared_ptr<const BinaryData> _bdata; /**< binary data elements, replacing uris when set. */
+    bool _accepts_binary = false; /**< whether the connector reads binary data elements. */
     std::string _model_repo; /**< model repository, useful when connector needs to read from saved data (e.g. vocabulary). */
     std::shared_ptr<spdlog::logger> _logger;
+    std::function<void(const std::string&,const double&)> _add_meas; /**< reports data preparation measures to the training job, when set. */
   };
   
 }
@@ -336,10 +336,11 @@ namespace dd
     jhead.AddMember("branch",JVal().SetString(GIT_BRANCH,jinfo.GetAllocator()),jinfo.GetAllocator());
     jhead.AddMember("commit",JVal().SetString(GIT_COMMIT_HASH,jinfo.GetAllocator()),jinfo.GetAllocator());
     JVal jservs(rapidjson::kArrayType);
-    auto hit = _mlservices.begin();
-    while(hit!=_mlservices.end())
+    std::shared_ptr<const mls_map_type> mlservices = services_snapshot();
+    auto hit = mlservices->begin();
+    while(hit!=mlservices->end())
       {
-	APIData ad = mapbox::util::apply_visitor(visitor_info(status),(*hit).second);
+	APIData ad = mapbox::util::apply_visitor(visitor_info(status),*(*hit).second);
 	JVal jserv(rapidjson::kObjectType);
 	ad.toJVal(jinfo,jserv);
 	jservs.PushBack(jserv,jinfo.GetAllocator());
@@ -653,10 +654,10 @@ namespace dd
   {
     if (sname.empty())
       return dd_service_not_found_1002();
-    if (!this->service_exists(sname))
+    std::shared_ptr<mls_variant_type> mls = this->get_service(sname);
+    if (!mls)
       return dd_not_found_404();
-    auto hit = this->get_service_it(sname);
-    APIData ad = mapbox::util::apply_visitor(visitor_status(),(*hit).second);
+    APIData ad = mapbox::util::apply_visitor(visitor_status(),*mls);
     JDoc jst = dd_ok_200();
     JVal jbody(rapidjson::kObjectType);
     ad.toJVal(jst,jbody);
@@ -713,7 +714,10 @@ namespace dd
     return dd_not_found_404();
   }
 
-  JDoc JsonAPI::service_predict(const std::string &jstr)
+  JDoc JsonAPI::service_predict(const std::string &jstr,
+			       const std::shared_ptr<const BinaryData> &bdata,
+			       std::string *bout,
+			       APIData *sout)
   {
     rapidjson::Document d;
     d.Parse(jstr.c_str());
@@ -752,6 +756,8 @@ namespace dd
       {
 	return dd_bad_request_400();
       }
+    if (bdata)
+      ad_data.set_binary_data(bdata);
     
     // prediction
     APIData out;
@@ -794,9 +800,44 @@ namespace dd
 	return dd_internal_mllib_error_1007(e.what());
       }
     JDoc jpred = dd_ok_200();
+    bool has_measure = ad_data.getobj_ref("parameters").getobj_ref("output").has("measure");
+    if (bout && !has_measure
+	&& !ad_data.getobj_ref("parameters").getobj_ref("output").has("template")
+	&& !ad_data.getobj_ref("parameters").getobj_ref("output").has("network")
+	&& !out.has("run_metadata")
+	&& render_binary(out,*bout) == 0)
+      {
+	// binary response, only the head is kept for logging
+	JVal jhead(rapidjson::kObjectType);
+	jhead.AddMember("method","/predict",jpred.GetAllocator());
+	jhead.AddMember("service",d["service"],jpred.GetAllocator());
+	jpred.AddMember("head",jhead,jpred.GetAllocator());
+	return jpred;
+      }
+    if (bout)
+      bout->clear();
+    if (sout && !has_measure
+	&& !ad_data.getobj_ref("parameters").getobj_ref("output").has("template")
+	&& !ad_data.getobj_ref("parameters").getobj_ref("output").has("network"))
+      {
+	// body is handed over to the caller for serialization, predictions are not copied
+	JVal jhead(rapidjson::kObjectType);
+	jhead.AddMember("method","/predict",jpred.GetAllocator());
+	jhead.AddMember("service",d["service"],jpred.GetAllocator());
+	if (out.has("time"))
+	  jhead.AddMember("time",JVal(out.get("time").get<double>()),jpred.GetAllocator());
+	jpred.AddMember("head",jhead,jpred.GetAllocator());
+	sout->_data.clear();
+	auto hit = out._data.find("predictions");
+	if (hit != out._data.end())
+	  sout->_data.insert(std::move(*hit));
+	hit = out._data.find("run_metadata");
+	if (hit != out._data.end())
+	  sout->_data.insert(std::move(*hit));
+	return jpred;
+      }
     JVal jout(rapidjson::kObjectType);
     out.toJVal(jpred,jout);
-    bool has_measure = ad_data.getobj("parameters").getobj("output").has("measure");
     JVal jhead(rapidjson::kObjectType);
     jhead.AddMember("method","/predict",jpred.GetAllocator());
     jhead.AddMember("service",d["service"],jpred.GetAllocator());
@@ -811,15 +852,17 @@ namespace dd
     JVal jbody(rapidjson::kObjectType);
     if (jout.HasMember("predictions"))
       jbody.AddMember("predictions",jout["predictions"],jpred.GetAllocator());
+    if (jout.HasMember("run_metadata"))
+      jbody.AddMember("run_metadata",jout["run_metadata"],jpred.GetAllocator());
     jpred.AddMember("body",jbody,jpred.GetAllocator());
-    if (ad_data.getobj("parameters").getobj("output").has("template")
-        && ad_data.getobj("parameters").getobj("output").get("template").get<std::string>() != "")
+    if (ad_data.getobj_ref("parameters").getobj_ref("output").has("template")
+        && ad_data.getobj_ref("parameters").getobj_ref("output").get("template").get<std::string>() != "")
       {
 	APIData ad_params = ad_data.getobj("parameters");
 	APIData ad_output = ad_params.getobj("output");
 	jpred.AddMember("template",JVal().SetString(ad_output.get("template").get<std::string>().c_str(),jpred.GetAllocator()),jpred.GetAllocator());
       }
-    if (ad_data.getobj("parameters").getobj("output").has("network"))
+    if (ad_data.getobj_ref("parameters").getobj_ref("output").has("network"))
       {
 	APIData ad_params = ad_data.getobj("parameters");
 	APIData ad_output = ad_params.getobj("output");
@@ -831,6 +874,71 @@ namespace dd
     return jpred;
   }
 
+  int JsonAPI::render_binary(const APIData &out, std::string &bout)
+  {
+    auto put_u32 = [&bout](const uint32_t &v)
+      {
+	bout.append(reinterpret_cast<const char*>(&v),sizeof(uint32_t));
+      };
+    auto put_str = [&bout,&put_u32](const std::string &str)
+      {
+	put_u32(static_cast<uint32_t>(str.size()));
+	bout.append(str);
+      };
+    bout.clear();
+    try
+      {
+	std::vector<APIData> preds = out.getv("predictions");
+	bout.append("DDB1",4);
+	put_u32(static_cast<uint32_t>(preds.size()));
+	for (const APIData &p: preds)
+	  {
+	    put_str(p.get("uri").get<std::string>());
+	    std::vector<float> vals;
+	    std::vector<std::string> cats;
+	    if (p.has("classes"))
+	      {
+		for (const APIData &c: p.getv("classes"))
+		  {
+		    if (c.has("bbox") || c.has("mask"))
+		      {
+			bout.clear();
+			return 1;
+		      }
+		    vals.push_back(static_cast<float>(c.get("prob").get<double>()));
+		    cats.push_back(c.get("cat").get<std::string>());
+		  }
+	      }
+	    else if (p.has("vector"))
+	      {
+		for (const APIData &v: p.getv("vector"))
+		  vals.push_back(static_cast<float>(v.get("val").get<double>()));
+	      }
+	    else if (p.has("vals"))
+	      {
+		std::vector<double> dvals = p.get("vals").get<std::vector<double>>();
+		vals.assign(dvals.begin(),dvals.end());
+	      }
+	    else
+	      {
+		bout.clear();
+		return 1;
+	      }
+	    put_u32(static_cast<uint32_t>(vals.size()));
+	    bout.append(reinterpret_cast<const char*>(vals.data()),vals.size()*sizeof(float));
+	    put_u32(static_cast<uint32_t>(cats.size()));
+	    for (const std::string &c: cats)
+	      put_str(c);
+	  }
+      }
+    catch (std::exception &e)
+      {
+	bout.clear();
+	return 1;
+      }
+    return 0;
+  }
+
   JDoc JsonAPI::service_train(const std::string &jstr)
   {
     rapidjson::Document d;
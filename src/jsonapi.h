@@ -94,7 +94,29 @@ namespace dd
     JDoc service_delete(const std::string &sname,
 			const std::string &jstr);
     
-    JDoc service_predict(const std::string &jstr);
+    /**
+     * \brief prediction call
+     * @param jstr JSON call
+     * @param bdata binary data elements, if any
+     * @param bout if set, receives predictions as packed binary when possible
+     * @param sout if set, receives the response body instead of the returned
+     *        document, for direct serialization by the caller
+     */
+    JDoc service_predict(const std::string &jstr,
+			 const std::shared_ptr<const BinaryData> &bdata=nullptr,
+			 std::string *bout=nullptr,
+			 APIData *sout=nullptr);
+
+    /**
+     * \brief packs predictions into a binary response, little-endian:
+     *        "DDB1", uint32 number of predictions, then for each prediction
+     *        uint32 uri length and uri, uint32 n and n float32 probabilities (or values),
+     *        uint32 m and m categories as uint32 length and string.
+     * @param out predict output data object
+     * @param bout binary response
+     * @return 0 if OK, 1 if predictions cannot be packed (e.g. bounding boxes)
+     */
+    static int render_binary(const APIData &out, std::string &bout);
 
     JDoc service_train(const std::string &jstr);
     JDoc service_train_status(const std::string &jstr);
@@ -328,6 +328,26 @@ namespace dd
       }
     }
 
+    /**
+     * \brief collects intermediate results of a running training job, if any
+     * @param ad_out data object for "parameters/output" of the status call
+     * @param out status data object
+     */
+    void collect_intermediate_results(const APIData &ad_out, APIData &out) const
+    {
+      (void)ad_out;
+      (void)out;
+    }
+
+    /**
+     * \brief adds library runtime statistics to the service info, if any
+     * @param ad service info data object
+     */
+    void lib_stats(APIData &ad) const
+    {
+      (void)ad;
+    }
+
     TInputConnectorStrategy _inputc; /**< input connector strategy for channeling data in. */
     TOutputConnectorStrategy _outputc; /**< output connector strategy for passing results back to API. */
 
@@ -108,8 +108,27 @@ namespace dd
     {
       if (!_se)
 	{
-	  _se = new SearchEngine<AnnoySE>(dim,_repo);
-	  _se->_tse->_map_populate = _index_preload;
+	  if (_index_type == "hnsw")
+	    {
+	      SearchEngine<HnswSE> *hse = new SearchEngine<HnswSE>(dim,_repo);
+	      if (_index_storage == "int8")
+		hse->_tse->_storage = HnswStorage::int8;
+	      else if (_index_storage == "pq")
+		hse->_tse->_storage = HnswStorage::pq;
+	      if (_index_pq_subspaces > 0)
+		hse->_tse->_pq_m = _index_pq_subspaces;
+	      if (_index_pq_train_size > 0)
+		hse->_tse->_pq_train_size = _index_pq_train_size;
+	      if (_index_rerank >= 0)
+		hse->_tse->_rerank = _index_rerank;
+	      _se = hse;
+	    }
+	  else
+	    {
+	      SearchEngine<AnnoySE> *ase = new SearchEngine<AnnoySE>(dim,_repo);
+	      ase->_tse->_map_populate = _index_preload;
+	      _se = ase;
+	    }
 	  _se->create_index();
 	}
     }
@@ -149,8 +168,13 @@ namespace dd
     std::string _best_model_filename = "/best_model.txt";
     
 #ifdef USE_SIMSEARCH
-    SearchEngine<AnnoySE> *_se = nullptr;
+    SearchEngineBase *_se = nullptr;
     bool _index_preload = false;
+    std::string _index_type = "annoy"; /**< similarity search index, annoy or hnsw. */
+    std::string _index_storage = "float32"; /**< hnsw vector storage, float32, int8 or pq. */
+    int _index_pq_subspaces = -1; /**< pq subspaces, defaults to dim/4. */
+    int _index_pq_train_size = -1; /**< number of first indexed vectors the pq codebook is trained on. */
+    int _index_rerank = -1; /**< re-ranking candidates multiplier with compressed storage. */
 #endif
 
   private:
@@ -169,6 +193,26 @@ namespace dd
 #ifdef USE_SIMSEARCH
       if (ad.has("index_preload") && ad.get("index_preload").get<bool>())
 	_index_preload = true;
+      if (ad.has("index_type"))
+	{
+	  _index_type = ad.get("index_type").get<std::string>();
+	  if (_index_type != "annoy" && _index_type != "hnsw")
+	    throw MLLibBadParamException("unknown index_type " + _index_type + ", expected annoy or hnsw");
+	}
+      if (ad.has("index_storage"))
+	{
+	  _index_storage = ad.get("index_storage").get<std::string>();
+	  if (_index_storage != "float32" && _index_storage != "int8" && _index_storage != "pq")
+	    throw MLLibBadParamException("unknown index_storage " + _index_storage + ", expected float32, int8 or pq");
+	  if (_index_storage != "float32" && _index_type != "hnsw")
+	    throw MLLibBadParamException("compressed index_storage requires index_type hnsw");
+	}
+      if (ad.has("index_pq_subspaces"))
+	_index_pq_subspaces = ad.get("index_pq_subspaces").get<int>();
+      if (ad.has("index_pq_train_size"))
+	_index_pq_train_size = ad.get("index_pq_train_size").get<int>();
+      if (ad.has("index_rerank"))
+	_index_rerank = ad.get("index_rerank").get<int>();
 #endif
       // auto-install from model archive
       if (ad.has("init"))
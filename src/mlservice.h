@@ -24,6 +24,7 @@
 
 #include "mllibstrategy.h"
 #include "mlmodel.h"
+#include "predictbatcher.h"
 #include <string>
 #include <future>
 #include <mutex>
@@ -97,7 +98,7 @@ namespace dd
      * @param mls ML service
      */
     MLService(MLService &&mls) noexcept
-      :TMLLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>(std::move(mls)),_sname(std::move(mls._sname)),_description(std::move(mls._description)),_init_parameters(std::move(mls._init_parameters)),_tjobs_counter(mls._tjobs_counter.load()),_training_jobs(std::move(mls._training_jobs))
+      :TMLLib<TInputConnectorStrategy,TOutputConnectorStrategy,TMLModel>(std::move(mls)),_sname(std::move(mls._sname)),_description(std::move(mls._description)),_init_parameters(std::move(mls._init_parameters)),_tjobs_counter(mls._tjobs_counter.load()),_training_jobs(std::move(mls._training_jobs)),_batcher(std::move(mls._batcher))
       {}
     
     /**
@@ -129,6 +130,27 @@ namespace dd
       this->_outputc.init(_init_parameters.getobj("output"));
       this->init_mllib(_init_parameters.getobj("mllib"));
       this->fillup_measures_history(ad);
+      init_batcher(_init_parameters.getobj("mllib"));
+    }
+
+    /**
+     * \brief sets up dynamic batching of concurrent predict calls, if requested
+     * @param ad data object for "parameters/mllib"
+     */
+    void init_batcher(const APIData &ad)
+    {
+      int max_batch_size = 1;
+      if (ad.has("max_batch_size"))
+	max_batch_size = ad.get("max_batch_size").get<int>();
+      if (max_batch_size <= 1)
+	return;
+      int max_wait_us = 1000;
+      if (ad.has("max_wait_us"))
+	max_wait_us = ad.get("max_wait_us").get<int>();
+      if (max_wait_us < 0)
+	throw MLLibBadParamException("max_wait_us must be positive");
+      _batcher = std::unique_ptr<PredictBatcher>(new PredictBatcher(max_batch_size,max_wait_us));
+      this->_logger->info("dynamic batching of predict calls: max_batch_size={} / max_wait_us={}",max_batch_size,max_wait_us);
     }
 
     /**
@@ -170,6 +192,9 @@ namespace dd
 	    ad.add("predict",true);
 	  else ad.add("training",true);
 	  ad.add("mltype",this->_mltype);
+	  if (_batcher)
+	    ad.add("batching",_batcher->stats());
+	  this->lib_stats(ad);
 	}
       else
 	{
@@ -284,7 +309,7 @@ namespace dd
 	    boost::unique_lock< boost::shared_mutex > lock(_train_mutex);
 	    int status = this->train(ad,out);
 	    //this->collect_measures(out);
-	    APIData ad_params_out = ad.getobj("parameters").getobj("output");
+	    const APIData &ad_params_out = ad.getobj_ref("parameters").getobj_ref("output");
 	    if (ad_params_out.has("measure_hist") && ad_params_out.get("measure_hist").get<bool>())
 	      this->collect_measures_history(out);
 	    return status;
@@ -303,7 +328,7 @@ namespace dd
       int secs = 0;
       if (ad.has("timeout"))
 	secs = ad.get("timeout").get<int>();
-      APIData ad_params_out = ad.getobj("parameters").getobj("output");
+      const APIData &ad_params_out = ad.getobj_ref("parameters").getobj_ref("output");
       std::lock_guard<std::mutex> lock(_tjobs_mutex);
       std::unordered_map<int,tjob>::iterator hit;
       if ((hit=_training_jobs.find(j))!=_training_jobs.end())
@@ -323,6 +348,7 @@ namespace dd
 	      if (ad_params_out.has("max_hist_points"))
 		max_hist_points = ad_params_out.get("max_hist_points").get<int>();
 	      this->collect_measures_history(out,max_hist_points);
+	      this->collect_intermediate_results(ad_params_out,out);
 	    }
 	  else if (status == std::future_status::ready)
 	    {
@@ -412,12 +438,26 @@ namespace dd
     }
 
     /**
-     * \brief starts a predict job, makes sure no training call is running.
+     * \brief starts a predict job, possibly merged with concurrent calls when batching is on
      * @param ad root data object
      * @param out output data object
      * @return predict job status
      */
     int predict_job(const APIData &ad, APIData &out)
+    {
+      if (_batcher)
+	return _batcher->predict(ad,out,[this](const APIData &bad, APIData &bout)
+				 { return this->predict_job_locked(bad,bout); });
+      return predict_job_locked(ad,out);
+    }
+
+    /**
+     * \brief runs a predict call under the training lock
+     * @param ad root data object
+     * @param out output data object
+     * @return predict job status
+     */
+    int predict_job_locked(const APIData &ad, APIData &out)
     {
       if (!this->_online)
 	{
@@ -454,6 +494,8 @@ namespace dd
     std::unordered_map<int,APIData> _training_out;
 
     boost::shared_mutex _train_mutex;
+
+    std::unique_ptr<PredictBatcher> _batcher; /**< optional batching of concurrent predict calls. */
   };
   
 }
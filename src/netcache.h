@@ -0,0 +1,145 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2019 Jolibrain
+ * Author: Emmanuel Benazera <beniz@droidnik.fr>
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETCACHE_H
+#define NETCACHE_H
+
+#include "apidata.h"
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace dd
+{
+  /**
+   * \brief least recently used cache of instantiated nets, keyed by input shape,
+   *        so that alternating input shapes do not trigger a net re-instantiation
+   *        on every call. Nets are handed out as shared pointers, an evicted net
+   *        lives on until the calls using it return.
+   */
+  template <class TKey, class TNet>
+  class NetCache
+  {
+  public:
+    typedef std::function<std::shared_ptr<TNet>()> create_func;
+
+    /**
+     * \brief cache constructor
+     * @param capacity max number of cached nets
+     */
+    NetCache(const int &capacity=4)
+      :_capacity(capacity) {}
+    ~NetCache() {}
+
+    /**
+     * \brief gets the net for a shape, instantiating it as needed
+     * @param key input shape
+     * @param create instantiates a net for the shape, called outside the cache lock
+     * @return net for the shape
+     */
+    std::shared_ptr<TNet> get(const TKey &key, const create_func &create)
+    {
+      {
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto hit = _index.find(key);
+	if (hit != _index.end())
+	  {
+	    ++_hits;
+	    _items.splice(_items.begin(),_items,(*hit).second);
+	    return (*hit).second->second;
+	  }
+	++_misses;
+      }
+      std::shared_ptr<TNet> net = create();
+      std::lock_guard<std::mutex> lock(_mutex);
+      auto hit = _index.find(key);
+      if (hit != _index.end()) // instantiated by a concurrent call meanwhile
+	return (*hit).second->second;
+      if (_capacity <= 0)
+	return net;
+      _items.emplace_front(key,net);
+      _index[key] = _items.begin();
+      while (static_cast<int>(_items.size()) > _capacity)
+	{
+	  _index.erase(_items.back().first);
+	  _items.pop_back();
+	  ++_evictions;
+	}
+      return net;
+    }
+
+    /**
+     * \brief drops all nets, e.g. when the weights they share change
+     */
+    void clear()
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _items.clear();
+      _index.clear();
+    }
+
+    /**
+     * \brief sets the max number of cached nets
+     */
+    void set_capacity(const int &capacity)
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _capacity = capacity;
+      while (static_cast<int>(_items.size()) > std::max(_capacity,0))
+	{
+	  _index.erase(_items.back().first);
+	  _items.pop_back();
+	  ++_evictions;
+	}
+    }
+
+    /**
+     * \brief cache statistics, reported by service info
+     * @return data object with cache size and hit / miss counters
+     */
+    APIData stats() const
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      APIData ad;
+      ad.add("capacity",_capacity);
+      ad.add("size",static_cast<int>(_items.size()));
+      ad.add("hits",static_cast<double>(_hits));
+      ad.add("misses",static_cast<double>(_misses));
+      ad.add("evictions",static_cast<double>(_evictions));
+      return ad;
+    }
+
+  private:
+    int _capacity = 4; /**< max number of cached nets, 0 for no caching. */
+    std::list<std::pair<TKey,std::shared_ptr<TNet>>> _items; /**< nets, most recently used first. */
+    std::unordered_map<TKey,typename std::list<std::pair<TKey,std::shared_ptr<TNet>>>::iterator> _index; /**< nets per shape. */
+    long int _hits = 0;
+    long int _misses = 0;
+    long int _evictions = 0;
+    mutable std::mutex _mutex; /**< mutex around nets and counters. */
+  };
+
+}
+
+#endif
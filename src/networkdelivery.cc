@@ -0,0 +1,234 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2019 Jolibrain
+ * Author: Emmanuel Benazera <beniz@droidnik.fr>
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "networkdelivery.h"
+#include <curlpp/cURLpp.hpp>
+#include <curlpp/Easy.hpp>
+#include <curlpp/Options.hpp>
+#include <curlpp/Infos.hpp>
+#include <algorithm>
+#include <chrono>
+#include <list>
+#include <sstream>
+
+namespace dd
+{
+
+  NetworkDelivery::NetworkDelivery()
+  {
+  }
+
+  NetworkDelivery::~NetworkDelivery()
+  {
+    stop();
+  }
+
+  void NetworkDelivery::start(const std::shared_ptr<spdlog::logger> &logger,
+			      const int &nworkers,
+			      const int &queue_size,
+			      const int &batch_size,
+			      const int &max_retries,
+			      const int &retry_delay_ms,
+			      const int &timeout_ms)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_running)
+      return;
+    _logger = logger;
+    _queue_size = queue_size;
+    _batch_size = std::max(1,batch_size);
+    _max_retries = std::max(0,max_retries);
+    _retry_delay_ms = std::max(0,retry_delay_ms);
+    _timeout_ms = std::max(0,timeout_ms);
+    _cleanup.reset(new curlpp::Cleanup());
+    _running = true;
+    for (int i=0;i<std::max(1,nworkers);i++)
+      _workers.push_back(std::thread(&NetworkDelivery::worker,this));
+  }
+
+  void NetworkDelivery::stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (!_running)
+	return;
+      _running = false;
+      _dropped += _queue.size();
+      _queue.clear();
+    }
+    _cv.notify_all();
+    _stop_cv.notify_all();
+    for (std::thread &w: _workers)
+      w.join();
+    _workers.clear();
+    _cleanup.reset();
+  }
+
+  bool NetworkDelivery::push(const std::string &url,
+			     const std::string &content,
+			     const std::string &http_method,
+			     const std::string &content_type,
+			     const bool &batchable)
+  {
+    Item it;
+    it._url = url;
+    it._content = content;
+    it._http_method = http_method;
+    it._content_type = content_type;
+    it._batchable = batchable;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (!_running || static_cast<int>(_queue.size()) >= _queue_size)
+	{
+	  ++_rejected;
+	  return false;
+	}
+      _queue.push_back(std::move(it));
+    }
+    _cv.notify_one();
+    return true;
+  }
+
+  APIData NetworkDelivery::stats() const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    APIData ad;
+    ad.add("running",_running);
+    ad.add("workers",static_cast<int>(_workers.size()));
+    ad.add("queue_size",_queue_size);
+    ad.add("queued",static_cast<int>(_queue.size()));
+    ad.add("batch_size",_batch_size);
+    ad.add("posts",static_cast<double>(_posts));
+    ad.add("delivered",static_cast<double>(_delivered));
+    ad.add("failed",static_cast<double>(_failed));
+    ad.add("retries",static_cast<double>(_retries));
+    ad.add("rejected",static_cast<double>(_rejected));
+    ad.add("dropped",static_cast<double>(_dropped));
+    return ad;
+  }
+
+  void NetworkDelivery::worker()
+  {
+    // keep-alive connections, one per destination
+    std::unordered_map<std::string,std::unique_ptr<curlpp::Easy>> easy;
+    while(true)
+      {
+	std::vector<Item> batch;
+	{
+	  std::unique_lock<std::mutex> lock(_mutex);
+	  _cv.wait(lock,[this]{ return !_running || !_queue.empty(); });
+	  if (!_running)
+	    break;
+	  batch.push_back(std::move(_queue.front()));
+	  _queue.pop_front();
+	  if (batch.front()._batchable)
+	    {
+	      auto qit = _queue.begin();
+	      while(qit!=_queue.end() && static_cast<int>(batch.size()) < _batch_size)
+		{
+		  if ((*qit)._batchable && (*qit).same_destination(batch.front()))
+		    {
+		      batch.push_back(std::move(*qit));
+		      qit = _queue.erase(qit);
+		    }
+		  else ++qit;
+		}
+	    }
+	}
+	bool delivered = deliver(batch,easy);
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (delivered)
+	  {
+	    ++_posts;
+	    _delivered += batch.size();
+	  }
+	else _failed += batch.size();
+      }
+  }
+
+  bool NetworkDelivery::deliver(const std::vector<Item> &batch,
+				std::unordered_map<std::string,std::unique_ptr<curlpp::Easy>> &easy)
+  {
+    const Item &dest = batch.front();
+    std::string content;
+    if (batch.size() == 1)
+      content = dest._content;
+    else
+      {
+	content = "[";
+	for (size_t i=0;i<batch.size();i++)
+	  {
+	    if (i > 0)
+	      content += ",";
+	    content += batch.at(i)._content;
+	  }
+	content += "]";
+      }
+
+    for (int attempt=0;;++attempt)
+      {
+	int outcode = 0;
+	std::string error;
+	try
+	  {
+	    std::unique_ptr<curlpp::Easy> &request = easy[dest._url];
+	    if (!request)
+	      request.reset(new curlpp::Easy());
+	    else request->reset(); // options only, the connection is kept alive
+	    std::ostringstream os;
+	    request->setOpt(curlpp::options::Url(dest._url));
+	    request->setOpt(curlpp::options::WriteStream(&os));
+	    request->setOpt(curlpp::options::CustomRequest(dest._http_method));
+	    std::list<std::string> header;
+	    header.push_back(dest._content_type);
+	    request->setOpt(curlpp::options::HttpHeader(header));
+	    request->setOpt(curlpp::options::PostFields(content));
+	    request->setOpt(curlpp::options::PostFieldSize(content.length()));
+	    if (_timeout_ms > 0)
+	      request->setOpt(curlpp::OptionTrait<long,CURLOPT_TIMEOUT_MS>(_timeout_ms));
+	    request->perform();
+	    outcode = curlpp::infos::ResponseCode::get(*request);
+	    if (outcode < 400)
+	      return true;
+	    error = "HTTP status " + std::to_string(outcode);
+	  }
+	catch (std::exception &e)
+	  {
+	    error = e.what();
+	    easy.erase(dest._url); // connection is not reused after a transport error
+	  }
+
+	// transport errors, server errors and throttling are retried
+	bool retry = attempt < _max_retries && (outcode == 0 || outcode >= 500 || outcode == 429);
+	if (!retry)
+	  {
+	    _logger->error("network output connector delivery to {} failed: {}",dest._url,error);
+	    return false;
+	  }
+	std::unique_lock<std::mutex> lock(_mutex);
+	++_retries;
+	std::chrono::milliseconds delay(static_cast<long int>(_retry_delay_ms) << std::min(attempt,10));
+	if (_stop_cv.wait_for(lock,delay,[this]{ return !_running; }))
+	  return false; // stopping
+      }
+  }
+
+}
@@ -0,0 +1,153 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2019 Jolibrain
+ * Author: Emmanuel Benazera <beniz@droidnik.fr>
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETWORKDELIVERY_H
+#define NETWORKDELIVERY_H
+
+#include "apidata.h"
+#include <spdlog/spdlog.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace curlpp
+{
+  class Cleanup;
+  class Easy;
+}
+
+namespace dd
+{
+  /**
+   * \brief background delivery of results to the network output connector
+   *        destinations. Results are queued by the HTTP server threads and
+   *        posted by a pool of workers, each keeping a keep-alive connection
+   *        per destination. Several queued JSON results for the same
+   *        destination are posted together as a JSON array, failed posts are
+   *        retried with exponential backoff.
+   */
+  class NetworkDelivery
+  {
+  public:
+    NetworkDelivery();
+    ~NetworkDelivery();
+
+    /**
+     * \brief starts the delivery workers
+     * @param logger logger for delivery failures
+     * @param nworkers number of workers
+     * @param queue_size max number of pending results
+     * @param batch_size max number of results per post, 1 for no batching
+     * @param max_retries number of retries of a failed post
+     * @param retry_delay_ms delay before the first retry, doubled on every retry
+     * @param timeout_ms max duration of a post, 0 for none
+     */
+    void start(const std::shared_ptr<spdlog::logger> &logger,
+	       const int &nworkers=2,
+	       const int &queue_size=1000,
+	       const int &batch_size=1,
+	       const int &max_retries=3,
+	       const int &retry_delay_ms=100,
+	       const int &timeout_ms=30000);
+
+    /**
+     * \brief stops the workers, pending results are dropped
+     */
+    void stop();
+
+    /**
+     * \brief queues a result for delivery, does not block
+     * @param url destination
+     * @param content result body
+     * @param http_method HTTP method
+     * @param content_type content type header
+     * @param batchable whether the result may be posted along with others, JSON only
+     * @return false if the queue is full or delivery is not running
+     */
+    bool push(const std::string &url,
+	      const std::string &content,
+	      const std::string &http_method="POST",
+	      const std::string &content_type="Content-Type: application/json",
+	      const bool &batchable=true);
+
+    /**
+     * \brief delivery statistics, reported by the /info call
+     * @return data object with queue size and delivery counters
+     */
+    APIData stats() const;
+
+  private:
+    class Item
+    {
+    public:
+      std::string _url;
+      std::string _http_method;
+      std::string _content_type;
+      std::string _content;
+      bool _batchable = true;
+
+      bool same_destination(const Item &it) const
+      {
+	return _url == it._url && _http_method == it._http_method
+	  && _content_type == it._content_type;
+      }
+    };
+
+    void worker();
+
+    /**
+     * \brief posts a batch of results with retries
+     * @param batch results for a single destination
+     * @param easy keep-alive handles per destination, owned by the calling worker
+     * @return true if delivered
+     */
+    bool deliver(const std::vector<Item> &batch,
+		 std::unordered_map<std::string,std::unique_ptr<curlpp::Easy>> &easy);
+
+    std::shared_ptr<spdlog::logger> _logger;
+    std::unique_ptr<curlpp::Cleanup> _cleanup; /**< curl global init, once for all workers. */
+    std::vector<std::thread> _workers;
+    std::deque<Item> _queue; /**< pending results. */
+    mutable std::mutex _mutex; /**< mutex around queue and counters. */
+    std::condition_variable _cv; /**< signals new results and stop. */
+    std::condition_variable _stop_cv; /**< signals stop to retry backoffs. */
+    bool _running = false;
+    int _queue_size = 1000;
+    int _batch_size = 1;
+    int _max_retries = 3;
+    int _retry_delay_ms = 100;
+    int _timeout_ms = 30000;
+    long int _posts = 0; /**< successful posts. */
+    long int _delivered = 0; /**< delivered results. */
+    long int _failed = 0; /**< results dropped after all retries. */
+    long int _retries = 0;
+    long int _rejected = 0; /**< results refused on a full queue. */
+    long int _dropped = 0; /**< results pending at stop. */
+  };
+
+}
+
+#endif
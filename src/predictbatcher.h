@@ -0,0 +1,346 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2019 Jolibrain
+ * Author: Emmanuel Benazera <beniz@droidnik.fr>
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PREDICTBATCHER_H
+#define PREDICTBATCHER_H
+
+#include "apidata.h"
+#include <functional>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dd
+{
+  /**
+   * \brief dynamic batching of concurrent predict calls.
+   *        The first call to arrive opens a batch and waits up to max_wait_us
+   *        for other calls with identical parameters to join, then runs a single
+   *        predict call over the merged data and scatters the predictions back
+   *        to each caller based on their URIs.
+   *        Calls that cannot be merged (measures, binary data, non string data, overlapping
+   *        URIs, ...) simply bypass the batcher.
+   */
+  class PredictBatcher
+  {
+  public:
+    typedef std::function<int(const APIData&,APIData&)> predict_func;
+
+    /**
+     * \brief batcher constructor
+     * @param max_batch_size max number of data elements (URIs) per merged call
+     * @param max_wait_us max time in microseconds a batch waits for other calls
+     */
+    PredictBatcher(const int &max_batch_size, const int &max_wait_us)
+      :_max_batch_size(max_batch_size),_max_wait_us(max_wait_us) {}
+    ~PredictBatcher() {}
+
+    /**
+     * \brief predicts through the batcher
+     * @param ad root data object
+     * @param out output data object
+     * @param pfunc the actual prediction function, called once per merged batch
+     * @return predict status
+     */
+    int predict(const APIData &ad, APIData &out, const predict_func &pfunc)
+    {
+      std::shared_ptr<pjob> job = std::make_shared<pjob>();
+      if (!batchable(ad,job->_data))
+	return pfunc(ad,out);
+      job->_ad = ad;
+      std::string params_key = get_params_key(ad);
+
+      std::unique_lock<std::mutex> lock(_mutex);
+      if (_open && _open->_params_key == params_key
+	  && _open->_nuris + static_cast<int>(job->_data.size()) <= _max_batch_size
+	  && _open->add_job(job))
+	{
+	  // follower: the batch leader runs the merged call
+	  if (_open->_nuris >= _max_batch_size)
+	    _cv.notify_all();
+	  _cv.wait(lock,[&job]{ return job->_done; });
+	  lock.unlock();
+	  if (job->_eptr)
+	    std::rethrow_exception(job->_eptr);
+	  out = std::move(job->_out);
+	  return job->_status;
+	}
+      else if (_open)
+	{
+	  // a batch is already open with incompatible parameters
+	  lock.unlock();
+	  return pfunc(ad,out);
+	}
+
+      // leader: opens a batch and waits for other calls to join
+      std::shared_ptr<pbatch> batch = std::make_shared<pbatch>();
+      batch->_params_key = params_key;
+      batch->add_job(job);
+      _open = batch;
+      std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+	+ std::chrono::microseconds(_max_wait_us);
+      _cv.wait_until(lock,deadline,[this,&batch]{ return batch->_nuris >= _max_batch_size; });
+      if (_open == batch)
+	_open.reset();
+      ++_nbatches;
+      _nrequests += batch->_jobs.size();
+      _nuris += batch->_nuris;
+      if (batch->_nuris > _max_achieved)
+	_max_achieved = batch->_nuris;
+      lock.unlock();
+
+      run_batch(batch,pfunc);
+
+      lock.lock();
+      for (auto j: batch->_jobs)
+	j->_done = true;
+      _cv.notify_all();
+      lock.unlock();
+      if (job->_eptr)
+	std::rethrow_exception(job->_eptr);
+      out = std::move(job->_out);
+      return job->_status;
+    }
+
+    /**
+     * \brief batching statistics, reported by service info
+     * @return data object with achieved batch sizes
+     */
+    APIData stats() const
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      APIData ad;
+      ad.add("max_batch_size",_max_batch_size);
+      ad.add("max_wait_us",_max_wait_us);
+      ad.add("batches",static_cast<double>(_nbatches));
+      ad.add("requests",static_cast<double>(_nrequests));
+      ad.add("avg_batch_size",_nbatches > 0 ? _nuris / static_cast<double>(_nbatches) : 0.0);
+      ad.add("max_achieved_batch_size",_max_achieved);
+      return ad;
+    }
+
+    int _max_batch_size = 1; /**< max number of data elements in a merged call. */
+    int _max_wait_us = 1000; /**< max wait in microseconds before a batch is run. */
+
+  private:
+    /**
+     * \brief a single predict call waiting for its results
+     */
+    class pjob
+    {
+    public:
+      APIData _ad;
+      std::vector<std::string> _data;
+      APIData _out;
+      int _status = 0;
+      std::exception_ptr _eptr;
+      bool _done = false;
+    };
+
+    /**
+     * \brief a set of predict calls merged into a single one
+     */
+    class pbatch
+    {
+    public:
+      /**
+       * \brief adds a call to the batch if none of its URIs collides with the batch's
+       * @param job the call
+       * @return true if the call was added
+       */
+      bool add_job(const std::shared_ptr<pjob> &job)
+      {
+	int j = static_cast<int>(_jobs.size());
+	std::vector<std::pair<std::string,std::string>> keys;
+	for (size_t i=0;i<job->_data.size();i++)
+	  {
+	    // predictions are reported with either the data element itself (e.g. an URL)
+	    // or its position in the data array (e.g. base64 content)
+	    keys.push_back(std::pair<std::string,std::string>(job->_data.at(i),job->_data.at(i)));
+	    keys.push_back(std::pair<std::string,std::string>(std::to_string(_nuris+i),std::to_string(i)));
+	  }
+	for (auto &k: keys)
+	  if (_uris.find(k.first) != _uris.end())
+	    return false;
+	for (auto &k: keys)
+	  _uris.insert(std::pair<std::string,std::pair<int,std::string>>(k.first,std::pair<int,std::string>(j,k.second)));
+	_nuris += job->_data.size();
+	_jobs.push_back(job);
+	return true;
+      }
+
+      std::string _params_key;
+      std::vector<std::shared_ptr<pjob>> _jobs;
+      std::unordered_map<std::string,std::pair<int,std::string>> _uris; /**< merged URI to call number and original URI. */
+      int _nuris = 0;
+    };
+
+    /**
+     * \brief whether a call can be merged with others
+     * @param ad root data object
+     * @param data the call's data elements
+     */
+    bool batchable(const APIData &ad, std::vector<std::string> &data) const
+    {
+      if (!ad.has("data"))
+	return false;
+      if (ad.binary_data()) // binary elements are not carried over to the merged call
+	return false;
+      const APIData &ad_output = ad.getobj_ref("parameters").getobj_ref("output");
+      if (ad_output.has("measure"))
+	return false;
+      try
+	{
+	  data = ad.get("data").get<std::vector<std::string>>();
+	}
+      catch (std::exception &e)
+	{
+	  return false;
+	}
+      return !data.empty() && static_cast<int>(data.size()) < _max_batch_size;
+    }
+
+    /**
+     * \brief key over call parameters, only calls with identical keys are merged
+     * @param ad root data object
+     */
+    std::string get_params_key(const APIData &ad) const
+    {
+      JDoc jd;
+      jd.SetObject();
+      ad.getobj_ref("parameters").toJDoc(jd);
+      rapidjson::StringBuffer buffer;
+      rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+      jd.Accept(writer);
+      return buffer.GetString();
+    }
+
+    /**
+     * \brief runs the merged call and scatters predictions to every call of the batch
+     * @param batch the batch to run
+     * @param pfunc prediction function
+     */
+    void run_batch(const std::shared_ptr<pbatch> &batch, const predict_func &pfunc)
+    {
+      if (batch->_jobs.size() == 1)
+	{
+	  run_single(batch->_jobs.at(0),pfunc);
+	  return;
+	}
+
+      std::vector<std::string> mdata;
+      mdata.reserve(batch->_nuris);
+      for (auto j: batch->_jobs)
+	mdata.insert(mdata.end(),j->_data.begin(),j->_data.end());
+      APIData mad = batch->_jobs.at(0)->_ad;
+      mad.add("data",mdata);
+      APIData mout;
+      int status = 0;
+      try
+	{
+	  status = pfunc(mad,mout);
+	}
+      catch (std::exception &e)
+	{
+	  // one faulty call should not fail the others
+	  run_unbatched(batch,pfunc);
+	  return;
+	}
+
+      std::vector<std::vector<APIData>> jpreds(batch->_jobs.size());
+      std::vector<APIData> preds = mout.getv("predictions");
+      for (APIData &p: preds)
+	{
+	  std::string uri;
+	  try
+	    {
+	      uri = p.get("uri").get<std::string>();
+	    }
+	  catch (std::exception &e)
+	    {
+	      run_unbatched(batch,pfunc);
+	      return;
+	    }
+	  auto hit = batch->_uris.find(uri);
+	  if (hit == batch->_uris.end())
+	    {
+	      run_unbatched(batch,pfunc);
+	      return;
+	    }
+	  p.add("uri",(*hit).second.second);
+	  jpreds.at((*hit).second.first).push_back(std::move(p));
+	}
+      for (size_t j=0;j<jpreds.size();j++)
+	if (jpreds.at(j).empty())
+	  {
+	    // a call got no prediction back from the merged call
+	    run_unbatched(batch,pfunc);
+	    return;
+	  }
+      mout.erase("predictions");
+      for (size_t j=0;j<batch->_jobs.size();j++)
+	{
+	  std::shared_ptr<pjob> job = batch->_jobs.at(j);
+	  job->_out = mout;
+	  job->_out.add("predictions",jpreds.at(j));
+	  job->_status = status;
+	}
+    }
+
+    /**
+     * \brief runs every call of a batch separately
+     */
+    void run_unbatched(const std::shared_ptr<pbatch> &batch, const predict_func &pfunc)
+    {
+      for (auto j: batch->_jobs)
+	run_single(j,pfunc);
+    }
+
+    void run_single(const std::shared_ptr<pjob> &job, const predict_func &pfunc)
+    {
+      try
+	{
+	  job->_out = APIData();
+	  job->_status = pfunc(job->_ad,job->_out);
+	}
+      catch (...)
+	{
+	  job->_eptr = std::current_exception();
+	}
+    }
+
+    mutable std::mutex _mutex; /**< mutex around the open batch and statistics. */
+    std::condition_variable _cv;
+    std::shared_ptr<pbatch> _open; /**< batch currently accepting calls, if any. */
+    long int _nbatches = 0;
+    long int _nrequests = 0;
+    long int _nuris = 0;
+    int _max_achieved = 0;
+  };
+
+}
+
+#endif
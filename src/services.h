@@ -54,7 +54,9 @@
 #endif
 #include <spdlog/spdlog.h>
 #include <vector>
+#include <memory>
 #include <mutex>
+#include <atomic>
 #include <chrono>
 #include <iostream>
 
@@ -118,6 +120,9 @@ namespace dd
 #endif
     > mls_variant_type;
 
+  /* service registry, services are shared with the calls that use them. */
+  typedef std::unordered_map<std::string,std::shared_ptr<mls_variant_type>> mls_map_type;
+
   class ServiceForbiddenException : public std::exception
   {
   public:
@@ -152,11 +157,11 @@ namespace dd
     template<typename T>
       output operator() (T &mllib)
       {
-        int r = mllib.predict_job(_ad,_out);
+        int r = mllib.predict_job(*_ad,_out);
 	return output(r,_out);
       }
     
-    APIData _ad;
+    const APIData *_ad = nullptr; /**< call data, not copied. */
     APIData _out;
   };
 
@@ -285,11 +290,15 @@ namespace dd
    *        Each service instanciates a machine learning library and channels
    *        data for training and prediction along with parameters from API
    *        Service uses a variant type and store instances in a single iterable container.
+   *        The container is an immutable snapshot that is replaced as a whole when
+   *        services are added or removed (read-copy-update), so that lookups never
+   *        block, and a removed service is kept alive until the calls using it return.
    */
   class Services
   {
   public:
-    Services() {}
+    Services()
+      :_mlservices(std::make_shared<const mls_map_type>()) {}
     ~Services() {}
 
     /**
@@ -298,7 +307,16 @@ namespace dd
      */
     size_t services_size() const
     {
-      return _mlservices.size();
+      return services_snapshot()->size();
+    }
+
+    /**
+     * \brief get current services, lock-free
+     * @return snapshot of the services container
+     */
+    std::shared_ptr<const mls_map_type> services_snapshot() const
+    {
+      return std::atomic_load(&_mlservices);
     }
     
     /**
@@ -311,19 +329,27 @@ namespace dd
 		     mls_variant_type &&mls,
 		     const APIData &ad=APIData()) 
     {
-      std::unordered_map<std::string,mls_variant_type>::const_iterator hit;
-      if ((hit=_mlservices.find(sname))!=_mlservices.end())
+      if (service_exists(sname))
 	{
 	  throw ServiceForbiddenException("Service already exists");
 	}
 
       auto llog = spdlog::get(sname);
+      std::shared_ptr<mls_variant_type> smls = std::make_shared<mls_variant_type>(std::move(mls));
       visitor_init vi(ad);
       try
 	{
-	  mapbox::util::apply_visitor(vi,mls);
+	  mapbox::util::apply_visitor(vi,*smls);
 	  std::lock_guard<std::mutex> lock(_mlservices_mtx);
-	  _mlservices.insert(std::pair<std::string,mls_variant_type>(sname,std::move(mls)));
+	  std::shared_ptr<mls_map_type> nmlservices = std::make_shared<mls_map_type>(*services_snapshot());
+	  if (!nmlservices->insert(std::pair<std::string,std::shared_ptr<mls_variant_type>>(sname,smls)).second)
+	    throw ServiceForbiddenException("Service already exists");
+	  std::atomic_store(&_mlservices,std::shared_ptr<const mls_map_type>(std::move(nmlservices)));
+	}
+      catch (ServiceForbiddenException &e)
+	{
+	  llog->error("service creation conflict: {}",e.what());
+	  throw;
 	}
       catch (InputConnectorBadParamException &e)
 	{
@@ -349,6 +375,7 @@ namespace dd
 
     /**
      * \brief removes and destroys a service
+     *        The service is destroyed once the last running call on it returns.
      * @param sname service name
      * @param ad root data object
      * @return true if service was removed, false otherwise (i.e. not found)
@@ -357,8 +384,9 @@ namespace dd
 			const APIData &ad)
     {
       std::lock_guard<std::mutex> lock(_mlservices_mtx);
-      auto hit = _mlservices.begin();
-      if ((hit=_mlservices.find(sname))!=_mlservices.end())
+      std::shared_ptr<const mls_map_type> mlservices = services_snapshot();
+      auto hit = mlservices->find(sname);
+      if (hit!=mlservices->end())
 	{
 	  auto llog = spdlog::get(sname);
 	  if (ad.has("clear"))
@@ -366,7 +394,7 @@ namespace dd
 	      visitor_clear vc(ad);
 	      try
 		{
-		  mapbox::util::apply_visitor(vc,(*hit).second);
+		  mapbox::util::apply_visitor(vc,*(*hit).second);
 		}
 	      catch (MLLibBadParamException &e)
 		{
@@ -384,7 +412,9 @@ namespace dd
 	  	  throw;
 		}
 	    }
-	  _mlservices.erase(hit);
+	  std::shared_ptr<mls_map_type> nmlservices = std::make_shared<mls_map_type>(*mlservices);
+	  nmlservices->erase(sname);
+	  std::atomic_store(&_mlservices,std::shared_ptr<const mls_map_type>(std::move(nmlservices)));
 	  return true;
 	}
       auto llog = spdlog::get("api");
@@ -393,16 +423,17 @@ namespace dd
     }
 
     /**
-     * \brief get a service position as iterator
+     * \brief get a service, lock-free
      * @param sname service name
-     * @return service position, end of container if not found
+     * @return shared service object, that remains valid while held, nullptr if not found
      */
-    std::unordered_map<std::string,mls_variant_type>::iterator get_service_it(const std::string &sname)
+    std::shared_ptr<mls_variant_type> get_service(const std::string &sname) const
       {
-	std::unordered_map<std::string,mls_variant_type>::iterator hit;
-	if ((hit=_mlservices.find(sname))!=_mlservices.end())
-	  return hit;
-	return _mlservices.end();
+	std::shared_ptr<const mls_map_type> mlservices = services_snapshot();
+	auto hit = mlservices->find(sname);
+	if (hit!=mlservices->end())
+	  return (*hit).second;
+	return nullptr;
       }
 
     /**
@@ -410,12 +441,9 @@ namespace dd
      * @param sname service name
      * return true if service exists, false otherwise
      */
-    bool service_exists(const std::string &sname)
+    bool service_exists(const std::string &sname) const
     {
-      auto hit = get_service_it(sname);
-      if (hit == _mlservices.end())
-	return false;
-      return true;
+      return get_service(sname) != nullptr;
     }
     
     /**
@@ -433,8 +461,10 @@ namespace dd
       auto llog = spdlog::get(sname);
       try
 	{
-	  auto hit = get_service_it(sname);
-	  pout = mapbox::util::apply_visitor(vt,(*hit).second);
+	  std::shared_ptr<mls_variant_type> mls = get_service(sname);
+	  if (!mls)
+	    throw ServiceForbiddenException("Service not found");
+	  pout = mapbox::util::apply_visitor(vt,*mls);
 	}
       catch (InputConnectorBadParamException &e)
 	{
@@ -489,8 +519,10 @@ namespace dd
       output pout;
       try
 	{
-	  auto hit = get_service_it(sname);
-	  pout = mapbox::util::apply_visitor(vt,(*hit).second);
+	  std::shared_ptr<mls_variant_type> mls = get_service(sname);
+	  if (!mls)
+	    throw ServiceForbiddenException("Service not found");
+	  pout = mapbox::util::apply_visitor(vt,*mls);
 	}
       catch(...)
 	{
@@ -516,8 +548,10 @@ namespace dd
       output pout;
       try
 	{
-	  auto hit = get_service_it(sname);
-	  pout = mapbox::util::apply_visitor(vt,(*hit).second);
+	  std::shared_ptr<mls_variant_type> mls = get_service(sname);
+	  if (!mls)
+	    throw ServiceForbiddenException("Service not found");
+	  pout = mapbox::util::apply_visitor(vt,*mls);
 	}
       catch(...)
 	{
@@ -540,13 +574,15 @@ namespace dd
     {
       std::chrono::time_point<std::chrono::system_clock> tstart = std::chrono::system_clock::now();
       visitor_predict vp;
-      vp._ad = ad;
+      vp._ad = &ad;
       output pout;
       auto llog = spdlog::get(sname);
       try
 	{
-	  auto hit = get_service_it(sname);
-	  pout = mapbox::util::apply_visitor(vp,(*hit).second);
+	  std::shared_ptr<mls_variant_type> mls = get_service(sname);
+	  if (!mls)
+	    throw ServiceForbiddenException("Service not found");
+	  pout = mapbox::util::apply_visitor(vp,*mls);
 	}
       catch (InputConnectorBadParamException &e)
 	{
@@ -585,17 +621,16 @@ namespace dd
 	  pout._status = -1;
 	  throw;
 	}
-      out = pout._out;
+      out._data.swap(pout._out._data); // avoids copying large outputs
       std::chrono::time_point<std::chrono::system_clock> tstop = std::chrono::system_clock::now();
       double elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(tstop-tstart).count();
       out.add("time",elapsed);
       return pout._status;
     }
 
-    std::unordered_map<std::string,mls_variant_type> _mlservices; /**< container of instanciated services. */
-    
   protected:
-    std::mutex _mlservices_mtx; /**< mutex around adding/removing services. */
+    std::shared_ptr<const mls_map_type> _mlservices; /**< snapshot of instanciated services, only accessed atomically. */
+    std::mutex _mlservices_mtx; /**< mutex around adding/removing services, i.e. writers. */
   };
   
 }
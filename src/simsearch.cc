@@ -22,6 +22,9 @@
 #include "simsearch.h"
 #include "utils/fileops.hpp"
 #include "utils/utils.hpp"
+#include <cstring>
+#include <exception>
+#include <unordered_map>
 
 namespace dd
 {
@@ -73,12 +76,14 @@ namespace dd
   template <class TSE>
   void SearchEngine<TSE>::create_index()
   {
+    std::lock_guard<std::mutex> lock(_index_mutex);
     _tse->create_index();
   }
 
   template <class TSE>
   void SearchEngine<TSE>::update_index()
   {
+    std::lock_guard<std::mutex> lock(_index_mutex);
     _tse->update_index();
   }
 
@@ -86,6 +91,7 @@ namespace dd
   void SearchEngine<TSE>::remove_index()
   {
     std::cerr << "removing index\n";
+    std::lock_guard<std::mutex> lock(_index_mutex);
     _tse->remove_index();
   }
   
@@ -106,6 +112,54 @@ namespace dd
     _tse->search(data,nn,uris,distances);
   }
 
+  template <class TSE>
+  void SearchEngine<TSE>::search_batch(const std::vector<std::vector<double>> &data,
+				       const int &nn,
+				       std::vector<std::vector<URIData>> &uris,
+				       std::vector<std::vector<double>> &distances)
+  {
+    int nq = static_cast<int>(data.size());
+    std::vector<std::vector<int>> ids(nq);
+    uris.clear();
+    uris.resize(nq);
+    distances.clear();
+    distances.resize(nq);
+    std::exception_ptr eptr;
+#pragma omp parallel for
+    for (int i=0;i<nq;i++)
+      {
+	try
+	  {
+	    _tse->search_ids(data.at(i),nn,ids.at(i),distances.at(i));
+	  }
+	catch (...)
+	  {
+#pragma omp critical
+	    eptr = std::current_exception();
+	  }
+      }
+    if (eptr)
+      std::rethrow_exception(eptr);
+
+    // neighbors are often shared among queries, e.g. boxes of the same image
+    std::unordered_map<int,URIData> names;
+    for (int i=0;i<nq;i++)
+      {
+	uris.at(i).reserve(ids.at(i).size());
+	for (int id: ids.at(i))
+	  {
+	    auto hit = names.find(id);
+	    if (hit == names.end())
+	      {
+		URIData uri;
+		_tse->get_from_db(id,uri);
+		hit = names.insert(std::pair<int,URIData>(id,uri)).first;
+	      }
+	    uris.at(i).push_back((*hit).second);
+	  }
+      }
+  }
+
   /*- AnnoySE -*/
 
   AnnoySE::AnnoySE(const int &f,
@@ -201,10 +255,8 @@ namespace dd
 		       std::vector<URIData> &uris,
 		       std::vector<double> &distances)
   {
-    if (!_built_index)
-      throw SimSearchException("Cannot search before the Annoy tree has been built");
     std::vector<int> result;
-    _aindex->get_nns_by_vector(&vec[0],nn,-1,&result,&distances);
+    search_ids(vec,nn,result,distances);
     for (auto i: result)
       {
 	URIData uri;
@@ -213,6 +265,16 @@ namespace dd
       }
   }
 
+  void AnnoySE::search_ids(const std::vector<double> &vec,
+			   const int &nn,
+			   std::vector<int> &ids,
+			   std::vector<double> &distances)
+  {
+    if (!_built_index)
+      throw SimSearchException("Cannot search before the Annoy tree has been built");
+    _aindex->get_nns_by_vector(&vec[0],nn,-1,&ids,&distances);
+  }
+
   void AnnoySE::add_to_db(const int &idx,
 			  const URIData &fmap)
   {
@@ -235,6 +297,200 @@ namespace dd
     fmap.decode(tmp);
   }
   
+  /*- HnswSE -*/
+
+  HnswSE::HnswSE(const int &f,
+		 const std::string &model_repo)
+    :_f(f),_model_repo(model_repo)
+  {
+    _db = caffe::db::GetDB(_db_backend);
+  }
+
+  HnswSE::~HnswSE()
+  {
+    delete _hindex;
+    if (_db)
+      _db->Close();
+    delete _db;
+  }
+
+  void HnswSE::create_index()
+  {
+    if (!_hindex) // storage settings are known only once the engine is configured
+      _hindex = new HnswIndex(_f,_M,_ef_construction,_storage,_pq_m,_pq_train_size);
+    std::string index_filename = _model_repo + "/" + _index_name;
+    if (fileops::file_exists(index_filename)
+	&& !_hindex->load(index_filename))
+      throw SimIndexException("Cannot load HNSW index " + index_filename);
+    std::string db_filename = _model_repo + "/" + _db_name;
+    if (fileops::file_exists(db_filename))
+      _db->Open(db_filename,caffe::db::WRITE);
+    else _db->Open(db_filename,caffe::db::NEW);
+  }
+
+  void HnswSE::remove_index()
+  {
+    fileops::remove_file(_model_repo,_index_name);
+    std::string db_filename = _model_repo + "/" + _db_name;
+    fileops::clear_directory(db_filename);
+    rmdir(db_filename.c_str());
+  }
+
+  void HnswSE::update_index()
+  {
+    commit_db();
+    save_index(); // indexing may resume afterwards
+  }
+
+  void HnswSE::save_index()
+  {
+    std::string index_path = _model_repo + "/" + _index_name;
+    if (!_hindex->save(index_path))
+      throw SimIndexException("Cannot save HNSW index " + index_path);
+  }
+
+  // must be protected by mutex
+  void HnswSE::index(const URIData &uri,
+		     const std::vector<double> &vec)
+  {
+    if (static_cast<int>(vec.size()) != _f)
+      throw SimIndexException("Cannot index vector of size " + std::to_string(vec.size()) + ", index dimension is " + std::to_string(_f));
+    bool exact = _rerank > 0 && _hindex->storage() != HnswStorage::float32;
+    {
+      // id is known before insertion since insertions are serialized
+      std::lock_guard<std::mutex> lock(_pending_mutex);
+      int idx = _hindex->size();
+      _pending.insert(std::pair<int,URIData>(idx,uri));
+      if (exact)
+	_pending_vecs.insert(std::pair<int,std::vector<float>>(idx,std::vector<float>(vec.begin(),vec.end())));
+    }
+    int idx = _hindex->add(&vec[0]);
+    add_to_db(idx,uri,exact ? &vec : nullptr);
+  }
+
+  void HnswSE::search(const std::vector<double> &vec,
+		      const int &nn,
+		      std::vector<URIData> &uris,
+		      std::vector<double> &distances)
+  {
+    std::vector<int> result;
+    search_ids(vec,nn,result,distances);
+    for (auto i: result)
+      {
+	URIData uri;
+	get_from_db(i,uri);
+	uris.push_back(uri);
+      }
+  }
+
+  void HnswSE::search_ids(const std::vector<double> &vec,
+			  const int &nn,
+			  std::vector<int> &ids,
+			  std::vector<double> &distances)
+  {
+    if (static_cast<int>(vec.size()) != _f)
+      throw SimSearchException("Cannot search vector of size " + std::to_string(vec.size()) + ", index dimension is " + std::to_string(_f));
+    if (_rerank <= 0 || _hindex->storage() == HnswStorage::float32)
+      {
+	_hindex->search(&vec[0],nn,ids,distances,_ef_search);
+	return;
+      }
+
+    // approximate candidates, re-ranked with exact distances
+    std::vector<int> result;
+    std::vector<double> adistances;
+    _hindex->search(&vec[0],nn*_rerank,result,adistances,std::max(_ef_search,nn*_rerank));
+    double qnorm = 0.0;
+    for (double v: vec)
+      qnorm += v*v;
+    std::vector<std::pair<double,int>> exact;
+    std::vector<float> cvec;
+    for (auto i: result)
+      {
+	get_vec_from_db(i,cvec);
+	double dot = 0.0, cnorm = 0.0;
+	for (int j=0;j<_f;j++)
+	  {
+	    dot += vec[j]*cvec[j];
+	    cnorm += cvec[j]*cvec[j];
+	  }
+	double cosv = qnorm > 0.0 && cnorm > 0.0 ? dot / std::sqrt(qnorm*cnorm) : 0.0;
+	exact.push_back(std::pair<double,int>(std::sqrt(std::max(0.0,2.0-2.0*cosv)),i));
+      }
+    std::sort(exact.begin(),exact.end());
+    for (size_t k=0;k<exact.size()&&static_cast<int>(k)<nn;k++)
+      {
+	ids.push_back(exact.at(k).second);
+	distances.push_back(exact.at(k).first);
+      }
+  }
+
+  void HnswSE::add_to_db(const int &idx,
+			 const URIData &fmap,
+			 const std::vector<double> *vec)
+  {
+    if (!_txn)
+      _txn = std::unique_ptr<caffe::db::Transaction>(_db->NewTransaction());
+    _txn->Put(std::to_string(idx),fmap.encode());
+    if (vec)
+      {
+	std::vector<float> fvec(vec->begin(),vec->end());
+	_txn->Put("v" + std::to_string(idx),
+		  std::string(reinterpret_cast<const char*>(fvec.data()),fvec.size()*sizeof(float)));
+      }
+    ++_count_put;
+    if (_count_put % _count_put_max == 0)
+      commit_db(); // batch commit
+  }
+
+  void HnswSE::commit_db()
+  {
+    if (!_txn)
+      return;
+    _txn->Commit();
+    _txn.reset();
+    std::lock_guard<std::mutex> lock(_pending_mutex);
+    _pending.clear();
+    _pending_vecs.clear();
+  }
+
+  void HnswSE::get_from_db(const int &idx,
+			   URIData &fmap)
+  {
+    {
+      std::lock_guard<std::mutex> lock(_pending_mutex);
+      auto hit = _pending.find(idx);
+      if (hit != _pending.end())
+	{
+	  fmap = (*hit).second;
+	  return;
+	}
+    }
+    std::string tmp;
+    _db->Get(std::to_string(idx),tmp);
+    fmap.decode(tmp);
+  }
+
+  void HnswSE::get_vec_from_db(const int &idx,
+			       std::vector<float> &vec)
+  {
+    {
+      std::lock_guard<std::mutex> lock(_pending_mutex);
+      auto hit = _pending_vecs.find(idx);
+      if (hit != _pending_vecs.end())
+	{
+	  vec = (*hit).second;
+	  return;
+	}
+    }
+    std::string tmp;
+    _db->Get("v" + std::to_string(idx),tmp);
+    if (tmp.size() != _f*sizeof(float))
+      throw SimSearchException("Cannot find exact vector " + std::to_string(idx) + " for re-ranking");
+    vec.resize(_f);
+    std::memcpy(vec.data(),tmp.data(),tmp.size());
+  }
 
   template class SearchEngine<AnnoySE>;
+  template class SearchEngine<HnswSE>;
 }
@@ -25,8 +25,10 @@
 #include "apidata.h"
 #include "annoylib.h"
 #include "kissrandom.h"
+#include "hnswindex.h"
 #include "caffe/util/db.hpp"
 #include <mutex>
+#include <unordered_map>
 
 namespace dd
 {
@@ -84,8 +86,36 @@ namespace dd
     static char _enc_char;
   };
   
+  /**
+   * \brief search engine interface, so that the index type can be selected at service creation
+   */
+  class SearchEngineBase
+  {
+  public:
+    virtual ~SearchEngineBase() {}
+
+    virtual void create_index() = 0;
+
+    virtual void update_index() = 0;
+
+    virtual void remove_index() = 0;
+
+    virtual void index(const URIData &uri,
+		       const std::vector<double> &data) = 0;
+
+    virtual void search(const std::vector<double> &data,
+			const int &nn,
+			std::vector<URIData> &uris,
+			std::vector<double> &distances) = 0;
+
+    virtual void search_batch(const std::vector<std::vector<double>> &data,
+			      const int &nn,
+			      std::vector<std::vector<URIData>> &uris,
+			      std::vector<std::vector<double>> &distances) = 0;
+  };
+  
   template <class TSE>
-    class SearchEngine
+    class SearchEngine : public SearchEngineBase
     {
     public:
       SearchEngine(const int &dim, const std::string &model_repo);
@@ -105,9 +135,22 @@ namespace dd
 		  std::vector<URIData> &uris,
 		  std::vector<double> &distances);
 
+      /**
+       * \brief searches several queries at once, index lookups run in parallel
+       *        and every distinct neighbor is read from db only once
+       * @param data queries, one per row
+       * @param nn number of neighbors per query
+       * @param uris neighbors per query
+       * @param distances neighbors distances per query
+       */
+      void search_batch(const std::vector<std::vector<double>> &data,
+			const int &nn,
+			std::vector<std::vector<URIData>> &uris,
+			std::vector<std::vector<double>> &distances);
+
       const int _dim = 128; /**< indexed vector length. */
       TSE *_tse = nullptr;
-      std::mutex _index_mutex; /**< mutex around indexing calls. */
+      std::mutex _index_mutex; /**< mutex around indexing, index commit, save and removal calls. */
     };
 
   class AnnoySE
@@ -130,6 +173,11 @@ namespace dd
 		const int &nn,
 		std::vector<URIData> &uris,
 		std::vector<double> &distances);
+
+    void search_ids(const std::vector<double> &vec,
+		    const int &nn,
+		    std::vector<int> &ids,
+		    std::vector<double> &distances);
       
     // internal functions
     void build_tree();
@@ -162,6 +210,76 @@ namespace dd
     bool _built_index = false; /**< whether the index has been built. */
     bool _map_populate = true; /**< whether to use MAP_POPULATE when mmapping the full index. */
   };
+
+  /**
+   * \brief HNSW graph index, unlike Annoy it accepts new items after it has been
+   *        built and saved, and items are searchable as soon as they are indexed.
+   *        Vectors can be held in memory as float32, int8 or product quantized codes,
+   *        in which case exact vectors are kept in the db and used to re-rank
+   *        the approximate nearest neighbors.
+   */
+  class HnswSE
+  {
+  public:
+    HnswSE(const int &f, const std::string &model_repo);
+    ~HnswSE();
+
+    // interface
+    void create_index();
+
+    void update_index();
+
+    void remove_index();
+
+    void index(const URIData &uri,
+	       const std::vector<double> &data);
+
+    void search(const std::vector<double> &vec,
+		const int &nn,
+		std::vector<URIData> &uris,
+		std::vector<double> &distances);
+
+    void search_ids(const std::vector<double> &vec,
+		    const int &nn,
+		    std::vector<int> &ids,
+		    std::vector<double> &distances);
+
+    // internal functions
+    void save_index();
+
+    void add_to_db(const int &idx,
+		   const URIData &fmap,
+		   const std::vector<double> *vec=nullptr);
+
+    void commit_db();
+
+    void get_from_db(const int &idx,
+		     URIData &fmap);
+
+    void get_vec_from_db(const int &idx,
+			 std::vector<float> &vec);
+
+    int _f = 128; /**< indexed vector length. */
+    int _M = 16; /**< max number of links per graph node. */
+    int _ef_construction = 200; /**< candidate list size at insertion. */
+    int _ef_search = 64; /**< candidate list size at search. */
+    HnswStorage _storage = HnswStorage::float32; /**< in-memory vector storage, overridden by a saved index. */
+    int _pq_m = 0; /**< product quantization subspaces, 0 for dim/4. */
+    int _pq_train_size = 10000; /**< number of first indexed vectors the quantization codebook is trained on. */
+    int _rerank = 10; /**< with compressed storage, nn*rerank candidates are re-ranked with exact vectors, 0 to disable. */
+    HnswIndex *_hindex = nullptr;
+    std::string _model_repo; /**< model directory */
+    const std::string _db_name = "names.bin";
+    const std::string _db_backend = "lmdb";
+    caffe::db::DB *_db = nullptr;
+    std::unique_ptr<caffe::db::Transaction> _txn;
+    int _count_put = 0;
+    int _count_put_max = 1000;
+    std::unordered_map<int,URIData> _pending; /**< indexed items not yet committed to db. */
+    std::unordered_map<int,std::vector<float>> _pending_vecs; /**< exact vectors not yet committed to db. */
+    std::mutex _pending_mutex; /**< mutex around pending items. */
+    const std::string _index_name = "index.hnsw";
+  };
   
 }
 
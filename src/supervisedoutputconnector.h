@@ -35,6 +35,86 @@ template bool SortScorePairDescend(const std::pair<double, std::pair<int, int> >
 namespace dd
 {
 
+  /**
+   * \brief columnar evaluation buffer: per-sample predictions and targets
+   *        stored contiguously with offsets, built once from the results
+   *        object so that measures never look samples up by key.
+   */
+  class MeasureData
+  {
+  public:
+    /**
+     * \brief fills up buffers from results object
+     * @param ad results object with batch_size and per-sample pred / target
+     */
+    MeasureData(const APIData &ad)
+    {
+      if (ad.has("batch_size"))
+	_batch_size = ad.get("batch_size").get<int>();
+      if (ad.has("nclasses"))
+	_nclasses = ad.get("nclasses").get<int>();
+      _pred_offsets.reserve(_batch_size+1);
+      _target_offsets.reserve(_batch_size+1);
+      _pred_offsets.push_back(0);
+      _target_offsets.push_back(0);
+      for (int i=0;i<_batch_size;i++)
+	{
+	  const APIData &bad = ad.getobj_ref(std::to_string(i));
+	  append(bad.get_view("pred"),_preds);
+	  append(bad.get_view("target"),_targets);
+	  _pred_offsets.push_back(_preds.size());
+	  _target_offsets.push_back(_targets.size());
+	}
+    }
+    ~MeasureData() {}
+
+    inline const double* pred(const int &i) const { return _preds.data() + _pred_offsets[i]; }
+    inline int pred_size(const int &i) const { return _pred_offsets[i+1] - _pred_offsets[i]; }
+    inline const double* target(const int &i) const { return _targets.data() + _target_offsets[i]; }
+    inline int target_size(const int &i) const { return _target_offsets[i+1] - _target_offsets[i]; }
+    inline double target_value(const int &i) const { return _targets[_target_offsets[i]]; }
+
+    /**
+     * \brief checks that every sample has a target, before reading them in parallel
+     */
+    void require_targets() const
+    {
+      for (int i=0;i<_batch_size;i++)
+	if (target_size(i) == 0)
+	  throw OutputConnectorBadParamException("missing target for sample " + std::to_string(i));
+    }
+
+    /**
+     * \brief index of the best prediction for a sample
+     */
+    inline int argmax(const int &i) const
+    {
+      const double *p = pred(i);
+      return std::distance(p,std::max_element(p,p+pred_size(i)));
+    }
+
+    int _batch_size = 0;
+    int _nclasses = 0;
+    std::vector<double> _preds; /**< all predictions, sample after sample. */
+    std::vector<double> _targets; /**< all targets, sample after sample. */
+    std::vector<size_t> _pred_offsets; /**< start of each sample's predictions, plus end. */
+    std::vector<size_t> _target_offsets; /**< start of each sample's targets, plus end. */
+
+  private:
+    static void append(const ad_variant_type &v, std::vector<double> &buf)
+    {
+      if (v.is<std::vector<double>>())
+	{
+	  const std::vector<double> &vd = v.get<std::vector<double>>();
+	  buf.insert(buf.end(),vd.begin(),vd.end());
+	}
+      else if (v.is<double>())
+	buf.push_back(v.get<double>());
+      else if (v.is<int>())
+	buf.push_back(static_cast<double>(v.get<int>()));
+    }
+  };
+
     /**
    * \brief supervised machine learning output connector class
    */
@@ -144,7 +224,7 @@ namespace dd
      */
     void init(const APIData &ad)
     {
-      APIData ad_out = ad.getobj("parameters").getobj("output");
+      const APIData &ad_out = ad.getobj_ref("parameters").getobj_ref("output");
       if (ad_out.has("best"))
 	_best = ad_out.get("best").get<int>();
       if (_best == -1)
@@ -314,6 +394,27 @@ namespace dd
     }
 
 #ifdef USE_SIMSEARCH
+    /**
+     * \brief gathers roi feature vectors of all results as a single batch of queries
+     * @param vvcats results
+     * @param offsets first query of every result, plus the total number of queries
+     * @return queries
+     */
+    static std::vector<std::vector<double>> roi_queries(const std::vector<sup_result> &vvcats,
+							 std::vector<size_t> &offsets)
+    {
+      std::vector<std::vector<double>> queries;
+      offsets.clear();
+      for (size_t i=0;i<vvcats.size();i++)
+	{
+	  offsets.push_back(queries.size());
+	  for (auto vit=vvcats.at(i)._vals.begin();vit!=vvcats.at(i)._vals.end();++vit)
+	    queries.push_back((*vit).second.get("vals").get<std::vector<double>>());
+	}
+      offsets.push_back(queries.size());
+      return queries;
+    }
+
     double multibox_distance(const double &dist,
 			     const double &prob)
     {
@@ -465,54 +566,53 @@ namespace dd
 	    search_nn = ad_in.get("search_nn").get<int>();
 	  if (!has_roi)
 	    {
+	      std::vector<std::vector<double>> queries(bcats._vvcats.size());
 	      for (size_t i=0;i<bcats._vvcats.size();i++)
 		{
-		  std::vector<double> probs;
 		  auto mit = bcats._vvcats.at(i)._cats.begin();
 		  while(mit!=bcats._vvcats.at(i)._cats.end())
 		    {
-		      probs.push_back((*mit).first);
+		      queries.at(i).push_back((*mit).first);
 		      ++mit;
 		    }
-		  std::vector<URIData> nn_uris;
-		  std::vector<double> nn_distances;
-		  mlm->_se->search(probs,search_nn,nn_uris,nn_distances);
-		  for (size_t j=0;j<nn_uris.size();j++)
+		}
+	      std::vector<std::vector<URIData>> nn_uris;
+	      std::vector<std::vector<double>> nn_distances;
+	      mlm->_se->search_batch(queries,search_nn,nn_uris,nn_distances);
+	      for (size_t i=0;i<bcats._vvcats.size();i++)
+		{
+		  for (size_t j=0;j<nn_uris.at(i).size();j++)
 		    {
-		      bcats._vvcats.at(i).add_nn(nn_distances.at(j),nn_uris.at(j));
+		      bcats._vvcats.at(i).add_nn(nn_distances.at(i).at(j),nn_uris.at(i).at(j));
 		    }
 		}
 	    }
 	  else if (has_roi && has_multibox_rois)
 	    {
+	      std::vector<size_t> offsets;
+	      std::vector<std::vector<URIData>> nn_uris;
+	      std::vector<std::vector<double>> nn_distances;
+	      mlm->_se->search_batch(roi_queries(bcats._vvcats,offsets),search_nn,nn_uris,nn_distances);
 	      for (size_t i=0;i<bcats._vvcats.size();i++)
 		{
 		  std::unordered_map<std::string,std::pair<double,int>> multibox_nn; // one uri (image) / total distance, count
 		  std::unordered_map<std::string,std::pair<double,int>>::iterator hit; 
-		  auto vit = bcats._vvcats.at(i)._vals.begin();
-		  auto mit = bcats._vvcats.at(i)._cats.begin();
-		  while(mit!=bcats._vvcats.at(i)._cats.end()) // equivalent to iterating the bboxes
+		  for (size_t b=offsets.at(i);b<offsets.at(i+1);b++) // bboxes
 		    {
-		      std::vector<URIData> nn_uris;
-		      std::vector<double> nn_distances;
-		      mlm->_se->search((*vit).second.get("vals").get<std::vector<double>>(),
-				       search_nn,nn_uris,nn_distances);
-		      for (size_t j=0;j<nn_uris.size();j++)
+		      for (size_t j=0;j<nn_uris.at(b).size();j++)
 			{
-			  if ((hit=multibox_nn.find(nn_uris.at(j)._uri))==multibox_nn.end())
+			  const URIData &nn_uri = nn_uris.at(b).at(j);
+			  if ((hit=multibox_nn.find(nn_uri._uri))==multibox_nn.end())
 			    {
-			      double mb_dist = multibox_distance(nn_distances.at(j),nn_uris.at(j)._prob);
-			      multibox_nn.insert(std::pair<std::string,std::pair<double,int>>(nn_uris.at(j)._uri,std::pair<double,int>(mb_dist,1)));
+			      double mb_dist = multibox_distance(nn_distances.at(b).at(j),nn_uri._prob);
+			      multibox_nn.insert(std::pair<std::string,std::pair<double,int>>(nn_uri._uri,std::pair<double,int>(mb_dist,1)));
 			    }
 			  else
 			    {
-			      (*hit).second.first += multibox_distance(nn_distances.at(j),nn_uris.at(j)._prob);
+			      (*hit).second.first += multibox_distance(nn_distances.at(b).at(j),nn_uri._prob);
 			      (*hit).second.second += 1;
 			    }
 			}
-		      
-		      ++mit;
-		      ++vit;
 		    }
 		  // final ranking per images and store final results here
 		  hit = multibox_nn.begin();
@@ -526,24 +626,19 @@ namespace dd
 	    }
 	  else // has_roi
 	    {
+	      std::vector<size_t> offsets;
+	      std::vector<std::vector<URIData>> nn_uris;
+	      std::vector<std::vector<double>> nn_distances;
+	      mlm->_se->search_batch(roi_queries(bcats._vvcats,offsets),search_nn,nn_uris,nn_distances);
 	      for (size_t i=0;i<bcats._vvcats.size();i++)
 		{
-		  int bb = 0;
-		  auto vit = bcats._vvcats.at(i)._vals.begin();
-		  auto mit = bcats._vvcats.at(i)._cats.begin(); 
-		  while(mit!=bcats._vvcats.at(i)._cats.end()) // equivalent to iterating the bboxes
+		  for (size_t b=offsets.at(i);b<offsets.at(i+1);b++)
 		    {
-		      std::vector<URIData> nn_uris;
-		      std::vector<double> nn_distances;
-		      mlm->_se->search((*vit).second.get("vals").get<std::vector<double>>(),
-				       search_nn,nn_uris,nn_distances);
-		      ++mit;
-		      ++vit;
-		      for (size_t j=0;j<nn_uris.size();j++)
+		      int bb = b - offsets.at(i);
+		      for (size_t j=0;j<nn_uris.at(b).size();j++)
 			{
-			  bcats._vvcats.at(i).add_bbox_nn(bb,nn_distances.at(j),nn_uris.at(j));
+			  bcats._vvcats.at(i).add_bbox_nn(bb,nn_distances.at(b).at(j),nn_uris.at(b).at(j));
 			}
-		      ++bb;
 		    }
 		}
 	    }
@@ -582,6 +677,7 @@ namespace dd
 
       if (ad_out.has("measure"))
 	{
+	  MeasureData md(ad_res); // columnar predictions and targets, shared by all measures
 	  std::vector<std::string> measures = ad_out.get("measure").get<std::vector<std::string>>();
       	  bool bauc = (std::find(measures.begin(),measures.end(),"auc")!=measures.end());
 	  bool bacc = false;
@@ -663,12 +759,12 @@ namespace dd
 	}
       if (bauc) // XXX: applies two binary classification problems only
 	{
-	  double mauc = auc(ad_res);
+	  double mauc = auc(md);
 	  meas_out.add("auc",mauc);
 	}
       if (bacc)
 	{
-	  std::map<std::string,double> accs = acc(ad_res,measures);
+	  std::map<std::string,double> accs = acc(md,measures);
 	  auto mit = accs.begin();
 	  while(mit!=accs.end())
 	    {
@@ -681,7 +777,7 @@ namespace dd
 	  double meanacc, meaniou;
 	  std::vector<double> clacc;
 	  std::vector<double> cliou;
-	  double accs = acc_v(ad_res,meanacc,meaniou,clacc,cliou);
+	  double accs = acc_v(md,meanacc,meaniou,clacc,cliou);
 	  meas_out.add("acc",accs);
 	  meas_out.add("meanacc",meanacc);
 	  meas_out.add("meaniou",meaniou);
@@ -691,7 +787,7 @@ namespace dd
       if (mlacc)
 	{
 	  double f1, sensitivity, specificity, harmmean, precision;
-	  multilabel_acc(ad_res,sensitivity,specificity,harmmean,precision,f1);
+	  multilabel_acc(md,sensitivity,specificity,harmmean,precision,f1);
 	  meas_out.add("f1",f1);
 	  meas_out.add("precision",precision);
 	  meas_out.add("sensitivity",sensitivity);
@@ -700,49 +796,49 @@ namespace dd
 	}
       if (mlsoft_kl)
         {
-          double kl_divergence = multilabel_soft_kl(ad_res,-1); // kl: amount of lost info if using pred instead of truth
+          double kl_divergence = multilabel_soft_kl(md,-1); // kl: amount of lost info if using pred instead of truth
           meas_out.add("kl_divergence",kl_divergence);
-          double kl_divergence_thres = multilabel_soft_kl(ad_res,mlsoft_kl_thres);
+          double kl_divergence_thres = multilabel_soft_kl(md,mlsoft_kl_thres);
           std::string b = "kl_divergence_no_" +std::to_string(mlsoft_kl_thres);
           meas_out.add(b,kl_divergence_thres);
         }
       if (mlsoft_js)
         {
-          double js_divergence = multilabel_soft_js(ad_res,-1) ; // jsd: symetrized version of kl
+          double js_divergence = multilabel_soft_js(md,-1) ; // jsd: symetrized version of kl
 	      meas_out.add("js_divergence",js_divergence);
-          double js_divergence_thres = multilabel_soft_js(ad_res,mlsoft_js_thres) ;
+          double js_divergence_thres = multilabel_soft_js(md,mlsoft_js_thres) ;
           std::string b = "js_divergence_no_" + std::to_string(mlsoft_js_thres);
           meas_out.add(b,js_divergence_thres);
         }
       if (mlsoft_was)
         {
-          double wasserstein = multilabel_soft_was(ad_res,-1); // wasserstein distance
+          double wasserstein = multilabel_soft_was(md,-1); // wasserstein distance
 	      meas_out.add("wasserstein",wasserstein);
-          double wasserstein_thres = multilabel_soft_was(ad_res,mlsoft_was_thres);
+          double wasserstein_thres = multilabel_soft_was(md,mlsoft_was_thres);
           std::string b = "wasserstein_no_" + std::to_string(mlsoft_was_thres);
           meas_out.add(b,wasserstein_thres);
         }
       if (mlsoft_ks)
         {
-          double kolmogorov_smirnov = multilabel_soft_ks(ad_res,-1); // kolmogorov-smirnov test aka max individual error
+          double kolmogorov_smirnov = multilabel_soft_ks(md,-1); // kolmogorov-smirnov test aka max individual error
 	      meas_out.add("kolmogorov_smirnov",kolmogorov_smirnov);
-          double kolmogorov_smirnov_thres = multilabel_soft_ks(ad_res,mlsoft_ks_thres);
+          double kolmogorov_smirnov_thres = multilabel_soft_ks(md,mlsoft_ks_thres);
           std::string b = "kolmogorov_smirnov_no_" + std::to_string(kolmogorov_smirnov_thres);
           meas_out.add(b,kolmogorov_smirnov_thres);
         }
       if (mlsoft_dc)
         {
-          double distance_correlation = multilabel_soft_dc(ad_res,-1); // distance correlation , same as brownian correlation
+          double distance_correlation = multilabel_soft_dc(md,-1); // distance correlation , same as brownian correlation
 	      meas_out.add("distance_correlation",distance_correlation);
-          double distance_correlation_thres = multilabel_soft_dc(ad_res,mlsoft_dc_thres);
+          double distance_correlation_thres = multilabel_soft_dc(md,mlsoft_dc_thres);
           std::string b = "distance_correlation_no_" + std::to_string(mlsoft_dc_thres);
           meas_out.add(b,distance_correlation_thres);
         }
       if (mlsoft_r2)
         {
-          double r_2 = multilabel_soft_r2(ad_res,-1); // r_2 score: best  is 1, min is 0
+          double r_2 = multilabel_soft_r2(md,-1); // r_2 score: best  is 1, min is 0
           meas_out.add("r2",r_2);
-          double r_2_thres = multilabel_soft_r2(ad_res,mlsoft_r2_thres);
+          double r_2_thres = multilabel_soft_r2(md,mlsoft_r2_thres);
           std::string b = "r2_no_" + std::to_string(mlsoft_r2_thres);
           meas_out.add(b,r_2_thres);
         }
@@ -751,8 +847,8 @@ namespace dd
           std::vector<double> delta_scores {0,0,0,0}; // delta-score , aka 1 if pred \in [truth-delta, truth+delta]
           std::vector<double> delta_scores_thres {0,0,0,0}; // delta-score , aka 1 if pred \in [truth-delta, truth+delta]
           std::vector<double> deltas {0.05, 0.1, 0.2, 0.5};
-          multilabel_soft_deltas(ad_res, delta_scores, deltas,-1);
-          multilabel_soft_deltas(ad_res, delta_scores_thres, deltas,mlsoft_deltas_thres);
+          multilabel_soft_deltas(md, delta_scores, deltas,-1);
+          multilabel_soft_deltas(md, delta_scores_thres, deltas,mlsoft_deltas_thres);
           for (unsigned int i=0; i<deltas.size(); ++i)
             {
               std::ostringstream sstr;
@@ -768,7 +864,7 @@ namespace dd
 	    {
 	      double f1,precision,recall,acc;
 	      dMat conf_diag,conf_matrix;
-	      f1 = mf1(ad_res,precision,recall,acc,conf_diag,conf_matrix);
+	      f1 = mf1(md,precision,recall,acc,conf_diag,conf_matrix);
 	      meas_out.add("f1",f1);
 	      meas_out.add("precision",precision);
 	      meas_out.add("recall",recall);
@@ -799,25 +895,25 @@ namespace dd
 	    }
 	  if (!multilabel && !segmentation && !bbox && bmcll)
 	    {
-	      double mmcll = mcll(ad_res);
+	      double mmcll = mcll(md);
 	      meas_out.add("mcll",mmcll);
 	    }
 	  if (bgini)
 	    {
-	      double mgini = gini(ad_res,regression);
+	      double mgini = gini(md,regression);
 	      meas_out.add("gini",mgini);
 	    }
 	  if (beucll)
 	    {
-	      double meucll = eucll(ad_res,-1);
+	      double meucll = eucll(md,ad_res,-1);
 	      meas_out.add("eucll",meucll);
-          double meucll_thres = eucll(ad_res,beucll_thres);
+          double meucll_thres = eucll(md,ad_res,beucll_thres);
           std::string b = "eucll_no_" + std::to_string(beucll_thres);
           meas_out.add(b,meucll_thres);
 	    }
 	  if (bmcc)
 	    {
-	      double mmcc = mcc(ad_res);
+	      double mmcc = mcc(md);
 	      meas_out.add("mcc",mmcc);
 	      
 	    }
@@ -844,7 +940,7 @@ namespace dd
 
              if (L1)
                {
-                 timeSeriesErrors(ad_res, timeseries, max_errors, indexes_max_error, mean_errors, max_error, mean_error, true);
+                 timeSeriesErrors(md, timeseries, max_errors, indexes_max_error, mean_errors, max_error, mean_error, true);
                  for (int i=0; i<timeseries; ++i)
                    {
                      meas_out.add("L1_max_error_" + std::to_string(i),max_errors[i]);
@@ -858,7 +954,7 @@ namespace dd
                }
              if (L2)
                {
-                 timeSeriesErrors(ad_res, timeseries, max_errors, indexes_max_error, mean_errors, max_error, mean_error, false);
+                 timeSeriesErrors(md, timeseries, max_errors, indexes_max_error, mean_errors, max_error, mean_error, false);
                  for (int i=0; i<timeseries; ++i)
                    {
                      meas_out.add("L2_max_error_" + std::to_string(i),max_errors[i]);
@@ -880,7 +976,7 @@ namespace dd
 	out.add("measure",meas_out);
     }
 
-    static void timeSeriesErrors(const APIData &ad, const int timeseries,
+    static void timeSeriesErrors(const MeasureData &md, const int timeseries,
                                  double * const max_errors, int * const indexes_max_error,
                                  double * const mean_errors, double& max_error,
                                  double& mean_error, bool L1)
@@ -890,32 +986,20 @@ namespace dd
       mean_error_vector.setZero();
       Eigen::Map<dVec> max = dVec::Map(max_errors,timeseries);
       double nts = 0;
-      int batch_size = ad.get("batch_size").get<int>();
-      for (int i=0;i<batch_size;i++)
+      for (int i=0;i<md._batch_size;i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
-          std::vector<double> targets = bad.get("target").get<std::vector<double>>();
-          /* std::cout << "targets: " ; */
-          /* for (double d: targets) */
-          /*   std::cout << d << " "; */
-          /* std::cout << std::endl; */
-          std::vector<double> predictions = bad.get("pred").get<std::vector<double>>();
-          /* std::cout << "predictions: "; */
-          /* for (double d : predictions) */
-          /*   std::cout << d << " "; */
-          /* std::cout << std::endl; */
-          nts+=targets.size();
-
-          int dataduration = targets.size() / timeseries;
+          int tsize = md.target_size(i);
+          nts+=tsize;
+
+          int dataduration = tsize / timeseries;
           typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Mdat;
-          Mdat dpred = Mdat::Map(&predictions.at(0), dataduration, timeseries);
-          Mdat dtarg = Mdat::Map(&targets.at(0), dataduration, timeseries);
+          Eigen::Map<const Mdat> dpred(md.pred(i), dataduration, timeseries);
+          Eigen::Map<const Mdat> dtarg(md.target(i), dataduration, timeseries);
           // now can access dpred(timestep_number, serie_number)
           Mdat error;
           error = (dpred - dtarg).cwiseAbs();
           if (!L1)
             error = error.array() * error.array();
-          //          std::cout << "error: " << error << std::endl;
           dVec batchmax = error.colwise().maxCoeff();
           int batch_max_indexes[timeseries];
           for (int j =0; j<timeseries; ++j)
@@ -957,7 +1041,6 @@ namespace dd
     }
 
 
-
     static void find_presence_and_thres(std::string meas, std::vector<std::string> measures, bool& do_meas, float& meas_thres)
     {
       for(auto s: measures)
@@ -977,24 +1060,17 @@ namespace dd
 
     static double straight_meas(const APIData &ad)
     {
-      APIData bad = ad.getobj("0");
-      std::vector<double> acc = bad.get("pred").get<std::vector<double>>();
-      if (acc.empty())
+      const APIData &bad = ad.getobj_ref("0");
+      const ad_variant_type &acc = bad.get_view("pred");
+      if (!acc.is<std::vector<double>>() || acc.get<std::vector<double>>().empty())
 	return 0.0;
-      else return acc.at(0);
+      else return acc.get<std::vector<double>>().at(0);
     }
     
     // measure: ACC
-    static std::map<std::string,double> acc(const APIData &ad,
+    static std::map<std::string,double> acc(const MeasureData &md,
 					    const std::vector<std::string> &measures)
     {
-      struct acc_comp
-      {
-        acc_comp(const std::vector<double> &v)
-	:_v(v) {}
-	bool operator()(double a, double b) { return _v[a] > _v[b]; }
-	const std::vector<double> _v;
-      };
       std::map<std::string,double> accs;
       std::vector<int> vacck;
       for(auto s: measures)
@@ -1008,22 +1084,26 @@ namespace dd
 	    else vacck.push_back(1);
 	  }
       
-      int batch_size = ad.get("batch_size").get<int>();
+      md.require_targets();
+      int batch_size = md._batch_size;
       for (auto k: vacck)
 	{
 	  double acc = 0.0;
+#pragma omp parallel for reduction(+:acc)
 	  for (int i=0;i<batch_size;i++)
 	    {
-	      APIData bad = ad.getobj(std::to_string(i));
-	      std::vector<double> predictions = bad.get("pred").get<std::vector<double>>();
-	      if (k-1 >= static_cast<int>(predictions.size()))
+	      const double *predictions = md.pred(i);
+	      int npreds = md.pred_size(i);
+	      if (k-1 >= npreds)
 		continue; // ignore instead of error
-	      std::vector<int> predk(predictions.size());
-	      for (size_t j=0;j<predictions.size();j++)
+	      std::vector<int> predk(npreds);
+	      for (int j=0;j<npreds;j++)
 		predk[j] = j;
-	      std::partial_sort(predk.begin(),predk.begin()+k-1,predk.end(),acc_comp(predictions));
+	      std::partial_sort(predk.begin(),predk.begin()+k-1,predk.end(),
+				[predictions](int a, int b){ return predictions[a] > predictions[b]; });
+	      double target = md.target_value(i);
 	      for (int l=0;l<k;l++)
-		if (predk.at(l) == bad.get("target").get<double>())
+		if (predk.at(l) == target)
 		  {
 		    acc++;
 		    break;
@@ -1037,10 +1117,10 @@ namespace dd
       return accs;
     }
 
-    static double acc_v(const APIData &ad, double &meanacc, double &meaniou, std::vector<double> &clacc, std::vector<double> &cliou)
+    static double acc_v(const MeasureData &md, double &meanacc, double &meaniou, std::vector<double> &clacc, std::vector<double> &cliou)
     {
-      int nclasses = ad.get("nclasses").get<int>();
-      int batch_size = ad.get("batch_size").get<int>();
+      int nclasses = md._nclasses;
+      int batch_size = md._batch_size;
       std::vector<double> mean_acc(nclasses,0.0);
       std::vector<double> mean_acc_bs(nclasses,0.0);
       std::vector<double> mean_iou_bs(nclasses,0.0);
@@ -1050,17 +1130,20 @@ namespace dd
       meaniou = 0.0;
       for (int i=0;i<batch_size;i++)
 	{
-	  APIData bad = ad.getobj(std::to_string(i));
-	  std::vector<double> predictions = bad.get("pred").get<std::vector<double>>(); // all best-1
-	  std::vector<double> targets = bad.get("target").get<std::vector<double>>(); // all targets against best-1
-	  dVec dpred = dVec::Map(&predictions.at(0),predictions.size());
-	  dVec dtarg = dVec::Map(&targets.at(0),targets.size());
-	  dVec ddiff = dpred - dtarg;
-	  double acc = (ddiff.cwiseAbs().array() == 0).count() / static_cast<double>(dpred.size());
+	  Eigen::Map<const dVec> dpred(md.pred(i),md.pred_size(i)); // all best-1
+	  Eigen::Map<const dVec> dtarg(md.target(i),md.target_size(i)); // all targets against best-1
+	  double acc = ((dpred - dtarg).cwiseAbs().array() == 0).count() / static_cast<double>(dpred.size());
 	  acc_v += acc;
-	  
-	  for (int c=0;c<nclasses;c++)
+	}
+
+      // classes are independent from each other
+#pragma omp parallel for
+      for (int c=0;c<nclasses;c++)
+	{
+	  for (int i=0;i<batch_size;i++)
 	    {
+	      Eigen::Map<const dVec> dpred(md.pred(i),md.pred_size(i));
+	      Eigen::Map<const dVec> dtarg(md.target(i),md.target_size(i));
 	      dVec dpredc = (dpred.array() == c).select(dpred,dVec::Constant(dpred.size(),-2.0));
 	      dVec dtargc = (dtarg.array() == c).select(dtarg,dVec::Constant(dtarg.size(),-1.0));
 	      dVec ddiffc = dpredc - dtargc;
@@ -1090,7 +1173,6 @@ namespace dd
             mean_iou_bs[c]++;
           // another possible waywould be to put artificially iou to one if nothing is to be
           // predicted for class c
-
 	    }
 	}
       int c_nclasses = 0;
@@ -1117,29 +1199,30 @@ namespace dd
     }
 
     // multilabel measures
-    static double multilabel_acc(const APIData &ad, double &sensitivity, double &specificity,
+    static double multilabel_acc(const MeasureData &md, double &sensitivity, double &specificity,
 				 double &harmmean, double &precision, double &f1)
     {
-      int batch_size = ad.get("batch_size").get<int>();
+      int batch_size = md._batch_size;
       double tp = 0.0;
       double fp = 0.0;
       double tn = 0.0;
       double fn = 0.0;
       double count_pos = 0.0;
       double count_neg = 0.0;
+#pragma omp parallel for reduction(+:tp,fp,tn,fn,count_pos,count_neg)
       for (int i=0;i<batch_size;i++)
 	{
-	  APIData bad = ad.getobj(std::to_string(i));
-	  std::vector<double> targets = bad.get("target").get<std::vector<double>>();
-	  std::vector<double> predictions = bad.get("pred").get<std::vector<double>>();
-	  for (size_t j=0;j<predictions.size();j++)
+	  const double *targets = md.target(i);
+	  const double *predictions = md.pred(i);
+	  int npreds = md.pred_size(i);
+	  for (int j=0;j<npreds;j++)
 	    {
-	      if (targets.at(j) < 0)
+	      if (targets[j] < 0)
 		continue;
-	      if (targets.at(j) >= 0.5)
+	      if (targets[j] >= 0.5)
 		{
 		  // positive accuracy
-		  if (predictions.at(j) >= 0)
+		  if (predictions[j] >= 0)
 		    ++tp;
 		  else ++fn;
 		  ++count_pos;
@@ -1147,7 +1230,7 @@ namespace dd
 	      else
 		{
 		  // negative accuracy
-		  if (predictions.at(j) < 0)
+		  if (predictions[j] < 0)
 		    ++tn;
 		  else ++fp;
 		  ++count_neg;
@@ -1163,18 +1246,16 @@ namespace dd
       return f1;
     }
 
-    static double multilabel_soft_kl(const APIData &ad, float thres)
+    static double multilabel_soft_kl(const MeasureData &md, float thres)
     {
       double kl_divergence = 0;
       long int total_number = 0;
-      int batch_size = ad.get("batch_size").get<int>();
+      int batch_size = md._batch_size;
+#pragma omp parallel for reduction(+:kl_divergence,total_number)
       for (int i=0;i<batch_size;i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
-          std::vector<double> targets = bad.get("target").get<std::vector<double>>();
-          std::vector<double> predictions = bad.get("pred").get<std::vector<double>>();
-          dVec dpred = dVec::Map(&predictions.at(0), predictions.size());
-          dVec dtarg = dVec::Map(&targets.at(0), targets.size());
+          Eigen::Map<const dVec> dpred(md.pred(i), md.pred_size(i));
+          Eigen::Map<const dVec> dtarg(md.target(i), md.target_size(i));
           double eps = 0.00001;
           dVec dprede = (dpred.array() < eps).select(eps, dpred);
           dVec dtarge = (dtarg.array() < eps).select(eps, dtarg);
@@ -1194,18 +1275,16 @@ namespace dd
       return kl_divergence / (double)total_number;
     }
 
-    static double multilabel_soft_js(const APIData &ad, float thres)
+    static double multilabel_soft_js(const MeasureData &md, float thres)
     {
-      int batch_size = ad.get("batch_size").get<int>();
+      int batch_size = md._batch_size;
       double js_divergence = 0;
       long int total_number = 0;
+#pragma omp parallel for reduction(+:js_divergence,total_number)
       for (int i=0;i<batch_size;i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
-          std::vector<double> targets = bad.get("target").get<std::vector<double>>();
-          std::vector<double> predictions = bad.get("pred").get<std::vector<double>>();
-          dVec dpred = dVec::Map(&predictions.at(0), predictions.size());
-          dVec dtarg = dVec::Map(&targets.at(0), targets.size());
+          Eigen::Map<const dVec> dpred(md.pred(i), md.pred_size(i));
+          Eigen::Map<const dVec> dtarg(md.target(i), md.target_size(i));
           double eps = 0.00001;
           dVec dprede = (dpred.array() < eps).select(eps, dpred);
           dVec dtarge = (dtarg.array() < eps).select(eps, dtarg);
@@ -1227,18 +1306,16 @@ namespace dd
       return js_divergence / (double)total_number;
     }
 
-    static double multilabel_soft_was(const APIData &ad, float thres)
+    static double multilabel_soft_was(const MeasureData &md, float thres)
     {
-      int batch_size = ad.get("batch_size").get<int>();
+      int batch_size = md._batch_size;
       double was = 0;
       long int total_number = 0;
+#pragma omp parallel for reduction(+:was,total_number)
       for (int i=0;i<batch_size;i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
-          std::vector<double> targets = bad.get("target").get<std::vector<double>>();
-          std::vector<double> predictions = bad.get("pred").get<std::vector<double>>();
-          dVec dpred = dVec::Map(&predictions.at(0), predictions.size());
-          dVec dtarg = dVec::Map(&targets.at(0), targets.size());
+          Eigen::Map<const dVec> dpred(md.pred(i), md.pred_size(i));
+          Eigen::Map<const dVec> dtarg(md.target(i), md.target_size(i));
           dVec dif = dtarg - dpred;
           if (thres >=0)
             {
@@ -1256,18 +1333,15 @@ namespace dd
       return was/sqrt((double)total_number);
     }
 
-    static double multilabel_soft_ks(const APIData &ad, float thres)
+    static double multilabel_soft_ks(const MeasureData &md, float thres)
     {
-      int batch_size = ad.get("batch_size").get<int>();
+      int batch_size = md._batch_size;
       double ks = 0;
       long int total_number = 0;
       for (int i=0;i<batch_size;i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
-          std::vector<double> targets = bad.get("target").get<std::vector<double>>();
-          std::vector<double> predictions = bad.get("pred").get<std::vector<double>>();
-          dVec dpred = dVec::Map(&predictions.at(0), predictions.size());
-          dVec dtarg = dVec::Map(&targets.at(0), targets.size());
+          Eigen::Map<const dVec> dpred(md.pred(i), md.pred_size(i));
+          Eigen::Map<const dVec> dtarg(md.target(i), md.target_size(i));
           dVec dif = dtarg-dpred;
           if (thres >= 0)
             {
@@ -1284,7 +1358,7 @@ namespace dd
       return ks;
     }
 
-    static int dc_pt_jk(const long int j, const long int k, const std::vector<double> &targets, const std::vector<double> & predictions, double& p_jk, double &t_jk )
+    static int dc_pt_jk(const long int j, const long int k, const double *targets, const double *predictions, double& p_jk, double &t_jk )
     {
       p_jk = fabs(predictions[j]-predictions[k]);
       t_jk = fabs(targets[j]-targets[k]);
@@ -1292,10 +1366,10 @@ namespace dd
     }
 
 
-    static double multilabel_soft_dc(const APIData &ad, float thres)
+    static double multilabel_soft_dc(const MeasureData &md, float thres)
     {
-      int batch_size = ad.get("batch_size").get<int>();
-      int nclasses = ad.getobj(std::to_string(0)).get("target").get<std::vector<double>>().size();
+      int batch_size = md._batch_size;
+      int nclasses = md.target_size(0);
 
       double distance_correlation = 0;
 
@@ -1310,9 +1384,8 @@ namespace dd
       std::vector<int> care_classes;
 
       for (int i =0; i< batch_size; ++i) {
-        APIData badj = ad.getobj(std::to_string(i));
-        std::vector<double> targets = badj.get("target").get<std::vector<double>>();
-        std::vector<double> predictions = badj.get("pred").get<std::vector<double>>();
+        const double *targets = md.target(i);
+        const double *predictions = md.pred(i);
 
         care_classes.clear();
         for (int l =0; l<nclasses; ++l)
@@ -1373,19 +1446,17 @@ namespace dd
       return distance_correlation;
     }
 
-    static double multilabel_soft_r2(const APIData &ad, float thres)
+    static double multilabel_soft_r2(const MeasureData &md, float thres)
     {
-      int batch_size = ad.get("batch_size").get<int>();
+      int batch_size = md._batch_size;
       double tmean = 0;
       long int total_number = 0;
       double ssres = 0;
+#pragma omp parallel for reduction(+:tmean,total_number,ssres)
       for (int i=0;i<batch_size;i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
-          std::vector<double> targets = bad.get("target").get<std::vector<double>>();
-          std::vector<double> predictions = bad.get("pred").get<std::vector<double>>();
-          dVec dpred = dVec::Map(&predictions.at(0), predictions.size());
-          dVec dtarg = dVec::Map(&targets.at(0), targets.size());
+          Eigen::Map<const dVec> dpred(md.pred(i), md.pred_size(i));
+          Eigen::Map<const dVec> dtarg(md.target(i), md.target_size(i));
           dVec dif = dtarg - dpred;
           if (thres >=0)
             {
@@ -1405,13 +1476,10 @@ namespace dd
 
       double sstot = 0;
 
+#pragma omp parallel for reduction(+:sstot)
       for (int i=0;i<batch_size;i++)
         {
-          APIData bad = ad.getobj(std::to_string(i));
-          std::vector<double> targets = bad.get("target").get<std::vector<double>>();
-          std::vector<double> predictions = bad.get("pred").get<std::vector<double>>();
-          dVec dpred = dVec::Map(&predictions.at(0), predictions.size());
-          dVec dtarg = dVec::Map(&targets.at(0), targets.size());
+          Eigen::Map<const dVec> dtarg(md.target(i), md.target_size(i));
           dVec temp;
           if (thres>=0)
             {
@@ -1426,58 +1494,86 @@ namespace dd
       return  1.0 - ssres/sstot;
     }
 
-    static void multilabel_soft_deltas(const APIData &ad, std::vector<double>& delta_scores, const std::vector<double>& deltas, float thres)
+    static void multilabel_soft_deltas(const MeasureData &md, std::vector<double>& delta_scores, const std::vector<double>& deltas, float thres)
     {
-      int batch_size = ad.get("batch_size").get<int>();
+      int batch_size = md._batch_size;
       long int total_number = 0;
       for (unsigned int k =0; k<deltas.size(); ++k)
         delta_scores[k] = 0;
-      for (int i=0;i<batch_size;i++)
-        {
-          APIData bad = ad.getobj(std::to_string(i));
-          std::vector<double> targets = bad.get("target").get<std::vector<double>>();
-          std::vector<double> predictions = bad.get("pred").get<std::vector<double>>();
-          dVec dpred = dVec::Map(&predictions.at(0), predictions.size());
-          dVec dtarg = dVec::Map(&targets.at(0), targets.size());
-          dVec dif;
-          if (thres >=0)
-            {
-              total_number += (dtarg.array()>thres).count();
-              dif = (dtarg.array() <= thres).select(10, (dtarg-dpred).array().abs());
-            }
-          else
-            {
-              total_number += (dtarg.array()>=0).count();
-              dif = (dtarg.array() < 0).select(10, (dtarg-dpred).array().abs());
-            }
-          for (unsigned int k=0; k<deltas.size(); ++k)
-            delta_scores[k] += (dif.array() < deltas[k]).count();
-        }
+#pragma omp parallel
+      {
+	std::vector<double> ldelta_scores(deltas.size(),0.0);
+#pragma omp for reduction(+:total_number)
+	for (int i=0;i<batch_size;i++)
+	  {
+	    Eigen::Map<const dVec> dpred(md.pred(i), md.pred_size(i));
+	    Eigen::Map<const dVec> dtarg(md.target(i), md.target_size(i));
+	    dVec dif;
+	    if (thres >=0)
+	      {
+		total_number += (dtarg.array()>thres).count();
+		dif = (dtarg.array() <= thres).select(10, (dtarg-dpred).array().abs());
+	      }
+	    else
+	      {
+		total_number += (dtarg.array()>=0).count();
+		dif = (dtarg.array() < 0).select(10, (dtarg-dpred).array().abs());
+	      }
+	    for (unsigned int k=0; k<deltas.size(); ++k)
+	      ldelta_scores[k] += (dif.array() < deltas[k]).count();
+	  }
+#pragma omp critical
+	{
+	  for (unsigned int k=0; k<deltas.size(); ++k)
+	    delta_scores[k] += ldelta_scores[k];
+	}
+      }
       for (unsigned int k =0; k<deltas.size(); ++k)
         delta_scores[k] /=  (double)total_number; // gives proportion of good in 0:1 at every threshold
 
     }
 
-
-    // measure: F1
-    static double mf1(const APIData &ad, double &precision, double &recall, double &acc, dMat &conf_diag, dMat &conf_matrix)
+    /**
+     * \brief checks discrete targets against the number of classes
+     */
+    static void check_targets(const MeasureData &md, const int &nclasses)
     {
-      int nclasses = ad.get("nclasses").get<int>();
-      double f1=0.0;
-      conf_matrix = dMat::Zero(nclasses,nclasses);
-      int batch_size = ad.get("batch_size").get<int>();
-      for (int i=0;i<batch_size;i++)
+      md.require_targets();
+      for (int i=0;i<md._batch_size;i++)
 	{
-	  APIData bad = ad.getobj(std::to_string(i));
-	  std::vector<double> predictions = bad.get("pred").get<std::vector<double>>();
-	  int maxpr = std::distance(predictions.begin(),std::max_element(predictions.begin(),predictions.end()));
-	  double target = bad.get("target").get<double>();
+	  double target = md.target_value(i);
 	  if (target < 0)
 	    throw OutputConnectorBadParamException("negative supervised discrete target (e.g. wrong use of label_offset ?");
 	  else if (target >= nclasses)
 	    throw OutputConnectorBadParamException("target class has id " + std::to_string(target) + " is higher than the number of classes " + std::to_string(nclasses) + " (e.g. wrong number of classes specified with nclasses");
-	  conf_matrix(maxpr,static_cast<int>(target)) += 1.0;
 	}
+    }
+
+    /**
+     * \brief confusion matrix, best prediction by target, accumulated per thread
+     */
+    static void confusion_matrix(const MeasureData &md, const int &nclasses, dMat &conf_matrix)
+    {
+      check_targets(md,nclasses);
+      conf_matrix = dMat::Zero(nclasses,nclasses);
+      int batch_size = md._batch_size;
+#pragma omp parallel
+      {
+	dMat lconf_matrix = dMat::Zero(nclasses,nclasses);
+#pragma omp for
+	for (int i=0;i<batch_size;i++)
+	  lconf_matrix(md.argmax(i),static_cast<int>(md.target_value(i))) += 1.0;
+#pragma omp critical
+	conf_matrix += lconf_matrix;
+      }
+    }
+
+    // measure: F1
+    static double mf1(const MeasureData &md, double &precision, double &recall, double &acc, dMat &conf_diag, dMat &conf_matrix)
+    {
+      int nclasses = md._nclasses;
+      double f1=0.0;
+      confusion_matrix(md,nclasses,conf_matrix);
       conf_diag = conf_matrix.diagonal();
       dMat conf_csum = conf_matrix.colwise().sum();
       dMat conf_rsum = conf_matrix.rowwise().sum();
@@ -1555,39 +1651,50 @@ namespace dd
       std::map<int, int> APs_count;
 
       // extract tp, fp, labels
-      APIData bad = ad.getobj("0");
+      const APIData &bad = ad.getobj_ref("0");
       int pos_count = ad.get("pos_count").get<int>();
+
+      // per image APs are computed in parallel, then merged in image order
+      std::vector<std::vector<std::pair<int,double>>> img_aps(pos_count);
+#pragma omp parallel for
       for (int i=0;i<pos_count;i++)
 	{
-         // do a mean over label AP per image in test set
-         double mAP = 0.0;
-	  std::vector<APIData> vbad = bad.getv(std::to_string(i));
-	  //std::cerr << "vbad size=" << vbad.size() << std::endl;
+	  const ad_variant_type &vv = bad.get_view(std::to_string(i));
+	  if (!vv.is<mapbox::util::recursive_wrapper<std::vector<APIData>>>())
+	    continue;
+	  const std::vector<APIData> &vbad = vv.get<mapbox::util::recursive_wrapper<std::vector<APIData>>>().get();
 	  for (size_t j=0;j<vbad.size();j++)
 	    {
-	      std::vector<double> tp_d = vbad.at(j).get("tp_d").get<std::vector<double>>();
-	      //std::cerr << "tp_d size=" << tp_d.size() << std::endl;
-	      std::vector<int> tp_i = vbad.at(j).get("tp_i").get<std::vector<int>>();
-	      std::vector<double> fp_d = vbad.at(j).get("fp_d").get<std::vector<double>>();
-	      std::vector<int> fp_i = vbad.at(j).get("fp_i").get<std::vector<int>>();
-	      int num_pos = vbad.at(j).get("num_pos").get<int>();
-	      //std::cerr << "num_pos=" << num_pos << std::endl;
-	      int label = vbad.at(j).get("label").get<int>();
-	      //std::cerr << "label=" << label << std::endl;
+	      const std::vector<double> &tp_d = vbad.at(j).get_view("tp_d").get<std::vector<double>>();
+	      const std::vector<int> &tp_i = vbad.at(j).get_view("tp_i").get<std::vector<int>>();
+	      const std::vector<double> &fp_d = vbad.at(j).get_view("fp_d").get<std::vector<double>>();
+	      const std::vector<int> &fp_i = vbad.at(j).get_view("fp_i").get<std::vector<int>>();
+	      int num_pos = vbad.at(j).get_view("num_pos").get<int>();
+	      int label = vbad.at(j).get_view("label").get<int>();
 	      std::vector<std::pair<double,int>> tp;
 	      std::vector<std::pair<double,int>> fp;
-	      
-	      //std::cerr << "fp_d size=" << fp_d.size() << std::endl;
-	      for (size_t j=0;j<tp_d.size();j++)
+	      tp.reserve(tp_d.size());
+	      fp.reserve(fp_d.size());
+	      for (size_t k=0;k<tp_d.size();k++)
 		{
-		  tp.push_back(std::pair<double,int>(tp_d.at(j),tp_i.at(j)));
+		  tp.push_back(std::pair<double,int>(tp_d.at(k),tp_i.at(k)));
 		}
-	      for (size_t j=0;j<fp_d.size();j++)
+	      for (size_t k=0;k<fp_d.size();k++)
 		{
-		  fp.push_back(std::pair<double,int>(fp_d.at(j),fp_i.at(j)));
+		  fp.push_back(std::pair<double,int>(fp_d.at(k),fp_i.at(k)));
 		}
+	      img_aps[i].push_back(std::pair<int,double>(label,compute_ap(tp,fp,num_pos)));
+	    }
+	}
 
-             double local_ap =compute_ap(tp,fp,num_pos);
+      for (int i=0;i<pos_count;i++)
+	{
+         // do a mean over label AP per image in test set
+         double mAP = 0.0;
+	  for (auto &lap: img_aps[i])
+	    {
+	      int label = lap.first;
+	      double local_ap = lap.second;
              if (APs.find(label) == APs.end())
                {
                  APs[label] = local_ap;
@@ -1598,10 +1705,9 @@ namespace dd
                  APs[label] += local_ap;
                  APs_count[label] += 1;
                }
-	      //std::cerr << "ap for label " << label << "=" << APs[label] << std::endl;
 	      mAP += local_ap;
 	    }
-	  mAP/=static_cast<double>(vbad.size());
+	  mAP/=static_cast<double>(img_aps[i].size());
          // do a mean mAP over images in test set
          mmAP += mAP;
 	}
@@ -1615,14 +1721,19 @@ namespace dd
     // measure: AUC
     static double auc(const APIData &ad)
     {
-      std::vector<double> pred1;
-      std::vector<double> targets;
-      int batch_size = ad.get("batch_size").get<int>();
-      for (int i=0;i<batch_size;i++)
+      return auc(MeasureData(ad));
+    }
+    static double auc(const MeasureData &md)
+    {
+      md.require_targets();
+      std::vector<double> pred1(md._batch_size);
+      std::vector<double> targets(md._batch_size);
+      for (int i=0;i<md._batch_size;i++)
 	{
-	  APIData bad = ad.getobj(std::to_string(i));
-	  pred1.push_back(bad.get("pred").get<std::vector<double>>().at(1));
-	  targets.push_back(bad.get("target").get<double>());
+	  if (md.pred_size(i) < 2)
+	    throw OutputConnectorBadParamException("auc requires two class predictions");
+	  pred1[i] = md.pred(i)[1];
+	  targets[i] = md.target_value(i);
 	}
       return auc(pred1,targets);
     }
@@ -1666,38 +1777,33 @@ namespace dd
     }
     
     // measure: multiclass logarithmic loss
-    static double mcll(const APIData &ad)
+    static double mcll(const MeasureData &md)
     {
+      md.require_targets();
       double ll=0.0;
-      int batch_size = ad.get("batch_size").get<int>();
+      int batch_size = md._batch_size;
       for (int i=0;i<batch_size;i++)
 	{
-	  APIData bad = ad.getobj(std::to_string(i));
-	  std::vector<double> predictions = bad.get("pred").get<std::vector<double>>();
-	  double target = bad.get("target").get<double>();
-	  ll -= std::log(predictions.at(target));
+	  double target = md.target_value(i);
+	  if (target < 0 || target >= md.pred_size(i))
+	    throw OutputConnectorBadParamException("target class has id " + std::to_string(target) + " out of the predicted classes");
 	}
+#pragma omp parallel for reduction(-:ll)
+      for (int i=0;i<batch_size;i++)
+	ll -= std::log(md.pred(i)[static_cast<int>(md.target_value(i))]);
       return ll / static_cast<double>(batch_size);
     }
 
     // measure: Mathew correlation coefficient for binary classes
     static double mcc(const APIData &ad)
     {
-      int nclasses = ad.get("nclasses").get<int>();
-      dMat conf_matrix = dMat::Zero(nclasses,nclasses);
-      int batch_size = ad.get("batch_size").get<int>();
-      for (int i=0;i<batch_size;i++)
-	{
-	  APIData bad = ad.getobj(std::to_string(i));
-	  std::vector<double> predictions = bad.get("pred").get<std::vector<double>>();
-	  int maxpr = std::distance(predictions.begin(),std::max_element(predictions.begin(),predictions.end()));
-	  double target = bad.get("target").get<double>();
-	  if (target < 0)
-	    throw OutputConnectorBadParamException("negative supervised discrete target (e.g. wrong use of label_offset ?");
-	  else if (target >= nclasses)
-	    throw OutputConnectorBadParamException("target class has id " + std::to_string(target) + " is higher than the number of classes " + std::to_string(nclasses) + " (e.g. wrong number of classes specified with nclasses");
-	  conf_matrix(maxpr,static_cast<int>(target)) += 1.0;
-	}
+      return mcc(MeasureData(ad));
+    }
+    static double mcc(const MeasureData &md)
+    {
+      int nclasses = md._nclasses;
+      dMat conf_matrix;
+      confusion_matrix(md,nclasses,conf_matrix);
       double tp = conf_matrix(0,0);
       double tn = conf_matrix(1,1);
       double fn = conf_matrix(0,1);
@@ -1709,31 +1815,30 @@ namespace dd
       return mcc;
     }
     
-    static double eucll(const APIData &ad, float thres)
+    static double eucll(const MeasureData &md, const APIData &ad, float thres)
     {
       double eucl = 0.0;
-      int batch_size = ad.get("batch_size").get<int>();
+      int batch_size = md._batch_size;
       bool has_ignore = ad.has("ignore_label");
 
       int ignore_label = -10000;
       if (has_ignore)
         ignore_label = ad.get("ignore_label").get<int>();
 
+#pragma omp parallel for reduction(+:eucl)
       for (int i=0;i<batch_size;i++)
 	{
-	  APIData bad = ad.getobj(std::to_string(i));
-	  std::vector<double> predictions = bad.get("pred").get<std::vector<double>>();
-	  std::vector<double> target;
-	  if (predictions.size() > 1)
-	    target = bad.get("target").get<std::vector<double>>();
-	  else target.push_back(bad.get("target").get<double>());
+	  const double *predictions = md.pred(i);
+	  const double *target = md.target(i);
+	  int ntargets = md.pred_size(i) > 1 ? md.target_size(i) : std::min(1,md.target_size(i));
+	  ntargets = std::min(ntargets,md.pred_size(i));
          double leucl = 0;
-	  for (size_t i=0;i<target.size();i++)
+	  for (int j=0;j<ntargets;j++)
            {
-             int t = target.at(i);
+             int t = target[j];
              if (has_ignore && t-static_cast<double>(ignore_label) < 1E-9)
                continue;
-             double diff = predictions.at(i)-target.at(i);
+             double diff = predictions[j]-target[j];
              if (thres >= 0 )
                {
                  if (fabs(diff) >= thres)
@@ -1771,20 +1876,22 @@ namespace dd
     static double gini(const APIData &ad,
 		       const bool &regression)
     {
-      int batch_size = ad.get("batch_size").get<int>();
+      return gini(MeasureData(ad),regression);
+    }
+    static double gini(const MeasureData &md,
+		       const bool &regression)
+    {
+      md.require_targets();
+      int batch_size = md._batch_size;
       std::vector<double> a(batch_size);
       std::vector<double> p(batch_size);
       for (int i=0;i<batch_size;i++)
 	{
-	  APIData bad = ad.getobj(std::to_string(i));
-	  a.at(i) = bad.get("target").get<double>();
+	  a.at(i) = md.target_value(i);
 	  if (regression)
-	    p.at(i) = bad.get("pred").get<std::vector<double>>().at(0); //XXX: could be vector for multi-dimensional regression -> TODO: in supervised mode, get best pred index ?
+	    p.at(i) = md.pred(i)[0]; //XXX: could be vector for multi-dimensional regression -> TODO: in supervised mode, get best pred index ?
 	  else
-	    {
-	      std::vector<double> allpreds = bad.get("pred").get<std::vector<double>>();
-	      a.at(i) = std::distance(allpreds.begin(),std::max_element(allpreds.begin(),allpreds.end()));
-	    }
+	    a.at(i) = md.argmax(i);
 	}
       return comp_gini_normalized(a,p);
     }
@@ -112,6 +112,12 @@ namespace dd
   void SVMInputFileConn::read_svm(const APIData &ad,
 				  const std::string &fname)
   {
+    if (_stream)
+      {
+	read_svm_stream(fname);
+	return;
+      }
+
     std::ifstream svm_file(fname,std::ios::binary);
     _logger->info("SVM fname={} / open={}",fname,svm_file.is_open());
     if (!svm_file.is_open())
@@ -187,6 +193,143 @@ namespace dd
 	}
   }
 
+  void SVMInputFileConn::read_svm_stream(const std::string &fname)
+  {
+    std::ifstream svm_file(fname,std::ios::binary);
+    _logger->info("streaming SVM fname={} / open={}",fname,svm_file.is_open());
+    if (!svm_file.is_open())
+      throw InputConnectorBadParamException("cannot open file " + fname);
+
+    // feature ids, and lines count in each part
+    bool split = _svm_test_fname.empty() && _test_split > 0.0;
+    _stream_train_size = _stream_test_size = 0;
+    long int lnum = 0;
+    std::string hline, col;
+    while(std::getline(svm_file,hline))
+      {
+	long int l = lnum++;
+	hline.erase(std::remove(hline.begin(),hline.end(),'\r'),hline.end());
+	if (hline.empty())
+	  continue;
+	if (split && StreamReader<SVMline>::is_test(l,_test_split))
+	  ++_stream_test_size;
+	else ++_stream_train_size;
+	bool fpos = true;
+	std::stringstream sh(hline);
+	while(std::getline(sh,col,' '))
+	  {
+	    if (fpos)
+	      {
+		fpos = false;
+		continue;
+	      }
+	    std::vector<std::string> res = dd_utils::split(col,':');
+	    if (res.size() == 2)
+	      {
+		int fid = std::stoi(res.at(0));
+		if (fid > _max_id)
+		  _max_id = fid;
+		_fids.insert(fid);
+	      }
+	  }
+      }
+    svm_file.close();
+    if (!_svm_test_fname.empty())
+      {
+	std::ifstream svm_test_file(_svm_test_fname,std::ios::binary);
+	if (!svm_test_file.is_open())
+	  throw InputConnectorBadParamException("cannot open SVM test file " + _svm_test_fname);
+	while(std::getline(svm_test_file,hline))
+	  {
+	    hline.erase(std::remove(hline.begin(),hline.end(),'\r'),hline.end());
+	    if (!hline.empty())
+	      ++_stream_test_size;
+	  }
+      }
+    _logger->info("total number of dimensions={}",_fids.size());
+    _logger->info("streaming {} training lines and {} testing lines",_stream_train_size,_stream_test_size);
+    if (_stream_train_size == 0)
+      throw InputConnectorBadParamException("no data could be found");
+    _stream_parser = std::make_shared<SVMInputFileConn>(*this);
+    _stream_train_reader.reset();
+    _stream_test_reader.reset();
+  }
+
+  StreamReader<SVMline>::parse_func SVMInputFileConn::stream_parse_func() const
+  {
+    std::shared_ptr<SVMInputFileConn> parser = _stream_parser;
+    return [parser](std::string &line, const long int &lnum, std::vector<SVMline> &lines)
+      {
+	(void)lnum;
+	line.erase(std::remove(line.begin(),line.end(),'\r'),line.end());
+	if (line.empty())
+	  return;
+	std::unordered_map<int,double> vals;
+	int label = -1;
+	parser->read_svm_line(line,vals,label);
+	lines.emplace_back(label,vals);
+      };
+  }
+
+  int SVMInputFileConn::stream_train(std::vector<SVMline> &lines, const int &n)
+  {
+    if (!_stream_parser)
+      throw InputConnectorInternalException("SVM streaming requires reading the training file first");
+    if (!_stream_train_reader)
+      {
+	_stream_train_reader = std::make_shared<StreamReader<SVMline>>();
+	_stream_train_reader->_test_split = _svm_test_fname.empty() ? _test_split : -1.0;
+	_stream_train_reader->_shuffle_window = _stream_shuffle ? _shuffle_window : 0;
+	_stream_train_reader->_seed = _stream_seed;
+	_stream_train_reader->_prefetch = _stream_prefetch;
+	_stream_train_reader->start(_svm_fname,0,stream_parse_func(),0,true);
+      }
+    try
+      {
+	return _stream_train_reader->next(lines,n);
+      }
+    catch (InputConnectorBadParamException &e)
+      {
+	throw;
+      }
+    catch (std::exception &e)
+      {
+	throw InputConnectorBadParamException(std::string("error streaming SVM training data: ") + e.what());
+      }
+  }
+
+  void SVMInputFileConn::reset_stream_test()
+  {
+    if (!_stream_parser)
+      return;
+    bool test_file = !_svm_test_fname.empty();
+    if (!_stream_test_reader)
+      _stream_test_reader = std::make_shared<StreamReader<SVMline>>();
+    _stream_test_reader->_test_split = test_file ? -1.0 : _test_split;
+    _stream_test_reader->_prefetch = _stream_prefetch;
+    _stream_test_reader->start(test_file ? _svm_test_fname : _svm_fname,0,stream_parse_func(),test_file ? -1 : 1,false);
+  }
+
+  int SVMInputFileConn::stream_test(std::vector<SVMline> &lines, const int &n)
+  {
+    if (!_stream_test_reader)
+      reset_stream_test();
+    if (!_stream_test_reader || _stream_test_size == 0)
+      return 0;
+    try
+      {
+	return _stream_test_reader->next(lines,n);
+      }
+    catch (InputConnectorBadParamException &e)
+      {
+	throw;
+      }
+    catch (std::exception &e)
+      {
+	throw InputConnectorBadParamException(std::string("error streaming SVM testing data: ") + e.what());
+      }
+  }
+
   void SVMInputFileConn::serialize_vocab()
   {
     std::string vocabfname = _model_repo + "/" + _vocabfname;
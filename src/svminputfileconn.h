@@ -23,6 +23,7 @@
 #define SVMINPUTFILECONN_H
 
 #include "inputconnectorstrategy.h"
+#include "utils/streamreader.hpp"
 #include <random>
 #include <algorithm>
 
@@ -80,6 +81,18 @@ namespace dd
     {
       if (ad_input.has("test_split"))
 	_test_split = ad_input.get("test_split").get<double>();
+
+      // streaming from file
+      if (ad_input.has("stream"))
+	_stream = ad_input.get("stream").get<bool>();
+      if (ad_input.has("shuffle_window"))
+	_shuffle_window = ad_input.get("shuffle_window").get<int>();
+      if (ad_input.has("stream_prefetch"))
+	_stream_prefetch = ad_input.get("stream_prefetch").get<int>();
+      if (ad_input.has("shuffle"))
+	_stream_shuffle = ad_input.get("shuffle").get<bool>();
+      if (ad_input.has("seed"))
+	_stream_seed = ad_input.get("seed").get<int>();
     }
 
     void shuffle_data(const APIData &ad)
@@ -147,6 +160,7 @@ namespace dd
 	    }
 	  else // training from posted data (in-memory)
 	    {
+	      _stream = false;
 	      for (size_t i=1;i<_uris.size();i++)
 		{
 		  DataEl<DDSvm> ddsvm;
@@ -181,7 +195,7 @@ namespace dd
 	      ddsvm.read_element(_uris.at(i),this->_logger);
 	    }
 	}
-      if (_db_fname.empty() && _svmdata.empty())
+      if (_db_fname.empty() && _svmdata.empty() && !_stream)
 	throw InputConnectorBadParamException("no data could be found");
     }
 
@@ -207,6 +221,39 @@ namespace dd
 		       std::unordered_map<int,double> &vals,
 		       int &label);
 
+    /**
+     * \brief prepares streaming of training data from file: collects feature ids
+     *        and counts lines in the training and testing parts, without holding the data in memory
+     * @param fname training file name
+     */
+    void read_svm_stream(const std::string &fname);
+
+    /**
+     * \brief parser of streamed lines
+     */
+    StreamReader<SVMline>::parse_func stream_parse_func() const;
+
+    /**
+     * \brief gets the next streamed training lines, the training data are looped over
+     * @param lines parsed lines are appended to this vector
+     * @param n number of lines
+     * @return number of lines appended
+     */
+    int stream_train(std::vector<SVMline> &lines, const int &n);
+
+    /**
+     * \brief restarts streaming of the testing data
+     */
+    void reset_stream_test();
+
+    /**
+     * \brief gets the next streamed testing lines
+     * @param lines parsed lines are appended to this vector
+     * @param n max number of lines
+     * @return number of lines appended, 0 when the testing data is exhausted
+     */
+    int stream_test(std::vector<SVMline> &lines, const int &n);
+
     int batch_size() const
     {
       return _svmdata.size();
@@ -231,6 +278,16 @@ namespace dd
     std::string _svm_fname;
     std::string _svm_test_fname;
     double _test_split = -1;
+    bool _stream = false; /**< whether training data is streamed from file instead of held in memory. */
+    int _shuffle_window = 100000; /**< number of lines shuffled together when streaming. */
+    int _stream_prefetch = 16; /**< number of blocks of lines read ahead when streaming. */
+    bool _stream_shuffle = false;
+    int _stream_seed = -1;
+    long int _stream_train_size = 0; /**< number of streamed training lines. */
+    long int _stream_test_size = 0; /**< number of streamed testing lines. */
+    std::shared_ptr<SVMInputFileConn> _stream_parser; /**< parsing state for streamed lines. */
+    std::shared_ptr<StreamReader<SVMline>> _stream_train_reader;
+    std::shared_ptr<StreamReader<SVMline>> _stream_test_reader;
 
     // data
     std::vector<SVMline> _svmdata;
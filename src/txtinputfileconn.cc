@@ -24,6 +24,7 @@
 #include "utils/utils.hpp"
 #include <boost/tokenizer.hpp>
 #include <iostream>
+#include <thread>
 
 namespace dd
 {
@@ -148,69 +149,77 @@ namespace dd
       }
     
     // parse content
-    // XXX: parallelize with openmp -> requires thread safe parse_content
-    for (std::pair<std::string,int> &p: lfiles)
+    if (!_ctfc->_characters)
       {
-	std::ifstream txt_file(p.first);
-	if (!txt_file.is_open())
-	  throw InputConnectorBadParamException("cannot open file " + p.first);
-	std::stringstream buffer;
-	buffer << txt_file.rdbuf();
-	std::string ct = buffer.str();
-	_ctfc->parse_content(ct,p.second,test_dir);
+	_ctfc->parse_bow(lfiles.size(),
+			 [&lfiles](const size_t &i, std::string &buf, const char *&begin, const char *&end, float &target)
+			 {
+			   const std::pair<std::string,int> &p = lfiles[i];
+			   std::ifstream txt_file(p.first,std::ios::binary);
+			   if (!txt_file.is_open())
+			     throw InputConnectorBadParamException("cannot open file " + p.first);
+			   txt_file.seekg(0,std::ios::end);
+			   buf.resize(std::max<std::streamoff>(0,txt_file.tellg()));
+			   txt_file.seekg(0,std::ios::beg);
+			   txt_file.read(&buf[0],buf.size());
+			   buf.resize(txt_file.gcount());
+			   begin = buf.data();
+			   end = begin + buf.size();
+			   target = p.second;
+			 },test_dir);
       }
-
-    // post-processing
-    size_t initial_vocab_size = _ctfc->_vocab.size();
-    if (_ctfc->_train && !test_dir)
-      {
-	auto vhit = _ctfc->_vocab.begin();
-	while(vhit!=_ctfc->_vocab.end())
-	  {
-	    if ((*vhit).second._total_count < _ctfc->_min_count)
-	      vhit = _ctfc->_vocab.erase(vhit);
-	    else ++vhit;
-	  }
-      }
-    if (_ctfc->_train && !test_dir && initial_vocab_size != _ctfc->_vocab.size())
+    else
       {
-	// update pos
-	int pos = 0;
-	auto vhit = _ctfc->_vocab.begin();
-	while(vhit!=_ctfc->_vocab.end())
+	for (std::pair<std::string,int> &p: lfiles)
 	  {
-	    (*vhit).second._pos = pos;
-	    ++pos;
-	    ++vhit;
+	    std::ifstream txt_file(p.first);
+	    if (!txt_file.is_open())
+	      throw InputConnectorBadParamException("cannot open file " + p.first);
+	    std::stringstream buffer;
+	    buffer << txt_file.rdbuf();
+	    std::string ct = buffer.str();
+	    _ctfc->parse_content(ct,p.second,test_dir);
 	  }
       }
 
+    // post-processing
+    size_t initial_vocab_size = _ctfc->_vocab.size();
+    std::vector<int> remap;
+    if (_ctfc->_train && !test_dir)
+      remap = _ctfc->_vocab.prune(_ctfc->_min_count);
+
     if (!_ctfc->_characters && !test_dir && (initial_vocab_size != _ctfc->_vocab.size() || _ctfc->_tfidf))
       {
-	// clearing up the corpus + tfidf
-	std::unordered_map<std::string,Word>::iterator whit;
-	for (TxtEntry<double> *te: _ctfc->_txt)
+	// clearing up the corpus + tfidf, renumbering preserves the order of words
+	std::vector<const Word*> words(_ctfc->_vocab.size(),nullptr);
+	for (size_t i=0;i<_ctfc->_vocab.size();i++)
+	  {
+	    const Word &w = _ctfc->_vocab.word(i);
+	    if (w._pos >= 0 && w._pos < static_cast<int>(words.size()))
+	      words[w._pos] = &w;
+	  }
+	double ndocs = _ctfc->_txt.size();
+#pragma omp parallel for schedule(dynamic,256)
+	for (size_t d=0;d<_ctfc->_txt.size();d++)
 	  {
-	    TxtBowEntry *tbe = static_cast<TxtBowEntry*>(te);
-	    auto hit = tbe->_v.begin();
-	    while(hit!=tbe->_v.end())
+	    TxtBowEntry *tbe = static_cast<TxtBowEntry*>(_ctfc->_txt[d]);
+	    std::pair<int,double> *out = tbe->begin();
+	    for (std::pair<int,double> &e: *tbe)
 	      {
-		if ((whit=_ctfc->_vocab.find((*hit).first))!=_ctfc->_vocab.end())
-		  {
-		    if (_ctfc->_tfidf)
-		      {
-			Word w = (*whit).second;
-			(*hit).second = (std::log(1.0+(*hit).second / static_cast<double>(w._total_count))) * std::log(_ctfc->_txt.size() / static_cast<double>(w._total_docs) + 1.0);
-			//std::cerr << "tfidf feature w=" << (*hit).first << " / val=" << (*hit).second << std::endl;
-		      }
-		    ++hit;
-		  }
-		else 
+		int pos = e.first;
+		if (!remap.empty())
+		  pos = pos < static_cast<int>(remap.size()) ? remap[pos] : -1;
+		if (pos < 0)
+		  continue;
+		double val = e.second;
+		if (_ctfc->_tfidf && words[pos])
 		  {
-		    //std::cerr << "removing ws=" << (*hit).first << std::endl;
-		    hit = tbe->_v.erase(hit);
+		    const Word &w = *words[pos];
+		    val = (std::log(1.0+val / static_cast<double>(w._total_count))) * std::log(ndocs / static_cast<double>(w._total_docs) + 1.0);
 		  }
+		*out++ = std::pair<int,double>(pos,val);
 	      }
+	    tbe->_len = tbe->begin() ? out - tbe->begin() : 0;
 	  }
       }
 
@@ -239,6 +248,41 @@ namespace dd
   {
     if (!_train && content.empty())
       throw InputConnectorBadParamException("no text data found");
+    if (!_characters)
+      {
+	if (!_sentences)
+	  {
+	    parse_bow(1,[&content,&target](const size_t &i, std::string &buf, const char *&begin, const char *&end, float &t)
+		      {
+			(void)i; (void)buf;
+			begin = content.data();
+			end = begin + content.size();
+			t = target;
+		      },test);
+	    return;
+	  }
+
+	// sentences are parsed in parallel, in blocks of lines
+	std::vector<const char*> bounds = {content.data()};
+	const char *cend = content.data() + content.size();
+	const size_t block = 1 << 16;
+	while (bounds.back() != cend)
+	  {
+	    const char *p = std::min(cend,bounds.back() + block);
+	    const char *nl = p < cend ? static_cast<const char*>(memchr(p,'\n',cend-p)) : nullptr;
+	    bounds.push_back(nl ? nl + 1 : cend);
+	  }
+	parse_bow(bounds.size()-1,[&bounds,&target](const size_t &i, std::string &buf, const char *&begin, const char *&end, float &t)
+		  {
+		    (void)buf;
+		    begin = bounds[i];
+		    end = bounds[i+1];
+		    t = target;
+		  },test);
+	return;
+      }
+
+    // character-level features
     std::vector<std::string> cts;
     if (_sentences)
       {
@@ -254,96 +298,217 @@ namespace dd
     for (std::string ct: cts)
       {
 	std::transform(ct.begin(),ct.end(),ct.begin(),::tolower);
-	if (!_characters)
+	if (_seq_forward)
+	  std::reverse(ct.begin(),ct.end());
+	TxtCharEntry *tce = new TxtCharEntry(target);
+	std::unordered_map<uint32_t,int>::const_iterator whit;
+	boost::char_separator<char> sep("\n\t\f\r");
+	boost::tokenizer<boost::char_separator<char>> tokens(ct,sep);
+	int seq = 0;
+	bool prev_space = false;
+	for (std::string w: tokens)
+	  {
+	    char *str = (char*)w.c_str();
+	    char *str_i = str;
+	    char *end = str+strlen(str)+1;
+	    do
+	    {
+	      uint32_t c = 0;
+	      try
+		{
+		  c = utf8::next(str_i,end);
+		}
+	      catch(...)
+		{
+		  _logger->error("Invalid UTF-8 character in {}",w);
+		  c = 0;
+		  ++str_i;
+		}
+	      if (c == 0)
+		continue;
+	      if ((whit=_alphabet.find(c))==_alphabet.end())
+		{
+		  if (!prev_space)
+		    {
+		      tce->add_char(' ');
+		      seq++;
+		      prev_space = true;
+		    }
+		}
+	      else 
+		{
+		  tce->add_char(c);
+		  seq++;
+		  prev_space = false;
+		}
+	    }
+	    while(str_i<end && seq < _sequence);
+	  }
+	if (!test)
+	  _txt.push_back(tce);
+	else _test_txt.push_back(tce);
+	std::cerr << "\rloaded text samples=" << _txt.size();
+      }
+  }
+
+  void TxtInputFileConn::parse_bow(const size_t &ninputs,
+				   const bow_loader &load,
+				   const bool &test)
+  {
+    // contiguous ranges of inputs, so that merging chunks in order yields
+    // words in order of first appearance, as a sequential parsing would
+    size_t nthreads = std::max(1u,std::thread::hardware_concurrency());
+    size_t nchunks = std::max<size_t>(1,std::min(ninputs / 16,4*nthreads));
+    std::vector<TxtBowChunk> chunks(nchunks);
+    std::vector<std::exception_ptr> eptrs(nchunks);
+#pragma omp parallel for schedule(dynamic)
+    for (size_t k=0;k<nchunks;k++)
+      {
+	try
 	  {
-	    TxtBowEntry *tbe = new TxtBowEntry(target);
-	    std::unordered_map<std::string,Word>::iterator vhit;
-	    boost::char_separator<char> sep("\n\t\f\r ,.;:`'!?)(-|><^·&\"\\/{}#$–=+");
-	    boost::tokenizer<boost::char_separator<char>> tokens(ct,sep);
-	    for (std::string w : tokens)
+	    parse_bow_chunk((ninputs * k) / nchunks,(ninputs * (k+1)) / nchunks,load,chunks[k]);
+	  }
+	catch (...)
+	  {
+	    eptrs[k] = std::current_exception();
+	  }
+      }
+    for (auto &eptr: eptrs)
+      if (eptr)
+	std::rethrow_exception(eptr);
+
+    std::vector<TxtEntry<double>*> &txt = test ? _test_txt : _txt;
+    std::vector<int> remap;
+    for (TxtBowChunk &chunk: chunks)
+      {
+	// merge chunk vocabulary, and move documents to global word positions
+	bool sorted = true;
+	if (_train)
+	  {
+	    remap.resize(chunk._vocab.size());
+	    for (size_t i=0;i<chunk._vocab.size();i++)
+	      {
+		const Word &cw = chunk._vocab.word(i);
+		Word *w = _vocab.find(chunk._vocab.key_data(i),chunk._vocab.key_size(i),chunk._vocab.key_hash(i));
+		if (!w)
+		  w = &_vocab.insert(chunk._vocab.key_data(i),chunk._vocab.key_size(i),chunk._vocab.key_hash(i),
+				     Word(_vocab.size(),0,0));
+		w->_total_count += cw._total_count;
+		w->_total_docs += cw._total_docs;
+		remap[cw._pos] = w->_pos;
+		sorted = sorted && (i == 0 || remap[i-1] < remap[i]);
+	      }
+	  }
+	TxtBowArena &elts = *chunk._elts;
+	for (size_t d=0;d+1<chunk._docs.size();d++)
+	  {
+	    size_t off = chunk._docs[d];
+	    size_t len = chunk._docs[d+1] - off;
+	    if (_train)
+	      {
+		for (size_t e=off;e<off+len;e++)
+		  elts[e].first = remap[elts[e].first];
+		if (!sorted)
+		  std::sort(elts.begin()+off,elts.begin()+off+len);
+	      }
+	    txt.push_back(new TxtBowEntry(chunk._targets[d],chunk._elts,off,len));
+	  }
+      }
+  }
+
+  void TxtInputFileConn::parse_bow_chunk(const size_t &start,
+					 const size_t &end,
+					 const bow_loader &load,
+					 TxtBowChunk &chunk) const
+  {
+    // byte-wise separators and lowercasing, as with a char tokenizer over lowercased text
+    static const std::string seps = "\n\t\f\r ,.;:`'!?)(-|><^·&\"\\/{}#$–=+";
+    bool sep[256] = {false};
+    for (unsigned char c: seps)
+      sep[c] = true;
+    char lower[256];
+    for (int c=0;c<256;c++)
+      lower[c] = static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+
+    std::string buf, word;
+    std::vector<int> ids;
+    TxtBowArena &elts = *chunk._elts;
+    for (size_t i=start;i<end;i++)
+      {
+	const char *begin = nullptr, *cend = nullptr;
+	float target = -1;
+	load(i,buf,begin,cend,target);
+	if (!_train && begin == cend)
+	  throw InputConnectorBadParamException("no text data found");
+	const char *p = begin;
+	while (p != cend || (!_sentences && p == begin))
+	  {
+	    // one document per line with sentences, empty lines are skipped
+	    const char *dend = cend;
+	    if (_sentences)
 	      {
-		if (static_cast<int>(w.length()) < _min_word_length)
+		const char *nl = static_cast<const char*>(memchr(p,'\n',cend-p));
+		dend = nl ? nl : cend;
+		if (dend == p)
+		  {
+		    p = nl ? nl + 1 : cend;
+		    continue;
+		  }
+	      }
+
+	    ids.clear();
+	    const char *q = p;
+	    while (q < dend)
+	      {
+		while (q < dend && sep[static_cast<unsigned char>(*q)])
+		  ++q;
+		const char *wb = q;
+		while (q < dend && !sep[static_cast<unsigned char>(*q)])
+		  ++q;
+		size_t len = q - wb;
+		if (len == 0 || static_cast<int>(len) < _min_word_length)
 		  continue;
-		
-		// check and fillup vocab.
-		int pos = -1;
-		if ((vhit=_vocab.find(w))==_vocab.end())
+		word.resize(len);
+		uint64_t h = 14695981039346656037ULL;
+		for (size_t c=0;c<len;c++)
 		  {
-		    if (_train)
-		      {
-			pos = _vocab.size();
-			_vocab.emplace(std::make_pair(w,Word(pos)));
-		      }
+		    word[c] = lower[static_cast<unsigned char>(wb[c])];
+		    h = (h ^ static_cast<unsigned char>(word[c])) * 1099511628211ULL;
+		  }
+		if (_train)
+		  {
+		    Word *w = chunk._vocab.find(word.data(),len,h);
+		    if (!w)
+		      w = &chunk._vocab.insert(word.data(),len,h,Word(chunk._vocab.size(),0,0));
+		    w->_total_count++;
+		    ids.push_back(w->_pos);
 		  }
 		else
 		  {
-		    if (_train)
-		      {
-			(*vhit).second._total_count++;
-			if (!tbe->has_word(w))
-			  (*vhit).second._total_docs++;
-		      }
+		    const Word *w = _vocab.find(word.data(),len,h);
+		    if (w)
+		      ids.push_back(w->_pos);
 		  }
-		tbe->add_word(w,1.0,_count);
 	      }
-	    if (!test)
-	      _txt.push_back(tbe);
-	    else _test_txt.push_back(tbe);
-	  }
-	else // character-level features
-	  {
-	    if (_seq_forward)
-	      std::reverse(ct.begin(),ct.end());
-	    TxtCharEntry *tce = new TxtCharEntry(target);
-	    std::unordered_map<uint32_t,int>::const_iterator whit;
-	    boost::char_separator<char> sep("\n\t\f\r");
-	    boost::tokenizer<boost::char_separator<char>> tokens(ct,sep);
-	    int seq = 0;
-	    bool prev_space = false;
-	    for (std::string w: tokens)
+
+	    // sorted (position,value) pairs
+	    std::sort(ids.begin(),ids.end());
+	    for (size_t k=0;k<ids.size();)
 	      {
-		char *str = (char*)w.c_str();
-		char *str_i = str;
-		char *end = str+strlen(str)+1;
-		do
-		{
-		  uint32_t c = 0;
-		  try
-		    {
-		      c = utf8::next(str_i,end);
-		    }
-		  catch(...)
-		    {
-		      _logger->error("Invalid UTF-8 character in {}",w);
-		      c = 0;
-		      ++str_i;
-		    }
-		  if (c == 0)
-		    continue;
-		  if ((whit=_alphabet.find(c))==_alphabet.end())
-		    {
-		      if (!prev_space)
-			{
-			  tce->add_char(' ');
-			  seq++;
-			  prev_space = true;
-			}
-		    }
-		  else 
-		    {
-		      tce->add_char(c);
-		      seq++;
-		      prev_space = false;
-		    }
-		}
-		while(str_i<end && seq < _sequence);
+		size_t n = 1;
+		while (k+n < ids.size() && ids[k+n] == ids[k])
+		  ++n;
+		elts.push_back(std::pair<int,double>(ids[k],_count ? static_cast<double>(n) : 1.0));
+		if (_train)
+		  chunk._vocab.word(ids[k])._total_docs++;
+		k += n;
 	      }
-	    if (!test)
-	      _txt.push_back(tce);
-	    else _test_txt.push_back(tce);
-	    std::cerr << "\rloaded text samples=" << _txt.size();
+	    chunk._docs.push_back(elts.size());
+	    chunk._targets.push_back(target);
+	    p = dend == cend ? cend : dend + 1;
+	    if (!_sentences)
+	      break;
 	  }
-
       }
   }
 
@@ -355,9 +520,10 @@ namespace dd
     out.open(vocabfname);
     if (!out.is_open())
       throw InputConnectorBadParamException("failed opening vocabulary file " + vocabfname);
-    for (auto const &p: _vocab)
+    for (size_t i=0;i<_vocab.size();i++)
       {
-	out << p.first << delim << p.second._pos << std::endl;
+	out.write(_vocab.key_data(i),_vocab.key_size(i));
+	out << delim << _vocab.word(i)._pos << std::endl;
       }
     out.close();
   }
@@ -381,7 +547,7 @@ namespace dd
 	std::vector<std::string> tokens = dd_utils::split(line,',');
 	std::string key = tokens.at(0);
 	int pos = std::atoi(tokens.at(1).c_str());
-	_vocab.emplace(std::make_pair(key,Word(pos)));
+	_vocab.insert(key,Word(pos));
       }
     _logger->info("loaded vocabulary of size={}",_vocab.size());
   }
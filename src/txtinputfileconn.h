@@ -25,6 +25,9 @@
 #include "inputconnectorstrategy.h"
 #include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <functional>
+#include <memory>
 #include <random>
 #include "utf8.h"
 
@@ -80,58 +83,228 @@ namespace dd
     std::string _uri;
   };
   
-  class TxtBowEntry: public TxtEntry<double>
+  /**
+   * \brief vocabulary as an open-addressing hash table, words are stored in a single
+   *        character arena along with their hash, computed once at tokenization time
+   */
+  class Vocab
   {
   public:
-  TxtBowEntry():TxtEntry<double>() {};
-  TxtBowEntry(const float &target):TxtEntry<double>(target) {}
-    virtual ~TxtBowEntry() {}
+    Vocab() {}
+    ~Vocab() {}
+
+    static uint64_t hash(const char *s, const size_t &len)
+    {
+      uint64_t h = 14695981039346656037ULL; // FNV-1a
+      for (size_t i=0;i<len;i++)
+	h = (h ^ static_cast<unsigned char>(s[i])) * 1099511628211ULL;
+      return h;
+    }
+
+    /**
+     * \brief looks a word up
+     * @param s word
+     * @param len word length
+     * @param h word hash
+     * @return word stats, nullptr if not found
+     */
+    Word* find(const char *s, const size_t &len, const uint64_t &h)
+    {
+      if (_slots.empty())
+	return nullptr;
+      for (size_t i=h&_mask;;i=(i+1)&_mask)
+	{
+	  uint32_t e = _slots[i];
+	  if (e == 0)
+	    return nullptr;
+	  VocabEntry &ve = _entries[e-1];
+	  if (ve._hash == h && ve._len == len && memcmp(&_chars[ve._off],s,len) == 0)
+	    return &ve._w;
+	}
+    }
+
+    const Word* find(const char *s, const size_t &len, const uint64_t &h) const
+    {
+      return const_cast<Vocab*>(this)->find(s,len,h);
+    }
 
-    void add_word(const std::string &str,
-		  const double &v,
-		  const bool &count)
+    const Word* find(const std::string &s) const
     {
-      std::unordered_map<std::string,double>::iterator hit;
-      if ((hit=_v.find(str))!=_v.end())
+      return find(s.data(),s.size(),hash(s.data(),s.size()));
+    }
+
+    /**
+     * \brief adds a word that is not in the vocabulary yet
+     */
+    Word& insert(const char *s, const size_t &len, const uint64_t &h, const Word &w)
+    {
+      if (2*(_entries.size()+1) > _slots.size())
+	rehash(std::max<size_t>(64,2*_slots.size()));
+      VocabEntry ve;
+      ve._hash = h;
+      ve._off = _chars.size();
+      ve._len = len;
+      ve._w = w;
+      _chars.insert(_chars.end(),s,s+len);
+      _entries.push_back(ve);
+      size_t i = h&_mask;
+      while (_slots[i] != 0)
+	i = (i+1)&_mask;
+      _slots[i] = _entries.size();
+      return _entries.back()._w;
+    }
+
+    Word& insert(const std::string &s, const Word &w)
+    {
+      uint64_t h = hash(s.data(),s.size());
+      Word *fw = find(s.data(),s.size(),h);
+      if (fw)
+	return *fw;
+      return insert(s.data(),s.size(),h,w);
+    }
+
+    /**
+     * \brief removes words with less than min_count occurences, remaining words are
+     *        renumbered in order
+     * @return old to new word position, -1 for removed words
+     */
+    std::vector<int> prune(const int &min_count)
+    {
+      int max_pos = -1;
+      for (const VocabEntry &ve: _entries)
+	max_pos = std::max(max_pos,ve._w._pos);
+      std::vector<int> remap(max_pos+1,-1);
+      std::vector<VocabEntry> entries;
+      std::vector<char> chars;
+      for (VocabEntry &ve: _entries)
 	{
-	  if (count)
-	    (*hit).second += v;
+	  if (ve._w._total_count < min_count)
+	    continue;
+	  remap[ve._w._pos] = entries.size();
+	  ve._w._pos = entries.size();
+	  size_t off = chars.size();
+	  chars.insert(chars.end(),_chars.begin()+ve._off,_chars.begin()+ve._off+ve._len);
+	  ve._off = off;
+	  entries.push_back(ve);
 	}
-      else _v.insert(std::pair<std::string,double>(str,v));
+      _entries.swap(entries);
+      _chars.swap(chars);
+      rehash(_slots.size());
+      return remap;
+    }
+
+    void clear()
+    {
+      _entries.clear();
+      _chars.clear();
+      _slots.clear();
+      _mask = 0;
     }
 
-    bool has_word(const std::string &str)
+    size_t size() const { return _entries.size(); }
+    bool empty() const { return _entries.empty(); }
+
+    // access to words in order of insertion
+    const char* key_data(const size_t &i) const { return &_chars[_entries[i]._off]; }
+    size_t key_size(const size_t &i) const { return _entries[i]._len; }
+    std::string key(const size_t &i) const { return std::string(key_data(i),key_size(i)); }
+    uint64_t key_hash(const size_t &i) const { return _entries[i]._hash; }
+    Word& word(const size_t &i) { return _entries[i]._w; }
+    const Word& word(const size_t &i) const { return _entries[i]._w; }
+
+  private:
+    void rehash(const size_t &nslots)
     {
-      return _v.count(str);
+      _slots.assign(nslots,0);
+      _mask = nslots - 1;
+      for (size_t e=0;e<_entries.size();e++)
+	{
+	  size_t i = _entries[e]._hash&_mask;
+	  while (_slots[i] != 0)
+	    i = (i+1)&_mask;
+	  _slots[i] = e+1;
+	}
     }
 
+    class VocabEntry
+    {
+    public:
+      uint64_t _hash = 0;
+      size_t _off = 0; /**< offset of the word in the character arena. */
+      size_t _len = 0;
+      Word _w;
+    };
+
+    std::vector<VocabEntry> _entries; /**< words in order of insertion. */
+    std::vector<char> _chars; /**< character arena. */
+    std::vector<uint32_t> _slots; /**< hash table, entry index + 1, 0 when empty. */
+    size_t _mask = 0;
+  };
+
+  typedef std::vector<std::pair<int,double>> TxtBowArena; /**< (word position, value) for a set of documents. */
+
+  class TxtBowEntry: public TxtEntry<double>
+  {
+  public:
+  TxtBowEntry():TxtEntry<double>() {};
+  TxtBowEntry(const float &target):TxtEntry<double>(target) {}
+  TxtBowEntry(const float &target,
+	      const std::shared_ptr<TxtBowArena> &arena,
+	      const size_t &off,
+	      const size_t &len)
+    :TxtEntry<double>(target),_arena(arena),_off(off),_len(len) {}
+    virtual ~TxtBowEntry() {}
+
     void reset()
     {
-      _vit = _v.begin();
+      _vit = 0;
     }
 
-    void get_next_elt(std::string &key, double &val)
+    void get_next_elt(int &key, double &val)
     {
-      if (_vit!=_v.end())
+      if (_vit < _len)
 	{
-	  key = (*_vit).first;
-	  val = (*_vit).second;
+	  const std::pair<int,double> &e = (*_arena)[_off+_vit];
+	  key = e.first;
+	  val = e.second;
 	  ++_vit;
 	}
     }
 
     bool has_elt() const
     {
-      return _vit != _v.end();
+      return _vit < _len;
     }
     
     size_t size() const
     {
-      return _v.size();
+      return _len;
     }
 
-    std::unordered_map<std::string,double> _v; /**< words as (<pos,val>). */
-    std::unordered_map<std::string,double>::iterator _vit;
+    // words, sorted by position
+    std::pair<int,double>* begin() { return _len ? &(*_arena)[_off] : nullptr; }
+    std::pair<int,double>* end() { return _len ? &(*_arena)[_off] + _len : nullptr; }
+
+    std::shared_ptr<TxtBowArena> _arena; /**< shared storage of words as (<pos,val>). */
+    size_t _off = 0; /**< offset of the document's words in the arena. */
+    size_t _len = 0; /**< number of words in the document. */
+    size_t _vit = 0;
+  };
+
+  /**
+   * \brief documents parsed by a single thread
+   */
+  class TxtBowChunk
+  {
+  public:
+    TxtBowChunk()
+      :_elts(std::make_shared<TxtBowArena>()) {}
+    ~TxtBowChunk() {}
+
+    Vocab _vocab; /**< chunk vocabulary in training mode, positions are chunk-local. */
+    std::shared_ptr<TxtBowArena> _elts;
+    std::vector<size_t> _docs = {0}; /**< document boundaries in _elts. */
+    std::vector<float> _targets;
   };
 
   class TxtCharEntry: public TxtEntry<double>
@@ -151,11 +324,11 @@ namespace dd
       _vit = _v.begin();
     }
 
-    void get_next_elt(std::string &key, double &val)
+    void get_next_elt(int &key, double &val)
     {
       if (_vit!=_v.end())
 	{
-	  key = std::to_string((*_vit));
+	  key = (*_vit);
 	  val = 1;
 	  ++_vit;
 	}
@@ -324,6 +497,27 @@ namespace dd
 		       const float &target=-1,
 		       const bool &test=false);
 
+    /**
+     * \brief loads input i as a [begin,end) character range and its target,
+     *        the buffer may be used as storage
+     */
+    typedef std::function<void(const size_t&,std::string&,const char*&,const char*&,float&)> bow_loader;
+
+    /**
+     * \brief parses inputs into BOW documents in parallel, then merges the chunk vocabularies
+     * @param ninputs number of inputs
+     * @param load input loader
+     * @param test whether documents go to the test set
+     */
+    void parse_bow(const size_t &ninputs,
+		   const bow_loader &load,
+		   const bool &test);
+
+    void parse_bow_chunk(const size_t &start,
+			 const size_t &end,
+			 const bow_loader &load,
+			 TxtBowChunk &chunk) const;
+
     // serialization of vocabulary
     void serialize_vocab();
     void deserialize_vocab(const bool &required=true);
@@ -352,7 +546,7 @@ namespace dd
     bool _seq_forward = false; /**< whether to read character-based sequences forward. */
     
     // internals
-    std::unordered_map<std::string,Word> _vocab; /**< string to word stats, including word */
+    Vocab _vocab; /**< string to word stats, including word */
     std::string _vocabfname = "vocab.dat";
     std::string _correspname = "corresp.txt";
     int _dirs = 0; /**< directories as input. */
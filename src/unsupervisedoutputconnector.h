@@ -95,7 +95,7 @@ namespace dd
 
     void init(const APIData &ad)
     {
-      APIData ad_out = ad.getobj("parameters").getobj("output");
+      const APIData &ad_out = ad.getobj_ref("parameters").getobj_ref("output");
       if (ad_out.has("binarized"))
 	_binarized = ad_out.get("binarized").get<bool>();
       else if (ad_out.has("bool_binarized"))
@@ -196,14 +196,18 @@ namespace dd
 	  int search_nn = _search_nn;
 	  if (ad_in.has("search_nn"))
 	    search_nn = ad_in.get("search_nn").get<int>();
+	  std::vector<std::vector<double>> queries;
+	  queries.reserve(_vvres.size());
+	  for (size_t i=0;i<_vvres.size();i++)
+	    queries.push_back(_vvres.at(i)._vals);
+	  std::vector<std::vector<URIData>> nn_uris;
+	  std::vector<std::vector<double>> nn_distances;
+	  mlm->_se->search_batch(queries,search_nn,nn_uris,nn_distances);
 	  for (size_t i=0;i<_vvres.size();i++)
 	    {
-	      std::vector<URIData> nn_uris;
-	      std::vector<double> nn_distances;
-	      mlm->_se->search(_vvres.at(i)._vals,search_nn,nn_uris,nn_distances);
-	      for (size_t j=0;j<nn_uris.size();j++)
+	      for (size_t j=0;j<nn_uris.at(i).size();j++)
 		{
-		  _vvres.at(i).add_nn(nn_distances.at(j),nn_uris.at(j)._uri);
+		  _vvres.at(i).add_nn(nn_distances.at(i).at(j),nn_uris.at(i).at(j)._uri);
 		}
 	    }
 	}
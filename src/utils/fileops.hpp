@@ -26,6 +26,8 @@
 #include <fstream>
 #include <unordered_set>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <archive.h>
@@ -319,7 +321,71 @@ namespace dd
 
       return 0;
     }
-  };  
+  };
+
+  /**
+   * \brief read-only memory mapping of a whole file
+   */
+  class mmap_file
+  {
+  public:
+    mmap_file() {}
+    mmap_file(const mmap_file &) = delete;
+    mmap_file& operator=(const mmap_file &) = delete;
+    ~mmap_file()
+    {
+      close();
+    }
+
+    /**
+     * \brief maps a file into memory
+     * @param fname file name
+     * @return true on success
+     */
+    bool open(const std::string &fname)
+    {
+      close();
+      int fd = ::open(fname.c_str(),O_RDONLY);
+      if (fd < 0)
+	return false;
+      struct stat st;
+      if (fstat(fd,&st) != 0)
+	{
+	  ::close(fd);
+	  return false;
+	}
+      _size = st.st_size;
+      if (_size > 0)
+	{
+	  void *addr = mmap(nullptr,_size,PROT_READ,MAP_PRIVATE,fd,0);
+	  if (addr == MAP_FAILED)
+	    {
+	      ::close(fd);
+	      _size = 0;
+	      return false;
+	    }
+	  madvise(addr,_size,MADV_SEQUENTIAL);
+	  _data = static_cast<const char*>(addr);
+	}
+      ::close(fd);
+      return true;
+    }
+
+    void close()
+    {
+      if (_data)
+	munmap(const_cast<char*>(_data),_size);
+      _data = nullptr;
+      _size = 0;
+    }
+
+    const char *data() const { return _data; }
+    size_t size() const { return _size; }
+
+  private:
+    const char *_data = nullptr;
+    size_t _size = 0;
+  };
 }
 
 #endif
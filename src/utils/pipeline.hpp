@@ -0,0 +1,249 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2019 Jolibrain
+ * Author: Emmanuel Benazera <beniz@droidnik.fr>
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DD_PIPELINE_H
+#define DD_PIPELINE_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace dd
+{
+  /**
+   * \brief three stages parallel pipeline with ordered output:
+   *        a sequential source, parallel workers and a single sink that receives
+   *        the work results in source order, e.g. listing, decoding and db writing.
+   *        At most 'window' elements are in flight, which bounds memory usage.
+   */
+  template <class TIn, class TOut>
+  class OrderedPipeline
+  {
+  public:
+    typedef std::function<bool(TIn&)> source_func; /**< fills up next input, returns false when exhausted. */
+    typedef std::function<bool(TIn&,TOut&)> work_func; /**< returns false to drop the element. */
+    typedef std::function<void(TOut&)> sink_func; /**< receives results in order. */
+
+    /**
+     * \brief pipeline constructor
+     * @param nworkers number of parallel workers
+     * @param window max number of elements in flight between source and sink
+     */
+    OrderedPipeline(const int &nworkers, const int &window)
+      :_nworkers(nworkers > 0 ? nworkers : 1),_window(window > _nworkers ? window : 2*_nworkers) {}
+    ~OrderedPipeline() {}
+
+    /**
+     * \brief runs the pipeline until the source is exhausted, the sink runs on the calling thread.
+     *        The first exception raised by any stage stops the pipeline and is rethrown.
+     * @param source sequential source
+     * @param work parallel work
+     * @param sink ordered sink
+     * @return number of elements that reached the sink
+     */
+    long int run(const source_func &source, const work_func &work, const sink_func &sink)
+    {
+      _next_in = _next_out = 0;
+      _exhausted = _stop = false;
+      _eptr = nullptr;
+      _results.clear();
+      _running = _nworkers;
+      std::vector<std::thread> workers;
+      for (int w=0;w<_nworkers;w++)
+	workers.push_back(std::thread([this,&source,&work](){ worker(source,work); }));
+
+      long int n = 0;
+      std::unique_lock<std::mutex> lock(_mutex);
+      while (true)
+	{
+	  _sink_cv.wait(lock,[this]{ return _eptr || _results.find(_next_out) != _results.end()
+		|| _running == 0 || (_exhausted && _next_out == _next_in); });
+	  auto hit = _results.find(_next_out);
+	  if (_eptr || hit == _results.end())
+	    break;
+	  std::pair<bool,TOut> res = std::move((*hit).second);
+	  _results.erase(hit);
+	  ++_next_out;
+	  _window_cv.notify_all();
+	  lock.unlock();
+	  std::exception_ptr eptr;
+	  if (res.first)
+	    {
+	      try
+		{
+		  sink(res.second);
+		  ++n;
+		}
+	      catch (...)
+		{
+		  eptr = std::current_exception();
+		}
+	    }
+	  lock.lock();
+	  if (eptr)
+	    fail(eptr);
+	}
+      _stop = true;
+      _window_cv.notify_all();
+      lock.unlock();
+      for (std::thread &t: workers)
+	t.join();
+      if (_eptr)
+	std::rethrow_exception(_eptr);
+      return n;
+    }
+
+  private:
+    void worker(const source_func &source, const work_func &work)
+    {
+      while (true)
+	{
+	  TIn in;
+	  long int seq = 0;
+	  {
+	    std::unique_lock<std::mutex> lock(_mutex);
+	    _window_cv.wait(lock,[this]{ return _stop || _exhausted || _next_in - _next_out < _window; });
+	    if (_stop || _exhausted)
+	      break;
+	    try
+	      {
+		if (!source(in))
+		  {
+		    _exhausted = true;
+		    _sink_cv.notify_all();
+		    _window_cv.notify_all();
+		    break;
+		  }
+	      }
+	    catch (...)
+	      {
+		fail(std::current_exception());
+		break;
+	      }
+	    seq = _next_in++;
+	  }
+	  std::pair<bool,TOut> res;
+	  try
+	    {
+	      res.first = work(in,res.second);
+	    }
+	  catch (...)
+	    {
+	      std::lock_guard<std::mutex> lock(_mutex);
+	      fail(std::current_exception());
+	      break;
+	    }
+	  std::lock_guard<std::mutex> lock(_mutex);
+	  _results.insert(std::pair<long int,std::pair<bool,TOut>>(seq,std::move(res)));
+	  _sink_cv.notify_all();
+	}
+      std::lock_guard<std::mutex> lock(_mutex);
+      --_running;
+      _sink_cv.notify_all();
+    }
+
+    /**
+     * \brief records the first failure and stops the pipeline, requires the lock
+     */
+    void fail(const std::exception_ptr &eptr)
+    {
+      if (!_eptr)
+	_eptr = eptr;
+      _stop = true;
+      _sink_cv.notify_all();
+      _window_cv.notify_all();
+    }
+
+    int _nworkers = 1;
+    int _window = 2;
+    std::mutex _mutex; /**< mutex around source, results and counters. */
+    std::condition_variable _window_cv; /**< workers wait for room in the window. */
+    std::condition_variable _sink_cv; /**< sink waits for the next result. */
+    std::map<long int,std::pair<bool,TOut>> _results; /**< finished results, by sequence number. */
+    long int _next_in = 0; /**< next sequence number from source. */
+    long int _next_out = 0; /**< next sequence number to the sink. */
+    int _running = 0;
+    bool _exhausted = false;
+    bool _stop = false;
+    std::exception_ptr _eptr;
+  };
+
+  /**
+   * \brief db writer with transactions batched by number and size of records, e.g. as the
+   *        sink of an OrderedPipeline. TDB has a NewTransaction() call that returns a new
+   *        transaction with Put(key,value) and Commit() calls, as caffe::db::DB.
+   */
+  template <class TDB>
+  class DbTxnWriter
+  {
+  public:
+    typedef typename std::remove_pointer<decltype(std::declval<TDB&>().NewTransaction())>::type txn_type;
+
+    /**
+     * \brief writer constructor
+     * @param db opened db
+     * @param max_txn_count max number of records per transaction
+     * @param max_txn_bytes max size of keys and values per transaction
+     */
+    DbTxnWriter(std::unique_ptr<TDB> &&db,
+		const int &max_txn_count=10000,
+		const size_t &max_txn_bytes=256*1024*1024)
+      :_db(std::move(db)),_txn(_db->NewTransaction()),
+       _max_txn_count(max_txn_count),_max_txn_bytes(max_txn_bytes) {}
+    ~DbTxnWriter() {}
+
+    void put(const std::string &key, const std::string &value)
+    {
+      _txn->Put(key,value);
+      _txn_bytes += key.size() + value.size();
+      if (++_txn_count >= _max_txn_count || _txn_bytes >= _max_txn_bytes)
+	commit();
+    }
+
+    void commit()
+    {
+      if (_txn_count == 0)
+	return;
+      _txn->Commit();
+      _txn.reset(_db->NewTransaction());
+      _txn_count = 0;
+      _txn_bytes = 0;
+    }
+
+    std::unique_ptr<TDB> _db;
+    std::unique_ptr<txn_type> _txn;
+    int _txn_count = 0;
+    size_t _txn_bytes = 0;
+    int _max_txn_count = 10000;
+    size_t _max_txn_bytes = 256*1024*1024;
+  };
+
+}
+
+#endif
@@ -0,0 +1,286 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2019 Jolibrain
+ * Author: Emmanuel Benazera <beniz@droidnik.fr>
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DD_STREAMREADER_H
+#define DD_STREAMREADER_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dd
+{
+  /**
+   * \brief streams parsed lines of a text file in blocks, read and parsed ahead of use
+   *        by a background thread, so that memory is bounded whatever the size of the file.
+   *        Lines are shuffled within a window of fixed size, and are deterministically
+   *        assigned to the training or testing part of the data by hashing their line number.
+   */
+  template <class TLine>
+  class StreamReader
+  {
+  public:
+    typedef std::function<void(std::string&,const long int&,std::vector<TLine>&)> parse_func; /**< parses a line with its number, appends zero or one element. */
+
+    StreamReader() {}
+    ~StreamReader()
+    {
+      stop();
+    }
+
+    /**
+     * \brief whether a line belongs to the test part of the data
+     * @param lnum line number, header excluded
+     * @param test_split test part ratio
+     * @param seed split seed
+     */
+    static bool is_test(const long int &lnum, const double &test_split, const uint64_t &seed=0)
+    {
+      if (test_split <= 0.0)
+	return false;
+      uint64_t z = static_cast<uint64_t>(lnum) + seed * 0x9E3779B97F4A7C15ULL + 0x9E3779B97F4A7C15ULL; // splitmix64
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      z = z ^ (z >> 31);
+      return (z >> 11) * (1.0 / 9007199254740992.0) < test_split;
+    }
+
+    /**
+     * \brief starts streaming
+     * @param fname file name
+     * @param skip number of header lines to skip
+     * @param parse line parser
+     * @param part 0 for training lines, 1 for testing lines, -1 for all lines
+     * @param loop whether to restart from the beginning of the file when exhausted
+     */
+    void start(const std::string &fname, const int &skip, const parse_func &parse,
+	       const int &part, const bool &loop)
+    {
+      stop();
+      _fname = fname;
+      _skip = skip;
+      _parse = parse;
+      _part = part;
+      _loop = loop;
+      _done = _stop = false;
+      _eptr = nullptr;
+      _epoch = 0;
+      _blocks.clear();
+      _cur.clear();
+      _cur_pos = 0;
+      _thread = std::thread([this](){ produce(); });
+    }
+
+    /**
+     * \brief stops the background reader, if any
+     */
+    void stop()
+    {
+      {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_stop = true;
+      }
+      _cv.notify_all();
+      if (_thread.joinable())
+	_thread.join();
+    }
+
+    /**
+     * \brief gets the next lines
+     * @param out lines are appended to this vector
+     * @param n number of lines
+     * @return number of lines appended, lower than n only when the stream is exhausted
+     */
+    int next(std::vector<TLine> &out, const int &n)
+    {
+      int added = 0;
+      while (added < n)
+	{
+	  if (_cur_pos >= _cur.size())
+	    {
+	      std::unique_lock<std::mutex> lock(_mutex);
+	      _cv.wait(lock,[this]{ return !_blocks.empty() || _done; });
+	      if (_blocks.empty())
+		{
+		  if (_eptr)
+		    std::rethrow_exception(_eptr);
+		  break;
+		}
+	      _cur = std::move(_blocks.front());
+	      _blocks.pop_front();
+	      _cur_pos = 0;
+	      lock.unlock();
+	      _cv.notify_all();
+	      continue;
+	    }
+	  out.push_back(std::move(_cur.at(_cur_pos++)));
+	  ++added;
+	}
+      return added;
+    }
+
+    /**
+     * \brief number of completed passes over the file
+     */
+    long int epoch() const
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _epoch;
+    }
+
+    double _test_split = -1; /**< test part ratio, <= 0 for no test part. */
+    uint64_t _split_seed = 0; /**< seed of the test split. */
+    int _shuffle_window = 0; /**< shuffle buffer size, 0 for no shuffling. */
+    int _seed = -1; /**< shuffle seed, random when negative. */
+    int _block_size = 1024; /**< number of lines per block. */
+    int _prefetch = 16; /**< max number of blocks read ahead. */
+
+  private:
+    void produce()
+    {
+      try
+	{
+	  std::mt19937 g;
+	  if (_seed >= 0)
+	    g = std::mt19937(_seed);
+	  else
+	    {
+	      std::random_device rd;
+	      g = std::mt19937(rd());
+	    }
+	  std::vector<TLine> window, block, parsed;
+	  block.reserve(_block_size);
+	  std::string line;
+	  std::vector<char> buf(1 << 20);
+	  while (true)
+	    {
+	      std::ifstream in;
+	      in.rdbuf()->pubsetbuf(buf.data(),buf.size());
+	      in.open(_fname,std::ios::binary);
+	      if (!in.is_open())
+		throw std::runtime_error("cannot open file " + _fname);
+	      for (int s=0;s<_skip && std::getline(in,line);s++) {}
+	      long int lnum = 0, nparsed = 0;
+	      while (std::getline(in,line))
+		{
+		  long int l = lnum++;
+		  if (_part >= 0 && is_test(l,_test_split,_split_seed) != (_part == 1))
+		    continue;
+		  parsed.clear();
+		  _parse(line,l,parsed);
+		  if (parsed.empty())
+		    continue;
+		  ++nparsed;
+		  if (_shuffle_window <= 1)
+		    block.push_back(std::move(parsed.back()));
+		  else if (static_cast<int>(window.size()) < _shuffle_window)
+		    {
+		      window.push_back(std::move(parsed.back()));
+		      continue;
+		    }
+		  else
+		    {
+		      // emits a random line from the window, the new line takes its place
+		      TLine &w = window.at(g() % window.size());
+		      block.push_back(std::move(w));
+		      w = std::move(parsed.back());
+		    }
+		  if (static_cast<int>(block.size()) >= _block_size && !push(block))
+		    return;
+		}
+
+	      // flushes the shuffle window, so that every pass holds each line once
+	      std::shuffle(window.begin(),window.end(),g);
+	      for (TLine &w: window)
+		{
+		  block.push_back(std::move(w));
+		  if (static_cast<int>(block.size()) >= _block_size && !push(block))
+		    return;
+		}
+	      window.clear();
+	      {
+		std::lock_guard<std::mutex> lock(_mutex);
+		++_epoch;
+	      }
+	      if (!_loop || nparsed == 0)
+		break;
+	    }
+	  if (!block.empty() && !push(block))
+	    return;
+	}
+      catch (...)
+	{
+	  std::lock_guard<std::mutex> lock(_mutex);
+	  _eptr = std::current_exception();
+	}
+      std::lock_guard<std::mutex> lock(_mutex);
+      _done = true;
+      _cv.notify_all();
+    }
+
+    /**
+     * \brief hands a block over to the consumer, waits for room when enough blocks are ahead
+     * @return false when stopped
+     */
+    bool push(std::vector<TLine> &block)
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cv.wait(lock,[this]{ return _stop || static_cast<int>(_blocks.size()) < _prefetch; });
+      if (_stop)
+	return false;
+      _blocks.push_back(std::move(block));
+      block = std::vector<TLine>();
+      block.reserve(_block_size);
+      _cv.notify_all();
+      return true;
+    }
+
+    std::string _fname;
+    int _skip = 0;
+    parse_func _parse;
+    int _part = -1;
+    bool _loop = false;
+
+    mutable std::mutex _mutex; /**< mutex around blocks and state. */
+    std::condition_variable _cv;
+    std::thread _thread;
+    std::deque<std::vector<TLine>> _blocks; /**< blocks read ahead. */
+    std::vector<TLine> _cur; /**< block being consumed. */
+    size_t _cur_pos = 0;
+    bool _done = false;
+    bool _stop = false;
+    std::exception_ptr _eptr;
+    long int _epoch = 0;
+  };
+
+}
+
+#endif
@@ -128,3 +128,96 @@ TEST(apidata,to_from_json)
 }
 
 
+
+TEST(apidata,binary_data)
+{
+  // multipart form with json parameters, an encoded image and a tensor
+  uint32_t shape[3] = {2,2,1};
+  float vals[4] = {0.1,0.2,0.3,0.4};
+  std::string tensor(reinterpret_cast<const char*>(shape),sizeof(shape));
+  tensor.append(reinterpret_cast<const char*>(vals),sizeof(vals));
+  std::string body = "--xyz\r\nContent-Disposition: form-data; name=\"json\"\r\n\r\n{\"service\":\"imgserv\"}\r\n"
+    "--xyz\r\nContent-Disposition: form-data; name=\"img\"; filename=\"cat.jpg\"\r\nContent-Type: image/jpeg\r\n\r\nJPEGDATA\r\n"
+    "--xyz\r\nContent-Disposition: form-data; name=\"t\"\r\nContent-Type: application/x-dd-tensor\r\n\r\n" + tensor + "\r\n--xyz--\r\n";
+  std::shared_ptr<const std::string> bbody = std::make_shared<const std::string>(body);
+  std::shared_ptr<BinaryData> bdata = std::make_shared<BinaryData>();
+  std::string jstr;
+  ASSERT_TRUE(binarydata::is_binary("multipart/form-data; boundary=xyz"));
+  ASSERT_EQ(0,binarydata::parse("multipart/form-data; boundary=xyz",bbody,*bdata,jstr));
+  ASSERT_EQ("{\"service\":\"imgserv\"}",jstr);
+  ASSERT_EQ(2,bdata->size());
+  ASSERT_EQ("cat.jpg",bdata->at(0)._id);
+  ASSERT_EQ("JPEGDATA",std::string(bdata->at(0).data(),bdata->at(0)._size));
+  ASSERT_FALSE(bdata->at(0).is_tensor());
+  ASSERT_EQ("t",bdata->at(1)._id);
+  ASSERT_TRUE(bdata->at(1).is_tensor());
+  ASSERT_EQ(2,bdata->at(1)._shape.at(0));
+  ASSERT_EQ(sizeof(vals),bdata->at(1)._size);
+  float v;
+  std::memcpy(&v,bdata->at(1).data()+3*sizeof(float),sizeof(float));
+  ASSERT_EQ(vals[3],v);
+
+  // binary data is shared along APIData copies
+  APIData ad;
+  ad.set_binary_data(bdata);
+  APIData cad(ad);
+  ASSERT_EQ(bdata.get(),cad.binary_data().get());
+
+  // truncated tensor
+  std::shared_ptr<const std::string> tbody = std::make_shared<const std::string>(tensor.substr(0,tensor.size()-1));
+  BinaryData tdata;
+  ASSERT_EQ(1,binarydata::parse("application/x-dd-tensor",tbody,tdata,jstr));
+
+  // dims beyond the body, above INT_MAX, with too many channels, or empty
+  std::vector<std::vector<uint32_t>> bad_shapes = {{65536,65536,256},{0x80000000u,1,1},{1,1,4096},{2,0,1}};
+  for (const std::vector<uint32_t> &bs: bad_shapes)
+    {
+      std::string btensor(reinterpret_cast<const char*>(bs.data()),3*sizeof(uint32_t));
+      btensor.append(reinterpret_cast<const char*>(vals),sizeof(vals));
+      std::shared_ptr<const std::string> bbody2 = std::make_shared<const std::string>(btensor);
+      BinaryData bdata2;
+      ASSERT_EQ(1,binarydata::parse("application/x-dd-tensor",bbody2,bdata2,jstr));
+      ASSERT_TRUE(bdata2.empty());
+    }
+
+  // packed binary predictions
+  APIData out;
+  APIData pred;
+  pred.add("uri","cat.jpg");
+  APIData cl;
+  cl.add("prob",0.9);
+  cl.add("cat","cat");
+  pred.add("classes",std::vector<APIData>({cl}));
+  out.add("predictions",std::vector<APIData>({pred}));
+  std::string bout;
+  ASSERT_EQ(0,JsonAPI::render_binary(out,bout));
+  ASSERT_EQ("DDB1",bout.substr(0,4));
+  ASSERT_EQ(4+4+4+7+4+4+4+4+3,bout.size());
+}
+
+TEST(apidata,to_writer)
+{
+  APIData ad;
+  ad.add("string","string");
+  ad.add("double",2.3);
+  ad.add("int",3);
+  ad.add("bool",true);
+  ad.add("vdouble",std::vector<double>({1.1,2.2,3.3}));
+  ad.add("vbool",std::vector<bool>({true,false}));
+  APIData cl;
+  cl.add("cat","car");
+  cl.add("prob",0.67);
+  APIData sub;
+  sub.add("classes",std::vector<APIData>({cl,cl}));
+  ad.add("sub",sub);
+
+  // direct serialization matches serialization through a JSON document
+  JDoc jd;
+  jd.SetObject();
+  ad.toJDoc(jd);
+  JsonAPI japi;
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  ad.toWriter(writer);
+  ASSERT_EQ(japi.jrender(jd),std::string(buffer.GetString()));
+}
@@ -21,11 +21,13 @@
 
 #include "deepdetect.h"
 #include "jsonapi.h"
+#include "utils/utils.hpp"
 #include <gtest/gtest.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <fstream>
 #include <iostream>
 
 using namespace dd;
@@ -468,6 +470,43 @@ TEST(caffeapi,service_train_csv)
   ASSERT_TRUE(!fileops::remove_directory_files(forest_repo,{".prototxt"}));
 }
 
+TEST(caffeapi,service_train_csv_test_async)
+{
+  // create service
+  JsonAPI japi;
+  std::string sname = "my_service";
+  std::string jstr = "{\"mllib\":\"caffe\",\"description\":\"my classifier\",\"type\":\"supervised\",\"model\":{\"repository\":\"" +  forest_repo + "\",\"templates\":\"" + model_templates_repo  + "\"},\"parameters\":{\"input\":{\"connector\":\"csv\"},\"mllib\":{\"template\":\"mlp\",\"nclasses\":7,\"activation\":\"prelu\"}}}";
+  std::string joutstr = japi.jrender(japi.service_create(sname,jstr));
+  ASSERT_EQ(created_str,joutstr);
+
+  // train, testing asynchronously while training proceeds
+  std::string jtrainstr = "{\"service\":\"" + sname + "\",\"async\":false,\"parameters\":{\"input\":{\"label\":\"Cover_Type\",\"id\":\"Id\",\"scale\":true,\"test_split\":0.1,\"label_offset\":-1,\"shuffle\":true},\"mllib\":{\"gpu\":true,\"gpuid\":"+gpuid+",\"solver\":{\"iterations\":" + iterations_forest + ",\"test_interval\":100,\"test_async\":true,\"base_lr\":0.05},\"net\":{\"batch_size\":512}},\"output\":{\"measure\":[\"acc\",\"mcll\",\"f1\"]}},\"data\":[\"" + forest_repo + "train.csv\"]}";
+  joutstr = japi.jrender(japi.service_train(jtrainstr));
+  std::cout << "joutstr=" << joutstr << std::endl;
+  JDoc jd;
+  jd.Parse(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(201,jd["status"]["code"].GetInt());
+  ASSERT_TRUE(jd["body"]["measure"].HasMember("f1"));
+  ASSERT_TRUE(jd["body"]["measure"]["f1"].GetDouble() > 0.0);
+
+  // the best iteration recorded by an asynchronous test has its own snapshot
+  ASSERT_TRUE(fileops::file_exists(forest_repo + "/best_model.txt"));
+  std::ifstream bestfile(forest_repo + "/best_model.txt");
+  std::string line;
+  std::getline(bestfile,line);
+  std::vector<std::string> elts = dd_utils::split(line,':');
+  ASSERT_EQ(2,elts.size());
+  ASSERT_EQ("iteration",elts.at(0));
+  ASSERT_TRUE(fileops::file_exists(forest_repo + "/model_iter_" + elts.at(1) + ".caffemodel"));
+
+  // remove service
+  jstr = "{\"clear\":\"lib\"}";
+  joutstr = japi.jrender(japi.service_delete(sname,jstr));
+  ASSERT_EQ(ok_str,joutstr);
+  ASSERT_TRUE(!fileops::remove_directory_files(forest_repo,{".prototxt"}));
+}
+
 TEST(caffeapi,service_train_csv_in_memory)
 {
   // create service
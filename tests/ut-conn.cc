@@ -21,6 +21,7 @@
 
 #include "apidata.h"
 #include "imginputfileconn.h"
+#include "imgpreproc.h"
 #include "csvinputfileconn.h"
 #include "csvtsinputfileconn.h"
 #include "txtinputfileconn.h"
@@ -313,6 +314,182 @@ TEST(inputconn,img)
     ASSERT_TRUE(cv::countNonZero(channels.at(i))==0); // the two images must be identical
 }
 
+// synthetic image with gradients, so that decoding differences are measurable
+static cv::Mat test_image(const int &rows, const int &cols)
+{
+  cv::Mat img(rows,cols,CV_8UC3);
+  for (int r=0;r<rows;r++)
+    for (int c=0;c<cols;c++)
+      img.at<cv::Vec3b>(r,c) = cv::Vec3b((r*255)/rows,(c*255)/cols,((r+c)*127)/(rows+cols));
+  return img;
+}
+
+TEST(inputconn,img_jpeg_size)
+{
+  cv::Mat img = test_image(480,640);
+  std::vector<uchar> baseline, progressive, png;
+  cv::imencode(".jpg",img,baseline);
+  cv::imencode(".png",img,png);
+  int rows = 0, cols = 0;
+  ASSERT_TRUE(DDImg::jpeg_size(reinterpret_cast<const char*>(baseline.data()),baseline.size(),rows,cols));
+  ASSERT_EQ(480,rows);
+  ASSERT_EQ(640,cols);
+#if CV_MAJOR_VERSION >= 3
+  cv::imencode(".jpg",img,progressive,{cv::IMWRITE_JPEG_PROGRESSIVE,1});
+  ASSERT_NE(baseline,progressive);
+  rows = cols = 0;
+  ASSERT_TRUE(DDImg::jpeg_size(reinterpret_cast<const char*>(progressive.data()),progressive.size(),rows,cols));
+  ASSERT_EQ(480,rows);
+  ASSERT_EQ(640,cols);
+#endif
+
+  // truncated before the frame header
+  ASSERT_FALSE(DDImg::jpeg_size(reinterpret_cast<const char*>(baseline.data()),30,rows,cols));
+  ASSERT_FALSE(DDImg::jpeg_size(reinterpret_cast<const char*>(baseline.data()),3,rows,cols));
+  ASSERT_FALSE(DDImg::jpeg_size(reinterpret_cast<const char*>(baseline.data()),0,rows,cols));
+
+  // not a JPEG
+  ASSERT_FALSE(DDImg::jpeg_size(reinterpret_cast<const char*>(png.data()),png.size(),rows,cols));
+
+  // zero-length segment before a valid frame header
+  std::vector<unsigned char> zseg = {0xFF,0xD8,0xFF,0xE0,0x00,0x00,
+				     0xFF,0xC0,0x00,0x11,0x08,0x01,0xE0,0x02,0x80,0x03,
+				     0x01,0x22,0x00,0x02,0x11,0x01,0x03,0x11,0x01};
+  ASSERT_FALSE(DDImg::jpeg_size(reinterpret_cast<const char*>(zseg.data()),zseg.size(),rows,cols));
+  zseg[5] = 0x02; // empty segment, valid
+  ASSERT_TRUE(DDImg::jpeg_size(reinterpret_cast<const char*>(zseg.data()),zseg.size(),rows,cols));
+  ASSERT_EQ(480,rows);
+  ASSERT_EQ(640,cols);
+}
+
+TEST(inputconn,img_reduction_factor)
+{
+  // width and height target, the smaller side bounds the reduction
+  DDImg dimg;
+  dimg._width = dimg._height = 224;
+  ASSERT_EQ(8,dimg.reduction_factor(2000,3000));
+  ASSERT_EQ(4,dimg.reduction_factor(1000,1500));
+  ASSERT_EQ(2,dimg.reduction_factor(480,640));
+  ASSERT_EQ(1,dimg.reduction_factor(300,400));
+  ASSERT_EQ(1,dimg.reduction_factor(224,224));
+
+  // single side target, as the larger side
+  dimg._width = 300;
+  dimg._height = 0;
+  ASSERT_EQ(4,dimg.reduction_factor(1200,1600));
+  ASSERT_EQ(4,dimg.reduction_factor(1600,1200));
+  ASSERT_EQ(1,dimg.reduction_factor(400,500));
+
+  // no resizing
+  dimg._width = 0;
+  ASSERT_EQ(1,dimg.reduction_factor(2000,3000));
+
+  // scale_min and scale_max
+  dimg._scaled = true;
+  dimg._scale_min = 600;
+  dimg._scale_max = 1000;
+  ASSERT_EQ(4,dimg.reduction_factor(2400,3200)); // scaled to 600x800
+  ASSERT_EQ(8,dimg.reduction_factor(1200,8000)); // scaled to 150x1000
+  ASSERT_EQ(2,dimg.reduction_factor(1200,2000)); // scaled to 600x1000
+  ASSERT_EQ(1,dimg.reduction_factor(600,800));
+}
+
+TEST(inputconn,img_reduced_decode)
+{
+  std::string fname = "test_reduced.jpg";
+  cv::imwrite(fname,test_image(1200,1600));
+  std::vector<cv::Mat> imgs;
+  for (bool reduced: {false,true})
+    {
+      APIData ad;
+      std::vector<std::string> uris = {fname};
+      ad.add("data",uris);
+      APIData ad_param, ad_input;
+      ad_input.add("width",224);
+      ad_input.add("height",224);
+      ad_input.add("reduced_decode",reduced);
+      ad_param.add("input",ad_input);
+      ad.add("parameters",ad_param);
+      ImgInputFileConn iifc;
+      iifc._logger = spdlog::stdout_logger_mt(reduced ? "test_reduced_decode" : "test_full_decode");
+      iifc.transform(ad);
+      ASSERT_EQ(1,iifc._images.size());
+      ASSERT_EQ(224,iifc._images.at(0).rows);
+      ASSERT_EQ(224,iifc._images.at(0).cols);
+
+      // original size, for rescaling bounding boxes
+      ASSERT_EQ(1,iifc._images_size.size());
+      ASSERT_EQ(1200,iifc._images_size.at(0).first);
+      ASSERT_EQ(1600,iifc._images_size.at(0).second);
+      imgs.push_back(iifc._images.at(0));
+    }
+  ASSERT_EQ(imgs.at(0).type(),imgs.at(1).type());
+  cv::Mat diff;
+  cv::absdiff(imgs.at(0),imgs.at(1),diff);
+  cv::Scalar mdiff = cv::mean(diff);
+  for (int c=0;c<3;c++)
+    ASSERT_TRUE(mdiff[c] < 4.0);
+  remove(fname.c_str());
+}
+
+TEST(inputconn,img_preproc)
+{
+  int rows = 5, cols = 7;
+  cv::RNG rng(1);
+  for (int depth: {CV_8U,CV_32F})
+    for (int channels: {1,3})
+      for (bool chw: {true,false})
+	for (bool swap_rb: {false,true})
+	  for (bool padded: {false,true})
+	    {
+	      // source, as a view into a larger image when padded, so that rows are strided
+	      cv::Mat big(rows+2,cols+3,CV_MAKETYPE(depth,channels));
+	      rng.fill(big,cv::RNG::UNIFORM,0,255);
+	      cv::Mat img = padded ? big(cv::Rect(1,1,cols,rows)) : big(cv::Rect(0,0,cols,rows)).clone();
+	      ASSERT_EQ(padded,img.step[0] != img.cols*img.elemSize());
+
+	      std::vector<float> mean = channels == 3 ? std::vector<float>{104.0,117.0,123.0} : std::vector<float>{128.0};
+	      float stdv = 58.0;
+	      ImgPreproc::Params pp;
+	      pp._chw = chw;
+	      pp._swap_rb = swap_rb;
+	      pp._mean = mean.data();
+	      pp._scale = 1.0 / stdv;
+	      size_t cstep = static_cast<size_t>(rows)*cols;
+	      if (chw && padded)
+		pp._cstep = cstep = rows*cols + 5; // aligned planes, as NCNN
+	      std::vector<float> out(channels*cstep,-1000.0f);
+	      ASSERT_TRUE(ImgPreproc::convert(img,out.data(),pp));
+
+	      // reference: float conversion, mean in source channel order, channels reordering, scaling
+	      cv::Mat fimg;
+	      img.convertTo(fimg,CV_32F);
+	      std::vector<cv::Mat> planes;
+	      cv::split(fimg,planes);
+	      for (int c=0;c<channels;c++)
+		planes[c] = (planes[c] - mean[c]) / stdv;
+	      if (swap_rb && channels == 3)
+		std::swap(planes[0],planes[2]);
+	      for (int c=0;c<channels;c++)
+		for (int h=0;h<rows;h++)
+		  for (int w=0;w<cols;w++)
+		    {
+		      float ref = planes[c].at<float>(h,w);
+		      float v = chw ? out[c*cstep+h*cols+w] : out[(h*cols+w)*channels+c];
+		      ASSERT_NEAR(ref,v,1e-5);
+		    }
+	      if (chw && padded) // plane padding is left untouched
+		for (int c=0;c<channels;c++)
+		  for (size_t i=rows*cols;i<cstep;i++)
+		    ASSERT_EQ(-1000.0f,out[c*cstep+i]);
+	    }
+
+  // unsupported depth
+  cv::Mat img16(rows,cols,CV_16UC3,cv::Scalar(1,2,3));
+  std::vector<float> out(3*rows*cols);
+  ASSERT_FALSE(ImgPreproc::convert(img16,out.data(),ImgPreproc::Params()));
+}
+
 //TODO: test csv scale, separator, categorical, ...
 TEST(inputconn,csv_mem1)
 {
@@ -468,6 +645,87 @@ TEST(inputconn,csv_categoricals2)
   remove("test.csv");
 }
 
+TEST(inputconn,csv_chunk_parse_double)
+{
+  std::vector<std::string> nums = {"0","-1.5","+2","1e-3","3.14159265358979","0.1","-0.0",".5","5.",
+				   "123456789012345678","1.7976931348623157e308","2.5E-30","1e22","7e-23"};
+  std::string data;
+  for (size_t i=0;i<nums.size();i++)
+    data += (i > 0 ? "," : "") + nums[i];
+  data += "\r\n\n" + nums[1] + "\n";
+  CSVInputFileConn cifc;
+  cifc._logger = spdlog::stdout_logger_mt("test_chunk_parse");
+  std::vector<CSVChunk> chunks;
+  cifc.read_csv_chunks(data.data(),data.data()+data.size(),false,chunks);
+  ASSERT_EQ(1,chunks.size());
+  ASSERT_EQ(3,chunks.at(0)._lines.size());
+  const std::vector<double> &vals = chunks.at(0)._lines.at(0)._v;
+  ASSERT_EQ(nums.size(),vals.size());
+  for (size_t i=0;i<nums.size();i++)
+    ASSERT_EQ(std::stod(nums[i]),vals[i]);
+  ASSERT_TRUE(chunks.at(0)._lines.at(1)._v.empty());
+  ASSERT_EQ(-1.5,chunks.at(0)._lines.at(2)._v.at(0));
+
+  std::string bad = "1,abc,3\n";
+  ASSERT_THROW(cifc.read_csv_chunks(bad.data(),bad.data()+bad.size(),false,chunks),InputConnectorBadParamException);
+  std::string big = "1e400\n";
+  ASSERT_THROW(cifc.read_csv_chunks(big.data(),big.data()+big.size(),false,chunks),std::out_of_range);
+}
+
+TEST(inputconn,csv_chunks_min_max)
+{
+  // chunks starting with, or made of, empty lines
+  std::vector<std::string> data = {"1,5\n3,2\n","\n-1,7\n","\n"};
+  CSVInputFileConn cifc;
+  cifc._logger = spdlog::stdout_logger_mt("test_chunk_minmax");
+  std::vector<CSVChunk> chunks(data.size());
+  for (size_t c=0;c<data.size();c++)
+    cifc.read_csv_chunk(data[c].data(),data[c].data()+data[c].size(),{},{},{},false,chunks[c]);
+  cifc.find_min_max(chunks);
+  std::vector<double> min_vals = {-1,2};
+  std::vector<double> max_vals = {3,7};
+  ASSERT_EQ(min_vals,cifc._min_vals);
+  ASSERT_EQ(max_vals,cifc._max_vals);
+}
+
+TEST(inputconn,csv_chunks_categoricals)
+{
+  // large enough to be parsed in several chunks, with a category that only appears in the last one
+  int nlines = 400000;
+  std::ofstream of("test.csv");
+  of << "target,color,x" << std::endl;
+  for (int i=0;i<nlines-1;i++)
+    of << i % 2 << "," << (i % 2 ? "b" : "a") << "," << i << std::endl;
+  of << "1,c," << nlines-1 << std::endl;
+  of.close();
+  std::vector<std::string> vdata = { "test.csv" };
+  APIData ad;
+  ad.add("data",vdata);
+  APIData pad,pinp;
+  pinp.add("label","target");
+  std::vector<std::string> vcats = {"color"};
+  pinp.add("categoricals",vcats);
+  std::vector<APIData> vpinp = { pinp };
+  pad.add("input",vpinp);
+  std::vector<APIData> vpad = { pad };
+  ad.add("parameters",vpad);
+  CSVInputFileConn cifc;
+  cifc._logger = spdlog::stdout_logger_mt("test_chunk_cats");
+  cifc._train = true;
+  cifc.transform(ad);
+  ASSERT_EQ(nlines,cifc._csvdata.size());
+  std::vector<std::string> columns(cifc._columns.begin(),cifc._columns.end());
+  std::vector<std::string> ecolumns = {"target","color_a","color_b","color_c","x"};
+  ASSERT_EQ(ecolumns,columns);
+  std::vector<double> v1 = {0,1,0,0,0};
+  std::vector<double> v2 = {1,0,1,0,1};
+  std::vector<double> vl = {1,0,0,1,static_cast<double>(nlines-1)};
+  ASSERT_EQ(v1,cifc._csvdata.front()._v);
+  ASSERT_EQ(v2,cifc._csvdata.at(1)._v);
+  ASSERT_EQ(vl,cifc._csvdata.back()._v);
+  remove("test.csv");
+}
+
 TEST(inputconn,csv_read_categoricals)
 {
   std::string json_categorical_mapping = "{\"categoricals_mapping\":{\"bruises\":{\"t\":0,\"f\":1},\"cap-color\":{\"n\":0,\"y\":1,\"p\":5,\"c\":8,\"r\":9,\"w\":2,\"g\":3,\"e\":4,\"b\":6,\"u\":7},\"ring-number\":{\"o\":0,\"t\":1,\"n\":2},\"odor\":{\"p\":0,\"c\":5,\"y\":6,\"s\":7,\"a\":1,\"l\":2,\"n\":3,\"f\":4,\"m\":8},\"stalk-shape\":{\"e\":0,\"t\":1},\"stalk-surface-above-ring\":{\"s\":0,\"y\":3,\"f\":1,\"k\":2},\"gill-size\":{\"n\":0,\"b\":1},\"veil-type\":{\"p\":0},\"ring-type\":{\"p\":0,\"e\":1,\"l\":2,\"f\":3,\"n\":4},\"spore-print-color\":{\"k\":0,\"n\":1,\"u\":2,\"h\":3,\"w\":4,\"r\":5,\"y\":7,\"o\":6,\"b\":8},\"gill-color\":{\"b\":8,\"e\":7,\"o\":11,\"k\":0,\"n\":1,\"y\":10,\"g\":2,\"r\":9,\"w\":4,\"p\":3,\"h\":5,\"u\":6},\"gill-spacing\":{\"c\":0,\"w\":1},\"habitat\":{\"u\":0,\"d\":3,\"l\":6,\"g\":1,\"m\":2,\"p\":4,\"w\":5},\"cap-surface\":{\"s\":0,\"y\":1,\"f\":2,\"g\":3},\"gill-attachment\":{\"f\":0,\"a\":1},\"cap-shape\":{\"x\":0,\"s\":2,\"c\":5,\"b\":1,\"f\":3,\"k\":4},\"target\":{\"p\":0,\"e\":1},\"stalk-root\":{\"e\":0,\"b\":2,\"c\":1,\"r\":3,\"?\":4},\"stalk-surface-below-ring\":{\"s\":0,\"y\":2,\"f\":1,\"k\":3},\"veil-color\":{\"w\":0,\"n\":1,\"o\":2,\"y\":3},\"population\":{\"s\":0,\"y\":4,\"c\":5,\"n\":1,\"a\":2,\"v\":3},\"stalk-color-above-ring\":{\"w\":0,\"g\":1,\"p\":2,\"c\":7,\"y\":8,\"n\":3,\"b\":4,\"e\":5,\"o\":6},\"stalk-color-below-ring\":{\"w\":0,\"p\":1,\"y\":6,\"c\":8,\"g\":2,\"b\":3,\"e\":5,\"n\":4,\"o\":7}}}";
@@ -524,6 +782,129 @@ TEST(inputconn,csv_ignore)
   remove("test.csv");
 }
 
+TEST(inputconn,csv_stream)
+{
+  std::ofstream of("test_stream.csv");
+  of << "id,target,color,val" << std::endl;
+  for (int i=0;i<1000;i++)
+    of << i << "," << i%2 << "," << (i%3 ? "red" : "blue") << "," << i*0.5 << std::endl;
+  of.close();
+  std::vector<std::string> vdata = { "test_stream.csv" };
+  APIData ad;
+  ad.add("data",vdata);
+  APIData pad,pinp;
+  pinp.add("label","target");
+  pinp.add("id","id");
+  pinp.add("stream",true);
+  pinp.add("shuffle",true);
+  pinp.add("shuffle_window",100);
+  pinp.add("test_split",0.2);
+  std::vector<std::string> vcats = {"color"};
+  pinp.add("categoricals",vcats);
+  std::vector<APIData> vpinp = { pinp };
+  pad.add("input",vpinp);
+  std::vector<APIData> vpad = { pad };
+  ad.add("parameters",vpad);
+  CSVInputFileConn cifc;
+  cifc._logger = spdlog::stdout_logger_mt("test_stream");
+  cifc._train = true;
+  try
+    {
+      cifc.transform(ad);
+    }
+  catch(InputConnectorBadParamException &e)
+    {
+      std::cerr << "exception=" << e.what() << std::endl;
+      ASSERT_FALSE(true);
+    }
+  ASSERT_TRUE(cifc._csvdata.empty());
+  ASSERT_EQ(1000,cifc._stream_train_size+cifc._stream_test_size);
+  ASSERT_TRUE(cifc._stream_test_size > 100 && cifc._stream_test_size < 300);
+  ASSERT_EQ(5,cifc._columns.size()); // color is one-hot encoded
+
+  std::vector<CSVline> lines;
+  ASSERT_EQ(cifc._stream_train_size,cifc.stream_train(lines,cifc._stream_train_size));
+  std::unordered_set<std::string> train_ids;
+  for (const CSVline &l: lines)
+    {
+      ASSERT_EQ(5,l._v.size());
+      train_ids.insert(l._str);
+    }
+  ASSERT_EQ(cifc._stream_train_size,train_ids.size());
+
+  // training data loops, testing data is exhausted
+  lines.clear();
+  ASSERT_EQ(10,cifc.stream_train(lines,10));
+  for (int k=0;k<2;k++)
+    {
+      cifc.reset_stream_test();
+      std::vector<CSVline> tlines;
+      while(cifc.stream_test(tlines,64) > 0) {}
+      ASSERT_EQ(cifc._stream_test_size,tlines.size());
+      for (const CSVline &l: tlines)
+	ASSERT_TRUE(train_ids.find(l._str)==train_ids.end());
+    }
+  remove("test_stream.csv");
+}
+
+TEST(inputconn,csv_stream_scale)
+{
+  // streamed lines match lines held in memory, with categoricals and scaling
+  std::ofstream of("test_stream.csv");
+  of << "id,target,color,val" << std::endl;
+  for (int i=0;i<1000;i++)
+    {
+      of << i << "," << i%2 << "," << (i%3 ? "red" : "blue") << "," << i*0.5 << std::endl;
+      if (i % 100 == 0)
+	of << std::endl;
+    }
+  of << "1000,1,green,-10";
+  of.close();
+  std::vector<std::string> vdata = { "test_stream.csv" };
+  std::vector<CSVline> mlines, slines;
+  std::vector<double> min_vals, max_vals;
+  for (bool stream: {false,true})
+    {
+      APIData ad;
+      ad.add("data",vdata);
+      APIData pad,pinp;
+      pinp.add("label","target");
+      pinp.add("id","id");
+      pinp.add("stream",stream);
+      pinp.add("scale",true);
+      std::vector<std::string> vcats = {"color"};
+      pinp.add("categoricals",vcats);
+      std::vector<APIData> vpinp = { pinp };
+      pad.add("input",vpinp);
+      std::vector<APIData> vpad = { pad };
+      ad.add("parameters",vpad);
+      CSVInputFileConn cifc;
+      cifc._logger = spdlog::stdout_logger_mt(stream ? "test_stream_scale" : "test_mem_scale");
+      cifc._train = true;
+      cifc.transform(ad);
+      ASSERT_EQ(6,cifc._columns.size());
+      if (!stream)
+	{
+	  mlines = cifc._csvdata;
+	  min_vals = cifc._min_vals;
+	  max_vals = cifc._max_vals;
+	  continue;
+	}
+      ASSERT_EQ(min_vals,cifc._min_vals);
+      ASSERT_EQ(max_vals,cifc._max_vals);
+      ASSERT_EQ(1001,cifc._stream_train_size);
+      ASSERT_EQ(1001,cifc.stream_train(slines,1001));
+    }
+  std::unordered_map<std::string,std::vector<double>> mvals;
+  for (const CSVline &l: mlines)
+    if (!l._v.empty()) // empty lines are not streamed
+      mvals[l._str] = l._v;
+  ASSERT_EQ(mvals.size(),slines.size());
+  for (const CSVline &l: slines)
+    ASSERT_EQ(mvals[l._str],l._v);
+  remove("test_stream.csv");
+}
+
 TEST(inputconn, csvts_basic)
 {
   std::string header = "target,cap-shape,cap-surface,cap-color,bruises";
@@ -579,19 +960,45 @@ TEST(inputconn, csvts_basic)
   // fileops::remove_dir("test");
 }
 
-/*TEST(inputconn,txt_parse_content)
+TEST(inputconn,txt_parse_content)
 {
-  std::string str = "everything runs fine, right?";
+  std::string str = "Everything runs fine, right?\nfine fine, everything.\n\n";
   TxtInputFileConn tifc;
+  tifc._train = true;
+  tifc._min_word_length = 2;
+  tifc._sentences = true;
   tifc.parse_content(str,1);
   ASSERT_EQ(4,tifc._vocab.size());
-  ASSERT_EQ(4,tifc._rvocab.size());
-  Word w = tifc._vocab["fine"];
-  ASSERT_EQ(2,w._pos);
-  ASSERT_EQ(1,w._total_count);
-  ASSERT_EQ(1,w._total_classes);
-  ASSERT_EQ(1,tifc._txt.size());
-  TxtBowEntry tbe = tifc._txt.at(0);
-  ASSERT_EQ(4,tbe._v.size());
-  ASSERT_EQ(1,tbe._target);
-  }*/
+  const Word *w = tifc._vocab.find("fine");
+  ASSERT_TRUE(w != nullptr);
+  ASSERT_EQ(2,w->_pos);
+  ASSERT_EQ(3,w->_total_count);
+  ASSERT_EQ(2,w->_total_docs);
+  ASSERT_EQ(2,tifc._txt.size());
+  TxtBowEntry *tbe = static_cast<TxtBowEntry*>(tifc._txt.at(0));
+  ASSERT_EQ(4,tbe->size());
+  ASSERT_EQ(1,tbe->_target);
+  tbe = static_cast<TxtBowEntry*>(tifc._txt.at(1));
+  ASSERT_EQ(2,tbe->size());
+  std::vector<std::pair<int,double>> elts(tbe->begin(),tbe->end());
+  ASSERT_EQ(0,elts.at(0).first); // everything
+  ASSERT_EQ(1.0,elts.at(0).second);
+  ASSERT_EQ(2,elts.at(1).first); // fine
+  ASSERT_EQ(2.0,elts.at(1).second);
+
+  // unknown words are dropped at prediction time
+  TxtInputFileConn tifcp;
+  tifcp._vocab = tifc._vocab;
+  tifcp._min_word_length = 2;
+  tifcp.parse_content("unknown FINE words, fine");
+  ASSERT_EQ(4,tifcp._vocab.size());
+  ASSERT_EQ(1,tifcp._txt.size());
+  tbe = static_cast<TxtBowEntry*>(tifcp._txt.at(0));
+  ASSERT_EQ(1,tbe->size());
+  int key;
+  double val;
+  tbe->reset();
+  tbe->get_next_elt(key,val);
+  ASSERT_EQ(2,key);
+  ASSERT_EQ(2.0,val);
+}
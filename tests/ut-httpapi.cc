@@ -505,3 +505,45 @@ TEST(httpjsonapi,predict)
   
   hja.stop_server();
 }
+
+TEST(httpjsonapi,network_delivery)
+{
+  HttpJsonAPI hja;
+  hja.start_server_daemon(host,std::to_string(++port),nthreads);
+  std::string luri = "http://" + host + ":" + std::to_string(port);
+  sleep(2);
+
+  // delivery statistics in /info
+  int code = -1;
+  std::string jstr;
+  httpclient::get_call(luri+"/info","GET",code,jstr);
+  ASSERT_EQ(200,code);
+  rapidjson::Document d;
+  d.Parse(jstr.c_str());
+  ASSERT_FALSE(d.HasParseError());
+  ASSERT_TRUE(d["head"].HasMember("network_delivery"));
+  ASSERT_TRUE(d["head"]["network_delivery"]["running"].GetBool());
+  ASSERT_EQ(0,d["head"]["network_delivery"]["queued"].GetInt());
+
+  // unreachable destination is retried, then dropped
+  NetworkDelivery nd;
+  nd.start(hja._logger,1,2,4,2,10,1000);
+  ASSERT_TRUE(nd.push("http://127.0.0.1:1/results","{\"status\":{\"code\":200}}"));
+  for (int i=0;i<50;i++)
+    {
+      if (nd.stats().get("failed").get<double>() > 0)
+	break;
+      usleep(100000);
+    }
+  APIData ad_stats = nd.stats();
+  ASSERT_EQ(1,ad_stats.get("failed").get<double>());
+  ASSERT_EQ(2,ad_stats.get("retries").get<double>());
+  ASSERT_EQ(0,ad_stats.get("delivered").get<double>());
+
+  // no delivery once stopped
+  nd.stop();
+  ASSERT_FALSE(nd.push("http://127.0.0.1:1/results","{}"));
+  ASSERT_EQ(1,nd.stats().get("rejected").get<double>());
+
+  hja.stop_server();
+}
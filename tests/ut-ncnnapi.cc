@@ -58,4 +58,30 @@ TEST(ncnnapi,service_predict)
   std::string cl1 = jd["body"]["predictions"][0]["classes"][0]["cat"].GetString();
   ASSERT_TRUE(cl1 == "15");
   ASSERT_TRUE(jd["body"]["predictions"][0]["classes"][0]["prob"].GetDouble() > 0.4);
+
+  // predict several images at once
+  jpredictstr = "{\"service\":\"imgserv\",\"parameters\":{\"input\":{\"height\":300,\"width\":300},\"output\":{\"bbox\":true}},\"data\":[\"" + incept_repo + "face.jpg\",\"" + incept_repo + "./face.jpg\",\"" + incept_repo + "../squeezenet_ssd_ncnn/face.jpg\"]}";
+  joutstr = japi.jrender(japi.service_predict(jpredictstr));
+  std::cout << "joutstr=" << joutstr << std::endl;
+  jd.Parse(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(200,jd["status"]["code"]);
+  ASSERT_EQ(3,jd["body"]["predictions"].Size());
+  for (int i=0;i<3;i++)
+    {
+      std::string cl = jd["body"]["predictions"][i]["classes"][0]["cat"].GetString();
+      ASSERT_TRUE(cl == "15");
+      ASSERT_NEAR(jd["body"]["predictions"][0]["classes"][0]["prob"].GetDouble(),
+		  jd["body"]["predictions"][i]["classes"][0]["prob"].GetDouble(),1e-4);
+    }
+
+  // a single net for the input height, reused across calls
+  joutstr = japi.jrender(japi.info(""));
+  std::cout << "joutstr=" << joutstr << std::endl;
+  jd.Parse(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_TRUE(jd["head"]["services"][0].HasMember("net_cache"));
+  ASSERT_EQ(1,jd["head"]["services"][0]["net_cache"]["size"].GetInt());
+  ASSERT_EQ(1,jd["head"]["services"][0]["net_cache"]["misses"].GetDouble());
+  ASSERT_EQ(1,jd["head"]["services"][0]["net_cache"]["hits"].GetDouble());
 }
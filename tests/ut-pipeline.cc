@@ -0,0 +1,176 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2019 Jolibrain
+ * Author: Emmanuel Benazera <beniz@droidnik.fr>
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/pipeline.hpp"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+using namespace dd;
+
+TEST(pipeline,ordered_output)
+{
+  OrderedPipeline<int,int> pipeline(8,16);
+  int next = 0, nelts = 5000;
+  std::vector<int> outs;
+  long int n = pipeline.run([&](int &in) { if (next == nelts) return false; in = next++; return true; },
+			    [](int &in, int &out)
+			    {
+			      // uneven work durations, so that results finish out of order
+			      if (in % 10 == 0)
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+			      out = 2 * in;
+			      return in % 7 != 0; // dropped elements
+			    },
+			    [&](int &out) { outs.push_back(out); });
+  ASSERT_EQ(outs.size(),n);
+  ASSERT_EQ(nelts - (nelts + 6) / 7,n);
+  int prev = -1;
+  for (int out: outs)
+    {
+      ASSERT_TRUE(out > prev);
+      ASSERT_TRUE((out / 2) % 7 != 0);
+      prev = out;
+    }
+}
+
+TEST(pipeline,exceptions)
+{
+  for (int stage=0;stage<3;stage++)
+    {
+      OrderedPipeline<int,int> pipeline(4,8);
+      int next = 0;
+      long int nsink = 0;
+      try
+	{
+	  pipeline.run([&](int &in)
+			{
+			  if (stage == 0 && next == 500)
+			    throw std::runtime_error("source");
+			  if (next == 1000)
+			    return false;
+			  in = next++;
+			  return true;
+			},
+			[&](int &in, int &out)
+			{
+			  if (stage == 1 && in == 500)
+			    throw std::runtime_error("work");
+			  out = in;
+			  return true;
+			},
+			[&](int &out)
+			{
+			  if (stage == 2 && out == 500)
+			    throw std::runtime_error("sink");
+			  ++nsink;
+			});
+	  ASSERT_FALSE(true);
+	}
+      catch (std::runtime_error &e)
+	{
+	  std::string what = e.what();
+	  ASSERT_EQ(stage == 0 ? "source" : stage == 1 ? "work" : "sink",what);
+	}
+      ASSERT_TRUE(nsink <= 500);
+    }
+}
+
+// records transactions and their commits
+class FakeTxn
+{
+public:
+  FakeTxn(std::vector<std::vector<std::string>> &commits)
+    :_commits(commits) {}
+
+  void Put(const std::string &key, const std::string &value)
+  {
+    (void)value;
+    _keys.push_back(key);
+  }
+
+  void Commit()
+  {
+    _commits.push_back(_keys);
+    _keys.clear();
+  }
+
+  std::vector<std::vector<std::string>> &_commits;
+  std::vector<std::string> _keys;
+};
+
+class FakeDB
+{
+public:
+  FakeTxn* NewTransaction()
+  {
+    return new FakeTxn(_commits);
+  }
+
+  std::vector<std::vector<std::string>> _commits;
+};
+
+TEST(pipeline,db_txn_writer)
+{
+  // by number of records
+  DbTxnWriter<FakeDB> writer(std::unique_ptr<FakeDB>(new FakeDB()),3,1024);
+  for (int i=0;i<7;i++)
+    writer.put(std::to_string(i),"value");
+  ASSERT_EQ(2,writer._db->_commits.size());
+  ASSERT_EQ(3,writer._db->_commits.at(0).size());
+  ASSERT_EQ(1,writer._txn_count);
+  writer.commit();
+  ASSERT_EQ(3,writer._db->_commits.size());
+  ASSERT_EQ("6",writer._db->_commits.back().at(0));
+  writer.commit(); // nothing to commit
+  ASSERT_EQ(3,writer._db->_commits.size());
+
+  // by size of records
+  DbTxnWriter<FakeDB> bwriter(std::unique_ptr<FakeDB>(new FakeDB()),10000,16);
+  for (int i=0;i<5;i++)
+    bwriter.put(std::to_string(i),"1234567"); // 8 bytes per record
+  ASSERT_EQ(2,bwriter._db->_commits.size());
+  ASSERT_EQ(2,bwriter._db->_commits.at(0).size());
+  ASSERT_EQ(8,bwriter._txn_bytes);
+}
+
+TEST(pipeline,ordered_db_writes)
+{
+  OrderedPipeline<int,std::pair<std::string,std::string>> pipeline(4,8);
+  DbTxnWriter<FakeDB> writer(std::unique_ptr<FakeDB>(new FakeDB()),100,1024*1024);
+  int next = 0;
+  pipeline.run([&](int &in) { if (next == 1050) return false; in = next++; return true; },
+	       [](int &in, std::pair<std::string,std::string> &record)
+	       {
+		 record.first = std::to_string(in);
+		 record.second = std::string(in % 13,'x');
+		 return true;
+	       },
+	       [&](std::pair<std::string,std::string> &record) { writer.put(record.first,record.second); });
+  writer.commit();
+  ASSERT_EQ(11,writer._db->_commits.size());
+  int k = 0;
+  for (const std::vector<std::string> &keys: writer._db->_commits)
+    for (const std::string &key: keys)
+      ASSERT_EQ(std::to_string(k++),key);
+  ASSERT_EQ(1050,k);
+}
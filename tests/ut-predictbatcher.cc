@@ -0,0 +1,152 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2019 Jolibrain
+ * Author: Emmanuel Benazera <beniz@droidnik.fr>
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "predictbatcher.h"
+#include "binarydata.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+using namespace dd;
+
+// one prediction per data element, except for 'skip' when merged with other elements
+class FakePredict
+{
+public:
+  int operator()(const APIData &ad, APIData &out)
+  {
+    std::vector<std::string> data = ad.get("data").get<std::vector<std::string>>();
+    ++_calls;
+    if (data.size() > 1)
+      ++_merged_calls;
+    std::vector<APIData> preds;
+    for (const std::string &d: data)
+      {
+	if (d == "skip" && data.size() > 1)
+	  continue;
+	APIData p;
+	p.add("uri",d);
+	p.add("val",static_cast<double>(d.size()));
+	preds.push_back(p);
+      }
+    out.add("predictions",preds);
+    return 0;
+  }
+
+  std::atomic<int> _calls{0};
+  std::atomic<int> _merged_calls{0};
+};
+
+static APIData call(const std::vector<std::string> &data)
+{
+  APIData ad;
+  ad.add("service",std::string("myserv"));
+  ad.add("data",data);
+  APIData ad_output;
+  ad_output.add("best",1);
+  APIData ad_param;
+  ad_param.add("output",ad_output);
+  ad.add("parameters",ad_param);
+  return ad;
+}
+
+// runs the calls concurrently through the batcher
+static std::vector<APIData> run_calls(PredictBatcher &pb, FakePredict &fp,
+				      const std::vector<std::vector<std::string>> &calls)
+{
+  std::vector<APIData> outs(calls.size());
+  std::vector<std::thread> ts;
+  PredictBatcher::predict_func pfunc = [&fp](const APIData &ad, APIData &out) { return fp(ad,out); };
+  for (size_t i=0;i<calls.size();i++)
+    ts.push_back(std::thread([&,i]{ pb.predict(call(calls.at(i)),outs.at(i),pfunc); }));
+  for (std::thread &t: ts)
+    t.join();
+  return outs;
+}
+
+TEST(predictbatcher,merge_and_scatter)
+{
+  PredictBatcher pb(16,500000);
+  FakePredict fp;
+  std::vector<std::vector<std::string>> calls = {{"a"},{"bb","ccc"},{"dddd"}};
+  std::vector<APIData> outs = run_calls(pb,fp,calls);
+  ASSERT_EQ(1,fp._calls);
+  ASSERT_EQ(1,fp._merged_calls);
+  for (size_t i=0;i<calls.size();i++)
+    {
+      std::vector<APIData> preds = outs.at(i).getv("predictions");
+      ASSERT_EQ(calls.at(i).size(),preds.size());
+      for (size_t k=0;k<preds.size();k++)
+	{
+	  ASSERT_EQ(calls.at(i).at(k),preds.at(k).get("uri").get<std::string>());
+	  ASSERT_EQ(calls.at(i).at(k).size(),preds.at(k).get("val").get<double>());
+	}
+    }
+  APIData ad_stats = pb.stats();
+  ASSERT_EQ(1,ad_stats.get("batches").get<double>());
+  ASSERT_EQ(3,ad_stats.get("requests").get<double>());
+  ASSERT_EQ(4,ad_stats.get("max_achieved_batch_size").get<double>());
+}
+
+TEST(predictbatcher,unbatched_fallback)
+{
+  PredictBatcher pb(16,500000);
+  FakePredict fp;
+  std::vector<std::vector<std::string>> calls = {{"a"},{"skip"},{"bb"}};
+  std::vector<APIData> outs = run_calls(pb,fp,calls);
+  ASSERT_EQ(1,fp._merged_calls);
+  ASSERT_EQ(4,fp._calls); // merged call, then one per call
+  for (size_t i=0;i<calls.size();i++)
+    {
+      std::vector<APIData> preds = outs.at(i).getv("predictions");
+      ASSERT_EQ(1,preds.size());
+      ASSERT_EQ(calls.at(i).at(0),preds.at(0).get("uri").get<std::string>());
+    }
+}
+
+TEST(predictbatcher,bypass)
+{
+  PredictBatcher pb(16,500000);
+  FakePredict fp;
+  PredictBatcher::predict_func pfunc = [&fp](const APIData &ad, APIData &out) { return fp(ad,out); };
+
+  // binary data elements are not merged
+  APIData ad = call({"a"});
+  std::shared_ptr<BinaryData> bd(new BinaryData());
+  bd->push_back(BinaryEl("0",std::make_shared<const std::string>("raw"),0,3));
+  ad.set_binary_data(bd);
+  APIData out;
+  ASSERT_EQ(0,pb.predict(ad,out,pfunc));
+  ASSERT_EQ(1,fp._calls);
+  ASSERT_EQ(0,pb.stats().get("batches").get<double>());
+
+  // nor measures
+  APIData adm = call({"b"});
+  APIData ad_output;
+  ad_output.add("measure",std::vector<std::string>{"acc"});
+  APIData ad_param;
+  ad_param.add("output",ad_output);
+  adm.add("parameters",ad_param);
+  ASSERT_EQ(0,pb.predict(adm,out,pfunc));
+  ASSERT_EQ(2,fp._calls);
+  ASSERT_EQ(0,pb.stats().get("batches").get<double>());
+}
@@ -22,7 +22,11 @@
 #include "simsearch.h"
 #include "jsonapi.h"
 #include <gtest/gtest.h>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <random>
 
 using namespace dd;
 
@@ -96,6 +100,178 @@ TEST(annoyse,index_search_incr)
   rmdir(model_repo.c_str());
 }
 
+TEST(hnswse,index_search_incr)
+{
+  std::vector<double> vec1 = {1.0,0.0,0.0,0.0};
+  std::vector<double> vec2 = {0.0,1.0,0.0,0.0};
+  std::vector<double> vec3 = {1.0,0.0,1.0,0.0};
+  std::vector<double> vec4 = {0.0,0.0,5.0,5.0};
+  
+  int t = 4;
+  std::string model_repo = "simsearch";
+  mkdir(model_repo.c_str(),0770);
+  {
+    HnswSE hse(t,model_repo);
+    hse.create_index();
+    hse.index(URIData("test1"),vec1);
+    hse.index(URIData("test2"),vec2);
+    hse.index(URIData("test3"),vec3);
+    std::vector<URIData> uris;
+    std::vector<double> distances;
+    hse.search(vec1,3,uris,distances); // searchable before saving
+    ASSERT_EQ(3,uris.size());
+    ASSERT_EQ("test1",uris.at(0)._uri);
+    ASSERT_NEAR(0.0,distances.at(0),1e-5);
+    hse.update_index(); // saving
+    hse.index(URIData("test4"),vec4); // indexing after save
+    uris.clear();
+    distances.clear();
+    hse.search(vec4,3,uris,distances);
+    ASSERT_EQ("test4",uris.at(0)._uri);
+    ASSERT_EQ("test3",uris.at(1)._uri);
+    hse.update_index();
+  }
+  HnswSE hse(t,model_repo); // reload from repository
+  hse.create_index();
+  std::vector<URIData> uris;
+  std::vector<double> distances;
+  hse.search(vec2,4,uris,distances);
+  ASSERT_EQ(4,uris.size());
+  ASSERT_EQ("test2",uris.at(0)._uri);
+  hse.remove_index();
+  rmdir(model_repo.c_str());
+}
+
+TEST(hnswse,index_search_pq)
+{
+  int t = 8;
+  std::string model_repo = "simsearch";
+  mkdir(model_repo.c_str(),0770);
+  std::mt19937 rng(1);
+  std::normal_distribution<double> nd;
+  std::vector<std::vector<double>> vecs(300,std::vector<double>(t));
+  for (auto &v: vecs)
+    for (auto &x: v)
+      x = nd(rng);
+  HnswSE hse(t,model_repo);
+  hse._storage = HnswStorage::pq;
+  hse._pq_train_size = 100; // codebook trained after the first 100 vectors
+  hse.create_index();
+  for (size_t i=0;i<vecs.size();i++)
+    hse.index(URIData("test"+std::to_string(i)),vecs.at(i));
+  ASSERT_TRUE(hse._hindex->vectors_bytes() < vecs.size()*t*sizeof(float));
+  for (size_t i=0;i<vecs.size();i+=50)
+    {
+      std::vector<URIData> uris;
+      std::vector<double> distances;
+      hse.search(vecs.at(i),5,uris,distances); // re-ranked with exact vectors
+      ASSERT_EQ(5,uris.size());
+      ASSERT_EQ("test"+std::to_string(i),uris.at(0)._uri);
+      ASSERT_NEAR(0.0,distances.at(0),1e-3);
+    }
+  hse.remove_index();
+  rmdir(model_repo.c_str());
+}
+
+TEST(hnswse,search_batch)
+{
+  int t = 8;
+  std::string model_repo = "simsearch";
+  mkdir(model_repo.c_str(),0770);
+  std::mt19937 rng(2);
+  std::normal_distribution<double> nd;
+  std::vector<std::vector<double>> vecs(200,std::vector<double>(t));
+  for (auto &v: vecs)
+    for (auto &x: v)
+      x = nd(rng);
+  SearchEngine<HnswSE> se(t,model_repo);
+  se.create_index();
+  for (size_t i=0;i<vecs.size();i++)
+    se.index(URIData("test"+std::to_string(i)),vecs.at(i));
+  std::vector<std::vector<double>> queries(vecs.begin(),vecs.begin()+50);
+  std::vector<std::vector<URIData>> buris;
+  std::vector<std::vector<double>> bdistances;
+  se.search_batch(queries,5,buris,bdistances);
+  ASSERT_EQ(queries.size(),buris.size());
+  for (size_t i=0;i<queries.size();i++)
+    {
+      std::vector<URIData> uris;
+      std::vector<double> distances;
+      se.search(queries.at(i),5,uris,distances);
+      ASSERT_EQ(uris.size(),buris.at(i).size());
+      for (size_t j=0;j<uris.size();j++)
+	{
+	  ASSERT_EQ(uris.at(j)._uri,buris.at(i).at(j)._uri);
+	  ASSERT_EQ(distances.at(j),bdistances.at(i).at(j));
+	}
+    }
+  se.remove_index();
+  rmdir(model_repo.c_str());
+}
+
+TEST(hnswindex,load_corrupt)
+{
+  int t = 8;
+  uint64_t n = 50;
+  std::mt19937 rng(3);
+  std::normal_distribution<double> nd;
+  HnswIndex hi(t);
+  std::vector<double> v(t);
+  for (uint64_t i=0;i<n;i++)
+    {
+      for (auto &x: v)
+	x = nd(rng);
+      hi.add(v.data());
+    }
+  std::string fname = "hnsw_test.idx";
+  ASSERT_TRUE(hi.save(fname));
+  std::ifstream in(fname,std::ios::binary);
+  std::string content((std::istreambuf_iterator<char>(in)),std::istreambuf_iterator<char>());
+  in.close();
+  HnswIndex hl(t);
+  ASSERT_TRUE(hl.load(fname));
+  ASSERT_EQ(static_cast<int>(n),hl.size());
+
+  auto load_content = [&](const std::string &c)
+    {
+      std::ofstream out(fname,std::ios::binary|std::ios::trunc);
+      out.write(c.data(),c.size());
+      out.close();
+      HnswIndex hc(t);
+      return hc.load(fname);
+    };
+
+  // truncated
+  ASSERT_FALSE(load_content(content.substr(0,content.size()/2)));
+  ASSERT_FALSE(load_content(content.substr(0,content.size()-1)));
+
+  // huge node count
+  std::string bad = content;
+  uint64_t bad_n = 1ULL << 40;
+  bad.replace(40,sizeof(bad_n),reinterpret_cast<const char*>(&bad_n),sizeof(bad_n));
+  ASSERT_FALSE(load_content(bad));
+
+  // bad link id, first link of the first node: header, count, vectors, then level and links size
+  size_t link_pos = 40 + 8 + 8 + n*t*sizeof(float) + 3*8 + 4 + 8;
+  uint64_t nlinks = 0;
+  std::memcpy(&nlinks,content.data()+link_pos-8,sizeof(nlinks));
+  ASSERT_TRUE(nlinks > 0);
+  bad = content;
+  int32_t bad_id = n + 5;
+  bad.replace(link_pos,sizeof(bad_id),reinterpret_cast<const char*>(&bad_id),sizeof(bad_id));
+  ASSERT_FALSE(load_content(bad));
+
+  // bad M
+  bad = content;
+  int32_t bad_M = 1;
+  bad.replace(8,sizeof(bad_M),reinterpret_cast<const char*>(&bad_M),sizeof(bad_M));
+  ASSERT_FALSE(load_content(bad));
+
+  // unchanged content still loads
+  ASSERT_TRUE(load_content(content));
+  remove(fname.c_str());
+}
+
 TEST(simsearch,predict_simsearch_unsup)
 {
   // create service
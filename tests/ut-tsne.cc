@@ -0,0 +1,178 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2019 Jolibrain
+ * Author: Emmanuel Benazera <beniz@droidnik.fr>
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "deepdetect.h"
+#include "jsonapi.h"
+#include "backends/tsne/bhtsne.h"
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+using namespace dd;
+
+static std::string created_str = "{\"status\":{\"code\":201,\"msg\":\"Created\"}}";
+
+static std::string tsne_repo = "tsne_test/";
+
+// three gaussian clusters
+static std::vector<double> clusters(const int &N, const int &D, const int &seed)
+{
+  std::mt19937 g(seed);
+  std::normal_distribution<double> gauss(0.0,1.0);
+  std::vector<double> X(static_cast<size_t>(N)*D);
+  for (int n=0;n<N;n++)
+    for (int d=0;d<D;d++)
+      X[static_cast<size_t>(n)*D+d] = gauss(g) + (d == n % 3 ? 10.0 : 0.0);
+  return X;
+}
+
+TEST(tsne,bhtsne_embedding)
+{
+  int N = 150, D = 10, iterations = 500, test_iter = 50;
+  std::vector<double> X = clusters(N,D,42);
+  std::vector<double> Y(2*N,0.0);
+  std::atomic<bool> running(true);
+  BHTSNE tsne(N,D,10.0,0.5,2,42);
+  ASSERT_TRUE(tsne.step1(X.data(),Y.data(),running));
+  double loss = 0.0, first_loss = -1.0;
+  for (int iter=0;iter<iterations;iter++)
+    {
+      tsne.step2_one_iter(Y.data(),iter,loss,test_iter);
+      if (iter == tsne._stop_lying_iter) // loss without exaggeration
+	first_loss = loss;
+    }
+  ASSERT_TRUE(first_loss > 0.0);
+  ASSERT_TRUE(loss > 0.0);
+  ASSERT_TRUE(loss < first_loss);
+  for (double y: Y)
+    ASSERT_TRUE(std::isfinite(y));
+
+  // points from a same cluster are closer than from the others, on average
+  double intra = 0.0, inter = 0.0;
+  for (int i=0;i<N;i++)
+    for (int j=i+1;j<N;j++)
+      {
+	double dx = Y[2*i] - Y[2*j], dy = Y[2*i+1] - Y[2*j+1];
+	double dist = std::sqrt(dx*dx + dy*dy);
+	if (i % 3 == j % 3)
+	  intra += dist;
+	else inter += dist;
+      }
+  ASSERT_TRUE(intra / (N*(N/3-1)/2) < inter / (N*N/3));
+
+  // same seed, same embedding
+  std::vector<double> X2 = clusters(N,D,42);
+  std::vector<double> Y2(2*N,0.0);
+  BHTSNE tsne2(N,D,10.0,0.5,2,42);
+  ASSERT_TRUE(tsne2.step1(X2.data(),Y2.data(),running));
+  std::vector<double> Y3(2*N,0.0);
+  std::vector<double> X3 = clusters(N,D,42);
+  BHTSNE tsne3(N,D,10.0,0.5,2,42);
+  ASSERT_TRUE(tsne3.step1(X3.data(),Y3.data(),running));
+  ASSERT_EQ(Y2,Y3);
+}
+
+TEST(tsne,bhtsne_cancel)
+{
+  int N = 150, D = 10;
+  std::vector<double> X = clusters(N,D,42);
+  std::vector<double> Y(2*N,0.0);
+  std::atomic<bool> running(false);
+  BHTSNE tsne(N,D,10.0,0.5,2,42);
+  ASSERT_FALSE(tsne.step1(X.data(),Y.data(),running));
+}
+
+TEST(tsne,service_train_snapshot_cancel)
+{
+  int N = 300, D = 10;
+  mkdir(tsne_repo.c_str(),0755);
+  std::vector<double> X = clusters(N,D,42);
+  std::ofstream csv(tsne_repo + "clusters.csv");
+  for (int d=0;d<D;d++)
+    csv << (d > 0 ? "," : "") << "f" << d;
+  csv << std::endl;
+  for (int n=0;n<N;n++)
+    {
+      for (int d=0;d<D;d++)
+	csv << (d > 0 ? "," : "") << X[static_cast<size_t>(n)*D+d];
+      csv << std::endl;
+    }
+  csv.close();
+
+  // service
+  JsonAPI japi;
+  std::string sname = "my_service";
+  std::string jstr = "{\"mllib\":\"tsne\",\"description\":\"my tsne\",\"type\":\"unsupervised\",\"model\":{\"repository\":\"" + tsne_repo + "\"},\"parameters\":{\"input\":{\"connector\":\"csv\"}}}";
+  std::string joutstr = japi.jrender(japi.service_create(sname,jstr));
+  ASSERT_EQ(created_str,joutstr);
+
+  // train, long enough to be cancelled
+  std::string jtrainstr = "{\"service\":\"" + sname + "\",\"async\":true,\"parameters\":{\"mllib\":{\"iterations\":1000000,\"perplexity\":10,\"snapshot_interval\":10}},\"data\":[\"" + tsne_repo + "clusters.csv\"]}";
+  joutstr = japi.jrender(japi.service_train(jtrainstr));
+  std::cout << "joutstr=" << joutstr << std::endl;
+  JDoc jd;
+  jd.Parse(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(201,jd["status"]["code"].GetInt());
+
+  // status, until a snapshot of the embedding is available
+  bool snapshot = false;
+  for (int t=0;t<30 && !snapshot;t++)
+    {
+      std::string jstatusstr = "{\"service\":\"" + sname + "\",\"job\":1,\"timeout\":1,\"parameters\":{\"output\":{\"embedding\":true}}}";
+      joutstr = japi.jrender(japi.service_train_status(jstatusstr));
+      JDoc jd2;
+      jd2.Parse(joutstr.c_str());
+      ASSERT_TRUE(!jd2.HasParseError());
+      ASSERT_EQ(200,jd2["status"]["code"]);
+      ASSERT_EQ("running",jd2["head"]["status"]);
+      if (jd2["body"].HasMember("embedding"))
+	{
+	  std::cout << "iteration=" << jd2["body"]["embedding"]["iteration"].GetInt() << std::endl;
+	  ASSERT_EQ(0,jd2["body"]["embedding"]["iteration"].GetInt() % 10);
+	  ASSERT_EQ(N,jd2["body"]["embedding"]["points"].GetInt());
+	  ASSERT_EQ(2,jd2["body"]["embedding"]["dims"].GetInt());
+	  std::string b64 = jd2["body"]["embedding"]["data"].GetString();
+	  ASSERT_EQ(4*((N*2*sizeof(float)+2)/3),b64.size());
+	  snapshot = true;
+	}
+    }
+  ASSERT_TRUE(snapshot);
+
+  // cancel
+  std::string jdelstr = "{\"service\":\"" + sname + "\",\"job\":1}";
+  joutstr = japi.jrender(japi.service_train_delete(jdelstr));
+  std::cout << "joutstr=" << joutstr << std::endl;
+  JDoc jd3;
+  jd3.Parse(joutstr.c_str());
+  ASSERT_TRUE(!jd3.HasParseError());
+  ASSERT_EQ(200,jd3["status"]["code"]);
+  ASSERT_EQ("terminated",jd3["head"]["status"]);
+
+  // remove service
+  jstr = "{\"clear\":\"full\"}";
+  joutstr = japi.jrender(japi.service_delete(sname,jstr));
+  ASSERT_EQ("{\"status\":{\"code\":200,\"msg\":\"OK\"}}",joutstr);
+}
@@ -28,6 +28,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <iostream>
+#include <chrono>
 
 using namespace dd;
 
@@ -114,6 +115,64 @@ TEST(xgbapi,service_train_csv)
   ASSERT_TRUE(fileops::file_exists(forest_repo + "/" + JsonAPI::_json_blob_fname));
 }
 
+TEST(xgbapi,service_predict_dense)
+{
+  JsonAPI japi;
+  std::string sname = "my_service";
+  std::string jstr = "{\"mllib\":\"xgboost\",\"description\":\"my classifier\",\"type\":\"supervised\",\"model\":{\"repository\":\"" +  forest_repo + "\"},\"parameters\":{\"input\":{\"connector\":\"csv\"},\"mllib\":{\"nclasses\":7}}}";
+  std::string joutstr = japi.jrender(japi.service_create(sname,jstr));
+  ASSERT_EQ(created_str,joutstr);
+  std::string jtrainstr = "{\"service\":\"" + sname + "\",\"async\":false,\"parameters\":{\"input\":{\"label\":\"Cover_Type\",\"id\":\"Id\",\"test_split\":0.1,\"label_offset\":-1,\"shuffle\":true},\"mllib\":{\"iterations\":" + iterations_forest + ",\"objective\":\"multi:softprob\"}},\"data\":[\"" + forest_repo + "train.csv\"]}";
+  joutstr = japi.jrender(japi.service_train(jtrainstr));
+  JDoc jd;
+  jd.Parse(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(201,jd["status"]["code"].GetInt());
+
+  // same row through the CSV path and the dense path, compact output
+  std::string mem_data = "2499,326,7,300,88,480,202,232,169,1676,0,0,0,1,0,0,0,0,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0";
+  std::string jpredictstr = "{\"service\":\""+ sname + "\",\"parameters\":{\"input\":{\"connector\":\"csv\",\"scale\":false},\"output\":{\"compact\":true}},\"data\":[\"" + mem_data + "\"]}";
+  std::string jpredictstr_dense = "{\"service\":\""+ sname + "\",\"parameters\":{\"input\":{\"connector\":\"csv\",\"scale\":false,\"dense\":true},\"output\":{\"compact\":true}},\"data\":[\"" + mem_data + "\"]}";
+  joutstr = japi.jrender(japi.service_predict(jpredictstr));
+  std::cout << "joutstr=" << joutstr << std::endl;
+  jd.Parse(joutstr.c_str());
+  ASSERT_TRUE(!jd.HasParseError());
+  ASSERT_EQ(200,jd["status"]["code"].GetInt());
+  ASSERT_EQ(7,jd["body"]["predictions"][0]["vals"].Size());
+  JDoc jd_dense;
+  joutstr = japi.jrender(japi.service_predict(jpredictstr_dense));
+  std::cout << "joutstr=" << joutstr << std::endl;
+  jd_dense.Parse(joutstr.c_str());
+  ASSERT_TRUE(!jd_dense.HasParseError());
+  ASSERT_EQ(200,jd_dense["status"]["code"].GetInt());
+  ASSERT_EQ(7,jd_dense["body"]["predictions"][0]["vals"].Size());
+  for (int i=0;i<7;i++)
+    ASSERT_NEAR(jd["body"]["predictions"][0]["vals"][i].GetDouble(),
+		jd_dense["body"]["predictions"][0]["vals"][i].GetDouble(),1e-6);
+
+  // rows of different sizes
+  joutstr = japi.jrender(japi.service_predict("{\"service\":\""+ sname + "\",\"parameters\":{\"input\":{\"connector\":\"csv\",\"scale\":false,\"dense\":true}},\"data\":[\"1,2,3\",\"1,2\"]}"));
+  jd.Parse(joutstr.c_str());
+  ASSERT_EQ(400,jd["status"]["code"].GetInt());
+
+  // latency, full CSV path vs dense path with compact output
+  int niters = 1000;
+  std::string jpredictstr_full = "{\"service\":\""+ sname + "\",\"parameters\":{\"input\":{\"connector\":\"csv\",\"scale\":false}},\"data\":[\"" + mem_data + "\"]}";
+  std::vector<std::pair<std::string,std::string>> benches = {{"csv",jpredictstr_full},{"dense",jpredictstr_dense}};
+  for (auto &b: benches)
+    {
+      std::chrono::time_point<std::chrono::system_clock> tstart = std::chrono::system_clock::now();
+      for (int i=0;i<niters;i++)
+	japi.service_predict(b.second);
+      double us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now()-tstart).count() / static_cast<double>(niters);
+      std::cout << "predict latency " << b.first << "=" << us << "us" << std::endl;
+    }
+
+  jstr = "{\"clear\":\"lib\"}";
+  joutstr = japi.jrender(japi.service_delete(sname,jstr));
+  ASSERT_EQ(ok_str,joutstr);
+}
+
 TEST(xgbapi,service_train_txt)
 {
   // create service
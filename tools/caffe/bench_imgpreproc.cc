@@ -0,0 +1,140 @@
+/**
+ * DeepDetect
+ * Copyright (c) 2019 Jolibrain
+ * Author: Emmanuel Benazera <beniz@droidnik.fr>
+ *
+ * This file is part of deepdetect.
+ *
+ * deepdetect is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * deepdetect is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with deepdetect.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "imgpreproc.h"
+#include "caffe/caffe.hpp"
+#include "caffe/layers/memory_data_layer.hpp"
+#include "caffe/util/io.hpp"
+#include <opencv2/core/core.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <cstdlib>
+
+using namespace dd;
+
+typedef std::chrono::steady_clock bclock;
+
+static caffe::LayerParameter memory_data_param(const int &batch_size, const int &channels,
+					       const int &height, const int &width)
+{
+  caffe::LayerParameter lp;
+  lp.set_name("data");
+  lp.set_type("MemoryData");
+  caffe::MemoryDataParameter *mdp = lp.mutable_memory_data_param();
+  mdp->set_batch_size(batch_size);
+  mdp->set_channels(channels);
+  mdp->set_height(height);
+  mdp->set_width(width);
+  return lp;
+}
+
+/**
+ * \brief compares the Datum based image path to the fused ImgPreproc path,
+ *        from resized cv::Mat to filled input blob, with per channel mean subtraction
+ */
+int main(int argc, char **argv)
+{
+  int batch_size = argc > 1 ? atoi(argv[1]) : 32;
+  int side = argc > 2 ? atoi(argv[2]) : 224;
+  int iterations = argc > 3 ? atoi(argv[3]) : 20;
+  const int channels = 3;
+  if (batch_size <= 0 || side <= 0 || iterations <= 0)
+    {
+      std::cerr << "usage: " << argv[0] << " [batch_size] [side] [iterations]" << std::endl;
+      return 1;
+    }
+  caffe::Caffe::set_mode(caffe::Caffe::CPU);
+
+  std::vector<cv::Mat> imgs(batch_size);
+  for (cv::Mat &img: imgs)
+    {
+      img.create(side,side,CV_8UC3);
+      cv::randu(img,cv::Scalar::all(0),cv::Scalar::all(255));
+    }
+  float mean[channels] = {104.0, 117.0, 123.0};
+
+  caffe::Blob<float> data, label;
+  std::vector<caffe::Blob<float>*> bottom, top = {&data,&label};
+
+  // current path: Datum, mean subtraction on the Datum, copy into the batch
+  caffe::MemoryDataLayer<float> dlayer(memory_data_param(batch_size,channels,side,side));
+  dlayer.SetUp(bottom,top);
+  double datum_ms = 0.0;
+  for (int it=0;it<iterations;it++)
+    {
+      bclock::time_point tstart = bclock::now();
+      std::vector<caffe::Datum> dv;
+      for (const cv::Mat &img: imgs)
+	{
+	  caffe::Datum datum;
+	  caffe::CVMatToDatum(img,&datum);
+	  for (int c=0;c<datum.channels();++c)
+	    for (int h=0;h<datum.height();++h)
+	      for (int w=0;w<datum.width();++w)
+		{
+		  int data_index = (c*datum.height()+h)*datum.width()+w;
+		  float datum_element = static_cast<float>(static_cast<uint8_t>(datum.data()[data_index]));
+		  datum.add_float_data(datum_element - mean[c]);
+		}
+	  datum.clear_data();
+	  dv.push_back(datum);
+	}
+      dlayer.AddDatumVector(dv);
+      dlayer.Forward(bottom,top);
+      datum_ms += std::chrono::duration_cast<std::chrono::microseconds>(bclock::now()-tstart).count() / 1000.0;
+    }
+  std::vector<float> ref(data.cpu_data(),data.cpu_data()+data.count());
+
+  // fused path: single pass per image into the batch memory
+  caffe::MemoryDataLayer<float> flayer(memory_data_param(batch_size,channels,side,side));
+  flayer.SetUp(bottom,top);
+  std::vector<float> fdata(static_cast<size_t>(batch_size)*channels*side*side);
+  std::vector<float> flabels(batch_size,0.0);
+  ImgPreproc::Params pp;
+  pp._mean = mean;
+  double fused_ms = 0.0;
+  for (int it=0;it<iterations;it++)
+    {
+      bclock::time_point tstart = bclock::now();
+      size_t dsize = static_cast<size_t>(channels)*side*side;
+      for (int i=0;i<batch_size;i++)
+	ImgPreproc::convert(imgs.at(i),fdata.data()+i*dsize,pp);
+      flayer.Reset(fdata.data(),flabels.data(),batch_size);
+      flayer.Forward(bottom,top);
+      fused_ms += std::chrono::duration_cast<std::chrono::microseconds>(bclock::now()-tstart).count() / 1000.0;
+    }
+
+  double maxdiff = 0.0;
+  for (size_t i=0;i<ref.size();i++)
+    maxdiff = std::max(maxdiff,static_cast<double>(std::abs(ref[i]-data.cpu_data()[i])));
+
+  std::cout << "batch_size=" << batch_size << " image=" << side << "x" << side
+	    << " iterations=" << iterations << std::endl;
+  std::cout << "datum: " << datum_ms / iterations << " ms/batch, "
+	    << datum_ms / (iterations*batch_size) << " ms/image" << std::endl;
+  std::cout << "fused: " << fused_ms / iterations << " ms/batch, "
+	    << fused_ms / (iterations*batch_size) << " ms/image" << std::endl;
+  std::cout << "speedup: " << (fused_ms > 0.0 ? datum_ms / fused_ms : 0.0)
+	    << " max abs diff: " << maxdiff << std::endl;
+  return maxdiff > 1e-4 ? 1 : 0;
+}